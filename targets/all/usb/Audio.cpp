@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Audio.cpp
+ */
+
+#include <usb/Audio.h>
+
+namespace usb
+{
+
+namespace
+{
+
+enum
+{
+    ClockSamplingFrequency = 1,
+    ClockValid = 2,
+};
+
+}
+
+/****** AudioRing ******/
+
+uint32_t AudioRing::Write(const void* data, uint32_t frames)
+{
+    uint32_t space = Space();
+    uint32_t n = frames < space ? frames : space;
+    uint32_t index = Index(head);
+    uint32_t first = n < capacity - index ? n : capacity - index;
+
+    memcpy(buffer + index * frameSize, data, first * frameSize);
+    memcpy(buffer, (const uint8_t*)data + first * frameSize, (n - first) * frameSize);
+    head = Advance(head, n);
+    return n;
+}
+
+uint32_t AudioRing::Read(void* data, uint32_t frames)
+{
+    uint32_t level = Level();
+    uint32_t n = frames < level ? frames : level;
+    uint32_t index = Index(tail);
+    uint32_t first = n < capacity - index ? n : capacity - index;
+
+    memcpy(data, buffer + index * frameSize, first * frameSize);
+    memcpy((uint8_t*)data + first * frameSize, buffer, (n - first) * frameSize);
+    tail = Advance(tail, n);
+    return n;
+}
+
+uint32_t AudioRing::WriteSpan(void*& data) const
+{
+    uint32_t space = Space();
+    uint32_t index = Index(head);
+    data = buffer + index * frameSize;
+    return space < capacity - index ? space : capacity - index;
+}
+
+uint32_t AudioRing::ReadSpan(const void*& data) const
+{
+    uint32_t level = Level();
+    uint32_t index = Index(tail);
+    data = buffer + index * frameSize;
+    return level < capacity - index ? level : capacity - index;
+}
+
+/****** AudioFeedback ******/
+
+AudioFeedback::AudioFeedback(uint32_t sampleRate, Speed speed, uint8_t clockShift, uint8_t periodLog2, uint8_t gainShift)
+    : nominal(AudioFramesPerPacket(sampleRate, speed)), frameMask(speed == Speed::High ? 0x3FFF : 0x7FF),
+    clockShift(clockShift), periodLog2(periodLog2), gainShift(gainShift), highSpeed(speed == Speed::High)
+{
+    Reset();
+}
+
+void AudioFeedback::Reset()
+{
+    rate = nominal;
+    started = false;
+}
+
+void AudioFeedback::Sof(uint16_t frame, uint32_t clock)
+{
+    if (!started)
+    {
+        lastFrame = frame;
+        lastClock = clock;
+        started = true;
+        return;
+    }
+
+    uint32_t frames = (frame - lastFrame) & frameMask;
+    if (frames < (1u << periodLog2))
+        return;
+
+    uint32_t measured = uint32_t(((uint64_t(clock - lastClock) << 16) >> clockShift) / frames);
+    lastFrame = frame;
+    lastClock = clock;
+
+    // a measurement far off the nominal rate means the clock was stopped or restarted, it is ignored
+    if (measured < nominal - nominal / 8 || measured > nominal + nominal / 8)
+        return;
+
+    // smooth out the quantization error of the individual measurements
+    rate += (int32_t(measured) - int32_t(rate)) / 4;
+}
+
+uint32_t AudioFeedback::Value(uint32_t level, uint32_t target) const
+{
+    // more data than the target in the ring means the host is sending too fast
+    int32_t correction = (int32_t(target) - int32_t(level)) * (0x10000 >> gainShift);
+    int32_t value = int32_t(rate) + correction;
+
+    // the host can deliver at most one extra frame per (micro)frame, see AudioMaxPacketSize
+    int32_t min = nominal > 0x10000 ? nominal - 0x10000 : 0, max = nominal + 0x10000;
+    return value < min ? min : value > max ? max : value;
+}
+
+size_t AudioFeedback::Encode(void* buffer, uint32_t level, uint32_t target) const
+{
+    uint32_t value = Value(level, target);
+    uint8_t* p = (uint8_t*)buffer;
+
+    if (!highSpeed)
+        value >>= 2;    // 10.14 format
+
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    if (!highSpeed)
+        return 3;
+    p[3] = value >> 24;
+    return 4;
+}
+
+/****** AudioStream ******/
+
+AudioStream::AudioStream(AudioRing& ring, uint32_t sampleRate, Speed speed, uint8_t interval)
+    : ring(ring), nominal(AudioFramesPerPacket(sampleRate, speed, interval)), phase(0), underruns(0), overruns(0)
+{
+}
+
+void AudioStream::Reset()
+{
+    ring.Clear();
+    phase = 0;
+}
+
+size_t AudioStream::NextIn(void* packet, uint32_t rate)
+{
+    phase += rate ? rate : nominal;
+    uint32_t frames = phase >> 16;
+    phase &= 0xFFFF;
+
+    // nudge the level towards the target, keeping a hysteresis of one packet
+    uint32_t level = ring.Level(), target = Target();
+    if (level > target + frames)
+        frames++;
+    else if (level + frames < target && frames)
+        frames--;
+
+    if (frames > MaxPacketFrames())
+        frames = MaxPacketFrames();
+
+    uint32_t n = ring.Read(packet, frames);
+    if (n < frames)
+        underruns++;
+    return n * ring.FrameSize();
+}
+
+void AudioStream::Received(const void* packet, size_t length)
+{
+    uint32_t frames = length / ring.FrameSize();
+    if (ring.Write(packet, frames) < frames)
+        overruns++;
+}
+
+/****** AudioClock ******/
+
+ControlResult AudioClock::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    if ((setup.wIndex >> 8) != clockId)
+        return ControlResult::Unhandled();
+
+    unsigned control = setup.wValue >> 8;
+
+    switch (setup.bRequest)
+    {
+        case SetupPacket::ClassAudioCur:
+            if (control == ClockSamplingFrequency)
+            {
+                if (setup.direction == SetupPacket::DirIn)
+                {
+                    memcpy(response, &rate, 4);
+                    return ControlResult::In(response, 4);
+                }
+
+                if (stage == ControlStage::Setup)
+                {
+                    if (setup.wLength != 4)
+                        break;
+                    return ControlResult::Out(&request, 4);
+                }
+
+                for (unsigned i = 0; i < count; i++)
+                {
+                    if (rates[i] == request)
+                    {
+                        rate = request;
+                        return ControlResult::Ack();
+                    }
+                }
+                break;
+            }
+
+            if (control == ClockValid && setup.direction == SetupPacket::DirIn)
+            {
+                response[0] = 1;
+                return ControlResult::In(response, 1);
+            }
+            break;
+
+        case SetupPacket::ClassAudioRange:
+        {
+            if (control != ClockSamplingFrequency)
+                break;
+
+            // every supported rate is a separate subrange with zero resolution
+            unsigned n = count < 8 ? count : 8;
+            response[0] = n;
+            response[1] = 0;
+            for (unsigned i = 0; i < n; i++)
+            {
+                uint32_t range[3] = { rates[i], rates[i], 0 };
+                memcpy(response + 2 + i * 12, range, 12);
+            }
+            return ControlResult::In(response, 2 + n * 12);
+        }
+
+        default:
+            break;
+    }
+
+    return ControlResult::Stall();
+}
+
+}
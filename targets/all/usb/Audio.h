@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Audio.h
+ *
+ * USB Audio 2.0 isochronous streaming
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Audio 2.0 terminal types
+enum struct AudioTerminal : uint16_t
+{
+    UsbStreaming = 0x0101,      //!< USB streaming terminal
+    Microphone = 0x0201,        //!< Generic microphone
+    Speaker = 0x0301,           //!< Generic speaker
+    Headphones = 0x0302,        //!< Headphones
+    LineConnector = 0x0603,     //!< Analog line connector
+    SpdifInterface = 0x0605,    //!< S/PDIF digital interface
+};
+
+//! Audio 2.0 function categories, reported in the AudioControl header
+enum struct AudioCategory : uint8_t
+{
+    DesktopSpeaker = 0x01,
+    HomeTheater = 0x02,
+    Microphone = 0x03,
+    Headset = 0x04,
+    Converter = 0x07,
+    IoBox = 0x08,
+    ProAudio = 0x0A,
+    Other = 0xFF,
+};
+
+//! Creates a Clock Source descriptor, by default an internal fixed clock with read-only sampling frequency control
+constexpr auto AudioClockSource(uint8_t id, uint8_t attributes = 0x01, uint8_t controls = 0x01, uint8_t assocTerminal = 0, uint8_t strName = 0)
+{
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioClockSource, id, attributes, controls, assocTerminal, strName);
+}
+
+//! Creates an Input Terminal descriptor
+constexpr auto AudioInputTerminal(uint8_t id, AudioTerminal type, uint8_t clockId, uint8_t channels, uint32_t channelConfig = 0, uint8_t assocTerminal = 0, uint16_t controls = 0, uint8_t strName = 0)
+{
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioInputTerminal, id, type, assocTerminal, clockId, channels, channelConfig, uint8_t(0), controls, strName);
+}
+
+//! Creates an Output Terminal descriptor
+constexpr auto AudioOutputTerminal(uint8_t id, AudioTerminal type, uint8_t sourceId, uint8_t clockId, uint8_t assocTerminal = 0, uint16_t controls = 0, uint8_t strName = 0)
+{
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioOutputTerminal, id, type, assocTerminal, sourceId, clockId, controls, strName);
+}
+
+//! Creates an AudioControl interface with the specified clock, terminal and unit descriptors
+/*!
+ * The class-specific header, including the total length of the @p entities, is generated automatically
+ */
+template<typename... TEntities> constexpr auto AudioControlInterface(uint8_t interface, AudioCategory category, uint8_t strName, const TEntities&... entities)
+{
+    uint16_t total = sizeof(CustomDescriptor<DescriptorSubType, uint16_t, AudioCategory, uint16_t, uint8_t>) + (sizeof(TEntities) + ... + 0);
+    return InterfaceDescriptor(interface, 0, InterfaceClass::Audio, SubClass::AudioControl, Protocol::AudioV2, strName,
+        ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioHeader, uint16_t(0x0200), category, total, uint8_t(0)),
+        entities...);
+}
+
+//! Creates the alternate settings of an AudioStreaming interface carrying PCM data
+/*!
+ * Alternate setting 0 has no endpoints, alternate setting 1 contains the @p data endpoint
+ * and optionally an explicit @p feedback endpoint (see the overload below).
+ */
+constexpr auto AudioStreamingInterface(uint8_t interface, uint8_t terminalLink, uint8_t channels, uint8_t subslotSize, uint8_t bitResolution,
+    const EndpointDescriptor& data, uint32_t channelConfig = 0, uint8_t strName = 0)
+{
+    return DescriptorGroup(
+        InterfaceDescriptor(interface, 0, InterfaceClass::Audio, SubClass::AudioStreaming, Protocol::AudioV2, strName),
+        InterfaceDescriptor(interface, 1, InterfaceClass::Audio, SubClass::AudioStreaming, Protocol::AudioV2, strName,
+            // PCM format, no controls
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioStreamGeneral, terminalLink, uint8_t(0), uint8_t(1), uint32_t(1), channels, channelConfig, uint8_t(0)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioFormatType, uint8_t(1), subslotSize, bitResolution),
+            data,
+            ClassSpecificEndpointDescriptor(DescriptorSubType::AudioEndpointGeneral, uint8_t(0), uint8_t(0), uint8_t(0), uint16_t(0))));
+}
+
+//! Creates the alternate settings of an AudioStreaming interface carrying PCM data, with an explicit feedback endpoint
+constexpr auto AudioStreamingInterface(uint8_t interface, uint8_t terminalLink, uint8_t channels, uint8_t subslotSize, uint8_t bitResolution,
+    const EndpointDescriptor& data, const EndpointDescriptor& feedback, uint32_t channelConfig = 0, uint8_t strName = 0)
+{
+    return DescriptorGroup(
+        InterfaceDescriptor(interface, 0, InterfaceClass::Audio, SubClass::AudioStreaming, Protocol::AudioV2, strName),
+        InterfaceDescriptor(interface, 1, InterfaceClass::Audio, SubClass::AudioStreaming, Protocol::AudioV2, strName,
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioStreamGeneral, terminalLink, uint8_t(0), uint8_t(1), uint32_t(1), channels, channelConfig, uint8_t(0)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::AudioFormatType, uint8_t(1), subslotSize, bitResolution),
+            data,
+            ClassSpecificEndpointDescriptor(DescriptorSubType::AudioEndpointGeneral, uint8_t(0), uint8_t(0), uint8_t(0), uint16_t(0)),
+            feedback));
+}
+
+//! Gets the number of (micro)frames per second at the specified bus speed
+constexpr unsigned FramesPerSecond(Speed speed) { return speed == Speed::High ? 8000 : 1000; }
+
+//! Gets the nominal number of audio frames per isochronous packet, in 16.16 fixed point
+/*!
+ * @p interval is the bInterval of the endpoint, i.e. packets are sent every 2^(interval-1) (micro)frames
+ */
+constexpr uint32_t AudioFramesPerPacket(uint32_t sampleRate, Speed speed, uint8_t interval = 1)
+{
+    return uint32_t((uint64_t(sampleRate) << (16 + interval - 1)) / FramesPerSecond(speed));
+}
+
+//! Gets the wMaxPacketSize required for the specified stream, allowing one extra audio frame for rate adaptation
+constexpr uint16_t AudioMaxPacketSize(uint32_t sampleRate, Speed speed, unsigned frameSize, uint8_t interval = 1)
+{
+    return uint16_t((((AudioFramesPerPacket(sampleRate, speed, interval) + 0xFFFF) >> 16) + 1) * frameSize);
+}
+
+//! Ring buffer of audio frames between the USB and the codec side of a stream
+/*!
+ * Suitable for a single producer and a single consumer, each side only updates its own counter.
+ * The span-based methods allow the codec side to use the ring directly as a DMA buffer.
+ *
+ * The capacity does not have to be a power of two (e.g. 480 frames for 10 ms at 48 kHz), the counters
+ * wrap at twice the capacity, which keeps a full ring distinguishable from an empty one.
+ */
+class AudioRing
+{
+public:
+    //! Creates a ring of @p capacity frames (less than 2^31) of @p frameSize bytes each in the provided buffer
+    AudioRing(void* buffer, uint32_t capacity, uint16_t frameSize)
+        : buffer((uint8_t*)buffer), capacity(capacity), frameSize(frameSize) {}
+
+    //! Gets the capacity of the ring in frames
+    uint32_t Capacity() const { return capacity; }
+    //! Gets the size of a single frame in bytes
+    uint16_t FrameSize() const { return frameSize; }
+    //! Gets the number of frames stored in the ring
+    uint32_t Level() const { uint32_t n = head - tail; return n > 2 * capacity ? n + 2 * capacity : n; }
+    //! Gets the number of frames that can be added to the ring
+    uint32_t Space() const { return capacity - Level(); }
+
+    //! Copies frames into the ring, returns the number of frames actually written
+    uint32_t Write(const void* data, uint32_t frames);
+    //! Copies frames from the ring, returns the number of frames actually read
+    uint32_t Read(void* data, uint32_t frames);
+
+    //! Gets the contiguous space available for writing, returns its length in frames
+    uint32_t WriteSpan(void*& data) const;
+    //! Adds @p frames written to the span returned by WriteSpan
+    void Commit(uint32_t frames) { head = Advance(head, frames); }
+    //! Gets the contiguous frames available for reading, returns their count
+    uint32_t ReadSpan(const void*& data) const;
+    //! Removes @p frames read from the span returned by ReadSpan
+    void Consume(uint32_t frames) { tail = Advance(tail, frames); }
+
+    //! Discards all frames in the ring
+    void Clear() { tail = head; }
+
+private:
+    uint8_t* buffer;
+    uint32_t capacity;
+    uint16_t frameSize;
+    volatile uint32_t head = 0;     // count of frames written, modulo 2 * capacity
+    volatile uint32_t tail = 0;     // count of frames read, modulo 2 * capacity
+
+    uint32_t Advance(uint32_t counter, uint32_t frames) const { counter += frames; return counter >= 2 * capacity ? counter - 2 * capacity : counter; }
+    uint32_t Index(uint32_t counter) const { return counter >= capacity ? counter - capacity : counter; }
+};
+
+//! Explicit feedback calculator for asynchronous isochronous OUT streams
+/*!
+ * Measures the rate of the device audio clock against the USB (micro)frame clock. The driver
+ * calls Sof() on every start of frame with the current value of a free-running counter of
+ * the audio clock, which runs at 2^clockShift times the sample rate (e.g. a timer counting
+ * MCLK ticks at 256x the sample rate, using @p clockShift 8, gives a more precise measurement
+ * than a sample counter).
+ *
+ * The measured rate is corrected by a proportional controller keeping the level of the ring
+ * buffer at the target, which compensates for the phase errors the rate measurement alone
+ * cannot observe. The result is reported in 10.14 format at full speed (3 bytes) and in 16.16
+ * format at high speed (4 bytes), in audio frames per (micro)frame.
+ */
+class AudioFeedback
+{
+public:
+    //! Creates the feedback calculator
+    /*!
+     * @param periodLog2 log2 of the number of (micro)frames over which the clock is measured
+     * @param gainShift the correction is 2^-gainShift audio frames per (micro)frame for each frame of ring level error
+     */
+    AudioFeedback(uint32_t sampleRate, Speed speed, uint8_t clockShift = 0, uint8_t periodLog2 = 6, uint8_t gainShift = 6);
+
+    //! Records the audio clock counter at a start of frame
+    /*!
+     * @p frame is the (micro)frame number - the 11-bit frame number at full speed, or
+     * the 14-bit combination of frame and microframe number at high speed.
+     */
+    void Sof(uint16_t frame, uint32_t clock);
+
+    //! Gets the nominal rate in audio frames per (micro)frame, 16.16 fixed point
+    uint32_t Nominal() const { return nominal; }
+    //! Gets the measured rate in audio frames per (micro)frame, 16.16 fixed point
+    uint32_t Rate() const { return rate; }
+    //! Gets the feedback value in 16.16 fixed point, corrected according to the ring @p level and @p target level
+    uint32_t Value(uint32_t level, uint32_t target) const;
+    //! Encodes the feedback value for the feedback endpoint, returns its length
+    size_t Encode(void* buffer, uint32_t level, uint32_t target) const;
+
+    //! Restarts the measurement, e.g. when the stream is restarted
+    void Reset();
+
+private:
+    uint32_t nominal;
+    uint32_t rate;
+    uint32_t lastClock;
+    uint16_t lastFrame;
+    uint16_t frameMask;
+    uint8_t clockShift, periodLog2, gainShift;
+    bool highSpeed;
+    bool started;
+};
+
+//! Per-packet scheduler of an isochronous audio stream over an AudioRing
+/*!
+ * For IN streams, the number of audio frames in each packet follows the rate of the device
+ * audio clock (typically measured by an AudioFeedback), distributing the fractional part
+ * evenly using a phase accumulator, and adjusted by at most one frame per packet to keep
+ * the ring at half capacity. For OUT streams, received packets are simply appended to the ring.
+ */
+class AudioStream
+{
+public:
+    //! Creates the stream scheduler, @p interval is the bInterval of the data endpoint
+    AudioStream(AudioRing& ring, uint32_t sampleRate, Speed speed, uint8_t interval = 1);
+
+    //! Builds the next IN packet, returns its length in bytes
+    /*!
+     * @p rate is the rate of the audio clock in frames per packet (16.16 fixed point, see AudioFeedback::Rate
+     * multiplied by the number of (micro)frames per packet), zero to use the nominal rate.
+     * The packet buffer must be able to hold MaxPacketFrames() frames.
+     */
+    size_t NextIn(void* packet, uint32_t rate = 0);
+    //! Appends a received OUT packet to the ring
+    void Received(const void* packet, size_t length);
+
+    //! Gets the nominal number of frames per packet, 16.16 fixed point
+    uint32_t Nominal() const { return nominal; }
+    //! Gets the maximum number of frames in a single packet
+    uint32_t MaxPacketFrames() const { return ((nominal + 0xFFFF) >> 16) + 1; }
+    //! Gets the target level of the ring
+    uint32_t Target() const { return ring.Capacity() / 2; }
+
+    //! Gets the number of IN packets shorter than scheduled because the ring ran empty
+    uint32_t Underruns() const { return underruns; }
+    //! Gets the number of OUT packets not fully stored because the ring was full
+    uint32_t Overruns() const { return overruns; }
+
+    //! Restarts the stream, discarding all buffered frames
+    void Reset();
+
+private:
+    AudioRing& ring;
+    uint32_t nominal;
+    uint32_t phase;
+    uint32_t underruns, overruns;
+};
+
+//! State of the clock source of an Audio 2.0 function, handles the sampling frequency requests
+class AudioClock
+{
+public:
+    //! Creates the clock with the list of supported sample rates, the first one is initially selected
+    AudioClock(uint8_t clockId, const uint32_t* rates, uint8_t count)
+        : rates(rates), count(count), clockId(clockId), rate(rates[0]) {}
+
+    //! Handles a class-specific request directed at the AudioControl interface
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+
+    //! Gets the currently selected sample rate
+    uint32_t SampleRate() const { return rate; }
+
+private:
+    const uint32_t* rates;
+    uint8_t count;
+    uint8_t clockId;
+    uint32_t rate;
+    uint8_t response[2 + 12 * 8];
+    uint32_t request;
+};
+
+//! Class-specific request handlers for an AudioClock, for use with a SetupDispatcher
+/*!
+ * @p clock is the member of @p TContext holding the clock state, @p interface is the number of the AudioControl interface
+ */
+template<typename TContext, AudioClock TContext::*clock, uint8_t interface> struct AudioClockRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*clock).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassAudioCur, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassAudioCur, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassAudioRange, Handle, interface),
+    };
+};
+
+}
@@ -0,0 +1,867 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Benchmark.cpp
+ */
+
+#include <usb/Benchmark.h>
+#include <usb/CdcNcm.h>
+#include <usb/Composite.h>
+#include <usb/Device.h>
+#include <usb/HostParser.h>
+#include <usb/Msc.h>
+#include <usb/MscHost.h>
+#include <usb/NcmHost.h>
+#include <usb/UvcHost.h>
+#include <usb/ZeroHost.h>
+
+namespace usb
+{
+
+namespace
+{
+
+// hides the value from the optimizer, so loop-invariant lookups are not hoisted out of the measured loop
+template<typename T> ALWAYS_INLINE T Opaque(T value)
+{
+    __asm__ volatile("" : "+r"(value));
+    return value;
+}
+
+// the endpoint numbers are local to the function, they are allocated by the Composite
+constexpr auto CdcFunction(uint8_t interface)
+{
+    return DescriptorGroup(
+        InterfaceDescriptor(interface, 0, InterfaceClass::Cdc, SubClass::CdcAcm, Protocol::CdcAt, 0,
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcHeader, uint16_t(0x0110)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcCallManagement, uint8_t(0), uint8_t(interface + 1)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcAcm, uint8_t(2)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcUnion, uint8_t(interface), uint8_t(interface + 1)),
+            EndpointDescriptor::InterruptIn(1, 16, 16)),
+        InterfaceDescriptor(interface + 1, 0, InterfaceClass::CdcData, SubClass::None, Protocol::None, 0,
+            EndpointDescriptor::BulkIn(2, 64),
+            EndpointDescriptor::BulkOut(2, 64)));
+}
+
+constexpr auto HidFunction(uint8_t interface)
+{
+    return InterfaceDescriptor(interface, 0, InterfaceClass::Hid, SubClass::None, Protocol::None, 0,
+        // HID descriptor with a single report descriptor
+        CustomDescriptor<uint16_t, uint8_t, uint8_t, uint8_t, uint16_t>(DescriptorType::ClassSpecificDevice,
+            0x0111, 0, 1, 0x22, 52),
+        EndpointDescriptor::InterruptIn(1, 8, 10));
+}
+
+constexpr auto cdcFunction = [](uint8_t interface) { return CdcFunction(interface); };
+constexpr auto mscFunction = [](uint8_t interface) { return MscDescriptors(interface, 1, 64); };
+constexpr auto hidFunction = [](uint8_t interface) { return HidFunction(interface); };
+
+// six CDC functions, MSC and HID use 14 of the 15 IN endpoint numbers, so every endpoint address is unique
+using CompositeDevice = Composite<EndpointSharing::Any, 15,
+    cdcFunction, cdcFunction, cdcFunction, cdcFunction, cdcFunction, cdcFunction, mscFunction, hidFunction>;
+
+constexpr auto smallConfig = ConfigDescriptor(1, 100, 0, ConfigAttributes::BusPowered,
+    InterfaceDescriptor(0, 0, InterfaceClass::Vendor, SubClass::Vendor, Protocol::Vendor, 0,
+        EndpointDescriptor::BulkIn(1, 64),
+        EndpointDescriptor::BulkOut(1, 64)));
+
+constexpr auto mediumConfig = ConfigDescriptor(1, 100, 0, ConfigAttributes::BusPowered,
+    CdcNcmDescriptors(0, 1, 2, 64, 0),
+    MscDescriptors(2, 3, 64));
+
+constexpr auto compositeConfig = CompositeDevice::Config(1, 100);
+
+constexpr auto smallIndex = smallConfig.BuildEndpointIndex();
+constexpr auto mediumIndex = mediumConfig.BuildEndpointIndex();
+constexpr auto compositeIndex = compositeConfig.BuildEndpointIndex();
+
+struct FindCase
+{
+    const char* variant;
+    uint8_t address;
+    int interface;
+    int alternate;
+};
+
+// first endpoint, last endpoint, last endpoint in a specific interface, any alternate setting and a miss
+constexpr FindCase smallCases[] = {
+    { "small/first", 0x81, -1, 0 },
+    { "small/last", 0x01, -1, 0 },
+    { "small/interface", 0x01, 0, 0 },
+    { "small/any-alternate", 0x01, -1, -1 },
+    { "small/miss", 0x8F, -1, 0 },
+};
+
+constexpr FindCase mediumCases[] = {
+    { "medium/first", 0x81, -1, 0 },
+    { "medium/last", 0x03, -1, 0 },
+    { "medium/interface", 0x02, 1, 1 },
+    { "medium/any-alternate", 0x03, -1, -1 },
+    { "medium/miss", 0x8F, -1, 0 },
+};
+
+constexpr FindCase compositeCases[] = {
+    { "composite/first", 0x81, -1, 0 },
+    { "composite/last", CompositeDevice::EndpointAddress(7, 0x81), CompositeDevice::Interface(7), 0 },
+    { "composite/interface", CompositeDevice::EndpointAddress(5, 0x02), CompositeDevice::Interface(5) + 1, 0 },
+    { "composite/any-alternate", CompositeDevice::EndpointAddress(5, 0x02), -1, -1 },
+    { "composite/miss", 0x8F, -1, 0 },
+};
+
+USB_STRING_TABLE_START(0x0409)
+USB_STRING(strManufacturer, u"triaxis s.r.o.")
+USB_STRING(strProduct, u"Composite Benchmark Device")
+USB_STRING(strSerial, u"0123456789ABCDEF")
+USB_STRING(strConfig, u"Default Configuration")
+USB_STRING(strSerial0, u"Serial Port 0")
+USB_STRING(strSerial1, u"Serial Port 1")
+USB_STRING(strSerial2, u"Serial Port 2")
+USB_STRING(strSerial3, u"Serial Port 3")
+USB_STRING(strStorage, u"Mass Storage")
+USB_STRING(strKeyboard, u"Keyboard")
+USB_STRING_TABLE_END(strings)
+
+// typical mix of standard and class requests
+constexpr uint64_t setupPackets[] = {
+    0x0012000001000680,     // GET_DESCRIPTOR(Device)
+    0x00FF000002000680,     // GET_DESCRIPTOR(Config)
+    0x00FF040903010680,     // GET_DESCRIPTOR(String)
+    0x0000000000010900,     // SET_CONFIGURATION
+    0x0000008100000102,     // CLEAR_FEATURE(ENDPOINT_HALT)
+    0x00070000000020A1,     // CDC GET_LINE_CODING
+    0x0000000000032221,     // CDC SET_CONTROL_LINE_STATE
+    0x000100000000FEA1,     // MSC GET_MAX_LUN
+};
+
+constexpr auto zeroDevice = DeviceDescriptor(DeviceClass::None, SubClass::None, Protocol::None, 0x1209, 0x0001, 0x0100).WithUsbVersion(0x0200);
+constexpr auto zeroConfig = ConfigDescriptor(1, 100, 0, ConfigAttributes::BusPowered, ZeroDescriptors(0, 1, 512, 64, 1, 1024));
+const ConfigDescriptorHeader* const zeroConfigs[] = { &zeroConfig };
+
+struct ZeroDevice : DeviceState
+{
+    ZeroStorage<8, 4096> zero;
+    Endpoint bulkIn { EndpointDescriptor::BulkIn(1, 512) }, bulkOut { EndpointDescriptor::BulkOut(1, 512) };
+    Endpoint interruptIn { EndpointDescriptor::InterruptIn(2, 64, 1) }, interruptOut { EndpointDescriptor::InterruptOut(2, 64, 1) };
+    Endpoint isoIn { EndpointDescriptor::IsochronousIn(3, 1024) }, isoOut { EndpointDescriptor::IsochronousOut(3, 1024) };
+
+    ZeroDevice()
+    {
+        device = &zeroDevice;
+        configs = zeroConfigs;
+    }
+
+    bool OnSetConfiguration(const ConfigDescriptorHeader* config)
+    {
+        if (config)
+            zero.Open(bulkIn, bulkOut, &interruptIn, &interruptOut, &isoIn, &isoOut);
+        else
+            zero.Close();
+        return true;
+    }
+
+    bool OnSetInterface(uint8_t interface, uint8_t alternate) { return zero.SetAlternate(alternate); }
+    uint8_t OnGetInterface(uint8_t interface) { return zero.Alternate(); }
+};
+
+constexpr auto zeroDispatcher = MakeSetupDispatcher<ZeroDevice>(StandardRequests<ZeroDevice>::handlers,
+    ZeroRequests<ZeroDevice, ZeroStorage<8, 4096>, &ZeroDevice::zero, 0>::handlers);
+
+// connects the device to the VirtualHost, the function is polled whenever the host waits for it
+struct ZeroBus : VirtualDevice
+{
+    ZeroDevice dev;
+    const VirtualHost* host = NULL;
+
+    ControlResult Setup(const SetupPacket& setup, ControlStage stage) override { return zeroDispatcher.Dispatch(dev, setup, stage); }
+    void Run() override { dev.zero.Poll(host->Now() / 1000); }
+
+    Endpoint* FindEndpoint(uint8_t address) override
+    {
+        for (Endpoint* ep: { &dev.bulkIn, &dev.bulkOut, &dev.interruptIn, &dev.interruptOut, &dev.isoIn, &dev.isoOut })
+        {
+            if (ep->Address() == address)
+                return ep;
+        }
+        return NULL;
+    }
+};
+
+struct ZeroCase
+{
+    const char* name;
+    ZeroMode mode;
+    ZeroPipe pipe;
+    uint32_t length;
+};
+
+constexpr ZeroCase zeroCases[] = {
+    { "zero_bulk_source", ZeroMode::Source, ZeroPipe::Bulk, 4096 },
+    { "zero_bulk_sink", ZeroMode::Sink, ZeroPipe::Bulk, 4096 },
+    { "zero_bulk_loopback", ZeroMode::Loopback, ZeroPipe::Bulk, 512 },
+    { "zero_interrupt_loopback", ZeroMode::Loopback, ZeroPipe::Interrupt, 64 },
+    { "zero_iso_source", ZeroMode::Source, ZeroPipe::Isochronous, 1024 },
+    { "zero_iso_sink", ZeroMode::Sink, ZeroPipe::Isochronous, 1024 },
+};
+
+constexpr uint16_t uvcWidth = 320, uvcHeight = 240;
+constexpr uint32_t uvcClock = 1000000;     // PTS and SCR in microseconds of the bus time
+
+constexpr auto uvcDevice = DeviceDescriptor(DeviceClass::Misc, SubClass::MiscCommon, Protocol::MiscIad, 0x1209, 0x0002, 0x0100).WithUsbVersion(0x0200);
+constexpr auto uvcControl = VideoControlInterface(0, 1, uvcClock, 0,
+    VideoCameraTerminal(1), VideoOutputTerminal(2, VideoTerminal::UsbStreaming, 1));
+constexpr auto uvcFormat = VideoFormatUncompressed(1, VideoFourcc('Y', 'U', 'Y', '2'), 16,
+    VideoFrameUncompressed(1, uvcWidth, uvcHeight, 16, VideoInterval(30), VideoInterval(60)));
+
+constexpr auto uvcBulkEndpoint = EndpointDescriptor::BulkIn(1, 512);
+constexpr auto uvcBulkConfig = ConfigDescriptor(1, 100, 0, ConfigAttributes::BusPowered,
+    VideoFunction(0, 0, uvcControl, VideoStreamingBulk(1, 2, uvcBulkEndpoint, 0, uvcFormat)));
+
+// 60 frames per second do not fit into 1024 bytes per microframe, so the high-bandwidth alternate setting is selected
+constexpr auto uvcIsoEndpoint = VideoIsoEndpoint(1, 3072);
+constexpr auto uvcIsoConfig = ConfigDescriptor(1, 100, 0, ConfigAttributes::BusPowered,
+    VideoFunction(0, 0, uvcControl, DescriptorGroup(
+        VideoStreamingIso(1, 2, 1, 0, uvcFormat),
+        VideoIsoAlternate(1, 1, VideoIsoEndpoint(1, 1024)),
+        VideoIsoAlternate(1, 2, uvcIsoEndpoint))));
+
+struct UvcDevice : DeviceState
+{
+    UvcStorage<8> uvc { uvcClock };
+    Endpoint data;
+    const ConfigDescriptorHeader* config[1];
+
+    UvcDevice(const ConfigDescriptorHeader& config, const EndpointDescriptor& data)
+        : data(data), config { &config }
+    {
+        device = &uvcDevice;
+        configs = this->config;
+    }
+
+    bool OnSetConfiguration(const ConfigDescriptorHeader* config)
+    {
+        if (config)
+            return uvc.Open(config, 1, data, Speed::High);
+        uvc.Close();
+        return true;
+    }
+
+    // clearing the halt of the bulk endpoint ends the stream
+    void OnEndpointHalt(uint8_t address, bool halt)
+    {
+        if (address == data.Address())
+            uvc.Stop();
+    }
+
+    bool OnSetInterface(uint8_t interface, uint8_t alternate) { return interface == 1 ? uvc.SetAlternate(alternate) : !alternate; }
+    uint8_t OnGetInterface(uint8_t interface) { return interface == 1 ? uvc.Alternate() : 0; }
+};
+
+constexpr auto uvcDispatcher = MakeSetupDispatcher<UvcDevice>(StandardRequests<UvcDevice>::handlers,
+    UvcRequests<UvcDevice, UvcStorage<8>, &UvcDevice::uvc, 1>::handlers);
+
+// connects the device to the VirtualHost, a frame of the pattern is captured every committed frame interval
+// and stamped with the time it was due, it is dropped if all frame buffers are still queued
+struct UvcBus : VirtualDevice
+{
+    UvcDevice dev;
+    VideoTestPattern& pattern;
+    VideoFrame frames[3] = {};
+    const VirtualHost* host = NULL;
+    uint16_t sof = 0;
+    uint32_t due = 0;
+    bool capturing = false;
+
+    UvcBus(const ConfigDescriptorHeader& config, const EndpointDescriptor& data, VideoTestPattern& pattern)
+        : dev(config, data), pattern(pattern)
+    {
+        for (auto& f: frames)
+            f.done = true;
+    }
+
+    ControlResult Setup(const SetupPacket& setup, ControlStage stage) override { return uvcDispatcher.Dispatch(dev, setup, stage); }
+    Endpoint* FindEndpoint(uint8_t address) override { return address == dev.data.Address() ? &dev.data : NULL; }
+    void Frame(uint16_t frame) override { sof = frame; }
+
+    void Run() override
+    {
+        uint32_t now = host->Now() / 1000;
+        dev.uvc.Poll(now, sof);
+        if (!dev.uvc.Streaming())
+        {
+            capturing = false;
+            return;
+        }
+        if (!capturing)
+        {
+            capturing = true;
+            due = now;
+        }
+
+        // dwFrameInterval is in 100 ns units, the clock in microseconds
+        uint32_t interval = dev.uvc.Committed().dwFrameInterval / 10;
+        while (int32_t(now - due) >= 0)
+        {
+            for (auto& f: frames)
+            {
+                if (f.done)
+                {
+                    pattern.Next(f, due);
+                    dev.uvc.Submit(f);
+                    break;
+                }
+            }
+            if (!interval)
+                break;
+            due += interval;
+        }
+    }
+};
+
+struct UvcCase
+{
+    const char* name;
+    const ConfigDescriptorHeader& config;
+    const EndpointDescriptor& data;
+    uint32_t interval;
+};
+
+constexpr UvcCase uvcCases[] = {
+    { "uvc_bulk_yuy2_30fps", uvcBulkConfig, uvcBulkEndpoint, VideoInterval(30) },
+    { "uvc_iso_hb_yuy2_60fps", uvcIsoConfig, uvcIsoEndpoint, VideoInterval(60) },
+};
+
+constexpr uint32_t mscBlocks = 2048;
+constexpr auto mscDevice = DeviceDescriptor(DeviceClass::None, SubClass::None, Protocol::None, 0x1209, 0x0003, 0x0100).WithUsbVersion(0x0200);
+constexpr auto mscConfig = ConfigDescriptor(1, 100, 0, ConfigAttributes::BusPowered, MscDescriptors(0, 1, 512));
+const ConfigDescriptorHeader* const mscConfigs[] = { &mscConfig };
+
+// medium of mscBlocks blocks of 512 bytes in RAM
+struct RamDisk : BlockDevice
+{
+    uint8_t* data;
+
+    RamDisk(uint8_t* data)
+        : data(data) {}
+
+    uint32_t BlockSize() override { return 512; }
+    uint32_t BlockCount() override { return mscBlocks; }
+    bool Read(uint32_t block, void* buffer, uint32_t count) override { memcpy(buffer, data + block * 512, count * 512); return true; }
+    bool Write(uint32_t block, const void* buffer, uint32_t count) override { memcpy(data + block * 512, buffer, count * 512); return true; }
+};
+
+struct MscDevice : DeviceState
+{
+    RamDisk disk;
+    BlockDevice* const luns[1] = { &disk };
+    uint8_t buffer[2 * 8192];
+    MscBot msc { luns, 1, buffer, sizeof(buffer) };
+    Endpoint bulkIn { EndpointDescriptor::BulkIn(1, 512) }, bulkOut { EndpointDescriptor::BulkOut(1, 512) };
+
+    MscDevice(uint8_t* medium)
+        : disk(medium)
+    {
+        device = &mscDevice;
+        configs = mscConfigs;
+    }
+};
+
+constexpr auto mscDispatcher = MakeSetupDispatcher<MscDevice>(StandardRequests<MscDevice>::handlers,
+    MscRequests<MscDevice, &MscDevice::msc, 0>::handlers);
+
+// connects the MscBot to the endpoints, the next transfer is armed and the medium accessed whenever the host waits for the device
+struct MscBus : VirtualDevice
+{
+    MscDevice dev;
+    EndpointTransfer in = {}, out = {};
+    MscTransfer pendingOut = {};
+    uint8_t packet[512];    // receives the CBW, which is shorter than a packet
+
+    MscBus(uint8_t* medium)
+        : dev(medium)
+    {
+        in.done = out.done = true;
+    }
+
+    ControlResult Setup(const SetupPacket& setup, ControlStage stage) override { return mscDispatcher.Dispatch(dev, setup, stage); }
+    Endpoint* FindEndpoint(uint8_t address) override { return address == dev.bulkIn.Address() ? &dev.bulkIn : address == dev.bulkOut.Address() ? &dev.bulkOut : NULL; }
+
+    void Run() override
+    {
+        auto& bot = dev.msc;
+
+        if (pendingOut.data && out.done)
+        {
+            if (out.buffer == packet)
+                memcpy(pendingOut.data, packet, out.transferred < pendingOut.length ? out.transferred : pendingOut.length);
+            pendingOut = {};
+            bot.OutReceived(out.transferred);
+        }
+        if (!pendingOut.data && (pendingOut = bot.NextOut()).data)
+        {
+            // OUT transfers must be made of whole packets
+            if (pendingOut.length % dev.bulkOut.MaxPacketSize())
+                out.Setup(packet, sizeof(packet), false);
+            else
+                out.Setup(pendingOut.data, pendingOut.length, false);
+            dev.bulkOut.Submit(out);
+        }
+
+        if (in.done)
+        {
+            if (in.buffer)
+            {
+                in.buffer = NULL;
+                bot.InSent();
+            }
+            auto t = bot.NextIn();
+            if (t.data)
+            {
+                in.Setup(t.data, t.length, false);
+                dev.bulkIn.Submit(in);
+            }
+        }
+
+        bot.Poll();
+    }
+};
+
+struct MscCase
+{
+    const char* name;
+    bool write;
+    uint16_t blocks;
+};
+
+// the written blocks are read back and verified
+constexpr MscCase mscCases[] = {
+    { "msc_bot_write_32k", true, 64 },
+    { "msc_bot_read_32k", false, 64 },
+};
+
+constexpr auto ncmDevice = DeviceDescriptor(DeviceClass::Cdc, SubClass::None, Protocol::None, 0x1209, 0x0004, 0x0100).WithUsbVersion(0x0200);
+constexpr auto ncmConfig = ConfigDescriptor(1, 100, 0, ConfigAttributes::BusPowered, CdcNcmDescriptors(0, 1, 2, 512, 0));
+const ConfigDescriptorHeader* const ncmConfigs[] = { &ncmConfig };
+
+struct NcmDevice : DeviceState
+{
+    CdcNcm ncm { 16384, 16384 };
+    Endpoint bulkIn { EndpointDescriptor::BulkIn(2, 512) }, bulkOut { EndpointDescriptor::BulkOut(2, 512) };
+    uint8_t alternate = 0;
+
+    NcmDevice()
+    {
+        device = &ncmDevice;
+        configs = ncmConfigs;
+    }
+
+    // leaving alternate setting 1 of the data interface drops the pending NTBs and the negotiated parameters
+    bool OnSetInterface(uint8_t interface, uint8_t alternate)
+    {
+        if (interface != 1)
+            return !alternate;
+        if (!alternate)
+        {
+            bulkIn.Cancel();
+            bulkOut.Cancel();
+            ncm.Reset();
+        }
+        this->alternate = alternate;
+        return true;
+    }
+
+    uint8_t OnGetInterface(uint8_t interface) { return interface == 1 ? alternate : 0; }
+};
+
+constexpr auto ncmDispatcher = MakeSetupDispatcher<NcmDevice>(StandardRequests<NcmDevice>::handlers,
+    CdcNcmRequests<NcmDevice, &NcmDevice::ncm, 0>::handlers);
+
+// connects the device to the VirtualHost, every received NTB is unpacked and its datagrams looped back in an IN NTB
+struct NcmBus : VirtualDevice
+{
+    NcmDevice dev;
+    EndpointTransfer rx = {}, tx = {};
+    bool receiving = false;
+    uint8_t rxBuffer[16384], txBuffer[16384];
+
+    NcmBus()
+    {
+        tx.done = true;
+    }
+
+    ControlResult Setup(const SetupPacket& setup, ControlStage stage) override { return ncmDispatcher.Dispatch(dev, setup, stage); }
+    Endpoint* FindEndpoint(uint8_t address) override { return address == dev.bulkIn.Address() ? &dev.bulkIn : address == dev.bulkOut.Address() ? &dev.bulkOut : NULL; }
+
+    void Run() override
+    {
+        if (dev.alternate != 1)
+        {
+            receiving = false;
+            return;
+        }
+
+        // the next NTB is received once the previous one has been looped back
+        if (receiving && rx.done && tx.done)
+        {
+            receiving = false;
+            size_t length = rx.status == TransferStatus::Complete ? Loop(rx.transferred) : 0;
+            if (length)
+            {
+                tx.Setup(txBuffer, length, length < dev.ncm.NtbInSize());
+                dev.bulkIn.Submit(tx);
+            }
+        }
+
+        if (!receiving)
+        {
+            rx.Setup(rxBuffer, sizeof(rxBuffer), false);
+            dev.bulkOut.Submit(rx);
+            receiving = true;
+        }
+    }
+
+    size_t Loop(size_t length)
+    {
+        NtbReader reader;
+        NtbWriter writer;
+        if (!reader.Begin(rxBuffer, length))
+            return 0;
+
+        dev.ncm.BeginIn(writer, txBuffer, sizeof(txBuffer));
+        const void* datagram;
+        size_t n;
+        while (reader.Next(datagram, n) && writer.Add(datagram, n))
+            ;
+        return writer.Empty() ? 0 : writer.Finish();
+    }
+};
+
+struct NcmCase
+{
+    const char* name;
+    uint16_t length;
+    uint32_t count;
+};
+
+// full Ethernet frames and minimum-size ones, which depend on the aggregation the most
+constexpr NcmCase ncmCases[] = {
+    { "ncm_loopback_1514", 1514, 2000 },
+    { "ncm_loopback_64", 64, 4000 },
+};
+
+}
+
+void Benchmark::Run()
+{
+    RunFindEndpoint();
+    RunDescriptorWalk();
+    RunStrings();
+    RunSetupDecode();
+    RunHostParse();
+    RunZero();
+    RunUvc();
+    RunMsc();
+    RunNcm();
+}
+
+void Benchmark::RunFindEndpoint()
+{
+    auto run = [this](const ConfigDescriptorHeader& config, const auto& index, const FindCase* cases, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const FindCase& c = cases[i];
+            Measure("find_endpoint_linear", c.variant, config.wTotalLength, [&](uint32_t)
+            {
+                return (uintptr_t)Opaque(&config)->FindEndpoint(Opaque(c.address), c.interface, c.alternate);
+            });
+            Measure("find_endpoint_index", c.variant, sizeof(index), [&](uint32_t)
+            {
+                return (uintptr_t)Opaque(&index)->Find(&config, Opaque(c.address), c.interface, c.alternate);
+            });
+        }
+    };
+
+    run(smallConfig, smallIndex, smallCases, countof(smallCases));
+    run(mediumConfig, mediumIndex, mediumCases, countof(mediumCases));
+    run(compositeConfig, compositeIndex, compositeCases, countof(compositeCases));
+}
+
+void Benchmark::RunDescriptorWalk()
+{
+    auto run = [this](const char* variant, const ConfigDescriptorHeader& config)
+    {
+        Measure("descriptor_walk", variant, config.wTotalLength, [&](uint32_t)
+        {
+            auto cfg = Opaque(&config);
+            uintptr_t count = 0;
+            for (const DescriptorHeader* hdr = cfg; hdr < cfg->End(); hdr = hdr->Next())
+                count++;
+            return count;
+        });
+    };
+
+    run("small", smallConfig);
+    run("medium", mediumConfig);
+    run("composite", compositeConfig);
+}
+
+void Benchmark::RunStrings()
+{
+    auto view = strings.View();
+#if USB_COMPACT_STRINGS
+    uint32_t size = 0;
+    for (unsigned i = 0; i < view.count; i++)
+        size += view.Get(i)->size + sizeof(CompactString);
+
+    Measure("string_expand", "last", size, [&](uint32_t)
+    {
+        // expands the whole descriptor in control packets, as it is sent
+        uint8_t packet[64];
+        auto s = Opaque(view.Get(view.count - 1));
+        uintptr_t total = 0;
+        for (size_t offset = 0; offset < s->len; offset += sizeof(packet))
+        {
+            size_t len = s->len - offset < sizeof(packet) ? s->len - offset : sizeof(packet);
+            ExpandCompactString(s, offset, packet, len);
+            total += packet[len - 1];
+        }
+        return total;
+    });
+
+    Measure("string_view", "last", size, [&](uint32_t)
+    {
+        return (uintptr_t)Opaque(&view)->Get(Opaque(view.count - 1));
+    });
+#else
+    uint32_t size = view.offsets[view.count - 1] + view.Get(view.count - 1)->len;
+
+    Measure("string_chain", "last", size, [&](uint32_t)
+    {
+        // walks the chain up to the last string, as the lookup by index without an offset table does
+        auto s = Opaque((const StringDescriptor*)strings);
+        for (unsigned n = Opaque(view.count - 1); n; n--)
+            s = s->Next();
+        return (uintptr_t)s;
+    });
+
+    Measure("string_chain", "all", size, [&](uint32_t)
+    {
+        uintptr_t total = 0;
+        for (auto s = Opaque((const StringDescriptor*)strings); s->len; s = s->Next())
+            total += s->len;
+        return total;
+    });
+
+    Measure("string_view", "last", size + view.count * sizeof(uint16_t), [&](uint32_t)
+    {
+        return (uintptr_t)Opaque(&view)->Get(Opaque(view.count - 1));
+    });
+#endif
+}
+
+void Benchmark::RunSetupDecode()
+{
+    Measure("setup_decode", "fields", sizeof(setupPackets), [&](uint32_t i)
+    {
+        SetupPacket setup;
+        setup.dw = Opaque(setupPackets[i % countof(setupPackets)]);
+        return uintptr_t(setup.direction + setup.type + setup.recipient + setup.bRequest + setup.wValue + setup.wIndex + setup.wLength);
+    });
+
+    Measure("setup_decode", "key", sizeof(setupPackets), [&](uint32_t i)
+    {
+        SetupPacket setup;
+        setup.dw = Opaque(setupPackets[i % countof(setupPackets)]);
+        return uintptr_t(setup.Key() + setup.wValue + setup.wIndex + setup.wLength);
+    });
+}
+
+void Benchmark::RunHostParse()
+{
+    HostConfigStorage<32, 64> host;
+
+    auto run = [&](const char* variant, const ConfigDescriptorHeader& config, const FindCase& miss)
+    {
+        Measure("host_parse", variant, config.wTotalLength, [&](uint32_t)
+        {
+            return (uintptr_t)host.Parse(Opaque(&config), config.wTotalLength);
+        });
+
+        host.Parse(&config, config.wTotalLength);
+        Measure("host_find_endpoint", variant, config.wTotalLength, [&](uint32_t)
+        {
+            return (uintptr_t)Opaque(&host)->FindEndpoint(Opaque(miss.address), miss.interface, miss.alternate);
+        });
+        Measure("host_find_class_specific", variant, config.wTotalLength, [&](uint32_t)
+        {
+            // the last class-specific interface descriptor of the first interface
+            return (uintptr_t)Opaque(&host)->FindClassSpecific(0, DescriptorType::ClassSpecificInterface, DescriptorSubType::CdcUnion);
+        });
+    };
+
+    // misses walk the whole endpoint index, as the linear walk does for find_endpoint_linear
+    run("small", smallConfig, smallCases[countof(smallCases) - 1]);
+    run("medium", mediumConfig, mediumCases[countof(mediumCases) - 1]);
+    run("composite", compositeConfig, compositeCases[countof(compositeCases) - 1]);
+}
+
+void Benchmark::RunZero()
+{
+    ZeroBus bus;
+    VirtualBusConfig bc;
+    bc.speed = Speed::High;
+    VirtualHost host(bus, bc);
+    bus.host = &host;
+
+    HostConfigStorage<4, 16> config;
+    uint8_t buffer[8192];
+    uint32_t samples[128];
+    VirtualZeroRunner runner(host, buffer, sizeof(buffer), samples, countof(samples));
+
+    // when the enumeration fails, the runs report all their transfers as failures
+    if (host.Enumerate() && config.Parse(&host.Config(), host.Config().wTotalLength) == HostParseError::None)
+        runner.Attach(config, 0);
+
+    for (auto& c: zeroCases)
+    {
+        ZeroRunResult res;
+        switch (c.mode)
+        {
+            case ZeroMode::Source: res = runner.Source(c.pipe, ZeroPattern::Mod63, c.length, 100); break;
+            case ZeroMode::Sink: res = runner.Sink(c.pipe, ZeroPattern::Mod63, c.length, 100); break;
+            default: res = runner.Loopback(c.pipe, ZeroPattern::Mod63, c.length, 100); break;
+        }
+
+        char line[320];
+        ZeroRunner::Format(line, sizeof(line), c.name, res);
+        ReportRun(line);
+    }
+}
+
+void Benchmark::RunUvc()
+{
+    // the pattern holds two frames and a bulk payload carries a whole frame with its header
+    static uint8_t frames[VideoTestPattern::Yuy2BufferSize(uvcWidth, uvcHeight)];
+    static uint8_t payload[uvcWidth * uvcHeight * 2 + 12];
+    VideoTestPattern pattern;
+    pattern.Yuy2(frames, uvcWidth, uvcHeight);
+
+    for (auto& c: uvcCases)
+    {
+        UvcBus bus(c.config, c.data, pattern);
+        VirtualBusConfig bc;
+        bc.speed = Speed::High;
+        VirtualHost host(bus, bc);
+        bus.host = &host;
+
+        HostConfigStorage<8, 8> config;
+        VirtualUvcRunner runner(host, payload, sizeof(payload));
+        VideoRunResult res = {};
+        if (host.Enumerate() && config.Parse(&host.Config(), host.Config().wTotalLength) == HostParseError::None && runner.Attach(config, 1))
+            res = runner.Run(1, 1, c.interval, 30);
+
+        char line[320];
+        UvcRunner::Format(line, sizeof(line), c.name, res);
+        ReportRun(line);
+    }
+}
+
+void Benchmark::RunMsc()
+{
+    static uint8_t medium[mscBlocks * 512];
+    MscBus bus(medium);
+    VirtualBusConfig bc;
+    bc.speed = Speed::High;
+    VirtualHost host(bus, bc);
+
+    HostConfigStorage<4, 8> config;
+    static uint8_t buffer[32768];
+    VirtualMscRunner runner(host, buffer, sizeof(buffer));
+    bool attached = host.Enumerate() && config.Parse(&host.Config(), host.Config().wTotalLength) == HostParseError::None && runner.Attach(config, 0);
+
+    for (auto& c: mscCases)
+    {
+        // 16 commands cover half of the medium
+        MscRunResult res = {};
+        if (attached)
+            res = c.write ? runner.Write(0, c.blocks, 16) : runner.Read(0, c.blocks, 16);
+        else
+            res.failures = 16;
+
+        char line[320];
+        MscRunner::Format(line, sizeof(line), c.name, res);
+        ReportRun(line);
+    }
+}
+
+void Benchmark::RunNcm()
+{
+    NcmBus bus;
+    VirtualBusConfig bc;
+    bc.speed = Speed::High;
+    VirtualHost host(bus, bc);
+
+    HostConfigStorage<4, 8> config;
+    static uint8_t buffer[32768];
+    VirtualNcmRunner runner(host, buffer, sizeof(buffer));
+    bool attached = host.Enumerate() && config.Parse(&host.Config(), host.Config().wTotalLength) == HostParseError::None && runner.Attach(config, 0);
+
+    for (auto& c: ncmCases)
+    {
+        NcmRunResult res = {};
+        if (attached)
+            res = runner.Loopback(c.length, c.count);
+        else
+            res.failures = 1;
+
+        char line[320];
+        NcmRunner::Format(line, sizeof(line), c.name, res);
+        ReportRun(line);
+    }
+}
+
+size_t Benchmark::Format(char* buffer, size_t size, const BenchmarkResult& result)
+{
+    return JsonWriter(buffer, size)
+        .String("name", result.name)
+        .String("variant", result.variant)
+        .Number("iterations", result.iterations)
+        .Fixed("ns_per_op", result.PicosPerOp())
+        .Number("data_bytes", result.dataSize)
+        .Finish();
+}
+
+/****** JsonWriter ******/
+
+void JsonWriter::Raw(const char* s)
+{
+    while (*s && p < end)
+        *p++ = *s++;
+}
+
+void JsonWriter::Digits(uint64_t value, unsigned minDigits)
+{
+    char tmp[20];
+    unsigned n = 0;
+    do
+    {
+        tmp[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value || n < minDigits);
+    while (n && p < end)
+        *p++ = tmp[--n];
+}
+
+void JsonWriter::Key(const char* key)
+{
+    if (!first)
+        Raw(",");
+    first = false;
+    Raw("\"");
+    Raw(key);
+    Raw("\":");
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Benchmark.h
+ *
+ * Micro-benchmarks of the descriptor and setup packet hot paths and simulated function runs
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Packets.h>
+
+namespace usb
+{
+
+//! Result of a single benchmark variant
+struct BenchmarkResult
+{
+    const char* name;       //!< Name of the measured operation
+    const char* variant;    //!< Variant of the operation (configuration, filter, ...)
+    uint32_t iterations;    //!< Number of operations performed
+    uint64_t time;          //!< Total time of all operations in nanoseconds
+    uint32_t dataSize;      //!< Size of the descriptors or tables examined by the variant in bytes
+
+    //! Gets the time of a single operation in picoseconds
+    uint64_t PicosPerOp() const { return iterations ? time * 1000 / iterations : 0; }
+};
+
+//! Writes a single-line JSON object into a fixed buffer, the output is truncated if it does not fit
+/*!
+ * Used to format the results of the benchmarks and of the simulated function runs, for example
+ *
+ *     JsonWriter(buffer, size).String("name", name).Number("frames", frames).Fixed("fps", milliFps).Finish();
+ */
+class JsonWriter
+{
+public:
+    //! Starts the object in @p buffer of @p size bytes, which must not be zero
+    JsonWriter(char* buffer, size_t size)
+        : buffer(buffer), p(buffer), end(buffer + size - 1) { Raw("{"); }
+
+    //! Adds a member with a string value, which is not escaped
+    JsonWriter& String(const char* key, const char* value) { Key(key); Raw("\""); Raw(value); Raw("\""); return *this; }
+    //! Adds a member with an unsigned integer value
+    JsonWriter& Number(const char* key, uint64_t value) { Key(key); Digits(value); return *this; }
+    //! Adds a member with a value in thousandths, printed with three decimals
+    JsonWriter& Fixed(const char* key, uint64_t value) { Key(key); Digits(value / 1000); Raw("."); Digits(value % 1000, 3); return *this; }
+
+    //! Closes the object, returns the length of the output (excluding the null terminator)
+    size_t Finish() { Raw("}"); *p = 0; return p - buffer; }
+
+private:
+    char* buffer;
+    char* p;
+    char* end;
+    bool first = true;
+
+    void Raw(const char* s);
+    void Digits(uint64_t value, unsigned minDigits = 1);
+    void Key(const char* key);
+};
+
+//! Runner of the descriptor and setup packet micro-benchmarks
+/*!
+ * The suite is intended to be built for the host (or a target with a cycle counter) and covers
+ * ConfigDescriptorHeader::FindEndpoint (compared with EndpointIndex::Find) across configurations
+ * of different sizes and interface/alternate filters, DescriptorHeader::Next walks,
+ * StringDescriptor::Next chains (CompactString expansion when USB_COMPACT_STRINGS is enabled),
+ * SetupPacket field decoding and the host-side HostConfig
+ * parser and its index lookups.
+ *
+ * Functions are exercised end to end on a VirtualHost: a Zero function is enumerated at high speed
+ * and runs its source, sink and loopback tests with pattern verification, a Uvc function streams
+ * a VideoTestPattern over bulk and high-bandwidth isochronous endpoints, a MscBot backed by
+ * a RAM disk executes WRITE(10) and READ(10) commands, verifying the blocks read back, and a CdcNcm
+ * function loops back datagrams aggregated into NTBs. These runs are timed by the simulated bus,
+ * each run is reported as the JSON line produced by the runner.
+ *
+ * The configurations include a large Composite (6 CDC functions, MSC and HID),
+ * so the linear walks can be compared with future lookup tables. The platform provides
+ * the time source and receives the results, which can be formatted as JSON lines using Format().
+ */
+class Benchmark
+{
+public:
+    Benchmark(uint32_t iterations = 100000)
+        : iterations(iterations) {}
+
+    //! Runs all benchmarks, reporting every variant
+    void Run();
+
+    //! Measures a single variant, @p fn is invoked @p iterations times and its results are accumulated to keep it from being optimized out
+    template<typename TFn> void Measure(const char* name, const char* variant, uint32_t dataSize, TFn fn)
+    {
+        // warm up caches and branch predictors
+        for (uint32_t i = 0; i < iterations / 16; i++)
+            sink = sink + fn(i);
+
+        uint64_t start = Nanoseconds();
+        for (uint32_t i = 0; i < iterations; i++)
+            sink = sink + fn(i);
+        uint64_t time = Nanoseconds() - start;
+
+        Report({ name, variant, iterations, time, dataSize });
+    }
+
+    //! Formats the result as a single line of JSON, returns the length of the output (excluding the null terminator)
+    static size_t Format(char* buffer, size_t size, const BenchmarkResult& result);
+
+protected:
+    //! Gets the current time in nanoseconds from a monotonic clock
+    virtual uint64_t Nanoseconds() = 0;
+    //! Called with the result of every measured variant
+    virtual void Report(const BenchmarkResult& result) = 0;
+    //! Called with the JSON line of every simulated function run (see ZeroRunner::Format, UvcRunner::Format, MscRunner::Format and NcmRunner::Format)
+    virtual void ReportRun(const char* json) = 0;
+
+private:
+    uint32_t iterations;
+    volatile uintptr_t sink = 0;
+
+    void RunFindEndpoint();
+    void RunDescriptorWalk();
+    void RunStrings();
+    void RunSetupDecode();
+    void RunHostParse();
+    void RunZero();
+    void RunUvc();
+    void RunMsc();
+    void RunNcm();
+};
+
+}
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Bos.h
+ *
+ * Binary Device Object Store, LPM and platform capabilities (Microsoft OS 2.0, WebUSB)
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Device capability types
+enum struct DeviceCapabilityType : uint8_t
+{
+    Wireless = 1,       //!< Wireless USB
+    Usb20Extension = 2, //!< USB 2.0 Extension (LPM)
+    SuperSpeed = 3,     //!< SuperSpeed USB
+    ContainerId = 4,    //!< Container ID
+    Platform = 5,       //!< Platform-specific capability identified by a UUID
+};
+
+//! BOS descriptor header, immediately followed by the device capability descriptors
+/*!
+ * The BOS descriptor is requested only from devices reporting bcdUSB 0x0201 or later,
+ * see DeviceDescriptor::WithUsbVersion
+ */
+PACKED_UNALIGNED_STRUCT BosDescriptorHeader : DescriptorHeader
+{
+    constexpr BosDescriptorHeader(uint16_t capsSize, uint8_t numCaps)
+        : DescriptorHeader(sizeof(BosDescriptorHeader), DescriptorType::Bos),
+        wTotalLength(sizeof(BosDescriptorHeader) + capsSize),
+        bNumDeviceCaps(numCaps) {}
+
+    uint16_t wTotalLength;          //!< Total length including all device capability descriptors
+    uint8_t bNumDeviceCaps;         //!< Number of device capability descriptors
+};
+
+//! Full BOS descriptor, with device capabilities embedded
+template<typename... TCaps> PACKED_UNALIGNED_STRUCT BosDescriptorBlock : BosDescriptorHeader
+{
+    constexpr BosDescriptorBlock(const TCaps&... caps)
+        : BosDescriptorHeader(sizeof(ConfigChildren<TCaps...>), sizeof...(TCaps)),
+        caps(caps...) {}
+
+    ConfigChildren<TCaps...> caps;  //!< Nested device capability descriptors
+};
+
+//! Creates a BosDescriptorBlock with the specified device capabilities
+template<typename... TCaps> constexpr BosDescriptorBlock<TCaps...> BosDescriptor(const TCaps&... caps)
+{
+    return BosDescriptorBlock<TCaps...>(caps...);
+}
+
+//! Common header of device capability descriptors
+PACKED_UNALIGNED_STRUCT DeviceCapabilityHeader : DescriptorHeader
+{
+    constexpr DeviceCapabilityHeader(uint8_t size, DeviceCapabilityType type)
+        : DescriptorHeader(size, DescriptorType::DeviceCapability), bDevCapabilityType(type) {}
+
+    DeviceCapabilityType bDevCapabilityType;    //!< Type of the capability
+};
+
+//! USB 2.0 Extension attributes
+enum struct Usb20Attributes : uint32_t
+{
+    None = 0,
+    Lpm = BIT(1),                   //!< Link Power Management supported
+    Besl = BIT(2),                  //!< BESL and alternate HIRD definitions supported
+    BaselineBeslValid = BIT(3),     //!< Recommended baseline BESL value is valid
+    DeepBeslValid = BIT(4),         //!< Recommended deep BESL value is valid
+};
+
+DEFINE_FLAG_ENUM(Usb20Attributes);
+
+//! USB 2.0 Extension capability, advertising Link Power Management
+PACKED_UNALIGNED_STRUCT Usb20ExtensionDescriptor : DeviceCapabilityHeader
+{
+    constexpr Usb20ExtensionDescriptor(Usb20Attributes attributes, uint8_t baselineBesl = 0, uint8_t deepBesl = 0)
+        : DeviceCapabilityHeader(sizeof(Usb20ExtensionDescriptor), DeviceCapabilityType::Usb20Extension),
+        bmAttributes((uint32_t)attributes | (baselineBesl & 0xF) << 8 | (deepBesl & 0xF) << 12) {}
+
+    uint32_t bmAttributes;          //!< Usb20Attributes and the recommended BESL values
+};
+
+//! Creates a USB 2.0 Extension capability
+/*!
+ * LPM lets the host put the link to the L1 sleep state, with wakeup latencies in the order
+ * of tens of microseconds instead of the milliseconds required to resume from suspend.
+ * The optional recommended BESL values (0-15, negative if not specified) tell the host how long
+ * the device needs to resume, the device must report bcdUSB 0x0201 or later.
+ */
+constexpr Usb20ExtensionDescriptor Usb20Extension(bool lpm = true, int baselineBesl = -1, int deepBesl = -1)
+{
+    Usb20Attributes attr = Usb20Attributes::None;
+    if (lpm)
+        attr = attr | Usb20Attributes::Lpm | Usb20Attributes::Besl;
+    if (lpm && baselineBesl >= 0)
+        attr = attr | Usb20Attributes::BaselineBeslValid;
+    if (lpm && deepBesl >= 0)
+        attr = attr | Usb20Attributes::DeepBeslValid;
+    return Usb20ExtensionDescriptor(attr, baselineBesl < 0 ? 0 : baselineBesl, deepBesl < 0 ? 0 : deepBesl);
+}
+
+//! UUID in the byte order used by the platform capability descriptor
+struct PlatformUuid
+{
+    uint8_t bytes[16];
+
+    //! Creates the UUID from its canonical form {d1-d2-d3-d4}, the first three fields are stored little-endian
+    static constexpr PlatformUuid Guid(uint32_t d1, uint16_t d2, uint16_t d3, uint64_t d4)
+    {
+        PlatformUuid res = {};
+        for (unsigned i = 0; i < 4; i++)
+            res.bytes[i] = d1 >> (i * 8);
+        for (unsigned i = 0; i < 2; i++)
+        {
+            res.bytes[4 + i] = d2 >> (i * 8);
+            res.bytes[6 + i] = d3 >> (i * 8);
+        }
+        for (unsigned i = 0; i < 8; i++)
+            res.bytes[8 + i] = d4 >> ((7 - i) * 8);
+        return res;
+    }
+};
+
+//! Platform capability, identified by a UUID and followed by platform-specific data
+template<typename TData> PACKED_UNALIGNED_STRUCT PlatformCapabilityDescriptor : DeviceCapabilityHeader
+{
+    constexpr PlatformCapabilityDescriptor(const PlatformUuid& uuid, const TData& data)
+        : DeviceCapabilityHeader(sizeof(PlatformCapabilityDescriptor), DeviceCapabilityType::Platform),
+        uuid(uuid), data(data) {}
+
+    uint8_t bReserved = 0;
+    PlatformUuid uuid;              //!< Identifier of the platform
+    TData data;                     //!< Platform-specific data
+};
+
+//! Microsoft OS 2.0 descriptor platform capability data
+PACKED_UNALIGNED_STRUCT MsOs20PlatformData
+{
+    uint32_t dwWindowsVersion;              //!< Minimum Windows version of the descriptor set
+    uint16_t wMSOSDescriptorSetTotalLength; //!< Length of the descriptor set returned by the vendor request
+    uint8_t bMS_VendorCode;                 //!< bRequest of the vendor request returning the descriptor set
+    uint8_t bAltEnumCode;                   //!< Non-zero if the device supports alternate enumeration
+};
+
+//! WebUSB platform capability data
+PACKED_UNALIGNED_STRUCT WebUsbPlatformData
+{
+    uint16_t bcdVersion;            //!< WebUSB version
+    uint8_t bVendorCode;            //!< bRequest of the WebUSB vendor requests
+    uint8_t iLandingPage;           //!< Index of the landing page URL, zero if none
+};
+
+//! Windows 8.1, the first version supporting Microsoft OS 2.0 descriptors
+static constexpr uint32_t MsOs20WindowsVersion = 0x06030000;
+
+//! Creates the Microsoft OS 2.0 descriptor platform capability for the specified descriptor set
+/*!
+ * Windows reads the descriptor set during the first enumeration, so no driver search nor the
+ * legacy Microsoft OS string descriptor requests are needed. See MsOs20Requests.
+ */
+template<typename TSet> constexpr auto MsOs20Platform(const TSet& descriptorSet, uint8_t vendorCode, uint8_t altEnumCode = 0)
+{
+    return PlatformCapabilityDescriptor<MsOs20PlatformData>(
+        PlatformUuid::Guid(0xD8DD60DF, 0x4589, 0x4CC7, 0x9CD2659D9E648A9F),
+        { descriptorSet.dwWindowsVersion, uint16_t(sizeof(TSet)), vendorCode, altEnumCode });
+}
+
+//! Creates the WebUSB platform capability, @p landingPage is the index of the URL served by WebUsbRequests
+constexpr auto WebUsbPlatform(uint8_t vendorCode, uint8_t landingPage = 0)
+{
+    return PlatformCapabilityDescriptor<WebUsbPlatformData>(
+        PlatformUuid::Guid(0x3408B638, 0x09A9, 0x47A0, 0x8BFDA0768815B665),
+        { 0x0100, vendorCode, landingPage });
+}
+
+//! Microsoft OS 2.0 descriptor types
+enum struct MsOs20Type : uint16_t
+{
+    SetHeader = 0,
+    ConfigurationSubset = 1,
+    FunctionSubset = 2,
+    CompatibleId = 3,
+    RegistryProperty = 4,
+    MinResumeTime = 5,
+    ModelId = 6,
+    CcgpDevice = 7,
+    VendorRevision = 8,
+};
+
+//! Registry value types of Microsoft OS 2.0 registry properties
+enum struct MsOs20PropertyType : uint16_t
+{
+    String = 1,             //!< REG_SZ
+    ExpandString = 2,       //!< REG_EXPAND_SZ
+    Binary = 3,             //!< REG_BINARY
+    DwordLittleEndian = 4,  //!< REG_DWORD_LITTLE_ENDIAN
+    DwordBigEndian = 5,     //!< REG_DWORD_BIG_ENDIAN
+    Link = 6,               //!< REG_LINK
+    MultiString = 7,        //!< REG_MULTI_SZ
+};
+
+//! Microsoft OS 2.0 descriptor set header, immediately followed by the nested descriptors
+template<typename... T> PACKED_UNALIGNED_STRUCT MsOs20DescriptorSetBlock
+{
+    constexpr MsOs20DescriptorSetBlock(uint32_t windowsVersion, const T&... children)
+        : dwWindowsVersion(windowsVersion), children(children...) {}
+
+    uint16_t wLength = 10;                      //!< Length of the header
+    MsOs20Type wDescriptorType = MsOs20Type::SetHeader;
+    uint32_t dwWindowsVersion;                  //!< Minimum Windows version
+    uint16_t wTotalLength = sizeof(MsOs20DescriptorSetBlock);   //!< Length of the whole set
+    ConfigChildren<T...> children;
+};
+
+//! Creates a Microsoft OS 2.0 descriptor set with the specified nested descriptors
+/*!
+ * Devices with a single function place the feature descriptors (e.g. MsOs20CompatibleId)
+ * directly in the set, composite devices wrap them in MsOs20Configuration and MsOs20Function subsets
+ */
+template<typename... T> constexpr MsOs20DescriptorSetBlock<T...> MsOs20DescriptorSet(const T&... children)
+{
+    return MsOs20DescriptorSetBlock<T...>(MsOs20WindowsVersion, children...);
+}
+
+//! Microsoft OS 2.0 configuration subset
+template<typename... T> PACKED_UNALIGNED_STRUCT MsOs20ConfigurationBlock
+{
+    constexpr MsOs20ConfigurationBlock(uint8_t index, const T&... children)
+        : bConfigurationValue(index), children(children...) {}
+
+    uint16_t wLength = 8;
+    MsOs20Type wDescriptorType = MsOs20Type::ConfigurationSubset;
+    uint8_t bConfigurationValue;                //!< Index (not value) of the configuration
+    uint8_t bReserved = 0;
+    uint16_t wTotalLength = sizeof(MsOs20ConfigurationBlock);
+    ConfigChildren<T...> children;
+};
+
+//! Creates a Microsoft OS 2.0 configuration subset, @p index is the zero-based configuration index
+template<typename... T> constexpr MsOs20ConfigurationBlock<T...> MsOs20Configuration(uint8_t index, const T&... children)
+{
+    return MsOs20ConfigurationBlock<T...>(index, children...);
+}
+
+//! Microsoft OS 2.0 function subset
+template<typename... T> PACKED_UNALIGNED_STRUCT MsOs20FunctionBlock
+{
+    constexpr MsOs20FunctionBlock(uint8_t firstInterface, const T&... children)
+        : bFirstInterface(firstInterface), children(children...) {}
+
+    uint16_t wLength = 8;
+    MsOs20Type wDescriptorType = MsOs20Type::FunctionSubset;
+    uint8_t bFirstInterface;                    //!< First interface of the function
+    uint8_t bReserved = 0;
+    uint16_t wSubsetLength = sizeof(MsOs20FunctionBlock);
+    ConfigChildren<T...> children;
+};
+
+//! Creates a Microsoft OS 2.0 function subset for the function starting at @p firstInterface
+template<typename... T> constexpr MsOs20FunctionBlock<T...> MsOs20Function(uint8_t firstInterface, const T&... children)
+{
+    return MsOs20FunctionBlock<T...>(firstInterface, children...);
+}
+
+//! Microsoft OS 2.0 compatible ID descriptor, selects an inbox driver such as WinUSB
+PACKED_UNALIGNED_STRUCT MsOs20CompatibleIdDescriptor
+{
+    template<size_t n, size_t nSub = 1> constexpr MsOs20CompatibleIdDescriptor(const char (&id)[n], const char (&subId)[nSub] = "")
+    {
+        static_assert(n <= 9 && nSub <= 9, "Compatible IDs are limited to 8 characters");
+        for (size_t i = 0; i < n - 1; i++)
+            compatibleId[i] = id[i];
+        for (size_t i = 0; i < nSub - 1; i++)
+            subCompatibleId[i] = subId[i];
+    }
+
+    uint16_t wLength = sizeof(MsOs20CompatibleIdDescriptor);
+    MsOs20Type wDescriptorType = MsOs20Type::CompatibleId;
+    char compatibleId[8] = {};                  //!< Compatible ID, zero-padded
+    char subCompatibleId[8] = {};               //!< Sub-compatible ID, zero-padded
+};
+
+//! Creates a Microsoft OS 2.0 compatible ID descriptor, e.g. MsOs20CompatibleId("WINUSB")
+template<size_t n> constexpr MsOs20CompatibleIdDescriptor MsOs20CompatibleId(const char (&id)[n])
+{
+    return MsOs20CompatibleIdDescriptor(id);
+}
+
+//! Microsoft OS 2.0 registry property descriptor with a UTF-16 name and @p nData bytes of data
+template<size_t nName, size_t nData> PACKED_UNALIGNED_STRUCT MsOs20RegistryPropertyDescriptor
+{
+    // the data is stored as bytes, as the values of some types are not aligned to UTF-16 characters
+    constexpr MsOs20RegistryPropertyDescriptor(MsOs20PropertyType type, const char16_t* name, const char16_t* data, size_t count)
+        : wPropertyDataType(type)
+    {
+        for (size_t i = 0; i < nName; i++)
+            propertyName[i] = name[i];
+        for (size_t i = 0; i < count && i * 2 + 1 < nData; i++)
+        {
+            propertyData[i * 2] = data[i];
+            propertyData[i * 2 + 1] = data[i] >> 8;
+        }
+    }
+
+    uint16_t wLength = sizeof(MsOs20RegistryPropertyDescriptor);
+    MsOs20Type wDescriptorType = MsOs20Type::RegistryProperty;
+    MsOs20PropertyType wPropertyDataType;       //!< Type of the registry value
+    uint16_t wPropertyNameLength = nName * 2;   //!< Length of the name in bytes, including the null terminator
+    char16_t propertyName[nName] = {};          //!< Name of the registry value
+    uint16_t wPropertyDataLength = nData;       //!< Length of the data in bytes
+    uint8_t propertyData[nData] = {};           //!< Data of the registry value
+};
+
+//! Creates a Microsoft OS 2.0 registry property with a string value (REG_SZ)
+template<size_t nName, size_t nValue> constexpr auto MsOs20RegistryProperty(const char16_t (&name)[nName], const char16_t (&value)[nValue])
+{
+    return MsOs20RegistryPropertyDescriptor<nName, nValue * 2>(MsOs20PropertyType::String, name, value, nValue);
+}
+
+//! Creates a Microsoft OS 2.0 registry property with a DWORD value (REG_DWORD_LITTLE_ENDIAN)
+template<size_t nName> constexpr auto MsOs20RegistryProperty(const char16_t (&name)[nName], uint32_t value)
+{
+    const char16_t data[2] = { char16_t(value), char16_t(value >> 16) };
+    return MsOs20RegistryPropertyDescriptor<nName, 4>(MsOs20PropertyType::DwordLittleEndian, name, data, 2);
+}
+
+//! Creates the DeviceInterfaceGUIDs registry property (REG_MULTI_SZ), used by applications to locate a WinUSB device
+/*!
+ * @p guid is in the registry format, including braces, e.g. u"{01234567-89AB-CDEF-0123-456789ABCDEF}"
+ */
+template<size_t n> constexpr auto MsOs20DeviceInterfaceGuid(const char16_t (&guid)[n])
+{
+    // the multi-string is terminated by an additional null character
+    return MsOs20RegistryPropertyDescriptor<21, (n + 1) * 2>(MsOs20PropertyType::MultiString, u"DeviceInterfaceGUIDs", guid, n);
+}
+
+//! Microsoft OS 2.0 minimum resume time descriptor, lets Windows shorten the resume recovery
+PACKED_UNALIGNED_STRUCT MsOs20MinResumeTimeDescriptor
+{
+    constexpr MsOs20MinResumeTimeDescriptor(uint8_t resumeRecovery, uint8_t resumeSignaling)
+        : bResumeRecoveryTime(resumeRecovery), bResumeSignalingTime(resumeSignaling) {}
+
+    uint16_t wLength = sizeof(MsOs20MinResumeTimeDescriptor);
+    MsOs20Type wDescriptorType = MsOs20Type::MinResumeTime;
+    uint8_t bResumeRecoveryTime;                //!< Time in milliseconds the device needs to recover from resume (0-10)
+    uint8_t bResumeSignalingTime;               //!< Time in milliseconds the host has to signal resume (1-20)
+};
+
+//! WebUSB URL descriptor
+template<size_t n> PACKED_UNALIGNED_STRUCT WebUsbUrlDescriptor
+{
+    constexpr WebUsbUrlDescriptor(uint8_t scheme, const char* url)
+        : bScheme(scheme)
+    {
+        for (size_t i = 0; i < n; i++)
+            URL[i] = url[i];
+    }
+
+    uint8_t bLength = sizeof(WebUsbUrlDescriptor);
+    uint8_t bDescriptorType = 3;                //!< WEBUSB_URL
+    uint8_t bScheme;                            //!< 0 for http://, 1 for https://, 255 if included in the URL
+    char URL[n] = {};                           //!< UTF-8 URL without the scheme prefix, not null-terminated
+};
+
+//! Creates a WebUSB URL descriptor for an https:// URL, e.g. WebUsbUrl("example.com/app")
+template<size_t n> constexpr WebUsbUrlDescriptor<n - 1> WebUsbUrl(const char (&url)[n], bool https = true)
+{
+    return WebUsbUrlDescriptor<n - 1>(https ? 1 : 0, url);
+}
+
+//! Vendor request returning the Microsoft OS 2.0 descriptor set
+/*!
+ * @p descriptorSet is the MsOs20DescriptorSet referenced by MsOs20Platform with the same @p vendorCode
+ */
+template<typename TContext, uint8_t vendorCode, const auto& descriptorSet> struct MsOs20Requests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return ControlResult::In(&descriptorSet, sizeof(descriptorSet));
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        // MS_OS_20_DESCRIPTOR_INDEX
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeVendor, SetupPacket::RecipientDevice, vendorCode, Handle, 7),
+    };
+};
+
+//! Vendor request returning the WebUSB URLs, @p urls are WebUsbUrl descriptors with indices starting at 1
+template<typename TContext, uint8_t vendorCode, const auto&... urls> struct WebUsbRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        static constexpr const void* data[] = { &urls... };
+        static constexpr uint8_t lengths[] = { uint8_t(sizeof(urls))... };
+
+        unsigned index = setup.wValue;
+        if (!index || index > sizeof...(urls))
+            return ControlResult::Stall();
+        return ControlResult::In(data[index - 1], lengths[index - 1]);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        // GET_URL
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeVendor, SetupPacket::RecipientDevice, vendorCode, Handle, 2),
+    };
+};
+
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/CdcAcm.cpp
+ */
+
+#include <usb/CdcAcm.h>
+
+namespace usb
+{
+
+namespace
+{
+
+PACKED_UNALIGNED_STRUCT SerialStateNotification
+{
+    uint8_t bmRequestType;
+    uint8_t bNotificationCode;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+    uint16_t wState;
+};
+
+enum
+{
+    NotificationSerialState = 0x20,
+};
+
+static_assert(sizeof(SerialStateNotification) == 10, "Invalid notification layout");
+
+// steady serial state bits, the others are reported once
+const CdcSerialState steadyState = CdcSerialState::Dcd | CdcSerialState::Dsr;
+
+}
+
+ControlResult CdcAcmChannel::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    switch (setup.bRequest)
+    {
+        case SetupPacket::ClassCdcSetLineCoding:
+            if (stage == ControlStage::Setup)
+            {
+                if (setup.wLength != sizeof(CdcLineCoding))
+                    break;
+                return ControlResult::Out(&pendingCoding, sizeof(CdcLineCoding));
+            }
+            else
+            {
+                lineCoding = pendingCoding;
+                return ControlResult::Ack();
+            }
+
+        case SetupPacket::ClassCdcGetLineCoding:
+            return ControlResult::In(&lineCoding, sizeof(CdcLineCoding));
+
+        case SetupPacket::ClassCdcSetControlLineState:
+            controlLineState = CdcControlLineState(setup.wValue & 3);
+            return ControlResult::Ack();
+
+        case SetupPacket::ClassCdcSendBreak:
+            breakDuration = setup.wValue;
+            return ControlResult::Ack();
+
+        default:
+            return ControlResult::Unhandled();
+    }
+
+    return ControlResult::Stall();
+}
+
+bool CdcAcmChannel::Open(uint8_t interface, Endpoint* notify, Endpoint& in, Endpoint& out, uint32_t flushDeadline)
+{
+    Close();
+    if (out.MaxPacketSize() > packetSize)
+        return false;
+    this->interface = interface;
+    this->notifyEp = notify;
+    this->in = &in;
+    this->out = &out;
+    deadline = flushDeadline;
+    SubmitRx();
+    return true;
+}
+
+void CdcAcmChannel::Close()
+{
+    for (auto ep: { notifyEp, in, out })
+    {
+        if (ep)
+            ep->Cancel();
+    }
+
+    notifyEp = in = out = NULL;
+    txSubmitted[0] = txSubmitted[1] = false;
+    txFill = 0;
+    txLength = 0;
+    txFlush = txOpen = false;
+    notifySubmitted = false;
+    rxHead = rxTail = rxSubmitted = 0;
+    rxOffset = 0;
+    serialState = reportedState = CdcSerialState::None;
+    controlLineState = CdcControlLineState::None;
+}
+
+void CdcAcmChannel::SetSerialState(CdcSerialState state)
+{
+    // events not reported yet are kept
+    serialState = state | CdcSerialState(unsigned(serialState) & ~unsigned(steadyState));
+}
+
+/****** Transmit ******/
+
+size_t CdcAcmChannel::WriteSpace() const
+{
+    return in && !TxBusy(txFill) ? txSize - txLength : 0;
+}
+
+size_t CdcAcmChannel::Write(const void* data, size_t length)
+{
+    if (!in)
+        return 0;
+
+    size_t written = 0;
+    while (written < length && !TxBusy(txFill))
+    {
+        // the deadline counts from the time of the last Poll() preceding the first write
+        if (!txLength)
+            txTime = now;
+
+        size_t n = length - written;
+        if (n > size_t(txSize - txLength))
+            n = txSize - txLength;
+        memcpy(tx + txFill * txSize + txLength, (const uint8_t*)data + written, n);
+        txLength += n;
+        written += n;
+
+        if (txLength == txSize)
+            SubmitTx(false);
+    }
+
+    return written;
+}
+
+void CdcAcmChannel::Flush()
+{
+    txFlush = true;
+    if (in && !TxBusy(txFill) && (txLength || txOpen))
+    {
+        SubmitTx(true);
+        txFlush = false;
+    }
+}
+
+void CdcAcmChannel::SubmitTx(bool zlp)
+{
+    auto& t = txTransfers[txFill];
+    t.Setup(tx + txFill * txSize, txLength, zlp);
+    txSubmitted[txFill] = true;
+    // a full buffer sent without a ZLP leaves the read of the host open until more data or a ZLP follows
+    txOpen = !zlp && txLength;
+    txTime = now;
+    txFill ^= 1;
+    txLength = 0;
+    in->Submit(t);
+}
+
+/****** Receive ******/
+
+void CdcAcmChannel::SubmitRx()
+{
+    uint32_t tail = __atomic_load_n(&rxTail, __ATOMIC_ACQUIRE);
+    while (rxSubmitted - tail < rxPackets)
+    {
+        // a single packet per slot, so every packet is available as soon as it arrives
+        unsigned slot = rxSubmitted % rxPackets;
+        rxTransfers[slot].Setup(rx + slot * packetSize, out->MaxPacketSize(), false);
+        rxSubmitted++;
+        out->Submit(rxTransfers[slot]);
+    }
+}
+
+size_t CdcAcmChannel::Available() const
+{
+    uint32_t head = __atomic_load_n(&rxHead, __ATOMIC_ACQUIRE);
+    size_t total = 0;
+    for (uint32_t i = rxTail; i != head; i++)
+        total += rxLengths[i % rxPackets];
+    return total - (rxTail != head ? rxOffset : 0);
+}
+
+bool CdcAcmChannel::Peek(const uint8_t*& data, size_t& length)
+{
+    uint32_t head = __atomic_load_n(&rxHead, __ATOMIC_ACQUIRE);
+    while (rxTail != head)
+    {
+        unsigned slot = rxTail % rxPackets;
+        if (rxOffset < rxLengths[slot])
+        {
+            data = rx + slot * packetSize + rxOffset;
+            length = rxLengths[slot] - rxOffset;
+            return true;
+        }
+
+        // empty slot (ZLP or cancelled transfer)
+        rxOffset = 0;
+        __atomic_store_n(&rxTail, rxTail + 1, __ATOMIC_RELEASE);
+    }
+    return false;
+}
+
+void CdcAcmChannel::Consume(size_t length)
+{
+    if (rxTail == __atomic_load_n(&rxHead, __ATOMIC_ACQUIRE))
+        return;
+
+    rxOffset += length;
+    if (rxOffset >= rxLengths[rxTail % rxPackets])
+    {
+        rxOffset = 0;
+        // the slot is returned to the producer, to be submitted again
+        __atomic_store_n(&rxTail, rxTail + 1, __ATOMIC_RELEASE);
+    }
+}
+
+size_t CdcAcmChannel::Read(void* buffer, size_t length)
+{
+    size_t total = 0;
+    const uint8_t* data;
+    size_t available;
+
+    while (total < length && Peek(data, available))
+    {
+        size_t n = length - total < available ? length - total : available;
+        memcpy((uint8_t*)buffer + total, data, n);
+        Consume(n);
+        total += n;
+    }
+
+    return total;
+}
+
+/****** Poll ******/
+
+void CdcAcmChannel::Poll(uint32_t now)
+{
+    this->now = now;
+    if (!in)
+        return;
+
+    if (!TxBusy(txFill) && (txLength || txOpen) && (txFlush || now - txTime >= deadline))
+        SubmitTx(true);
+    if (!txLength && !txOpen)
+        txFlush = false;
+
+    // publish the received packets in order
+    while (rxHead != rxSubmitted)
+    {
+        unsigned slot = rxHead % rxPackets;
+        auto& t = rxTransfers[slot];
+        if (!t.done)
+            break;
+        rxLengths[slot] = t.status == TransferStatus::Complete ? t.transferred : 0;
+        __atomic_store_n(&rxHead, rxHead + 1, __ATOMIC_RELEASE);
+    }
+    SubmitRx();
+
+    if (notifyEp && (!notifySubmitted || notifyTransfer.done) && serialState != reportedState)
+    {
+        *(SerialStateNotification*)notification = { 0xA1, NotificationSerialState, 0, interface, 2, uint16_t(serialState) };
+        serialState = reportedState = serialState & steadyState;
+        notifyTransfer.Setup(notification, sizeof(SerialStateNotification));
+        notifySubmitted = true;
+        notifyEp->Submit(notifyTransfer);
+    }
+}
+
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/CdcAcm.h
+ *
+ * CDC Abstract Control Model (virtual serial port) function with any number of channels
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Endpoint.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Creates the interfaces of a single CDC-ACM channel
+/*!
+ * The channel occupies interfaces @p interface (communication) and @p interface + 1 (data)
+ */
+constexpr auto CdcAcmDescriptors(uint8_t interface, uint8_t notifyEndpoint, uint8_t dataEndpoint, uint16_t maxPacketSize, uint8_t strName = 0)
+{
+    return DescriptorGroup(
+        InterfaceDescriptor(interface, 0, InterfaceClass::Cdc, SubClass::CdcAcm, Protocol::None, strName,
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcHeader, uint16_t(0x0110)),
+            // no call management
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcCallManagement, uint8_t(0), uint8_t(interface + 1)),
+            // line coding, control line state, serial state and send break
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcAcm, uint8_t(0x06)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcUnion, uint8_t(interface), uint8_t(interface + 1)),
+            EndpointDescriptor::InterruptIn(notifyEndpoint, 16, 8)),
+        InterfaceDescriptor(interface + 1, 0, InterfaceClass::CdcData, SubClass::None, Protocol::None, 0,
+            EndpointDescriptor::BulkIn(dataEndpoint, maxPacketSize),
+            EndpointDescriptor::BulkOut(dataEndpoint, maxPacketSize)));
+}
+
+template<size_t... c> constexpr auto _CdcAcmChannels(uint8_t interface, uint8_t endpoint, uint16_t maxPacketSize, uint8_t strName, std::index_sequence<c...>)
+{
+    constexpr uint8_t n = sizeof...(c);
+    return DescriptorGroup(DescriptorGroup(
+        InterfaceAssociationDescriptor(interface + 2 * c, 2, InterfaceClass::Cdc, SubClass::CdcAcm, Protocol::None, strName),
+        CdcAcmDescriptors(interface + 2 * c, endpoint + n + c, endpoint + c, maxPacketSize, strName))...);
+}
+
+//! Creates the interfaces of @p n CDC-ACM channels, each preceded by an InterfaceAssociationDescriptor
+/*!
+ * Channel @e c occupies interfaces @p interface + 2 * @e c and @p interface + 2 * @e c + 1, uses
+ * endpoint @p endpoint + @e c for data (both directions) and IN endpoint @p endpoint + @p n + @e c
+ * for notifications. When used as a Composite function, the endpoints are renumbered as needed.
+ */
+template<size_t n> constexpr auto CdcAcmChannels(uint8_t interface, uint8_t endpoint, uint16_t maxPacketSize, uint8_t strName = 0)
+{
+    static_assert(n > 0 && n <= 7, "Unsupported number of CDC-ACM channels");
+    return _CdcAcmChannels(interface, endpoint, maxPacketSize, strName, std::make_index_sequence<n>());
+}
+
+//! Line coding set by the host, transferred by SET_LINE_CODING and GET_LINE_CODING
+PACKED_UNALIGNED_STRUCT CdcLineCoding
+{
+    uint32_t dwDTERate = 115200;    //!< Data terminal rate in bits per second
+    uint8_t bCharFormat = 0;        //!< Stop bits: 0 = 1, 1 = 1.5, 2 = 2
+    uint8_t bParityType = 0;        //!< Parity: 0 = none, 1 = odd, 2 = even, 3 = mark, 4 = space
+    uint8_t bDataBits = 8;          //!< Number of data bits
+};
+
+//! Control signals set by the host using SET_CONTROL_LINE_STATE
+enum struct CdcControlLineState : uint16_t
+{
+    None = 0,
+    Dtr = BIT(0),       //!< Data terminal ready, usually asserted when the port is opened by the host
+    Rts = BIT(1),       //!< Request to send
+};
+
+DEFINE_FLAG_ENUM(CdcControlLineState);
+
+//! Serial state reported to the host using SERIAL_STATE notifications
+/*!
+ * Dcd and Dsr are steady states, the other bits are events reported once
+ */
+enum struct CdcSerialState : uint16_t
+{
+    None = 0,
+    Dcd = BIT(0),           //!< Data carrier detect (bRxCarrier)
+    Dsr = BIT(1),           //!< Data set ready (bTxCarrier)
+    Break = BIT(2),         //!< Break detected
+    Ring = BIT(3),          //!< Ring signal detected
+    FramingError = BIT(4),  //!< Framing error
+    ParityError = BIT(5),   //!< Parity error
+    Overrun = BIT(6),       //!< Received data has been discarded
+};
+
+DEFINE_FLAG_ENUM(CdcSerialState);
+
+//! Single channel of a CdcAcm function
+/*!
+ * Transmitted data is coalesced into two buffers of full-size packets, while one of them is
+ * being sent, Write() fills the other. A buffer is submitted as a single transfer when it is full,
+ * when Flush() is called, or when the oldest data in it is older than the flush deadline, so many
+ * small writes result in a few full packets instead of many short ones.
+ *
+ * Received data is stored in a ring of packet slots, each free slot has a transfer queued on the
+ * OUT endpoint, so packets are received directly to their final location, one after another.
+ * The slots are consumed in place using Peek() and Consume(), or copied out using Read(). When
+ * the ring is full, no transfer is queued and the host is NAKed until the data is consumed.
+ *
+ * Write(), Flush(), Poll() and HandleRequest() must follow the rules of Endpoint, i.e. run on
+ * the same scheduler as the controller driver. Available(), Peek(), Consume() and Read() may be
+ * invoked concurrently by a single consumer, the ring is lock-free.
+ */
+class CdcAcmChannel
+{
+public:
+    //! Creates the channel using the provided buffers
+    /*!
+     * @p tx holds two buffers of @p txSize bytes, @p rx holds @p rxPackets slots of @p packetSize bytes,
+     * @p txSize must be a multiple of @p packetSize and @p rxPackets a power of two, so the slot
+     * indexes stay continuous when the free-running counters of the ring wrap
+     */
+    CdcAcmChannel(uint8_t* tx, size_t txSize, uint8_t* rx, uint16_t* rxLengths, EndpointTransfer* rxTransfers, size_t rxPackets, size_t packetSize)
+        : tx(tx), rx(rx), rxLengths(rxLengths), rxTransfers(rxTransfers), txSize(txSize), rxPackets(rxPackets), packetSize(packetSize) {}
+
+    //! Handles a class-specific request directed at the communication interface of the channel
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+
+    //! Starts using the endpoints, to be called when the configuration is selected
+    /*!
+     * @p interface is the number of the communication interface, @p notify may be NULL if
+     * notifications are not used, @p flushDeadline is in the units of the time passed to Poll().
+     * Fails, leaving the channel closed, if a packet of @p out does not fit a receive slot.
+     */
+    bool Open(uint8_t interface, Endpoint* notify, Endpoint& in, Endpoint& out, uint32_t flushDeadline);
+    //! Cancels all transfers and discards buffered data, to be called when the configuration is deselected
+    /*!
+     * Must not be invoked concurrently with the consumer of the received data
+     */
+    void Close();
+    //! Checks if the channel is open
+    bool IsOpen() const { return in; }
+
+    //! Gets the line coding set by the host
+    const CdcLineCoding& LineCoding() const { return lineCoding; }
+    //! Gets the control signals set by the host
+    CdcControlLineState ControlLineState() const { return controlLineState; }
+    //! Checks if the host has the port open (DTR asserted)
+    bool Dtr() const { return !!(controlLineState & CdcControlLineState::Dtr); }
+    //! Gets the duration of the last break requested by the host in milliseconds, 0xFFFF until stopped
+    uint16_t BreakDuration() const { return breakDuration; }
+
+    //! Updates the serial state, a notification is sent if it differs from the state last reported
+    void SetSerialState(CdcSerialState state);
+
+    //! Buffers data for transmission, returns the number of bytes accepted
+    size_t Write(const void* data, size_t length);
+    //! Requests the buffered data to be sent without waiting for the flush deadline
+    void Flush();
+    //! Gets the number of bytes that can be written without blocking
+    size_t WriteSpace() const;
+
+    //! Gets the number of bytes received and not yet consumed
+    size_t Available() const;
+    //! Gets the received data in the oldest slot without copying it, returns false if there is none
+    bool Peek(const uint8_t*& data, size_t& length);
+    //! Releases @p length bytes of received data returned by Peek()
+    void Consume(size_t length);
+    //! Copies received data to the buffer, returns the number of bytes read
+    size_t Read(void* buffer, size_t length);
+
+    //! Submits coalesced data whose deadline expired, pending notifications and free receive slots
+    void Poll(uint32_t now);
+
+private:
+    uint8_t* tx;
+    uint8_t* rx;
+    uint16_t* rxLengths;
+    EndpointTransfer* rxTransfers;
+    uint16_t txSize, rxPackets, packetSize;
+    Endpoint* notifyEp = NULL;
+    Endpoint* in = NULL;
+    Endpoint* out = NULL;
+
+    // two transmit buffers, txFill is being filled while the other one may be in flight
+    EndpointTransfer txTransfers[2];
+    bool txSubmitted[2] = {};
+    uint8_t txFill = 0;
+    bool txFlush = false;
+    bool txOpen = false;    // last transfer ended with a full packet and no ZLP
+    uint16_t txLength = 0;
+    uint32_t txTime = 0, now = 0, deadline = 0;
+
+    // ring of receive slots, rxHead is published by Poll, rxTail by the consumer
+    uint32_t rxHead = 0, rxTail = 0, rxSubmitted = 0;
+    uint16_t rxOffset = 0;
+
+    EndpointTransfer notifyTransfer;
+    uint8_t notification[10];
+    bool notifySubmitted = false;
+    uint8_t interface = 0;
+    CdcSerialState serialState = CdcSerialState::None, reportedState = CdcSerialState::None;
+
+    CdcLineCoding lineCoding, pendingCoding;
+    CdcControlLineState controlLineState = CdcControlLineState::None;
+    uint16_t breakDuration = 0;
+
+    bool TxBusy(unsigned i) const { return txSubmitted[i] && !txTransfers[i].done; }
+    void SubmitTx(bool zlp);
+    void SubmitRx();
+};
+
+//! CdcAcmChannel with storage for the buffers, see CdcAcm for the parameters
+template<size_t packetBytes, size_t rxSlots, size_t txBytes> class CdcAcmChannelStorage : public CdcAcmChannel
+{
+    static_assert(txBytes >= packetBytes && !(txBytes % packetBytes), "Transmit buffer must hold whole packets");
+    static_assert(rxSlots && !(rxSlots & (rxSlots - 1)), "Number of receive slots must be a power of two");
+
+public:
+    CdcAcmChannelStorage()
+        : CdcAcmChannel(txData, txBytes, rxData, lengths, transfers, rxSlots, packetBytes) {}
+
+private:
+    uint8_t txData[txBytes * 2];
+    uint8_t rxData[rxSlots * packetBytes];
+    uint16_t lengths[rxSlots];
+    EndpointTransfer transfers[rxSlots];
+};
+
+//! CDC-ACM function with @p n channels, described by CdcAcmChannels
+/*!
+ * @p packetSize must be at least the max packet size of the bulk endpoints, @p rxPackets is the
+ * number of receive slots (a power of two) and @p txSize the size of each of the two transmit
+ * buffers per channel
+ */
+template<size_t n, size_t packetSize = 64, size_t rxPackets = 8, size_t txSize = 4 * packetSize> class CdcAcm
+{
+public:
+    //! Number of channels
+    static constexpr size_t Count = n;
+
+    //! Gets the specified channel
+    CdcAcmChannel& Channel(size_t index) { return channels[index]; }
+    //! Gets the specified channel
+    CdcAcmChannel& operator[](size_t index) { return channels[index]; }
+
+    //! Polls all the channels, see CdcAcmChannel::Poll
+    void Poll(uint32_t now) { for (auto& c: channels) c.Poll(now); }
+    //! Closes all the channels, see CdcAcmChannel::Close
+    void Close() { for (auto& c: channels) c.Close(); }
+
+private:
+    CdcAcmChannelStorage<packetSize, rxPackets, txSize> channels[n];
+};
+
+//! Class-specific request handlers for a CdcAcm function, for use with a SetupDispatcher
+/*!
+ * @p acm is the member of @p TContext holding the function state, @p interface is the number of
+ * the communication interface of the first channel, the channels follow as laid out by CdcAcmChannels
+ */
+template<typename TContext, typename TAcm, TAcm TContext::*acm, uint8_t interface, typename TChannels = std::make_index_sequence<TAcm::Count>> struct CdcAcmRequests;
+
+template<typename TContext, typename TAcm, TAcm TContext::*acm, uint8_t interface, size_t... c> struct CdcAcmRequests<TContext, TAcm, acm, interface, std::index_sequence<c...>>
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*acm).Channel(((setup.wIndex & 0xFF) - interface) / 2).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> Out(SetupPacket::Request request, uint8_t channel)
+    {
+        return OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface + 2 * channel);
+    }
+
+    static constexpr SetupHandler<TContext> In(SetupPacket::Request request, uint8_t channel)
+    {
+        return OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface + 2 * channel);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        Out(SetupPacket::ClassCdcSetLineCoding, c)...,
+        In(SetupPacket::ClassCdcGetLineCoding, c)...,
+        Out(SetupPacket::ClassCdcSetControlLineState, c)...,
+        Out(SetupPacket::ClassCdcSendBreak, c)...,
+    };
+};
+
+}
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/CdcNcm.cpp
+ */
+
+#include <usb/CdcNcm.h>
+
+namespace usb
+{
+
+namespace
+{
+
+enum : uint32_t
+{
+    Nth16Signature = 0x484D434E,    // "NCMH"
+    Nth32Signature = 0x686D636E,    // "ncmh"
+    Ndp16Signature = 0x304D434E,    // "NCM0"
+    Ndp16CrcSignature = 0x314D434E, // "NCM1"
+    Ndp32Signature = 0x306D636E,    // "ncm0"
+    Ndp32CrcSignature = 0x316D636E, // "ncm1"
+};
+
+PACKED_UNALIGNED_STRUCT Nth16
+{
+    uint32_t dwSignature;
+    uint16_t wHeaderLength;
+    uint16_t wSequence;
+    uint16_t wBlockLength;
+    uint16_t wNdpIndex;
+};
+
+PACKED_UNALIGNED_STRUCT Nth32
+{
+    uint32_t dwSignature;
+    uint16_t wHeaderLength;
+    uint16_t wSequence;
+    uint32_t dwBlockLength;
+    uint32_t dwNdpIndex;
+};
+
+PACKED_UNALIGNED_STRUCT Ndp16
+{
+    uint32_t dwSignature;
+    uint16_t wLength;
+    uint16_t wNextNdpIndex;
+    struct { uint16_t wDatagramIndex, wDatagramLength; } entries[];
+};
+
+PACKED_UNALIGNED_STRUCT Ndp32
+{
+    uint32_t dwSignature;
+    uint16_t wLength;
+    uint16_t wReserved6;
+    uint32_t dwNextNdpIndex;
+    uint32_t dwReserved12;
+    struct { uint32_t dwDatagramIndex, dwDatagramLength; } entries[];
+};
+
+PACKED_UNALIGNED_STRUCT CdcNotification
+{
+    uint8_t bmRequestType;
+    uint8_t bNotificationCode;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+    uint32_t data[2];
+};
+
+enum
+{
+    NotificationNetworkConnection = 0x00,
+    NotificationConnectionSpeedChange = 0x2A,
+};
+
+}
+
+/****** NtbWriter ******/
+
+void NtbWriter::Begin(void* buffer, size_t size, bool ntb32, uint16_t sequence, uint16_t maxDatagrams, uint16_t divisor, uint16_t remainder, uint16_t ndpAlignment)
+{
+    this->buffer = (uint8_t*)buffer;
+    this->size = ntb32 || size <= 0xFFFF ? size : 0xFFFF;
+    this->ntb32 = ntb32;
+    this->sequence = sequence;
+    this->maxDatagrams = maxDatagrams;
+    this->divisor = divisor ? divisor : 1;
+    this->remainder = remainder % this->divisor;
+    count = 0;
+
+    uint32_t hdr = ntb32 ? sizeof(Nth32) : sizeof(Nth16);
+    ndpAlignment = ndpAlignment ? ndpAlignment : 4;
+    ndp = (hdr + ndpAlignment - 1) / ndpAlignment * ndpAlignment;
+    // room for all entries and the terminating null entry
+    offset = ndp + (ntb32 ? sizeof(Ndp32) + (maxDatagrams + 1) * 8 : sizeof(Ndp16) + (maxDatagrams + 1) * 4);
+}
+
+uint32_t NtbWriter::DatagramOffset() const
+{
+    // lowest offset >= current satisfying (offset % divisor) == remainder
+    uint32_t off = offset + divisor - 1 - remainder;
+    return off - off % divisor + remainder;
+}
+
+void* NtbWriter::Reserve(size_t length)
+{
+    uint32_t off = DatagramOffset();
+    if (count >= maxDatagrams || off + length > size)
+        return NULL;
+
+    if (ntb32)
+        ((Ndp32*)(buffer + ndp))->entries[count] = { off, uint32_t(length) };
+    else
+        ((Ndp16*)(buffer + ndp))->entries[count] = { uint16_t(off), uint16_t(length) };
+
+    count++;
+    offset = off + length;
+    return buffer + off;
+}
+
+bool NtbWriter::Add(const void* datagram, size_t length)
+{
+    void* p = Reserve(length);
+    if (!p)
+        return false;
+    memcpy(p, datagram, length);
+    return true;
+}
+
+size_t NtbWriter::Finish()
+{
+    if (ntb32)
+    {
+        *(Nth32*)buffer = { Nth32Signature, sizeof(Nth32), sequence, offset, ndp };
+        auto p = (Ndp32*)(buffer + ndp);
+        p->dwSignature = Ndp32Signature;
+        p->wLength = sizeof(Ndp32) + (count + 1) * 8;
+        p->wReserved6 = 0;
+        p->dwNextNdpIndex = 0;
+        p->dwReserved12 = 0;
+        p->entries[count] = { 0, 0 };
+    }
+    else
+    {
+        *(Nth16*)buffer = { Nth16Signature, sizeof(Nth16), sequence, uint16_t(offset), ndp };
+        auto p = (Ndp16*)(buffer + ndp);
+        p->dwSignature = Ndp16Signature;
+        p->wLength = sizeof(Ndp16) + (count + 1) * 4;
+        p->wNextNdpIndex = 0;
+        p->entries[count] = { 0, 0 };
+    }
+
+    return offset;
+}
+
+/****** NtbReader ******/
+
+bool NtbReader::Begin(const void* ntb, size_t length)
+{
+    this->ntb = (const uint8_t*)ntb;
+    this->length = length;
+    ndp = 0;
+    ndps = 0;
+
+    if (length >= sizeof(Nth16) && ((const Nth16*)ntb)->dwSignature == Nth16Signature)
+    {
+        auto nth = (const Nth16*)ntb;
+        if (nth->wHeaderLength != sizeof(Nth16) || nth->wBlockLength > length)
+            return false;
+        if (nth->wBlockLength)
+            this->length = nth->wBlockLength;
+        ntb32 = false;
+        sequence = nth->wSequence;
+        return OpenNdp(nth->wNdpIndex);
+    }
+
+    if (length >= sizeof(Nth32) && ((const Nth32*)ntb)->dwSignature == Nth32Signature)
+    {
+        auto nth = (const Nth32*)ntb;
+        if (nth->wHeaderLength != sizeof(Nth32) || nth->dwBlockLength > length)
+            return false;
+        if (nth->dwBlockLength)
+            this->length = nth->dwBlockLength;
+        ntb32 = true;
+        sequence = nth->wSequence;
+        return OpenNdp(nth->dwNdpIndex);
+    }
+
+    return false;
+}
+
+bool NtbReader::OpenNdp(uint32_t index)
+{
+    ndp = 0;
+    entry = 0;
+
+    // NDPs must be at least 4-byte aligned and cannot overlap the header,
+    // there cannot be more of them than fit in the block (protects against loops)
+    if (!index || (index & 3) || index < (ntb32 ? sizeof(Nth32) : sizeof(Nth16)) || ++ndps > length / sizeof(Ndp16))
+        return false;
+
+    if (ntb32)
+    {
+        auto p = (const Ndp32*)(ntb + index);
+        if (index + sizeof(Ndp32) > length || index + p->wLength > length || p->wLength < sizeof(Ndp32) + 16 ||
+            (p->dwSignature != Ndp32Signature && p->dwSignature != Ndp32CrcSignature))
+            return false;
+    }
+    else
+    {
+        auto p = (const Ndp16*)(ntb + index);
+        if (index + sizeof(Ndp16) > length || index + p->wLength > length || p->wLength < sizeof(Ndp16) + 8 ||
+            (p->dwSignature != Ndp16Signature && p->dwSignature != Ndp16CrcSignature))
+            return false;
+    }
+
+    ndp = index;
+    return true;
+}
+
+bool NtbReader::Next(const void*& datagram, size_t& length)
+{
+    while (ndp)
+    {
+        uint32_t index, len, next;
+
+        if (ntb32)
+        {
+            auto p = (const Ndp32*)(ntb + ndp);
+            next = p->dwNextNdpIndex;
+            if (sizeof(Ndp32) + (entry + 1) * 8 > p->wLength)
+                index = len = 0;
+            else
+                index = p->entries[entry].dwDatagramIndex, len = p->entries[entry].dwDatagramLength;
+        }
+        else
+        {
+            auto p = (const Ndp16*)(ntb + ndp);
+            next = p->wNextNdpIndex;
+            if (sizeof(Ndp16) + (entry + 1) * 4 > p->wLength)
+                index = len = 0;
+            else
+                index = p->entries[entry].wDatagramIndex, len = p->entries[entry].wDatagramLength;
+        }
+
+        if (!index || !len)
+        {
+            // end of this NDP, continue with the next one
+            if (!OpenNdp(next))
+                return false;
+            continue;
+        }
+
+        entry++;
+        if (index >= this->length || len > this->length - index)
+            continue;   // skip invalid datagrams
+
+        datagram = ntb + index;
+        length = len;
+        return true;
+    }
+
+    return false;
+}
+
+/****** CdcNcm ******/
+
+CdcNcm::CdcNcm(uint32_t ntbInMaxSize, uint32_t ntbOutMaxSize, uint16_t maxDatagramSize, uint16_t alignment, uint16_t maxInDatagrams)
+    : maxInDatagrams(maxInDatagrams), maxDatagramLimit(maxDatagramSize), sequence(0)
+{
+    params.dwNtbInMaxSize = ntbInMaxSize;
+    params.wNdpInDivisor = alignment;
+    params.wNdpInPayloadRemainder = 0;
+    params.wNdpInAlignment = 4;
+    params.dwNtbOutMaxSize = ntbOutMaxSize;
+    params.wNdpOutDivisor = alignment;
+    params.wNdpOutPayloadRemainder = 0;
+    params.wNdpOutAlignment = 4;
+    params.wNtbOutMaxDatagrams = 0;
+    Reset();
+}
+
+void CdcNcm::Reset()
+{
+    ntbInSize = params.dwNtbInMaxSize;
+    ntbInMaxDatagrams = 0;
+    maxDatagramSize = maxDatagramLimit;
+    packetFilter = 0;
+    ntb32 = false;
+}
+
+ControlResult CdcNcm::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    switch (setup.bRequest)
+    {
+        case SetupPacket::ClassCdcSetEthernetPacketFilter:
+            if (setup.direction != SetupPacket::DirOut)
+                break;
+            packetFilter = setup.wValue;
+            return ControlResult::Ack();
+
+        case SetupPacket::ClassNcmGetNtbParameters:
+            return ControlResult::In(&params, sizeof(params));
+
+        case SetupPacket::ClassNcmGetNtbFormat:
+            response[0] = ntb32;
+            return ControlResult::In(response, 2);
+
+        case SetupPacket::ClassNcmSetNtbFormat:
+            if (setup.wValue > 1)
+                break;
+            ntb32 = setup.wValue;
+            return ControlResult::Ack();
+
+        case SetupPacket::ClassNcmGetNtbInputSize:
+            response[0] = ntbInSize;
+            response[1] = ntbInMaxDatagrams;
+            return ControlResult::In(response, 8);
+
+        case SetupPacket::ClassNcmSetNtbInputSize:
+            if (stage == ControlStage::Setup)
+            {
+                if (setup.wLength != 4 && setup.wLength != 8)
+                    break;
+                return ControlResult::Out(request, setup.wLength);
+            }
+            else
+            {
+                uint32_t size;
+                memcpy(&size, request, 4);
+                // the NTB must be able to hold at least the headers
+                if (size > params.dwNtbInMaxSize || size < 64)
+                    break;
+                ntbInSize = size;
+                if (setup.wLength == 8)
+                    memcpy(&ntbInMaxDatagrams, request + 4, 2);
+                return ControlResult::Ack();
+            }
+
+        case SetupPacket::ClassNcmGetMaxDatagramSize:
+            response[0] = maxDatagramSize;
+            return ControlResult::In(response, 2);
+
+        case SetupPacket::ClassNcmSetMaxDatagramSize:
+            if (stage == ControlStage::Setup)
+            {
+                if (setup.wLength != 2)
+                    break;
+                return ControlResult::Out(request, 2);
+            }
+            else
+            {
+                uint16_t size;
+                memcpy(&size, request, 2);
+                if (size > maxDatagramLimit)
+                    break;
+                maxDatagramSize = size;
+                return ControlResult::Ack();
+            }
+
+        default:
+            return ControlResult::Unhandled();
+    }
+
+    return ControlResult::Stall();
+}
+
+void CdcNcm::BeginIn(NtbWriter& writer, void* buffer, size_t size)
+{
+    size_t max = maxInDatagrams;
+    if (ntbInMaxDatagrams && ntbInMaxDatagrams < max)
+        max = ntbInMaxDatagrams;
+
+    writer.Begin(buffer, size < ntbInSize ? size : ntbInSize, ntb32, sequence++, max,
+        params.wNdpInDivisor, params.wNdpInPayloadRemainder, params.wNdpInAlignment);
+}
+
+size_t CdcNcm::ConnectionNotification(void* buffer, uint8_t interface, bool connected) const
+{
+    CdcNotification n = { 0xA1, NotificationNetworkConnection, connected, interface, 0, {} };
+    memcpy(buffer, &n, 8);
+    return 8;
+}
+
+size_t CdcNcm::SpeedNotification(void* buffer, uint8_t interface, uint32_t downstream, uint32_t upstream) const
+{
+    *(CdcNotification*)buffer = { 0xA1, NotificationConnectionSpeedChange, 0, interface, 8, { downstream, upstream } };
+    return 16;
+}
+
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/CdcNcm.h
+ *
+ * CDC Network Control Model function
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Creates the interfaces of a CDC-NCM function
+/*!
+ * The function occupies interfaces @p interface (communication) and @p interface + 1 (data),
+ * the data interface has the endpoints only in alternate setting 1, as required by the specification
+ */
+constexpr auto CdcNcmDescriptors(uint8_t interface, uint8_t notifyEndpoint, uint8_t dataEndpoint, uint16_t maxPacketSize,
+    uint8_t strMacAddress, uint16_t maxSegmentSize = 1514, uint8_t strName = 0)
+{
+    return DescriptorGroup(
+        InterfaceDescriptor(interface, 0, InterfaceClass::Cdc, SubClass::CdcNcm, Protocol::None, strName,
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcHeader, uint16_t(0x0110)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcUnion, uint8_t(interface), uint8_t(interface + 1)),
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcEthernet, strMacAddress, uint32_t(0), maxSegmentSize, uint16_t(0), uint8_t(0)),
+            // packet filter, max datagram size, 8-byte NTB input size
+            ClassSpecificInterfaceDescriptor(DescriptorSubType::CdcNcm, uint16_t(0x0100), uint8_t(0x29)),
+            EndpointDescriptor::InterruptIn(notifyEndpoint, 16, 8)),
+        InterfaceDescriptor(interface + 1, 0, InterfaceClass::CdcData, SubClass::None, Protocol::CdcDataNtb),
+        InterfaceDescriptor(interface + 1, 1, InterfaceClass::CdcData, SubClass::None, Protocol::CdcDataNtb, 0,
+            EndpointDescriptor::BulkIn(dataEndpoint, maxPacketSize),
+            EndpointDescriptor::BulkOut(dataEndpoint, maxPacketSize)));
+}
+
+//! NTB parameter structure, returned by GET_NTB_PARAMETERS
+PACKED_UNALIGNED_STRUCT NtbParameters
+{
+    uint16_t wLength = sizeof(NtbParameters);   //!< Size of the structure
+    uint16_t bmNtbFormatsSupported = 3;         //!< Supported NTB formats, NTB-16 and NTB-32
+    uint32_t dwNtbInMaxSize;                    //!< Maximum size of IN NTBs
+    uint16_t wNdpInDivisor;                     //!< Modulus for aligning datagrams in IN NTBs
+    uint16_t wNdpInPayloadRemainder;            //!< Remainder for aligning datagrams in IN NTBs
+    uint16_t wNdpInAlignment;                   //!< Alignment of NDPs in IN NTBs
+    uint16_t wReserved = 0;
+    uint32_t dwNtbOutMaxSize;                   //!< Maximum size of OUT NTBs
+    uint16_t wNdpOutDivisor;                    //!< Modulus for aligning datagrams in OUT NTBs
+    uint16_t wNdpOutPayloadRemainder;           //!< Remainder for aligning datagrams in OUT NTBs
+    uint16_t wNdpOutAlignment;                  //!< Alignment of NDPs in OUT NTBs
+    uint16_t wNtbOutMaxDatagrams;               //!< Maximum number of datagrams in an OUT NTB, zero for no limit
+};
+
+//! Builds NTB-16 or NTB-32 transfer blocks aggregating multiple datagrams
+/*!
+ * The NTH is placed at the start of the block, immediately followed by a single NDP with room
+ * for the maximum number of datagrams, so the datagrams can be written directly to their
+ * final location as they arrive.
+ */
+class NtbWriter
+{
+public:
+    //! Starts a new NTB in the provided buffer
+    void Begin(void* buffer, size_t size, bool ntb32, uint16_t sequence, uint16_t maxDatagrams = 32, uint16_t divisor = 4, uint16_t remainder = 0, uint16_t ndpAlignment = 4);
+
+    //! Reserves space for a datagram of the specified length
+    /*!
+     * @returns the location where the datagram is to be written, or NULL if it does not fit in the NTB
+     */
+    void* Reserve(size_t length);
+    //! Adds a copy of a datagram to the NTB, returns false if it does not fit
+    bool Add(const void* datagram, size_t length);
+
+    //! Gets the number of datagrams in the NTB
+    size_t Count() const { return count; }
+    //! Checks if the NTB contains no datagrams
+    bool Empty() const { return !count; }
+    //! Checks if another datagram of the specified length would fit in the NTB
+    bool Fits(size_t length) const { return count < maxDatagrams && DatagramOffset() + length <= size; }
+
+    //! Completes the NTB, returning its total length
+    size_t Finish();
+
+private:
+    uint8_t* buffer;
+    uint32_t size;
+    uint32_t offset;
+    uint16_t ndp;
+    uint16_t count;
+    uint16_t maxDatagrams;
+    uint16_t sequence;
+    uint16_t divisor, remainder;
+    bool ntb32;
+
+    uint32_t DatagramOffset() const;
+};
+
+//! Parses a received NTB-16 or NTB-32 transfer block, without copying the datagrams
+class NtbReader
+{
+public:
+    //! Starts parsing the specified NTB, returns false if the header is invalid
+    bool Begin(const void* ntb, size_t length);
+    //! Gets the next datagram, returns false when there are no more datagrams
+    bool Next(const void*& datagram, size_t& length);
+
+    //! Gets the sequence number of the NTB
+    uint16_t Sequence() const { return sequence; }
+
+private:
+    const uint8_t* ntb;
+    uint32_t length;
+    uint32_t ndp;
+    uint32_t entry;
+    uint32_t ndps;
+    uint16_t sequence;
+    bool ntb32;
+
+    bool OpenNdp(uint32_t index);
+};
+
+//! State of a CDC-NCM function, handles the class-specific requests
+class CdcNcm
+{
+public:
+    //! Creates the NCM function with the specified NTB limits
+    CdcNcm(uint32_t ntbInMaxSize = 2048, uint32_t ntbOutMaxSize = 2048, uint16_t maxDatagramSize = 1514, uint16_t alignment = 4, uint16_t maxInDatagrams = 32);
+
+    //! Handles a class-specific request directed at the communication interface
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+    //! Resets the state negotiated by the host, to be called when the data interface is deselected
+    void Reset();
+
+    //! Checks if the host selected the NTB-32 format
+    bool Ntb32() const { return ntb32; }
+    //! Gets the maximum size of IN NTBs accepted by the host
+    uint32_t NtbInSize() const { return ntbInSize; }
+    //! Gets the maximum number of datagrams per IN NTB accepted by the host, zero for no limit
+    uint16_t NtbInMaxDatagrams() const { return ntbInMaxDatagrams; }
+    //! Gets the maximum datagram size selected by the host
+    uint16_t MaxDatagramSize() const { return maxDatagramSize; }
+    //! Gets the Ethernet packet filter set by the host
+    uint16_t PacketFilter() const { return packetFilter; }
+    //! Gets the NTB parameters reported to the host
+    const NtbParameters& Parameters() const { return params; }
+
+    //! Starts a new IN NTB in the provided buffer, using the negotiated format and size
+    void BeginIn(NtbWriter& writer, void* buffer, size_t size);
+
+    //! Builds a NETWORK_CONNECTION notification (8 bytes) for the interrupt endpoint, returns its length
+    size_t ConnectionNotification(void* buffer, uint8_t interface, bool connected) const;
+    //! Builds a CONNECTION_SPEED_CHANGE notification (16 bytes) for the interrupt endpoint, returns its length
+    size_t SpeedNotification(void* buffer, uint8_t interface, uint32_t downstream, uint32_t upstream) const;
+
+private:
+    NtbParameters params;
+    uint32_t ntbInSize;
+    uint16_t ntbInMaxDatagrams, maxInDatagrams;
+    uint16_t maxDatagramSize, maxDatagramLimit;
+    uint16_t packetFilter;
+    uint16_t sequence;
+    bool ntb32;
+    uint8_t request[8];
+    uint32_t response[2];
+};
+
+//! Class-specific request handlers for a CdcNcm function, for use with a SetupDispatcher
+/*!
+ * @p ncm is the member of @p TContext holding the function state, @p interface is the number of its communication interface
+ */
+template<typename TContext, CdcNcm TContext::*ncm, uint8_t interface> struct CdcNcmRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*ncm).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> Out(SetupPacket::Request request)
+    {
+        return OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface);
+    }
+
+    static constexpr SetupHandler<TContext> In(SetupPacket::Request request)
+    {
+        return OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        Out(SetupPacket::ClassCdcSetEthernetPacketFilter),
+        In(SetupPacket::ClassNcmGetNtbParameters),
+        In(SetupPacket::ClassNcmGetNtbFormat),
+        Out(SetupPacket::ClassNcmSetNtbFormat),
+        In(SetupPacket::ClassNcmGetNtbInputSize),
+        Out(SetupPacket::ClassNcmSetNtbInputSize),
+        In(SetupPacket::ClassNcmGetMaxDatagramSize),
+        Out(SetupPacket::ClassNcmSetMaxDatagramSize),
+    };
+};
+
+}
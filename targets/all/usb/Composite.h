@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Composite.h
+ *
+ * Compile-time composition of functions with automatic interface and endpoint numbering
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+
+namespace usb
+{
+
+//! Rules for sharing a hardware endpoint number between an IN and an OUT endpoint
+enum struct EndpointSharing : uint8_t
+{
+    None,       //!< Every endpoint uses a separate number
+    SameType,   //!< IN and OUT endpoints of the same type may share a number (controllers with a single type per number)
+    Any,        //!< IN and OUT endpoints may share a number regardless of their types
+};
+
+//! Problems detected when laying out a Composite configuration
+enum struct CompositeError : uint8_t
+{
+    None,                   //!< Layout is valid
+    TooManyEndpoints,       //!< Not enough hardware endpoint numbers for the endpoints of all functions
+    TooManyInterfaces,      //!< More than 255 interfaces in total
+    InvalidEndpoint,        //!< A function uses endpoint number zero or reserved address bits
+    ConflictingEndpoint,    //!< A function uses the same endpoint address with different endpoint types
+};
+
+//! Interface and endpoint numbers allocated to @p n functions of a Composite
+template<size_t n> struct CompositeLayout
+{
+    uint8_t firstInterface[n ? n : 1];  //!< Number of the first interface of each function
+    uint8_t interfaceCount[n ? n : 1];  //!< Number of interfaces (alternate settings excluded) of each function
+    uint8_t addresses[n ? n : 1][32];   //!< Allocated address for each local endpoint slot (see EndpointIndex::Slot) of each function
+    uint8_t endpoints;                  //!< Highest hardware endpoint number used
+    CompositeError error;               //!< Problem detected during the allocation
+};
+
+/*
+ * Allocates the interfaces sequentially and the endpoints first-fit, lowest number first.
+ * A number which is entirely free is never lower than a number which is half-used, so an endpoint
+ * always pairs with a compatible endpoint of the opposite direction if there is one, resulting
+ * in the minimal number of hardware endpoints for each sharing mode
+ */
+template<EndpointSharing sharing, unsigned maxEndpoint, const auto&... functions> constexpr CompositeLayout<sizeof...(functions)> _CompositeAllocate()
+{
+    CompositeLayout<sizeof...(functions)> res = {};
+    // endpoint type + 1 of the endpoint allocated to each hardware slot, zero if free
+    uint8_t used[32] = {};
+    unsigned nextInterface = 0;
+    size_t f = 0;
+
+    auto allocate = [&](const auto& fn)
+    {
+        auto desc = fn(uint8_t(nextInterface));
+        unsigned count = _CountInterfaces(desc);
+        res.firstInterface[f] = nextInterface;
+        res.interfaceCount[f] = count;
+        nextInterface += count;
+        if (nextInterface > 255)
+            res.error = CompositeError::TooManyInterfaces;
+
+        // endpoint type + 1 of each local endpoint slot, the same endpoint may appear in several alternate settings
+        uint8_t local[32] = {};
+        VisitDescriptors(desc, [&](const auto& d, size_t)
+        {
+            if constexpr (std::is_same<std::decay_t<decltype(d)>, EndpointDescriptor>::value)
+            {
+                uint8_t address = d.bEndpointAddress, type = uint8_t(d.Type()) + 1;
+                unsigned slot = EndpointIndex<0>::Slot(address);
+                if (!(address & 0xF) || (address & 0x70))
+                {
+                    res.error = CompositeError::InvalidEndpoint;
+                    return;
+                }
+
+                if (local[slot])
+                {
+                    if (local[slot] != type)
+                        res.error = CompositeError::ConflictingEndpoint;
+                    return;
+                }
+                local[slot] = type;
+
+                for (unsigned number = 1; number <= maxEndpoint; number++)
+                {
+                    unsigned hw = (slot & 0x10) | number;
+                    uint8_t other = used[hw ^ 0x10];
+                    if (used[hw] || (other && (sharing == EndpointSharing::None || (sharing == EndpointSharing::SameType && other != type))))
+                        continue;
+
+                    used[hw] = type;
+                    res.addresses[f][slot] = (address & 0x80) | number;
+                    if (number > res.endpoints)
+                        res.endpoints = number;
+                    return;
+                }
+
+                res.error = CompositeError::TooManyEndpoints;
+            }
+        });
+        f++;
+    };
+
+    (allocate(functions), ...);
+    return res;
+}
+
+// renumbers the endpoint addresses contained in descriptors other than EndpointDescriptor (e.g. the UVC input header),
+// the overloads for such descriptors are resolved via ADL when instantiated
+template<typename T, typename TFn> constexpr void _RenumberEndpointReferences(const T&, TFn&) {}
+
+template<typename T1, typename TFn> constexpr void _RenumberEndpointReferences(const ConfigChildren<T1, _Empty>& c, TFn& renumber)
+{
+    _RenumberEndpointReferences(c.first, renumber);
+}
+
+template<typename T1, typename T2, typename... TRest, typename TFn> constexpr void _RenumberEndpointReferences(const ConfigChildren<T1, T2, TRest...>& c, TFn& renumber)
+{
+    _RenumberEndpointReferences(c.first, renumber);
+    _RenumberEndpointReferences(c.rest, renumber);
+}
+
+template<typename... T, typename TFn> constexpr void _RenumberEndpointReferences(const InterfaceDescriptorBlock<T...>& d, TFn& renumber)
+{
+    _RenumberEndpointReferences(d.endpoints, renumber);
+}
+
+//! Composite configuration built from independent functions
+/*!
+ * Each function is a constexpr object with static storage duration (usually a lambda), called
+ * with the number of its first interface and returning its descriptors, e.g.:
+ *
+ *     constexpr auto net = [](uint8_t interface) { return CdcNcmDescriptors(interface, 1, 2, 512, 4); };
+ *     constexpr auto disk = [](uint8_t interface) { return MscDescriptors(interface, 1, 512); };
+ *     using Device = Composite<EndpointSharing::Any, 5, net, disk>;
+ *     constexpr auto config = Device::Config(1, 100);
+ *
+ * The endpoint numbers used by the function are local to it, the endpoints (and the descriptors
+ * referring to them, such as the UVC input header) are renumbered to
+ * share as few hardware endpoints (at most @p maxEndpoint, excluding endpoint zero) as possible
+ * within the limits given by @p sharing. Functions with more than one interface are preceded by an
+ * InterfaceAssociationDescriptor copying the class and name of their first interface, unless they
+ * already contain their own associations. The DeviceDescriptor of a device using associations
+ * must use DeviceClass::Misc, SubClass::MiscCommon, Protocol::MiscIad.
+ *
+ * Interface numbers and endpoint addresses needed by the request handlers and transfers are
+ * available at compile time via Interface() and EndpointAddress(). Layouts that do not fit fail to compile.
+ */
+template<EndpointSharing sharing, unsigned maxEndpoint, const auto&... functions> class Composite
+{
+    static_assert(maxEndpoint >= 1 && maxEndpoint <= 15, "Endpoint numbers are limited to 1-15");
+
+public:
+    //! Number of functions
+    static constexpr size_t Count = sizeof...(functions);
+    //! Allocated interface and endpoint numbers
+    static constexpr CompositeLayout<Count> Layout = _CompositeAllocate<sharing, maxEndpoint, functions...>();
+
+    static_assert(Layout.error != CompositeError::TooManyEndpoints, "Not enough hardware endpoints for all functions");
+    static_assert(Layout.error != CompositeError::TooManyInterfaces, "Too many interfaces");
+    static_assert(Layout.error != CompositeError::InvalidEndpoint, "Functions must use endpoint numbers 1-15");
+    static_assert(Layout.error != CompositeError::ConflictingEndpoint, "Function uses the same endpoint address with different types");
+
+    //! Gets the number of the first interface of the specified function
+    static constexpr uint8_t Interface(size_t function) { return Layout.firstInterface[function]; }
+    //! Gets the allocated address of the endpoint of the specified function, given its local address
+    static constexpr uint8_t EndpointAddress(size_t function, uint8_t address) { return Layout.addresses[function][EndpointIndex<0>::Slot(address)]; }
+    //! Gets the number of hardware endpoints used (excluding endpoint zero)
+    static constexpr unsigned Endpoints() { return Layout.endpoints; }
+
+    //! Creates the ConfigDescriptorBlock containing all the functions
+    static constexpr auto Config(uint8_t index, int maxPower, uint8_t strName = 0, ConfigAttributes attributes = ConfigAttributes::BusPowered)
+    {
+        return Build(index, maxPower, strName, attributes, std::make_index_sequence<Count>());
+    }
+
+private:
+    template<size_t... i> static constexpr auto Build(uint8_t index, int maxPower, uint8_t strName, ConfigAttributes attributes, std::index_sequence<i...>)
+    {
+        return ConfigDescriptor(index, maxPower, strName, attributes, Function<functions, i>()...);
+    }
+
+    template<const auto& fn, size_t f> static constexpr auto Function()
+    {
+        auto desc = fn(Layout.firstInterface[f]);
+        const InterfaceDescriptorHeader* first = NULL;
+        // the copy is not const, so the endpoints can be renumbered in place
+        VisitDescriptors(desc, [&](const auto& d, size_t)
+        {
+            if constexpr (std::is_same<std::decay_t<decltype(d)>, EndpointDescriptor>::value)
+                const_cast<EndpointDescriptor&>(d).bEndpointAddress = Layout.addresses[f][EndpointIndex<0>::Slot(d.bEndpointAddress)];
+            else if (!first)
+                first = &d;
+        });
+        auto renumber = [](uint8_t address) { return Layout.addresses[f][EndpointIndex<0>::Slot(address)]; };
+        _RenumberEndpointReferences(desc, renumber);
+
+        // functions with their own associations (e.g. CdcAcmChannels) are left as they are
+        if constexpr (Layout.interfaceCount[f] > 1 &&
+            !_NestedCount<InterfaceAssociationDescriptor, decltype(desc)>::value)
+        {
+            return DescriptorGroup(
+                InterfaceAssociationDescriptor(Layout.firstInterface[f], Layout.interfaceCount[f],
+                    first->bInterfaceClass, first->bInterfaceSubClass, first->bInterfaceProtocol, first->iInterface),
+                desc);
+        }
+        else
+        {
+            return desc;
+        }
+    }
+};
+
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/ControlTransfer.cpp
+ */
+
+#include <usb/ControlTransfer.h>
+
+namespace usb
+{
+
+void ControlTransfer::Begin(const SetupPacket& setup, const ControlResult& result, unsigned maxPacketSize, void* packetBuffer)
+{
+    this->maxPacketSize = maxPacketSize;
+    this->packetBuffer = packetBuffer;
+    transferred = 0;
+    zlp = false;
+    generate = NULL;
+
+    switch (result.status)
+    {
+        case ControlResult::Status::In:
+            if (setup.direction != SetupPacket::DirIn || (result.generate && !packetBuffer))
+                break;
+            in = (const uint8_t*)result.in;
+            generate = result.generate;
+            remaining = result.length < setup.wLength ? result.length : setup.wLength;
+            zlp = result.NeedsZlp(setup, maxPacketSize);
+            // an empty response to a request expecting data is still a data stage consisting of a ZLP
+            stage = remaining || setup.wLength ? Stage::DataIn : Stage::Status;
+            return;
+
+        case ControlResult::Status::Out:
+            // the handler must be able to accept all the data announced by the host
+            if (setup.direction != SetupPacket::DirOut || result.length < setup.wLength)
+                break;
+            out = (uint8_t*)result.out;
+            remaining = setup.wLength;
+            stage = remaining ? Stage::DataOut : Stage::Status;
+            return;
+
+        case ControlResult::Status::Ack:
+            // OUT data not claimed by the handler cannot be accepted
+            if (setup.direction == SetupPacket::DirOut && setup.wLength)
+                break;
+            remaining = 0;
+            stage = Stage::Status;
+            return;
+
+        default:
+            break;
+    }
+
+    remaining = 0;
+    stage = Stage::Stall;
+}
+
+ControlPacket ControlTransfer::NextIn()
+{
+    if (stage != Stage::DataIn)
+        return { NULL, 0 };
+
+    uint16_t len = remaining < maxPacketSize ? remaining : maxPacketSize;
+    ControlPacket pkt = { in, len };
+    if (generate)
+    {
+        // the source stays in place, the generator is given the offset
+        generate(in, transferred, packetBuffer, len);
+        pkt.data = packetBuffer;
+    }
+    else
+    {
+        in += len;
+    }
+    remaining -= len;
+    transferred += len;
+
+    // a short packet terminates the data stage by itself, a full one may need a ZLP after it
+    if (!remaining && (len < maxPacketSize || !zlp))
+        stage = Stage::Status;
+
+    return pkt;
+}
+
+ControlBuffer ControlTransfer::NextOut() const
+{
+    if (stage != Stage::DataOut)
+        return { NULL, 0 };
+
+    return { out, uint16_t(remaining < maxPacketSize ? remaining : maxPacketSize) };
+}
+
+bool ControlTransfer::OutReceived(size_t length)
+{
+    if (stage != Stage::DataOut)
+        return false;
+
+    if (length > remaining)
+        length = remaining;
+
+    out += length;
+    remaining -= length;
+    transferred += length;
+
+    if (!remaining || length < maxPacketSize)
+    {
+        stage = Stage::Status;
+        return true;
+    }
+
+    return false;
+}
+
+}
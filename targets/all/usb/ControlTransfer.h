@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/ControlTransfer.h
+ *
+ * Zero-copy control transfer data stage
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Single control endpoint packet
+struct ControlPacket
+{
+    const void* data;   //!< Packet data, pointing directly into the source memory
+    uint16_t length;    //!< Length of the packet, zero for a ZLP
+};
+
+//! Destination of a single control endpoint OUT packet
+struct ControlBuffer
+{
+    void* data;         //!< Location where the packet should be received, pointing directly into the destination memory
+    uint16_t length;    //!< Maximum length of the packet
+};
+
+//! State of the data stage of a control transfer
+/*!
+ * IN data is split into packets pointing directly into the memory provided by the request handler
+ * (typically descriptors in flash), OUT data is received directly into the destination
+ * provided by the handler. No intermediate EP0 buffer is needed, provided the controller can
+ * access the memory in question.
+ *
+ * IN data with a ControlGenerator (e.g. compact strings) is produced one packet at a time into
+ * the packet buffer passed to Begin(), such requests are stalled if no buffer is available.
+ */
+class ControlTransfer
+{
+public:
+    enum struct Stage : uint8_t
+    {
+        Idle,       //!< No transfer in progress
+        DataIn,     //!< IN data stage in progress, packets are obtained using NextIn()
+        DataOut,    //!< OUT data stage in progress, buffers are obtained using NextOut()
+        Status,     //!< Data stage complete (or not present), status stage follows
+        Stall,      //!< Request was rejected, endpoint must be stalled
+    };
+
+    //! Starts the data stage according to the result of request dispatch
+    /*!
+     * @p packetBuffer receives the packets of generated IN data, it must hold @p maxPacketSize bytes
+     */
+    void Begin(const SetupPacket& setup, const ControlResult& result, unsigned maxPacketSize, void* packetBuffer = NULL);
+
+    //! Gets the current stage of the transfer
+    Stage CurrentStage() const { return stage; }
+    //! Gets the number of bytes remaining in the data stage (excluding a possible ZLP)
+    size_t Remaining() const { return remaining; }
+    //! Gets the number of bytes already transferred
+    size_t Transferred() const { return transferred; }
+
+    //! Gets the next IN packet, Stage::Status is entered after the last packet (including a ZLP if required) is returned
+    ControlPacket NextIn();
+    //! Gets the destination for the next OUT packet
+    ControlBuffer NextOut() const;
+    //! Completes the OUT packet received into the buffer returned by NextOut
+    /*!
+     * @returns true if the data stage is complete, i.e. all data was received or the packet was short.
+     * The request handler should then be invoked again with ControlStage::DataOut.
+     */
+    bool OutReceived(size_t length);
+
+    //! Completes the status stage, or aborts the transfer (e.g. when a new setup packet arrives)
+    void End() { stage = Stage::Idle; }
+
+private:
+    union
+    {
+        const uint8_t* in;
+        uint8_t* out;
+    };
+    ControlGenerator generate = NULL;
+    void* packetBuffer = NULL;
+    uint16_t remaining = 0;
+    uint16_t transferred = 0;
+    uint16_t maxPacketSize = 64;
+    Stage stage = Stage::Idle;
+    bool zlp = false;
+};
+
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/DescriptorMap.cpp
+ */
+
+#include <usb/DescriptorMap.h>
+
+namespace usb
+{
+
+const DescriptorEntry* DescriptorMapView::Find(DescriptorType type, uint8_t index, uint16_t language) const
+{
+    uint32_t key = DescriptorEntry::Key(type, index, language);
+    size_t lo = 0, hi = count;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        uint32_t k = entries[mid].key;
+        if (k == key)
+            return &entries[mid];
+        if (k < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return NULL;
+}
+
+DescriptorResponse DescriptorMapView::Find(const SetupPacket& setup, unsigned maxPacketSize0) const
+{
+    const DescriptorEntry* e;
+
+    if (setup.descriptorType != DescriptorType::String)
+        e = Find(setup.descriptorType, setup.descriptorIndex);
+    else if (!setup.descriptorIndex)
+        e = Find(DescriptorType::String, 0);
+    else if (!(e = Find(DescriptorType::String, setup.descriptorIndex, setup.wIndex)) && setup.wIndex != language)
+        e = Find(DescriptorType::String, setup.descriptorIndex, language);
+
+    if (!e)
+        return { NULL, 0, false, NULL };
+
+#if USB_COMPACT_STRINGS
+    ControlGenerator generate = e->generate;
+#else
+    ControlGenerator generate = NULL;
+#endif
+
+    uint16_t len = e->length;
+    if (len >= setup.wLength)
+        return { e->Data(), setup.wLength, false, generate };
+
+    return { e->Data(), len, !(len % maxPacketSize0), generate };
+}
+
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/DescriptorMap.h
+ *
+ * Precomputed GET_DESCRIPTOR responses
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Bos.h>
+#include <usb/Packets.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Location of a single descriptor returned by GET_DESCRIPTOR
+struct DescriptorEntry
+{
+    uint32_t key;       //!< Lookup key, see Key()
+    const void* base;   //!< Object containing the descriptor
+    uint16_t offset;    //!< Offset of the descriptor in the object
+    uint16_t length;    //!< Length of the descriptor
+#if USB_COMPACT_STRINGS
+    ControlGenerator generate;  //!< Generator of the descriptor from the object (compact strings), NULL if the descriptor is sent as it is
+#endif
+
+    //! Builds the lookup key for the specified descriptor
+    static constexpr uint32_t Key(DescriptorType type, uint8_t index, uint16_t language = 0)
+    {
+        return (uint32_t)type << 24 | (uint32_t)index << 16 | language;
+    }
+
+    //! Gets the descriptor data
+    const void* Data() const { return (const void*)((uintptr_t)base + offset); }
+};
+
+//! Creates a DescriptorEntry for an arbitrary descriptor object, e.g. BOS or Device Qualifier
+template<typename T> constexpr DescriptorEntry Descriptor(DescriptorType type, uint8_t index, const T& descriptor, uint16_t language = 0)
+{
+    return { DescriptorEntry::Key(type, index, language), &descriptor, 0, uint16_t(sizeof(T)) };
+}
+
+//! Descriptor data to be sent in response to a GET_DESCRIPTOR request
+struct DescriptorResponse
+{
+    const void* data;   //!< Descriptor data, NULL if the descriptor does not exist
+    uint16_t length;    //!< Length of the response, already truncated to wLength
+    bool zlp;           //!< A zero-length packet must terminate the data stage
+    ControlGenerator generate;  //!< Generator of the response from the data, see ControlResult::In
+
+    //! Checks if the descriptor was found
+    constexpr operator bool() const { return data; }
+};
+
+//! Type-erased view of a DescriptorMap
+struct DescriptorMapView
+{
+    const DescriptorEntry* entries;     //!< Entries, sorted by key
+    uint16_t count;                     //!< Number of entries
+    uint16_t language;                  //!< Primary language, used for string requests in other languages
+
+    //! Finds the specified descriptor, returns NULL if it does not exist
+    const DescriptorEntry* Find(DescriptorType type, uint8_t index, uint16_t language = 0) const;
+    //! Finds the descriptor requested by a GET_DESCRIPTOR packet
+    DescriptorResponse Find(const SetupPacket& setup, unsigned maxPacketSize0) const;
+};
+
+template<typename T, typename = void> struct _IsStringTable : std::false_type {};
+template<typename T> struct _IsStringTable<T, decltype((void)T::__language)> : std::true_type {};
+
+// number of DescriptorMap entries contributed by a single source object
+template<typename T, typename = void> struct _DescriptorEntryCount : std::integral_constant<size_t, 1> {};
+template<typename T> struct _DescriptorEntryCount<T, std::enable_if_t<_IsStringTable<T>::value>> : std::integral_constant<size_t, T::count> {};
+
+//! Sorted map of all descriptors of a device, for answering GET_DESCRIPTOR requests using a binary search
+/*!
+ * Created using MakeDescriptorMap, from the DeviceDescriptor, ConfigDescriptorBlock objects
+ * (indexed in the order of appearance), BosDescriptorBlock, string tables declared using the USB_STRING_TABLE
+ * macros (the first one is the primary language) and arbitrary DescriptorEntry objects.
+ */
+template<size_t n> struct DescriptorMap
+{
+    DescriptorEntry entries[n] = {};    //!< Entries, sorted by key
+    uint16_t language = 0;              //!< Primary language
+    size_t count = 0;
+    uint8_t configs = 0;
+
+    constexpr void Add(const DescriptorEntry& e)
+    {
+        size_t i = count++;
+        for (; i > 0 && entries[i - 1].key > e.key; i--)
+            entries[i] = entries[i - 1];
+        entries[i] = e;
+    }
+
+    constexpr void Add(const DeviceDescriptor& device)
+    {
+        Add(Descriptor(DescriptorType::Device, 0, device));
+    }
+
+    template<typename... T> constexpr void Add(const ConfigDescriptorBlock<T...>& config)
+    {
+        Add(Descriptor(DescriptorType::Config, configs++, config));
+    }
+
+    template<typename... T> constexpr void Add(const BosDescriptorBlock<T...>& bos)
+    {
+        Add(Descriptor(DescriptorType::Bos, 0, bos));
+    }
+
+#if USB_COMPACT_STRINGS
+    template<typename T> constexpr std::enable_if_t<_IsStringTable<T>::value> Add(const T& table)
+    {
+        auto strings = _CompactStrings<T>::strings;
+        if (!language)
+        {
+            language = T::__language;
+            Add(DescriptorEntry { DescriptorEntry::Key(DescriptorType::String, 0), &strings[0], 0, strings[0].len, ExpandCompactString });
+        }
+
+        for (size_t i = 1; i < T::count; i++)
+            Add(DescriptorEntry { DescriptorEntry::Key(DescriptorType::String, i, T::__language), &strings[i], 0, strings[i].len, ExpandCompactString });
+    }
+#else
+    template<typename T> constexpr std::enable_if_t<_IsStringTable<T>::value> Add(const T& table)
+    {
+        if (!language)
+        {
+            language = T::__language;
+            Add(DescriptorEntry { DescriptorEntry::Key(DescriptorType::String, 0), &table, _StringOffsets<T>::offsets[0], _StringOffsets<T>::lengths[0] });
+        }
+
+        for (size_t i = 1; i < T::count; i++)
+            Add(DescriptorEntry { DescriptorEntry::Key(DescriptorType::String, i, T::__language), &table, _StringOffsets<T>::offsets[i], _StringOffsets<T>::lengths[i] });
+    }
+#endif
+
+    //! Gets a type-erased view of the map
+    constexpr DescriptorMapView View() const { return { entries, uint16_t(count), language }; }
+
+    //! Finds the descriptor requested by a GET_DESCRIPTOR packet
+    DescriptorResponse Find(const SetupPacket& setup, unsigned maxPacketSize0) const { return View().Find(setup, maxPacketSize0); }
+};
+
+//! Creates a DescriptorMap from the specified descriptor objects, see DescriptorMap
+template<typename... T> constexpr auto MakeDescriptorMap(const T&... sources)
+{
+    // language tables of secondary string tables are not included
+    constexpr size_t strings = (_IsStringTable<T>::value + ... + 0);
+    DescriptorMap<(_DescriptorEntryCount<T>::value + ... + 0) - (strings ? strings - 1 : 0)> map;
+    (map.Add(sources), ...);
+    return map;
+}
+
+}
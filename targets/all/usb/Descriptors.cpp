@@ -45,4 +45,81 @@ const EndpointDescriptor* ConfigDescriptorHeader::FindEndpoint(uint8_t address,
     return NULL;
 }
 
+const InterfaceDescriptorHeader* ConfigDescriptorHeader::FindInterface(uint8_t interface, uint8_t alternate) const
+{
+    const DescriptorHeader* end = End();
+
+    for (const DescriptorHeader* hdr = this; hdr < end; hdr = hdr->Next())
+    {
+        if (hdr->bDescriptorType != DescriptorType::Interface)
+            continue;
+        auto ifd = (const InterfaceDescriptorHeader*)hdr;
+        if (ifd->bInterfaceNumber == interface && ifd->bAlternateSetting == alternate)
+            return ifd;
+    }
+
+    return NULL;
+}
+
+const StringEntry* StringTableView::Find(const StringTableView* tables, size_t count, unsigned index, uint16_t language)
+{
+    if (!count)
+        return NULL;
+
+    if (index)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (tables[i].language == language)
+                return tables[i].Get(index);
+        }
+    }
+
+    return tables[0].Get(index);
+}
+
+void ExpandCompactString(const void* string, size_t offset, void* buffer, size_t length)
+{
+    auto str = (const CompactString*)string;
+    auto out = (uint8_t*)buffer;
+    size_t pos = 0, end = offset + length;
+
+    // every packet decodes the string from its start, which is cheap for descriptors of at most 255 bytes
+    auto put = [&](uint8_t b)
+    {
+        if (pos >= offset && pos < end)
+            *out++ = b;
+        pos++;
+    };
+    auto unit = [&](uint32_t c)
+    {
+        put(uint8_t(c));
+        put(uint8_t(c >> 8));
+    };
+
+    put(str->len);
+    put(uint8_t(DescriptorType::String));
+
+    for (const uint8_t* p = str->data, *e = p + str->size; p < e && pos < end;)
+    {
+        uint32_t c = *p++;
+        unsigned extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+        if (extra)
+            c &= 0x3F >> extra;
+        for (; extra && p < e; extra--)
+            c = c << 6 | (*p++ & 0x3F);
+
+        if (c >= 0x10000)
+        {
+            c -= 0x10000;
+            unit(0xD800 | c >> 10);
+            unit(0xDC00 | (c & 0x3FF));
+        }
+        else
+        {
+            unit(c);
+        }
+    }
+}
+
 }
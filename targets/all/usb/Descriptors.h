@@ -13,6 +13,17 @@
 #include <base/base.h>
 
 #include <tuple>
+#include <type_traits>
+#include <utility>
+
+//! Stores the strings declared using the USB_STRING_TABLE macros as UTF-8, expanded to UTF-16 as they are sent
+/*!
+ * The tables then consist of CompactString entries instead of StringDescriptor chains, so they no longer
+ * provide the conversion to const StringDescriptor*, use View() or Get() to access the strings
+ */
+#ifndef USB_COMPACT_STRINGS
+#define USB_COMPACT_STRINGS 0
+#endif
 
 namespace usb
 {
@@ -25,12 +36,22 @@ enum struct DescriptorType : uint8_t
     String = 3,     //!< StringDescriptor
     Interface = 4,  //!< InterfaceDescriptorHeader
     Endpoint = 5,   //!< EndpointDescriptor
+    DeviceQualifier = 6,    //!< DeviceQualifierDescriptor
+    OtherSpeedConfig = 7,   //!< ConfigDescriptorHeader describing the configuration at the other speed
+    InterfacePower = 8,     //!< Interface power descriptor
+    InterfaceAssociation = 11,  //!< InterfaceAssociationDescriptor
+    Bos = 15,               //!< BosDescriptorHeader
+    DeviceCapability = 16,  //!< Device capability descriptor nested in the BOS descriptor
 
     ClassSpecific = 0x20,   //!< Class-specific descriptor flag
     ClassSpecificDevice = ClassSpecific | Device,   //!< Class-specific device descriptor
     ClassSpecificConfig = ClassSpecific | Config,   //!< Class-specific configuration descriptor
     ClassSpecificInterface = ClassSpecific | Interface, //!< Class-specific interface descriptor
     ClassSpecificEndpoint = ClassSpecific | Endpoint, //!< Class-specific endpoint descriptor
+
+    Hid = 0x21,             //!< HidDescriptor
+    HidReport = 0x22,       //!< HID report descriptor
+    HidPhysical = 0x23,     //!< HID physical descriptor
 };
 
 //! Subtypes for class-specific descriptors
@@ -63,6 +84,35 @@ enum struct DescriptorSubType : uint8_t
     CdcTcm = 24,        //!< Telephone Control Model Functional Descriptor
     CdcObexId = 25,     //!< OBEX Service Identifier Functional Descriptor
     CdcNcm = 26,        //!< NCM Functional Descriptor
+
+    // Audio 2.0 subtypes follow
+    AudioHeader = 1,            //!< Class-specific AudioControl Interface Header Descriptor
+    AudioInputTerminal = 2,     //!< Input Terminal Descriptor
+    AudioOutputTerminal = 3,    //!< Output Terminal Descriptor
+    AudioFeatureUnit = 6,       //!< Feature Unit Descriptor
+    AudioClockSource = 10,      //!< Clock Source Descriptor
+    AudioStreamGeneral = 1,     //!< Class-specific AudioStreaming Interface Descriptor
+    AudioFormatType = 2,        //!< Format Type Descriptor
+    AudioEndpointGeneral = 1,   //!< Class-specific AudioStreaming Isochronous Audio Data Endpoint Descriptor
+
+    // Video 1.1 subtypes follow
+    VideoHeader = 1,            //!< Class-specific VideoControl Interface Header Descriptor
+    VideoInputTerminal = 2,     //!< Input Terminal Descriptor (including Camera Terminal)
+    VideoOutputTerminal = 3,    //!< Output Terminal Descriptor
+    VideoProcessingUnit = 5,    //!< Processing Unit Descriptor
+    VideoInputHeader = 1,       //!< Class-specific VideoStreaming Input Header Descriptor
+    VideoFormatUncompressed = 4,    //!< Uncompressed Video Format Descriptor
+    VideoFrameUncompressed = 5,     //!< Uncompressed Video Frame Descriptor
+    VideoFormatMjpeg = 6,       //!< Motion-JPEG Video Format Descriptor
+    VideoFrameMjpeg = 7,        //!< Motion-JPEG Video Frame Descriptor
+    VideoColorFormat = 13,      //!< Color Matching Descriptor
+};
+
+//! Bus speed
+enum struct Speed : uint8_t
+{
+    Full,       //!< Full speed (12 Mbps)
+    High,       //!< High speed (480 Mbps)
 };
 
 //! ConfigDescriptor attributes
@@ -158,12 +208,28 @@ enum struct SubClass : uint8_t
     CdcEem = 12,    //!< Ethernet Emulation Model
     CdcNcm = 13,    //!< Network Control Model
 
+    // Audio Subclasses follow
+    AudioControl = 1,       //!< Audio control interface
+    AudioStreaming = 2,     //!< Audio streaming interface
+    AudioMidiStreaming = 3, //!< MIDI streaming interface
+
+    // Video Subclasses follow
+    VideoControl = 1,       //!< Video control interface
+    VideoStreaming = 2,     //!< Video streaming interface
+    VideoInterfaceCollection = 3,   //!< Video interface collection, used in the InterfaceAssociationDescriptor
+
     // MSC Subclasses follow
     MscScsi = 6,    //!< SCSI transparent command set
 
+    // HID Subclasses follow
+    HidBoot = 1,    //!< Boot interface
+
     // Application-Specific Subclasses follow
     AppDfu = 1,     //!< Device Firmware Upgrade
 
+    // Misc Subclasses follow
+    MiscCommon = 2, //!< Common class, used by devices with InterfaceAssociationDescriptors
+
     Vendor = 0xFF,  //!< Vendor-specific subclass
 };
 
@@ -182,11 +248,25 @@ enum struct Protocol : uint8_t
     CdcCdma = 6,    //!< AT Commands defined by TIA for CDMA
     CdcEem = 7,     //!< Ethernet Emulation Model
 
+    // CdcData Protocols follow
+    CdcDataNtb = 1, //!< Network Transfer Block
+
+    // Audio Protocols follow
+    AudioV2 = 0x20,     //!< Audio Device Class 2.0
+
     // MSC Protocols follow
     MscBulkOnly = 80,   //!< Bulk-Only Transport
 
+    // HidBoot Protocols follow
+    HidKeyboard = 1,    //!< Boot keyboard
+    HidMouse = 2,       //!< Boot mouse
+
     // DFU Protocols follow
     DfuRuntime = 1,     //!< Runtime mode
+    DfuMode = 2,        //!< DFU mode
+
+    // MiscCommon Protocols follow
+    MiscIad = 1,        //!< Interface Association Descriptor
 
     Vendor = 0xFF,  //!< Vendor-specific protocol
 };
@@ -221,6 +301,18 @@ PACKED_UNALIGNED_STRUCT DeviceDescriptor : DescriptorHeader
         iSerialNumber(strSerial),
         bNumConfigurations(numConfig) {}
 
+    //! Creates a copy of the descriptor with the specified USB version and control endpoint packet size
+    /*!
+     * High-speed capable devices must report version 2.00 or later and use 64 byte control packets
+     */
+    constexpr DeviceDescriptor WithUsbVersion(uint16_t bcdUSB, uint8_t maxPacketSize0 = 64) const
+    {
+        DeviceDescriptor res = *this;
+        res.bcdUSB = bcdUSB;
+        res.bMaxPacketSize0 = maxPacketSize0;
+        return res;
+    }
+
     uint16_t bcdUSB = 0x0200;                       //!< USB specification version (BCD)
     DeviceClass bDeviceClass;                       //!< DeviceClass
     SubClass bDeviceSubClass;                       //!< Device SubClass
@@ -268,6 +360,8 @@ PACKED_UNALIGNED_STRUCT ConfigDescriptorHeader : DescriptorHeader
 
     constexpr const DescriptorHeader* End() const { return (const DescriptorHeader*)((uintptr_t)this + wTotalLength); }
     const class EndpointDescriptor* FindEndpoint(uint8_t address, int interface = -1, int alternate = 0) const;
+    //! Finds the descriptor of the specified alternate setting of an interface
+    const struct InterfaceDescriptorHeader* FindInterface(uint8_t interface, uint8_t alternate = 0) const;
 
     uint16_t wTotalLength;          //!< Total length including all nested descriptors
     uint8_t bNumInterfaces;         //!< Number of nested interface descriptors
@@ -277,14 +371,19 @@ PACKED_UNALIGNED_STRUCT ConfigDescriptorHeader : DescriptorHeader
     uint8_t bMaxPower;              //!< Maximum power draw in 2 mA units
 };
 
+template<typename... T> constexpr uint8_t _CountInterfaces(const T&... descriptors);
+
 //! Full configuration definition, with interface descriptors embedded
 template<typename... TInterfaces> PACKED_UNALIGNED_STRUCT ConfigDescriptorBlock : ConfigDescriptorHeader
 {
     constexpr ConfigDescriptorBlock(uint8_t index, int maxPower, uint8_t strName, ConfigAttributes attributes, const TInterfaces&... interfaces) :
-        ConfigDescriptorHeader(sizeof(ConfigChildren<TInterfaces...>), sizeof...(TInterfaces), index, maxPower, strName, attributes),
+        ConfigDescriptorHeader(sizeof(ConfigChildren<TInterfaces...>), _CountInterfaces(interfaces...), index, maxPower, strName, attributes),
         interfaces(interfaces...) {}
 
     ConfigChildren<TInterfaces...> interfaces;  //!< Nested interface definitions
+
+    //! Builds a compile-time index of all endpoints nested in the configuration, see EndpointIndex
+    constexpr auto BuildEndpointIndex() const;
 };
 
 //! Creates a ConfigDescriptorHeader with the specified parameters
@@ -348,6 +447,30 @@ template<typename... TEndpoints> constexpr InterfaceDescriptorBlock<TEndpoints..
     return InterfaceDescriptorBlock<TEndpoints...>(index, alternate, cls, subCls, proto, strName, endpoints...);
 }
 
+//! Groups consecutive interfaces into a single function, immediately precedes the first interface
+/*!
+ * Devices using IADs must report DeviceClass::Misc, SubClass::MiscCommon, Protocol::MiscIad
+ * in their DeviceDescriptor
+ */
+PACKED_UNALIGNED_STRUCT InterfaceAssociationDescriptor : DescriptorHeader
+{
+    constexpr InterfaceAssociationDescriptor(uint8_t firstInterface, uint8_t interfaceCount, InterfaceClass cls, SubClass subCls, Protocol proto, uint8_t strName = 0)
+        : DescriptorHeader(sizeof(InterfaceAssociationDescriptor), DescriptorType::InterfaceAssociation),
+        bFirstInterface(firstInterface),
+        bInterfaceCount(interfaceCount),
+        bFunctionClass(cls),
+        bFunctionSubClass(subCls),
+        bFunctionProtocol(proto),
+        iFunction(strName) {}
+
+    uint8_t bFirstInterface;        //!< Number of the first interface of the function
+    uint8_t bInterfaceCount;        //!< Number of consecutive interfaces of the function
+    InterfaceClass bFunctionClass;  //!< Function Class
+    SubClass bFunctionSubClass;     //!< Function SubClass
+    Protocol bFunctionProtocol;     //!< Function Protocol
+    uint8_t iFunction;              //!< Function name string index
+};
+
 //! Defines an interface endpoint
 PACKED_UNALIGNED_STRUCT EndpointDescriptor
 {
@@ -357,14 +480,9 @@ PACKED_UNALIGNED_STRUCT EndpointDescriptor
         wMaxPacketSize(maxPacketSize),
         bInterval(interval) {}
 
+    // initializes the raw bytes rather than the bitfields, so the address and attributes can be read back in constant expressions
     constexpr EndpointDescriptor(bool in, uint8_t number, EndpointType type, uint16_t maxPacketSize, uint8_t interval = 1, IsoSync sync = IsoSync::None, IsoUsage usage = IsoUsage::Data) :
-        number(number),
-        in(in),
-        type((uint8_t)type),
-        isoSync((uint8_t)sync),
-        isoUsage((uint8_t)usage),
-        wMaxPacketSize(maxPacketSize),
-        bInterval(interval) {}
+        EndpointDescriptor((in ? 0x80 : 0) | (number & 0xF), (uint8_t)type | (uint8_t)sync << 2 | (uint8_t)usage << 4, maxPacketSize, interval) {}
 
     static constexpr EndpointDescriptor ControlIn()
     { return EndpointDescriptor(true, 0, EndpointType::Control, 64); }
@@ -379,7 +497,27 @@ PACKED_UNALIGNED_STRUCT EndpointDescriptor
     static constexpr EndpointDescriptor InterruptIn(uint8_t number, uint16_t maxPacketSize, uint8_t pollInterval)
     { return EndpointDescriptor(true, number, EndpointType::Interrupt, maxPacketSize, pollInterval); }
     static constexpr EndpointDescriptor InterruptOut(uint8_t number, uint16_t maxPacketSize, uint8_t pollInterval)
-    { return EndpointDescriptor(true, number, EndpointType::Interrupt, maxPacketSize, pollInterval); }
+    { return EndpointDescriptor(false, number, EndpointType::Interrupt, maxPacketSize, pollInterval); }
+
+    static constexpr EndpointDescriptor IsochronousIn(uint8_t number, uint16_t maxPacketSize, uint8_t interval = 1, IsoSync sync = IsoSync::Asynchronous, IsoUsage usage = IsoUsage::Data)
+    { return EndpointDescriptor(true, number, EndpointType::Isochronous, maxPacketSize, interval, sync, usage); }
+    static constexpr EndpointDescriptor IsochronousOut(uint8_t number, uint16_t maxPacketSize, uint8_t interval = 1, IsoSync sync = IsoSync::Asynchronous, IsoUsage usage = IsoUsage::Data)
+    { return EndpointDescriptor(false, number, EndpointType::Isochronous, maxPacketSize, interval, sync, usage); }
+
+    //! Creates a copy of a high-speed interrupt or isochronous endpoint with the specified number (1-3) of transactions per microframe
+    constexpr EndpointDescriptor HighBandwidth(unsigned transactions) const
+    {
+        EndpointDescriptor res = *this;
+        res.wMaxPacketSize = (wMaxPacketSize & 0x7FF) | ((transactions - 1) & 3) << 11;
+        return res;
+    }
+
+    //! Gets the maximum size of a single packet
+    constexpr unsigned MaxPacketSize() const { return wMaxPacketSize & 0x7FF; }
+    //! Gets the number of transactions per microframe of a high-bandwidth endpoint
+    constexpr unsigned Transactions() const { return 1 + ((wMaxPacketSize >> 11) & 3); }
+    //! Gets the type of the endpoint
+    constexpr EndpointType Type() const { return EndpointType(bmAttributes & 3); }
 
     uint8_t bLength = sizeof(EndpointDescriptor);   //!< Length of the EndpointDescriptor
     DescriptorType bDescriptorType = DescriptorType::Endpoint;  //!< EndpointDescriptor type
@@ -425,6 +563,270 @@ template<typename... TContent> constexpr auto ClassSpecificInterfaceDescriptor(D
     return CustomDescriptor<DescriptorSubType, TContent...>(DescriptorType::ClassSpecificInterface, subType, content...);
 }
 
+template<typename... TContent> constexpr auto ClassSpecificEndpointDescriptor(DescriptorSubType subType, const TContent&... content)
+{
+    return CustomDescriptor<DescriptorSubType, TContent...>(DescriptorType::ClassSpecificEndpoint, subType, content...);
+}
+
+//! Counts the descriptors of type @p TDesc nested in compile-time descriptor block @p T
+template<typename TDesc, typename T> struct _NestedCount : std::integral_constant<size_t, std::is_same<TDesc, T>::value> {};
+template<typename TDesc> struct _NestedCount<TDesc, _Empty> : std::integral_constant<size_t, 0> {};
+template<typename TDesc, typename... T> struct _NestedCount<TDesc, ConfigChildren<T...>> : std::integral_constant<size_t, (_NestedCount<TDesc, T>::value + ... + 0)> {};
+template<typename TDesc, typename... T> struct _NestedCount<TDesc, InterfaceDescriptorBlock<T...>> :
+    std::integral_constant<size_t, std::is_same<TDesc, InterfaceDescriptorHeader>::value + _NestedCount<TDesc, ConfigChildren<T...>>::value> {};
+template<typename TDesc, typename... T> struct _NestedCount<TDesc, ConfigDescriptorBlock<T...>> :
+    std::integral_constant<size_t, std::is_same<TDesc, ConfigDescriptorHeader>::value + _NestedCount<TDesc, ConfigChildren<T...>>::value> {};
+
+// compile-time descriptor walk, the overloads are resolved via ADL when instantiated
+template<typename T, typename TFn> constexpr void _VisitDescriptor(const T&, size_t, TFn&) {}
+template<typename TFn> constexpr void _VisitDescriptor(const InterfaceDescriptorHeader& d, size_t offset, TFn& fn) { fn(d, offset); }
+template<typename TFn> constexpr void _VisitDescriptor(const EndpointDescriptor& d, size_t offset, TFn& fn) { fn(d, offset); }
+
+template<typename T1, typename TFn> constexpr void _VisitDescriptor(const ConfigChildren<T1, _Empty>& c, size_t offset, TFn& fn)
+{
+    _VisitDescriptor(c.first, offset, fn);
+}
+
+template<typename T1, typename T2, typename... TRest, typename TFn> constexpr void _VisitDescriptor(const ConfigChildren<T1, T2, TRest...>& c, size_t offset, TFn& fn)
+{
+    _VisitDescriptor(c.first, offset, fn);
+    _VisitDescriptor(c.rest, offset + sizeof(T1), fn);
+}
+
+template<typename... T, typename TFn> constexpr void _VisitDescriptor(const InterfaceDescriptorBlock<T...>& d, size_t offset, TFn& fn)
+{
+    fn((const InterfaceDescriptorHeader&)d, offset);
+    _VisitDescriptor(d.endpoints, offset + sizeof(InterfaceDescriptorHeader), fn);
+}
+
+template<typename... T, typename TFn> constexpr void _VisitDescriptor(const ConfigDescriptorBlock<T...>& d, size_t offset, TFn& fn)
+{
+    _VisitDescriptor(d.interfaces, offset + sizeof(ConfigDescriptorHeader), fn);
+}
+
+//! Invokes @p fn for every InterfaceDescriptorHeader and EndpointDescriptor nested in a compile-time descriptor block,
+//! passing the descriptor and its offset in bytes from the start of the block
+template<typename T, typename TFn> constexpr void VisitDescriptors(const T& block, TFn&& fn)
+{
+    _VisitDescriptor(block, 0, fn);
+}
+
+// counts interfaces (alternate settings excluded) for ConfigDescriptorHeader::bNumInterfaces
+template<typename... T> constexpr uint8_t _CountInterfaces(const T&... descriptors)
+{
+    uint8_t count = 0;
+    auto fn = [&count](const auto& d, size_t)
+    {
+        if constexpr (std::is_same<std::decay_t<decltype(d)>, InterfaceDescriptorHeader>::value)
+            count += !d.bAlternateSetting;
+    };
+    (_VisitDescriptor(descriptors, 0, fn), ...);
+    return count;
+}
+
+//! Groups several descriptors (e.g. all interfaces of a function) so they can be passed as a single child to ConfigDescriptor
+template<typename... T> constexpr ConfigChildren<T...> DescriptorGroup(const T&... descriptors)
+{
+    return ConfigChildren<T...>(descriptors...);
+}
+
+//! Compile-time endpoint lookup table for a ConfigDescriptorBlock, created using ConfigDescriptorBlock::BuildEndpointIndex
+/*!
+ * Entries are bucketed by endpoint address, so a lookup only examines the (usually single)
+ * entries sharing the requested address, instead of walking the whole configuration
+ */
+template<size_t n> struct EndpointIndex
+{
+    static_assert(n < 256, "Too many endpoints in configuration");
+
+    //! Location of a single endpoint in the configuration
+    struct Entry
+    {
+        uint8_t bInterfaceNumber;   //!< Number of the interface containing the endpoint
+        uint8_t bAlternateSetting;  //!< Alternate setting of the interface containing the endpoint
+        uint16_t offset;            //!< Offset of the EndpointDescriptor from the start of the configuration
+    };
+
+    uint8_t start[33] = {};         //!< Index of the first entry for each endpoint slot, see Slot()
+    Entry entries[n ? n : 1] = {};  //!< Endpoint entries, ordered by slot
+
+    //! Gets the slot (0-15 OUT, 16-31 IN) of the specified endpoint address
+    static constexpr unsigned Slot(uint8_t address) { return (address & 0xF) | ((address >> 3) & 0x10); }
+    //! Gets the number of endpoints in the index
+    static constexpr size_t Count() { return n; }
+    //! Gets the number of distinct endpoint slots, i.e. endpoints counted once regardless of the alternate settings they appear in
+    constexpr size_t Addresses() const
+    {
+        size_t count = 0;
+        for (unsigned slot = 0; slot < 32; slot++)
+            count += start[slot + 1] > start[slot];
+        return count;
+    }
+
+    //! Finds the endpoint with the specified address in a configuration, equivalent to ConfigDescriptorHeader::FindEndpoint
+    const EndpointDescriptor* Find(const ConfigDescriptorHeader* config, uint8_t address, int interface = -1, int alternate = 0) const
+    {
+        unsigned slot = Slot(address);
+        for (unsigned i = start[slot]; i < start[slot + 1]; i++)
+        {
+            const Entry& e = entries[i];
+            if ((interface < 0 || interface == e.bInterfaceNumber) &&
+                (alternate < 0 || alternate == e.bAlternateSetting))
+            {
+                auto epd = (const EndpointDescriptor*)((uintptr_t)config + e.offset);
+                // the slot ignores the reserved address bits, verify the actual address
+                if (epd->bEndpointAddress == address)
+                    return epd;
+            }
+        }
+        return NULL;
+    }
+};
+
+template<typename... TInterfaces> constexpr auto ConfigDescriptorBlock<TInterfaces...>::BuildEndpointIndex() const
+{
+    using Index = EndpointIndex<_NestedCount<EndpointDescriptor, ConfigDescriptorBlock>::value>;
+    Index index;
+    uint8_t slots[Index::Count() ? Index::Count() : 1] = {};
+    uint8_t interface = 0, alternate = 0;
+    size_t count = 0;
+
+    struct Visitor
+    {
+        Index& index;
+        uint8_t* slots;
+        uint8_t& interface;
+        uint8_t& alternate;
+        size_t& count;
+
+        constexpr void operator()(const InterfaceDescriptorHeader& ifd, size_t)
+        {
+            interface = ifd.bInterfaceNumber;
+            alternate = ifd.bAlternateSetting;
+        }
+
+        constexpr void operator()(const EndpointDescriptor& epd, size_t offset)
+        {
+            // insertion sort by slot, keeping the descriptor order within a slot
+            size_t i = count++;
+            uint8_t slot = Index::Slot(epd.bEndpointAddress);
+            for (; i > 0 && slots[i - 1] > slot; i--)
+            {
+                slots[i] = slots[i - 1];
+                index.entries[i] = index.entries[i - 1];
+            }
+            slots[i] = slot;
+            index.entries[i] = { interface, alternate, uint16_t(offset) };
+        }
+    };
+
+    VisitDescriptors(*this, Visitor { index, slots, interface, alternate, count });
+
+    for (unsigned slot = 0, i = 0; slot <= 32; slot++)
+    {
+        while (i < count && slots[i] < slot)
+            i++;
+        index.start[slot] = i;
+    }
+
+    return index;
+}
+
+//! Describes the device as it would appear at the other speed, returned by high-speed capable devices
+PACKED_UNALIGNED_STRUCT DeviceQualifierDescriptor : DescriptorHeader
+{
+    //! Creates the qualifier for the specified device, @p maxPacketSize0 is the control endpoint packet size at the other speed
+    constexpr DeviceQualifierDescriptor(const DeviceDescriptor& device, uint8_t maxPacketSize0 = 64) :
+        DescriptorHeader(sizeof(DeviceQualifierDescriptor), DescriptorType::DeviceQualifier),
+        bcdUSB(device.bcdUSB),
+        bDeviceClass(device.bDeviceClass),
+        bDeviceSubClass(device.bDeviceSubClass),
+        bDeviceProtocol(device.bDeviceProtocol),
+        bMaxPacketSize0(maxPacketSize0),
+        bNumConfigurations(device.bNumConfigurations) {}
+
+    uint16_t bcdUSB;                //!< USB specification version (BCD)
+    DeviceClass bDeviceClass;       //!< DeviceClass
+    SubClass bDeviceSubClass;       //!< Device SubClass
+    Protocol bDeviceProtocol;       //!< Device Protocol
+    uint8_t bMaxPacketSize0;        //!< Maximum packet size for control endpoint at the other speed
+    uint8_t bNumConfigurations;     //!< Number of other-speed configurations
+    uint8_t bReserved = 0;
+};
+
+//! Converts an endpoint written for high speed to the specified speed
+/*!
+ * High-speed definitions are passed through unchanged. For full speed, bulk packets are limited to 64 bytes,
+ * interrupt packets to 64 bytes, isochronous packets to 1023 bytes (merging high-bandwidth transactions)
+ * and the microframe-based intervals are converted to frames.
+ *
+ * Isochronous endpoints serviced more often than once per frame are merged into a single packet per frame
+ * carrying the data of all the microframes. The 1023 byte limit still applies, so endpoints exceeding
+ * 1023 bytes per frame lose bandwidth at full speed.
+ */
+constexpr EndpointDescriptor EndpointForSpeed(const EndpointDescriptor& epd, Speed speed)
+{
+    if (speed == Speed::High)
+        return epd;
+
+    EndpointDescriptor res = epd;
+    unsigned size = epd.MaxPacketSize() * epd.Transactions();
+    // high-speed interval is 2^(bInterval-1) microframes
+    unsigned exp = epd.bInterval ? epd.bInterval - 1 : 0;
+
+    switch (epd.Type())
+    {
+        case EndpointType::Bulk:
+        case EndpointType::Control:
+            res.wMaxPacketSize = size < 64 ? size : 64;
+            res.bInterval = 0;
+            break;
+
+        case EndpointType::Interrupt:
+            res.wMaxPacketSize = size < 64 ? size : 64;
+            // full-speed interval is in frames
+            res.bInterval = exp <= 3 ? 1 : (1u << (exp - 3)) < 255 ? (1u << (exp - 3)) : 255;
+            break;
+
+        case EndpointType::Isochronous:
+            // intervals shorter than a frame are merged into one packet per frame
+            if (exp < 3)
+                size <<= 3 - exp;
+            res.wMaxPacketSize = size < 1023 ? size : 1023;
+            // full-speed interval is 2^(bInterval-1) frames
+            res.bInterval = exp <= 3 ? 1 : exp - 2;
+            break;
+    }
+
+    return res;
+}
+
+//! Creates a variant of a configuration written for high speed for the specified speed, see EndpointForSpeed
+/*!
+ * A configuration is written once for high speed, and the full-speed variant is derived from it.
+ * High-speed capable devices return the variant for the current speed as the configuration
+ * and the variant for the other speed (see OtherSpeed) as the other speed configuration.
+ */
+template<typename... TInterfaces> constexpr ConfigDescriptorBlock<TInterfaces...> ConfigForSpeed(const ConfigDescriptorBlock<TInterfaces...>& config, Speed speed)
+{
+    ConfigDescriptorBlock<TInterfaces...> res = config;
+    // the copy is not const, so the descriptors can be updated in place
+    VisitDescriptors(res, [speed](const auto& d, size_t)
+    {
+        if constexpr (std::is_same<std::decay_t<decltype(d)>, EndpointDescriptor>::value)
+            const_cast<EndpointDescriptor&>(d) = EndpointForSpeed(d, speed);
+    });
+    return res;
+}
+
+//! Creates a copy of a configuration to be returned as the Other Speed Configuration descriptor
+template<typename... TInterfaces> constexpr ConfigDescriptorBlock<TInterfaces...> OtherSpeed(const ConfigDescriptorBlock<TInterfaces...>& config)
+{
+    ConfigDescriptorBlock<TInterfaces...> res = config;
+    res.bDescriptorType = DescriptorType::OtherSpeedConfig;
+    return res;
+}
+
 //! Defines a static UTF16LE encoded string
 PACKED_UNALIGNED_STRUCT StringDescriptor
 {
@@ -450,19 +852,256 @@ template<size_t n> PACKED_UNALIGNED_STRUCT _StringDescriptor
     const char16_t value[n];    //!< StringDescriptor content
 };
 
+//! Tag type used to select string table entries by index
+template<size_t n> struct _StringSlot {};
+
+//! Offsets and lengths of all string descriptors in a string table type, computed once the table type is complete
+template<typename T, typename TIndices = std::make_index_sequence<T::count>> struct _StringOffsets;
+template<typename T, size_t... i> struct _StringOffsets<T, std::index_sequence<i...>>
+{
+    static_assert(((T::template __offset<T>(_StringSlot<i>()) < 65536) && ...), "String table too large");
+    static constexpr uint16_t offsets[] = { uint16_t(T::template __offset<T>(_StringSlot<i>()))... };
+    static constexpr uint8_t lengths[] = { uint8_t(T::template __length<T>(_StringSlot<i>()))... };
+};
+
+//! Content of a string declared using the USB_STRING_TABLE macros, used to build compact tables
+struct _StringSource
+{
+    const char16_t* data;
+    size_t length;
+};
+
+//! String descriptor stored as UTF-8 and expanded to UTF-16 when sent, see USB_COMPACT_STRINGS
+struct CompactString
+{
+    const uint8_t* data;    //!< UTF-8 content, usually shared with other strings
+    uint16_t size;          //!< Length of the UTF-8 content in bytes (up to 378 for the longest descriptor)
+    uint8_t len;            //!< Length of the expanded StringDescriptor
+};
+
+//! Writes @p length bytes of the StringDescriptor expanded from a CompactString, starting at @p offset
+/*!
+ * Matches ControlGenerator, so compact strings can be expanded directly into the EP0 packet buffer
+ */
+void ExpandCompactString(const void* string, size_t offset, void* buffer, size_t length);
+
+// encodes the UTF-16 string as UTF-8 into out (if not NULL), returns the encoded length
+constexpr size_t _Utf8Encode(const _StringSource& str, uint8_t* out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < str.length; i++)
+    {
+        uint32_t c = str.data[i];
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < str.length && str.data[i + 1] >= 0xDC00 && str.data[i + 1] < 0xE000)
+            c = 0x10000 + ((c - 0xD800) << 10) + (str.data[++i] - 0xDC00);
+
+        unsigned extra = c < 0x80 ? 0 : c < 0x800 ? 1 : c < 0x10000 ? 2 : 3;
+        uint8_t lead = c < 0x80 ? c : uint8_t(0xFF80 >> extra) | (c >> (6 * extra));
+        if (out)
+        {
+            out[n] = lead;
+            for (unsigned k = 1; k <= extra; k++)
+                out[n + k] = 0x80 | ((c >> (6 * (extra - k))) & 0x3F);
+        }
+        n += 1 + extra;
+    }
+    return n;
 }
 
+template<size_t bytes, size_t n> struct _CompactPacking
+{
+    uint8_t pool[bytes ? bytes : 1];
+    size_t used;
+    uint16_t offsets[n];
+    uint16_t sizes[n];
+};
+
+/*
+ * Packs the UTF-8 encoded strings into a single pool. Strings are placed longest first,
+ * a string found anywhere in the pool (a duplicate, a suffix or any other part of a longer string)
+ * is not stored again, otherwise it is appended, overlapping as much as possible with the end of the pool.
+ */
+template<size_t bytes, size_t n> constexpr _CompactPacking<bytes, n> _CompactPack(const _StringSource* sources)
+{
+    _CompactPacking<bytes, n> res = {};
+    bool placed[n] = {};
+
+    auto equal = [](const uint8_t* a, const uint8_t* b, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            if (a[i] != b[i])
+                return false;
+        }
+        return true;
+    };
+
+    for (size_t step = 0; step < n; step++)
+    {
+        size_t s = n, size = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t len = _Utf8Encode(sources[i], NULL);
+            if (!placed[i] && (s == n || len > size))
+            {
+                s = i;
+                size = len;
+            }
+        }
+
+        uint8_t str[bytes ? bytes : 1] = {};
+        _Utf8Encode(sources[s], str);
+        placed[s] = true;
+        res.sizes[s] = size;
+
+        size_t at = 0;
+        while (at + size <= res.used && !equal(res.pool + at, str, size))
+            at++;
+
+        if (at + size > res.used)
+        {
+            size_t overlap = size < res.used ? size : res.used;
+            while (overlap && !equal(res.pool + res.used - overlap, str, overlap))
+                overlap--;
+            at = res.used - overlap;
+            for (size_t i = overlap; i < size; i++)
+                res.pool[res.used++] = str[i];
+        }
+        res.offsets[s] = at;
+    }
+
+    return res;
+}
+
+template<size_t n> struct _CompactPool
+{
+    uint8_t data[n ? n : 1];
+};
+
+template<size_t n, size_t bytes, size_t count> constexpr _CompactPool<n> _CompactCopy(const _CompactPacking<bytes, count>& packing)
+{
+    _CompactPool<n> res = {};
+    for (size_t i = 0; i < n; i++)
+        res.data[i] = packing.pool[i];
+    return res;
+}
+
+//! Compact representation of a string table type, computed once the table type is complete
+template<typename T, typename TIndices = std::make_index_sequence<T::count>> struct _CompactStrings;
+template<typename T, size_t... i> struct _CompactStrings<T, std::index_sequence<i...>>
+{
+    static constexpr _StringSource sources[] = { T::__source(_StringSlot<i>())... };
+    static_assert(((sources[i].length <= 126) && ...), "String too long");
+    static constexpr auto packing = _CompactPack<(_Utf8Encode(sources[i], NULL) + ...), sizeof...(i)>(sources);
+    static constexpr auto pool = _CompactCopy<packing.used>(packing);
+    static constexpr CompactString strings[] = { { pool.data + packing.offsets[i], packing.sizes[i], uint8_t(2 + sources[i].length * 2) }... };
+};
+
+#if USB_COMPACT_STRINGS
+//! Representation of a single string in a string table
+typedef CompactString StringEntry;
+#else
+//! Representation of a single string in a string table
+typedef StringDescriptor StringEntry;
+#endif
+
+//! Type-erased view of a string table declared using the USB_STRING_TABLE macros
+struct StringTableView
+{
+#if USB_COMPACT_STRINGS
+    const CompactString* strings;   //!< Individual strings
+#else
+    const void* table;          //!< Start of the table
+    const uint16_t* offsets;    //!< Offsets of individual string descriptors
+#endif
+    uint8_t count;              //!< Number of string descriptors, including the language table
+    uint16_t language;          //!< Primary language ID of the table
+
+    //! Gets the string with the specified index, or NULL if there is no such string
+    const StringEntry* Get(unsigned index) const
+    {
+#if USB_COMPACT_STRINGS
+        return index < count ? &strings[index] : NULL;
+#else
+        return index < count ? (const StringDescriptor*)((uintptr_t)table + offsets[index]) : NULL;
+#endif
+    }
+
+    //! Gets the string with the specified index from the table matching the specified language
+    /*!
+     * String index 0 (the language table) and requests for unknown languages are served from the first table
+     */
+    static const StringEntry* Find(const StringTableView* tables, size_t count, unsigned index, uint16_t language);
+};
+
+//! Set of string tables with identical layout, one per supported language
+/*!
+ * The first table is the primary one, its language table (string index 0) must list the
+ * languages of all the tables in the set.
+ */
+template<size_t n> struct StringTableSet
+{
+    StringTableView tables[n];  //!< Tables for individual languages
+
+    //! Gets the string with the specified index in the specified language
+    const StringEntry* Get(unsigned index, uint16_t language) const
+    {
+        return StringTableView::Find(tables, n, index, language);
+    }
+};
+
+//! Creates a StringTableSet from string tables declared using the USB_STRING_TABLE macros
+template<typename TPrimary, typename... TTables> constexpr StringTableSet<1 + sizeof...(TTables)> StringTables(const TPrimary& primary, const TTables&... tables)
+{
+    static_assert(((TTables::count == TPrimary::count) && ...), "All string tables in a set must have the same number of strings");
+    return { { primary.View(), tables.View()... } };
+}
+
+}
+
+#if USB_COMPACT_STRINGS
+
+// the strings are only used at compile time, to build the _CompactStrings of the table type
+
 #define USB_STRING_TABLE_START(...) \
 const struct UNIQUE(UsbStringTable) { \
     static constexpr int __count0 = __COUNTER__; \
-    __attribute__((aligned(4))) const ::usb::_StringDescriptor<std::tuple_size<decltype(std::make_tuple(__VA_ARGS__))>::value + 1> _languages = { 2 + std::tuple_size<decltype(std::make_tuple(__VA_ARGS__))>::value * 2, ::usb::DescriptorType::String, { __VA_ARGS__, 0 } };
+    static constexpr uint16_t __language = std::get<0>(std::make_tuple(__VA_ARGS__)); \
+    static constexpr char16_t __languages[] = { __VA_ARGS__ }; \
+    static constexpr ::usb::_StringSource __source(::usb::_StringSlot<0>) { return { __languages, countof(__languages) }; }
 
 #define USB_STRING(name, value) \
     static constexpr uint8_t name = __COUNTER__ - __count0; \
-    __attribute__((aligned(4))) const ::usb::_StringDescriptor<countof(value)> name ## _desc = { countof(value) * 2, ::usb::DescriptorType::String, value };
+    static constexpr ::usb::_StringSource __source(::usb::_StringSlot<name>) { return { value, countof(value) - 1 }; }
+
+#define USB_STRING_TABLE_END(tableName) \
+    static constexpr int count = __COUNTER__ - __count0; \
+    constexpr ::usb::StringTableView View() const { using __self = std::remove_cv_t<std::remove_reference_t<decltype(*this)>>; return { ::usb::_CompactStrings<__self>::strings, count, __language }; } \
+    ALWAYS_INLINE const ::usb::CompactString* Get(unsigned index) const { return View().Get(index); } \
+} tableName;
+
+#else
+
+#define USB_STRING_TABLE_START(...) \
+const struct UNIQUE(UsbStringTable) { \
+    static constexpr int __count0 = __COUNTER__; \
+    static constexpr uint16_t __language = std::get<0>(std::make_tuple(__VA_ARGS__)); \
+    __attribute__((aligned(4))) const ::usb::_StringDescriptor<std::tuple_size<decltype(std::make_tuple(__VA_ARGS__))>::value + 1> _languages = { 2 + std::tuple_size<decltype(std::make_tuple(__VA_ARGS__))>::value * 2, ::usb::DescriptorType::String, { __VA_ARGS__, 0 } }; \
+    template<typename T> static constexpr size_t __offset(::usb::_StringSlot<0>) { return offsetof(T, _languages); } \
+    template<typename T> static constexpr size_t __length(::usb::_StringSlot<0>) { return sizeof(_languages) - 2; }
+
+#define USB_STRING(name, value) \
+    static constexpr uint8_t name = __COUNTER__ - __count0; \
+    __attribute__((aligned(4))) const ::usb::_StringDescriptor<countof(value)> name ## _desc = { countof(value) * 2, ::usb::DescriptorType::String, value }; \
+    template<typename T> static constexpr size_t __offset(::usb::_StringSlot<name>) { return offsetof(T, name ## _desc); } \
+    template<typename T> static constexpr size_t __length(::usb::_StringSlot<name>) { return sizeof(name ## _desc) - 2; }
 
 #define USB_STRING_TABLE_END(tableName) \
     static constexpr int count = __COUNTER__ - __count0; \
     __attribute__((aligned(4))) const ::usb::StringDescriptor _terminator = { }; \
     ALWAYS_INLINE operator const usb::StringDescriptor*() const { return (const usb::StringDescriptor*)&_languages; }; \
+    constexpr ::usb::StringTableView View() const { using __self = std::remove_cv_t<std::remove_reference_t<decltype(*this)>>; return { this, ::usb::_StringOffsets<__self>::offsets, count, __language }; } \
+    ALWAYS_INLINE const ::usb::StringDescriptor* Get(unsigned index) const { return View().Get(index); } \
 } tableName;
+
+#endif
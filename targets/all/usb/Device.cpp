@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Device.cpp
+ */
+
+#include <usb/Device.h>
+
+namespace usb
+{
+
+const ConfigDescriptorHeader* DeviceState::ActiveConfig() const
+{
+    return configuration ? FindConfig(configuration) : NULL;
+}
+
+const ConfigDescriptorHeader* DeviceState::FindConfig(uint8_t value) const
+{
+    for (unsigned i = 0; i < device->bNumConfigurations; i++)
+    {
+        if (configs[i]->bConfigurationValue == value)
+            return configs[i];
+    }
+    return NULL;
+}
+
+const StringEntry* DeviceState::GetString(unsigned index, uint16_t language) const
+{
+    return StringTableView::Find(strings, numLanguages, index, language);
+}
+
+const EndpointDescriptor* DeviceState::FindEndpoint(uint8_t address) const
+{
+    auto config = ActiveConfig();
+    return config ? config->FindEndpoint(address, -1, -1) : NULL;
+}
+
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Device.h
+ *
+ * Standard device state and standard request handlers
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Bos.h>
+#include <usb/DescriptorMap.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! State of the device required for handling standard requests
+/*!
+ * Device implementations derive from this structure and use the derived type as the context
+ * of a SetupDispatcher. The On... hooks can be hidden in the derived type to react to
+ * the corresponding requests, the derived implementation is called by StandardRequests.
+ */
+struct DeviceState
+{
+    const DeviceDescriptor* device;                 //!< Device descriptor
+    const ConfigDescriptorHeader* const* configs;   //!< Configuration descriptors, device->bNumConfigurations entries
+    const StringTableView* strings = NULL;          //!< String tables, one per supported language, the first one is primary
+    uint8_t numLanguages = 0;                       //!< Number of string tables
+    const BosDescriptorHeader* bos = NULL;          //!< BOS descriptor, the device must report bcdUSB 0x0201 or later
+    DescriptorMapView descriptors = {};             //!< Precomputed descriptor map, used instead of the above when not empty
+
+    uint8_t address = 0;                            //!< Device address assigned by the host
+    uint8_t configuration = 0;                      //!< Active configuration value, zero when not configured
+    bool remoteWakeup = false;                      //!< Remote wakeup enabled by the host
+    uint32_t halted = 0;                            //!< Halted endpoints, bits indexed by EndpointIndex::Slot
+    uint16_t response = 0;                          //!< Data stage of the GET_STATUS and GET_INTERFACE requests
+
+    //! Gets the active configuration, or NULL if the device is not configured
+    const ConfigDescriptorHeader* ActiveConfig() const;
+    //! Finds the configuration with the specified bConfigurationValue
+    const ConfigDescriptorHeader* FindConfig(uint8_t value) const;
+    //! Gets the string with the specified index and language
+    const StringEntry* GetString(unsigned index, uint16_t language) const;
+
+    //! Finds an endpoint of the active configuration, can be hidden to use an EndpointIndex
+    const EndpointDescriptor* FindEndpoint(uint8_t address) const;
+    //! Called when the host assigns an address to the device, the hardware address must be applied after the status stage
+    void OnSetAddress(uint8_t address) {}
+    //! Called when the configuration changes, @p config is NULL when the device is deconfigured
+    bool OnSetConfiguration(const ConfigDescriptorHeader* config) { return true; }
+    //! Called when the halt feature of an endpoint changes
+    void OnEndpointHalt(uint8_t address, bool halt) {}
+    //! Called when the host selects an alternate setting present in the active configuration, returns false to stall the request
+    /*!
+     * Interfaces with alternate settings must be handled in the derived type, together with OnGetInterface
+     */
+    bool OnSetInterface(uint8_t interface, uint8_t alternate) { return alternate == 0; }
+    //! Gets the selected alternate setting of an interface present in the active configuration
+    uint8_t OnGetInterface(uint8_t interface) { return 0; }
+};
+
+//! Handlers of the standard device requests, for use with a SetupDispatcher
+/*!
+ * @p TContext must be derived from DeviceState
+ */
+template<typename TContext> struct StandardRequests
+{
+    static ControlResult GetStatus(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        switch (setup.recipient)
+        {
+            case SetupPacket::RecipientDevice:
+            {
+                auto config = ctx.ActiveConfig();
+                ctx.response = (config && !!(config->bmAttributes & ConfigAttributes::SelfPowered)) | ctx.remoteWakeup << 1;
+                break;
+            }
+            case SetupPacket::RecipientInterface:
+                ctx.response = 0;
+                break;
+            case SetupPacket::RecipientEndpoint:
+                if ((setup.wIndex & 0x7F) && !ctx.FindEndpoint(setup.wIndex))
+                    return ControlResult::Stall();
+                ctx.response = !!(ctx.halted & BIT(EndpointIndex<0>::Slot(setup.wIndex)));
+                break;
+            default:
+                return ControlResult::Stall();
+        }
+        return ControlResult::In(&ctx.response, sizeof(ctx.response));
+    }
+
+    static ControlResult ClearFeature(TContext& ctx, const SetupPacket& setup, ControlStage stage) { return Feature(ctx, setup, false); }
+    static ControlResult SetFeature(TContext& ctx, const SetupPacket& setup, ControlStage stage) { return Feature(ctx, setup, true); }
+
+    static ControlResult SetAddress(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        if (setup.wValue > 127)
+            return ControlResult::Stall();
+        ctx.address = setup.wValue;
+        ctx.OnSetAddress(setup.wValue);
+        return ControlResult::Ack();
+    }
+
+    static ControlResult GetDescriptor(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        if (ctx.descriptors.count)
+        {
+            if (auto res = ctx.descriptors.Find(setup, ctx.device->bMaxPacketSize0))
+                return ControlResult::In(res.data, res.length, res.generate);
+            return ControlResult::Stall();
+        }
+
+        switch (setup.descriptorType)
+        {
+            case DescriptorType::Device:
+                return ControlResult::In(ctx.device, sizeof(DeviceDescriptor));
+
+            case DescriptorType::Config:
+                if (setup.descriptorIndex < ctx.device->bNumConfigurations)
+                {
+                    auto config = ctx.configs[setup.descriptorIndex];
+                    return ControlResult::In(config, config->wTotalLength);
+                }
+                break;
+
+            case DescriptorType::String:
+                if (auto str = ctx.GetString(setup.descriptorIndex, setup.wIndex))
+                    return ControlResult::In(str);
+                break;
+
+            case DescriptorType::Bos:
+                if (ctx.bos)
+                    return ControlResult::In(ctx.bos, ctx.bos->wTotalLength);
+                break;
+
+            default:
+                break;
+        }
+        return ControlResult::Stall();
+    }
+
+    static ControlResult GetConfiguration(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return ControlResult::In(&ctx.configuration, 1);
+    }
+
+    static ControlResult SetConfiguration(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        const ConfigDescriptorHeader* config = NULL;
+        if (setup.wValue > 0xFF || (setup.wValue && !(config = ctx.FindConfig(setup.wValue))))
+            return ControlResult::Stall();
+        if (!ctx.OnSetConfiguration(config))
+            return ControlResult::Stall();
+        ctx.configuration = setup.wValue;
+        ctx.halted = 0;
+        return ControlResult::Ack();
+    }
+
+    static ControlResult GetInterface(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        auto config = ctx.ActiveConfig();
+        if (!config || setup.wIndex > 0xFF || !config->FindInterface(setup.wIndex))
+            return ControlResult::Stall();
+        ctx.response = ctx.OnGetInterface(setup.wIndex);
+        return ControlResult::In(&ctx.response, 1);
+    }
+
+    static ControlResult SetInterface(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        auto config = ctx.ActiveConfig();
+        if (!config || setup.wIndex > 0xFF || setup.wValue > 0xFF || !config->FindInterface(setup.wIndex, setup.wValue))
+            return ControlResult::Stall();
+        if (!ctx.OnSetInterface(setup.wIndex, setup.wValue))
+            return ControlResult::Stall();
+        return ControlResult::Ack();
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, SetupPacket::StdGetStatus, GetStatus),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdGetStatus, GetStatus),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientEndpoint, SetupPacket::StdGetStatus, GetStatus),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, SetupPacket::StdClearFeature, ClearFeature),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientEndpoint, SetupPacket::StdClearFeature, ClearFeature),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, SetupPacket::StdSetFeature, SetFeature),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientEndpoint, SetupPacket::StdSetFeature, SetFeature),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, SetupPacket::StdSetAddress, SetAddress),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, SetupPacket::StdGetDescriptor, GetDescriptor),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, SetupPacket::StdGetConfiguration, GetConfiguration),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, SetupPacket::StdSetConfiguration, SetConfiguration),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdGetInterface, GetInterface),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdSetInterface, SetInterface),
+    };
+
+private:
+    static ControlResult Feature(TContext& ctx, const SetupPacket& setup, bool set)
+    {
+        switch (setup.wValue)
+        {
+            case SetupPacket::FeatureDeviceRemoteWakeup:
+                if (setup.recipient != SetupPacket::RecipientDevice)
+                    break;
+                ctx.remoteWakeup = set;
+                return ControlResult::Ack();
+
+            case SetupPacket::FeatureEndpointHalt:
+                if (setup.recipient != SetupPacket::RecipientEndpoint || !(setup.wIndex & 0x7F) || !ctx.FindEndpoint(setup.wIndex))
+                    break;
+                if (set)
+                    ctx.halted |= BIT(EndpointIndex<0>::Slot(setup.wIndex));
+                else
+                    ctx.halted &= ~BIT(EndpointIndex<0>::Slot(setup.wIndex));
+                ctx.OnEndpointHalt(setup.wIndex, set);
+                return ControlResult::Ack();
+        }
+        return ControlResult::Stall();
+    }
+};
+
+}
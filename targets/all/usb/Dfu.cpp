@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Dfu.cpp
+ */
+
+#include <usb/Dfu.h>
+
+namespace usb
+{
+
+Dfu::Dfu(DfuTarget& target, void* buffer, size_t bufferSize, DfuAttributes attributes, bool runtime, uint16_t pollTimeout)
+    : target(target), halfSize(bufferSize / 2 < 0xFFFF ? bufferSize / 2 : 0xFFFF), attributes(attributes),
+    state(runtime ? DfuState::AppIdle : DfuState::Idle), status(DfuStatus::Ok),
+    programTime(pollTimeout), manifestTime(pollTimeout)
+{
+    halves[0].data = (uint8_t*)buffer;
+    halves[1].data = (uint8_t*)buffer + halfSize;
+    Drop();
+}
+
+void Dfu::Drop()
+{
+    halves[0].pending = halves[1].pending = false;
+    recv = prog = 0;
+    manifested = false;
+    offset = 0;
+}
+
+ControlResult Dfu::Fail(DfuStatus status)
+{
+    this->status = status;
+    state = DfuState::Error;
+    Drop();
+    return ControlResult::Stall();
+}
+
+ControlResult Dfu::GetStatus()
+{
+    uint32_t timeout = 0;
+
+    switch (state)
+    {
+        case DfuState::DownloadSync:
+        case DfuState::DownloadBusy:
+            if (halves[recv].pending)
+            {
+                // no room for the next block until the older pending ones are programmed
+                state = DfuState::DownloadBusy;
+                timeout = programTime * Pending();
+            }
+            else
+            {
+                state = DfuState::DownloadIdle;
+            }
+            break;
+
+        case DfuState::ManifestSync:
+            if (manifested)
+            {
+                state = DfuState::Idle;
+                manifested = false;
+            }
+            else
+            {
+                state = DfuState::Manifest;
+                timeout = programTime * Pending() + manifestTime;
+            }
+            break;
+
+        case DfuState::Manifest:
+            timeout = programTime * Pending() + manifestTime;
+            break;
+
+        default:
+            break;
+    }
+
+    if (timeout > 0xFFFFFF)
+        timeout = 0xFFFFFF;
+
+    response[0] = uint8_t(status);
+    response[1] = timeout;
+    response[2] = timeout >> 8;
+    response[3] = timeout >> 16;
+    response[4] = uint8_t(state);
+    response[5] = 0;
+    return ControlResult::In(response, 6);
+}
+
+ControlResult Dfu::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    if (state == DfuState::AppIdle || state == DfuState::AppDetach)
+    {
+        // run-time mode
+        switch (setup.bRequest)
+        {
+            case SetupPacket::ClassDfuDetach:
+                state = DfuState::AppDetach;
+                target.Detach(setup.wValue);
+                return ControlResult::Ack();
+
+            case SetupPacket::ClassDfuGetStatus:
+                return GetStatus();
+
+            case SetupPacket::ClassDfuGetState:
+                response[0] = uint8_t(state);
+                return ControlResult::In(response, 1);
+
+            default:
+                return ControlResult::Stall();
+        }
+    }
+
+    switch (setup.bRequest)
+    {
+        case SetupPacket::ClassDfuDnload:
+            if (setup.direction != SetupPacket::DirOut || !(attributes & DfuAttributes::CanDownload))
+                break;
+
+            if (stage == ControlStage::DataOut)
+            {
+                auto& h = halves[recv];
+                h.offset = offset;
+                h.length = setup.wLength;
+                h.pending = true;
+                offset += setup.wLength;
+                recv ^= 1;
+                state = DfuState::DownloadSync;
+                return ControlResult::Ack();
+            }
+
+            if (state == DfuState::Idle && setup.wLength)
+            {
+                Drop();
+                DfuStatus res = target.Begin();
+                if (res != DfuStatus::Ok)
+                    return Fail(res);
+            }
+            else if (state != DfuState::DownloadIdle)
+            {
+                break;
+            }
+
+            if (!setup.wLength)
+            {
+                // end of download, manifestation follows once all pending blocks are programmed
+                state = DfuState::ManifestSync;
+                return ControlResult::Ack();
+            }
+
+            if (setup.wLength > halfSize || halves[recv].pending)
+                break;
+
+            return ControlResult::Out(halves[recv].data, setup.wLength);
+
+        case SetupPacket::ClassDfuUpload:
+        {
+            if (setup.direction != SetupPacket::DirIn || !(attributes & DfuAttributes::CanUpload) || setup.wLength > halfSize)
+                break;
+
+            if (state == DfuState::Idle)
+                Drop();
+            else if (state != DfuState::UploadIdle)
+                break;
+
+            // no download is in progress in these states, so the buffer is free
+            size_t len = target.Read(offset, halves[0].data, setup.wLength);
+            if (len > setup.wLength)
+                len = setup.wLength;
+            offset += len;
+            state = len < setup.wLength ? DfuState::Idle : DfuState::UploadIdle;
+            return ControlResult::In(halves[0].data, len);
+        }
+
+        case SetupPacket::ClassDfuGetStatus:
+            return GetStatus();
+
+        case SetupPacket::ClassDfuClrStatus:
+            if (state != DfuState::Error)
+                break;
+            status = DfuStatus::Ok;
+            state = DfuState::Idle;
+            return ControlResult::Ack();
+
+        case SetupPacket::ClassDfuGetState:
+            response[0] = uint8_t(state);
+            return ControlResult::In(response, 1);
+
+        case SetupPacket::ClassDfuAbort:
+            switch (state)
+            {
+                case DfuState::Idle:
+                case DfuState::DownloadSync:
+                case DfuState::DownloadIdle:
+                case DfuState::ManifestSync:
+                case DfuState::UploadIdle:
+                    Drop();
+                    state = DfuState::Idle;
+                    return ControlResult::Ack();
+
+                default:
+                    break;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    // any unexpected request is stalled and the device enters dfuERROR, unless already there
+    if (state == DfuState::Error)
+        return ControlResult::Stall();
+    return Fail(DfuStatus::ErrStalledPacket);
+}
+
+bool Dfu::Reset()
+{
+    switch (state)
+    {
+        case DfuState::AppDetach:
+            status = DfuStatus::Ok;
+            state = DfuState::Idle;
+            Drop();
+            return false;
+
+        case DfuState::ManifestWaitReset:
+            return true;
+
+        case DfuState::DownloadSync:
+        case DfuState::DownloadBusy:
+        case DfuState::DownloadIdle:
+        case DfuState::Manifest:
+            Fail(DfuStatus::ErrUsbReset);
+            return false;
+
+        case DfuState::ManifestSync:
+            // the image is complete only once the manifestation has finished
+            if (manifested)
+            {
+                state = DfuState::Idle;
+                Drop();
+            }
+            else
+            {
+                Fail(DfuStatus::ErrUsbReset);
+            }
+            return false;
+
+        case DfuState::UploadIdle:
+            state = DfuState::Idle;
+            Drop();
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+bool Dfu::Poll()
+{
+    if (state == DfuState::Error)
+        return false;
+
+    auto& h = halves[prog];
+    if (h.pending)
+    {
+        uint32_t start = target.Milliseconds();
+        DfuStatus res = target.Write(h.offset, h.data, h.length);
+        // a partial millisecond counts as a whole one, the host would otherwise poll too early
+        uint32_t elapsed = target.Milliseconds() - start + 1;
+        programTime = (programTime * 3 + elapsed + 3) / 4;
+
+        if (res != DfuStatus::Ok)
+        {
+            Fail(res);
+            return true;
+        }
+
+        h.pending = false;
+        prog ^= 1;
+        return true;
+    }
+
+    if (state == DfuState::Manifest && !manifested)
+    {
+        uint32_t start = target.Milliseconds();
+        DfuStatus res = target.Manifest();
+        manifestTime = target.Milliseconds() - start + 1;
+
+        if (res != DfuStatus::Ok)
+        {
+            Fail(res);
+            return true;
+        }
+
+        manifested = true;
+        state = !!(attributes & DfuAttributes::ManifestationTolerant) ? DfuState::ManifestSync : DfuState::ManifestWaitReset;
+        return true;
+    }
+
+    return false;
+}
+
+}
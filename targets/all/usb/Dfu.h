@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Dfu.h
+ *
+ * Device Firmware Upgrade 1.1 function
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! DFU functional descriptor attributes
+enum struct DfuAttributes : uint8_t
+{
+    CanDownload = BIT(0),           //!< Device supports DFU_DNLOAD
+    CanUpload = BIT(1),             //!< Device supports DFU_UPLOAD
+    ManifestationTolerant = BIT(2), //!< Device remains responsive on the bus after manifestation
+    WillDetach = BIT(3),            //!< Device detaches by itself after DFU_DETACH, without waiting for a bus reset
+};
+
+DEFINE_FLAG_ENUM(DfuAttributes);
+
+//! DFU device states, as reported by DFU_GETSTATUS and DFU_GETSTATE
+enum struct DfuState : uint8_t
+{
+    AppIdle = 0,                //!< Application running, DFU_DETACH can be requested
+    AppDetach = 1,              //!< DFU_DETACH received, waiting for a bus reset
+    Idle = 2,                   //!< DFU mode, waiting for requests
+    DownloadSync = 3,           //!< Block received, waiting for DFU_GETSTATUS
+    DownloadBusy = 4,           //!< Programming in progress, the host waits for bwPollTimeout
+    DownloadIdle = 5,           //!< Waiting for the next block
+    ManifestSync = 6,           //!< Download complete, waiting for DFU_GETSTATUS
+    Manifest = 7,               //!< Manifestation in progress
+    ManifestWaitReset = 8,      //!< Manifestation complete, waiting for a bus reset
+    UploadIdle = 9,             //!< Upload in progress, waiting for the next DFU_UPLOAD
+    Error = 10,                 //!< Error occurred, waiting for DFU_CLRSTATUS
+};
+
+//! DFU status codes, as reported by DFU_GETSTATUS
+enum struct DfuStatus : uint8_t
+{
+    Ok = 0,                     //!< No error
+    ErrTarget = 1,              //!< File is not targeted for this device
+    ErrFile = 2,                //!< File fails a vendor-specific verification
+    ErrWrite = 3,               //!< Device is unable to write memory
+    ErrErase = 4,               //!< Memory erase failed
+    ErrCheckErased = 5,         //!< Memory erase check failed
+    ErrProg = 6,                //!< Program memory function failed
+    ErrVerify = 7,              //!< Programmed memory failed verification
+    ErrAddress = 8,             //!< Received address is out of range
+    ErrNotDone = 9,             //!< Download ended before all data was received
+    ErrFirmware = 10,           //!< Firmware is corrupt, cannot return to run-time operation
+    ErrVendor = 11,             //!< Vendor-specific error
+    ErrUsbReset = 12,           //!< Unexpected bus reset
+    ErrPowerOnReset = 13,       //!< Unexpected power on reset
+    ErrUnknown = 14,            //!< Unknown error
+    ErrStalledPacket = 15,      //!< Device stalled an unexpected request
+};
+
+//! Creates a DFU functional descriptor
+constexpr auto DfuFunctionalDescriptor(DfuAttributes attributes, uint16_t detachTimeout, uint16_t transferSize, uint16_t bcdDfuVersion = 0x0110)
+{
+    // DFU FUNCTIONAL descriptor type is the same as the class-specific device descriptor type
+    return CustomDescriptor<DfuAttributes, uint16_t, uint16_t, uint16_t>(DescriptorType::ClassSpecificDevice, attributes, detachTimeout, transferSize, bcdDfuVersion);
+}
+
+//! Creates the interface of a DFU function, either in run-time or in DFU mode
+constexpr auto DfuDescriptors(uint8_t interface, bool runtime, DfuAttributes attributes, uint16_t detachTimeout, uint16_t transferSize, uint8_t strName = 0)
+{
+    return InterfaceDescriptor(interface, 0, InterfaceClass::App, SubClass::AppDfu, runtime ? Protocol::DfuRuntime : Protocol::DfuMode, strName,
+        DfuFunctionalDescriptor(attributes, detachTimeout, transferSize));
+}
+
+//! Memory programmed by a Dfu function
+class DfuTarget
+{
+public:
+    //! Called when a new download starts
+    virtual DfuStatus Begin() { return DfuStatus::Ok; }
+    //! Programs a downloaded block at the specified offset of the image, erasing memory as needed
+    virtual DfuStatus Write(uint32_t offset, const void* data, size_t length) = 0;
+    //! Completes the download, e.g. verifies the image and marks it as valid
+    virtual DfuStatus Manifest() { return DfuStatus::Ok; }
+    //! Reads a block of the image for upload, returns the number of bytes read, a short read ends the upload
+    virtual size_t Read(uint32_t offset, void* data, size_t length) { return 0; }
+    //! Called when the host requests a switch to DFU mode in run-time mode
+    virtual void Detach(uint16_t timeout) {}
+    //! Gets a monotonic time in milliseconds, used to measure programming times for bwPollTimeout
+    virtual uint32_t Milliseconds() = 0;
+};
+
+//! State of a DFU function, handles the DFU class requests
+/*!
+ * The buffer is split into two halves of the transfer size. A downloaded block is received
+ * directly into the free half, and programmed by Poll() while the next block is being received
+ * into the other half. DFU_GETSTATUS reports dfuDNBUSY only when both halves are occupied,
+ * with bwPollTimeout estimated from the measured duration of previous programming
+ * and manifestation operations, so the host never waits longer than necessary.
+ *
+ * Poll() must not be invoked concurrently with HandleRequest().
+ */
+class Dfu
+{
+public:
+    //! Creates the DFU function
+    /*!
+     * @param runtime the function starts in run-time mode (appIDLE) instead of DFU mode (dfuIDLE)
+     * @param pollTimeout initial estimate of the programming time of a single block in milliseconds
+     */
+    Dfu(DfuTarget& target, void* buffer, size_t bufferSize, DfuAttributes attributes, bool runtime = false, uint16_t pollTimeout = 10);
+
+    //! Handles a DFU class request
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+    //! Programs pending blocks and performs manifestation, returns true if any work was done
+    bool Poll();
+    //! Handles a bus reset, returns true if the platform should start the downloaded firmware
+    /*!
+     * A reset in appDETACH switches to DFU mode, a reset in dfuMANIFEST-WAIT-RESET completes
+     * the update. A reset interrupting a download or manifestation is reported as errUSBR.
+     */
+    bool Reset();
+
+    //! Gets the current state of the function
+    DfuState State() const { return state; }
+    //! Gets the current status of the function
+    DfuStatus Status() const { return status; }
+    //! Gets the maximum size of a single block, to be reported as wTransferSize
+    uint16_t TransferSize() const { return halfSize; }
+    //! Gets the current estimate of block programming time in milliseconds
+    uint32_t ProgramTime() const { return programTime; }
+
+private:
+    struct Half
+    {
+        uint8_t* data;
+        uint32_t offset;
+        uint16_t length;
+        bool pending;
+    };
+
+    DfuTarget& target;
+    Half halves[2];
+    uint16_t halfSize;
+    DfuAttributes attributes;
+    DfuState state;
+    DfuStatus status;
+    uint8_t recv, prog;         // half to receive the next block, half to be programmed next
+    bool manifested;
+    uint32_t offset;            // offset of the next downloaded or uploaded block
+    uint32_t programTime;       // estimated programming time of a block
+    uint32_t manifestTime;      // estimated duration of manifestation
+    uint8_t response[6];
+
+    ControlResult GetStatus();
+    ControlResult Fail(DfuStatus status);
+    unsigned Pending() const { return halves[0].pending + halves[1].pending; }
+    void Drop();
+};
+
+//! DFU class request handlers for a Dfu function, for use with a SetupDispatcher
+/*!
+ * @p dfu is the member of @p TContext holding the function state, @p interface is the number of its interface
+ */
+template<typename TContext, Dfu TContext::*dfu, uint8_t interface> struct DfuRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*dfu).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> Out(SetupPacket::Request request)
+    {
+        return OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface);
+    }
+
+    static constexpr SetupHandler<TContext> In(SetupPacket::Request request)
+    {
+        return OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        Out(SetupPacket::ClassDfuDetach),
+        Out(SetupPacket::ClassDfuDnload),
+        In(SetupPacket::ClassDfuUpload),
+        In(SetupPacket::ClassDfuGetStatus),
+        Out(SetupPacket::ClassDfuClrStatus),
+        In(SetupPacket::ClassDfuGetState),
+        Out(SetupPacket::ClassDfuAbort),
+    };
+};
+
+}
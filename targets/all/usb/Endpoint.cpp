@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Endpoint.cpp
+ */
+
+#include <usb/Endpoint.h>
+
+namespace usb
+{
+
+void Endpoint::Submit(EndpointTransfer& transfer)
+{
+    transfer.transferred = 0;
+    transfer.status = TransferStatus::Pending;
+    transfer.done = false;
+    transfer.next = NULL;
+
+    // isochronous transfers never end with a ZLP
+    if (type == EndpointType::Isochronous)
+        transfer.zlp = false;
+
+    // a short OUT buffer would be overrun by a full packet
+    if (!IsIn() && (!transfer.length || transfer.length % maxPacketSize))
+    {
+        transfer.status = TransferStatus::Invalid;
+        transfer.done = true;
+        return;
+    }
+
+    if (tail)
+        tail->next = &transfer;
+    else
+        head = &transfer;
+    tail = &transfer;
+
+    if (head == &transfer && !armed && controller)
+        controller->Arm(*this);
+}
+
+void Endpoint::Cancel()
+{
+    if (armed && controller)
+        controller->Abort(*this);
+    armed = false;
+
+    while (head)
+        Complete(TransferStatus::Cancelled);
+}
+
+void Endpoint::Complete(TransferStatus status)
+{
+    auto t = head;
+    head = t->next;
+    if (!head)
+        tail = NULL;
+
+    t->status = status;
+    t->done = true;
+}
+
+bool Endpoint::Next(EndpointPacket& packet, size_t maxLength)
+{
+    auto t = head;
+    if (armed || !t)
+        return false;
+
+    if (maxLength < maxPacketSize)
+        maxLength = maxPacketSize;
+    else if (!IsIn())
+        maxLength -= maxLength % maxPacketSize;
+
+    // the header shares the first packet with the data
+    size_t header = IsIn() ? t->headerLength : 0;
+    packet.header = header ? t->header : NULL;
+    packet.headerLength = header;
+    maxLength = header < maxLength ? maxLength - header : 0;
+
+    // OUT transfers advance by full packets until a short one completes them, so the remaining length is a multiple as well
+    size_t remaining = t->length - t->transferred;
+    packet.data = t->buffer + t->transferred;
+    packet.length = remaining < maxLength ? remaining : maxLength;
+    armedLength = packet.length;
+    armedHeader = header;
+    armed = true;
+    return true;
+}
+
+void Endpoint::Done(size_t length)
+{
+    auto t = head;
+    if (!armed || !t)
+        return;
+
+    armed = false;
+    // the whole packet decides about the ZLP, but only the data is counted as transferred
+    size_t packet = length;
+    if (armedHeader)
+    {
+        t->headerLength = 0;
+        t->header = NULL;
+        length = length > armedHeader ? length - armedHeader : 0;
+    }
+    if (length > armedLength)
+        length = armedLength;
+    t->transferred += length;
+
+    if (IsIn())
+    {
+        if (t->transferred < t->length)
+            return;
+
+        if (t->zlp && packet && !(packet % maxPacketSize))
+        {
+            // the last packet was full, the next one armed will be a ZLP
+            t->zlp = false;
+            return;
+        }
+    }
+    else
+    {
+        // a short packet terminates the transfer even if there is space left
+        if (t->transferred < t->length && length == armedLength)
+            return;
+    }
+
+    Complete(TransferStatus::Complete);
+}
+
+async(Endpoint::Read, void* buffer, size_t length)
+async_def(EndpointTransfer t)
+{
+    f.t.Setup(buffer, length, false);
+    Submit(f.t);
+    await_signal(f.t.done);
+    async_return(f.t.status == TransferStatus::Complete ? intptr_t(f.t.transferred) : -1);
+}
+async_end
+
+async(Endpoint::Write, const void* data, size_t length)
+async_def(EndpointTransfer t)
+{
+    f.t.Setup(data, length, true);
+    Submit(f.t);
+    await_signal(f.t.done);
+    async_return(f.t.status == TransferStatus::Complete ? intptr_t(f.t.transferred) : -1);
+}
+async_end
+
+async(Endpoint::Wait, EndpointTransfer& transfer)
+async_def()
+{
+    await_signal(transfer.done);
+    async_return(transfer.status == TransferStatus::Complete ? intptr_t(transfer.transferred) : -1);
+}
+async_end
+
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Endpoint.h
+ *
+ * Queued asynchronous endpoint transfers
+ */
+
+#pragma once
+
+#include <base/base.h>
+#include <kernel/kernel.h>
+
+#include <usb/Descriptors.h>
+
+namespace usb
+{
+
+class Endpoint;
+
+//! Outcome of an EndpointTransfer
+enum struct TransferStatus : uint8_t
+{
+    Pending,    //!< Transfer is queued or in progress
+    Complete,   //!< Transfer completed, possibly short (OUT)
+    Cancelled,  //!< Transfer was cancelled by Endpoint::Cancel
+    Invalid,    //!< OUT transfer was rejected by Endpoint::Submit, its length is not a non-zero multiple of the max packet size
+};
+
+//! Single transfer queued on an Endpoint
+/*!
+ * The structure is owned by the caller and must remain valid until the transfer completes
+ * or is cancelled, which is signalled by the @ref done flag.
+ */
+struct EndpointTransfer
+{
+    uint8_t* buffer;                    //!< Data to be sent or the destination of received data
+    size_t length;                      //!< Length of the data, or maximum length to receive
+    size_t transferred;                 //!< Number of bytes actually transferred
+    bool zlp;                           //!< IN transfers with length a multiple of max packet size are terminated by a ZLP
+    uint8_t headerLength;               //!< Length of the header, cleared once the header is sent
+    const uint8_t* header;              //!< Bytes sent in front of the data in the first packet of an IN transfer, NULL if there are none, see SetHeader
+    volatile bool done;                 //!< Set when the transfer is no longer pending, can be used with await_signal
+    volatile TransferStatus status;     //!< Outcome of the transfer
+    EndpointTransfer* next;             //!< Next transfer in the queue of the endpoint
+
+    //! Prepares the transfer for submission
+    void Setup(const void* buffer, size_t length, bool zlp = true)
+    {
+        this->buffer = (uint8_t*)buffer;
+        this->length = length;
+        this->zlp = zlp;
+        header = NULL;
+        headerLength = 0;
+    }
+
+    //! Adds a header sent in front of the data of an IN transfer, to be called after Setup()
+    /*!
+     * The header is not copied into the data, the controller gathers the first packet from both
+     * buffers (see EndpointPacket::header). It is not counted in @ref length nor @ref transferred,
+     * but it is part of the packet when deciding if a ZLP is needed.
+     */
+    void SetHeader(const void* header, uint8_t length)
+    {
+        this->header = (const uint8_t*)header;
+        headerLength = length;
+    }
+};
+
+//! Portion of the active transfer to be armed in the controller
+/*!
+ * The first packet of an IN transfer may carry a header, which the controller sends in front
+ * of the data - by writing both into the FIFO, using a two-entry DMA descriptor chain, or by
+ * copying them into a packet buffer if it can do neither.
+ */
+struct EndpointPacket
+{
+    uint8_t* data;          //!< Data to be sent or the destination of received data
+    size_t length;          //!< Length of the data, or maximum length to receive, zero for a ZLP
+    const uint8_t* header;  //!< Bytes to be sent in front of @ref data (IN only), NULL if there is none, see EndpointTransfer::SetHeader
+    size_t headerLength;    //!< Length of the header, zero if there is none, the packet is headerLength + length bytes long
+};
+
+//! Controller operations required by an Endpoint
+class EndpointController
+{
+public:
+    //! Called when a transfer is submitted to an idle endpoint, the controller should arm the packet returned by Endpoint::Next
+    virtual void Arm(Endpoint& endpoint) = 0;
+    //! Called when the transfers of an endpoint are cancelled, the controller must abort the armed packet
+    virtual void Abort(Endpoint& endpoint) {}
+};
+
+//! Queue of transfers of a single endpoint
+/*!
+ * Tasks submit any number of transfers, which are processed in order. The controller driver
+ * arms the packets returned by Next() and reports their completion using Done(). By calling
+ * Next() again immediately after Done(), the next packet - from the same transfer or the next
+ * queued one - is armed without waiting for the task to run, so there are no gaps between
+ * consecutive transfers.
+ *
+ * Transfers should be cancelled when the host clears the halt feature of the endpoint
+ * or changes the configuration (see DeviceState::OnEndpointHalt and DeviceState::OnSetConfiguration).
+ *
+ * The task-side methods must not be invoked concurrently with the controller-side methods,
+ * i.e. the driver has to call Next() and Done() from the same scheduler, or the endpoint
+ * interrupt has to be masked while submitting.
+ */
+class Endpoint
+{
+public:
+    //! Creates the endpoint queue for the specified endpoint
+    Endpoint(const EndpointDescriptor& epd, EndpointController* controller = NULL)
+        : controller(controller), maxPacketSize(epd.MaxPacketSize() * epd.Transactions()), address(epd.bEndpointAddress),
+        type(EndpointType(epd.bmAttributes & 3)) {}
+
+    //! Gets the address of the endpoint
+    uint8_t Address() const { return address; }
+    //! Checks if this is an IN endpoint
+    bool IsIn() const { return address & 0x80; }
+    //! Gets the maximum amount of data transferred in a single (micro)frame
+    uint16_t MaxPacketSize() const { return maxPacketSize; }
+    //! Gets the type of the endpoint
+    EndpointType Type() const { return type; }
+    //! Checks if there are any transfers pending
+    bool Busy() const { return head; }
+
+    //! Attaches the endpoint to a controller
+    void Attach(EndpointController* controller) { this->controller = controller; }
+
+    //! Queues a transfer without waiting for its completion
+    /*!
+     * The host may send a full packet at any time, so the length of an OUT transfer must be a non-zero
+     * multiple of the max packet size, other OUT transfers complete immediately with TransferStatus::Invalid
+     */
+    void Submit(EndpointTransfer& transfer);
+    //! Cancels all pending transfers
+    void Cancel();
+
+    //! Receives data into the buffer, returns the number of bytes received or -1 if cancelled or @p length is not valid (see Submit)
+    async(Read, void* buffer, size_t length);
+    //! Sends data, terminated by a ZLP if required, returns the number of bytes sent or -1 if cancelled
+    async(Write, const void* data, size_t length);
+    //! Waits for a submitted transfer to complete, returns the number of bytes transferred or -1 if cancelled
+    async(Wait, EndpointTransfer& transfer);
+
+    //! Gets the next packet to be armed in the controller
+    /*!
+     * @param maxLength maximum length of the packet, controllers capable of multi-packet transfers can request
+     * a larger amount, zero for a single packet. OUT packets are always armed as a multiple of the max packet size.
+     * @returns false if there is nothing to arm or a packet is already armed
+     */
+    bool Next(EndpointPacket& packet, size_t maxLength = 0);
+    //! Completes the armed packet, @p length is the amount of data actually transferred (including the header)
+    void Done(size_t length);
+
+private:
+    EndpointController* controller;
+    EndpointTransfer* head = NULL;
+    EndpointTransfer* tail = NULL;
+    size_t armedLength;
+    uint8_t armedHeader;
+    uint16_t maxPacketSize;
+    uint8_t address;
+    EndpointType type;
+    bool armed = false;
+
+    void Complete(TransferStatus status);
+};
+
+}
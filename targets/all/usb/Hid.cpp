@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Hid.cpp
+ */
+
+#include <usb/Hid.h>
+
+namespace usb
+{
+
+bool Hid::UsesReportIds(const void* reportDescriptor, size_t length)
+{
+    auto p = (const uint8_t*)reportDescriptor, end = p + length;
+    while (p < end)
+    {
+        // long items (0xFE) carry their data size in the following byte
+        unsigned size = *p == 0xFE ? (p + 1 < end ? p[1] + 2 : 0) : (*p & 3) == 3 ? 4 : (*p & 3);
+        if ((*p & 0xFC) == 0x84)
+            return true;
+        p += 1 + size;
+    }
+    return false;
+}
+
+ControlResult Hid::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    if (setup.type == SetupPacket::TypeStandard)
+    {
+        if (setup.bRequest != SetupPacket::StdGetDescriptor)
+            return ControlResult::Unhandled();
+
+        switch (setup.descriptorType)
+        {
+            case DescriptorType::Hid:
+                return ControlResult::In(&hidDescriptor, sizeof(HidDescriptor));
+            case DescriptorType::HidReport:
+                return ControlResult::In(reportDescriptor, hidDescriptor.wReportDescriptorLength);
+            default:
+                return ControlResult::Stall();
+        }
+    }
+
+    uint8_t id = setup.wValue & 0xFF;
+    auto type = HidReportType(setup.wValue >> 8);
+    uint8_t* buffer = Buffer(count + 2);
+
+    switch (setup.bRequest)
+    {
+        case SetupPacket::ClassHidGetReport:
+        {
+            // the report ID precedes the report data if IDs are used
+            unsigned prefix = reportIds;
+            int length = reports.GetReport(type, id, buffer + prefix, slotSize - 1);
+            if (length < 0)
+                break;
+            if (prefix)
+                buffer[0] = id;
+            return ControlResult::In(buffer, length + prefix);
+        }
+
+        case SetupPacket::ClassHidSetReport:
+            if (stage == ControlStage::Setup)
+            {
+                if (setup.wLength > slotSize)
+                    break;
+                return ControlResult::Out(buffer, setup.wLength);
+            }
+            else
+            {
+                unsigned prefix = reportIds && setup.wLength;
+                if (!reports.SetReport(type, id, buffer + prefix, setup.wLength - prefix))
+                    break;
+                return ControlResult::Ack();
+            }
+
+        case SetupPacket::ClassHidGetIdle:
+            response = Idle(id);
+            return ControlResult::In(&response, 1);
+
+        case SetupPacket::ClassHidSetIdle:
+        {
+            uint8_t idle = setup.wValue >> 8;
+            if (!id)
+            {
+                defaultIdle = idle;
+                for (size_t i = 0; i < count; i++)
+                    slots[i].idle = idle;
+                return ControlResult::Ack();
+            }
+
+            // the rate of a report ID that has not been sent yet is kept in a newly assigned slot
+            auto slot = Assign(id);
+            if (!slot)
+                break;
+            slot->idle = idle;
+            return ControlResult::Ack();
+        }
+
+        case SetupPacket::ClassHidGetProtocol:
+            response = reportProtocol;
+            return ControlResult::In(&response, 1);
+
+        case SetupPacket::ClassHidSetProtocol:
+            if (setup.wValue > 1)
+                break;
+            reportProtocol = setup.wValue;
+            reports.SetProtocol(reportProtocol);
+            return ControlResult::Ack();
+
+        default:
+            return ControlResult::Unhandled();
+    }
+
+    return ControlResult::Stall();
+}
+
+void Hid::Open(Endpoint& in, Endpoint* out)
+{
+    Close();
+    this->in = &in;
+    // a full OUT packet must fit into a single buffer
+    this->out = out && out->MaxPacketSize() <= slotSize ? out : NULL;
+    SubmitOut();
+}
+
+void Hid::Close()
+{
+    if (in)
+        in->Cancel();
+    if (out)
+        out->Cancel();
+    in = out = NULL;
+    txSubmitted = false;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        slots[i].length = 0;
+        slots[i].assigned = false;
+        slots[i].pending = false;
+    }
+    // the protocol returns to the default with every configuration change
+    reportProtocol = true;
+}
+
+const Hid::Slot* Hid::Find(uint8_t id) const
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (slots[i].assigned && slots[i].id == id)
+            return &slots[i];
+    }
+    return NULL;
+}
+
+Hid::Slot* Hid::Assign(uint8_t id)
+{
+    if (auto slot = (Slot*)Find(id))
+        return slot;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!slots[i].assigned)
+        {
+            slots[i].id = id;
+            slots[i].idle = defaultIdle;
+            slots[i].assigned = true;
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+bool Hid::Send(uint8_t id, const void* data, size_t length)
+{
+    unsigned prefix = reportIds;
+    if (length + prefix > slotSize)
+        return false;
+
+    auto slot = Assign(id);
+    if (!slot)
+        return false;
+
+    // a pending report is replaced in place, keeping its position in the queue
+    uint8_t* buffer = Buffer(slot - slots);
+    buffer[0] = id;
+    memcpy(buffer + prefix, data, length);
+    slot->length = length + prefix;
+    Queue(*slot);
+    return true;
+}
+
+void Hid::SubmitOut()
+{
+    if (!out)
+        return;
+    rxTransfer.Setup(Buffer(count + 1), slotSize - slotSize % out->MaxPacketSize(), false);
+    out->Submit(rxTransfer);
+}
+
+void Hid::Poll(uint32_t now)
+{
+    if (!in)
+        return;
+
+    if (out && rxTransfer.done)
+    {
+        if (rxTransfer.status == TransferStatus::Complete && rxTransfer.transferred)
+        {
+            uint8_t* buffer = Buffer(count + 1);
+            unsigned prefix = reportIds;
+            reports.SetReport(HidReportType::Output, prefix ? buffer[0] : 0, buffer + prefix, rxTransfer.transferred - prefix);
+        }
+        SubmitOut();
+    }
+
+    if (txSubmitted && !txTransfer.done)
+        return;
+    txSubmitted = false;
+
+    Slot* next = NULL;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& s = slots[i];
+        if (!s.length)
+            continue;
+        // the idle rate repeats reports that have not been sent for the idle period
+        if (!s.pending && s.idle && now - s.sent >= s.idle * 4u)
+            Queue(s);
+        if (s.pending && (!next || int32_t(s.order - next->order) < 0))
+            next = &s;
+    }
+
+    if (!next)
+        return;
+
+    // the report is copied, so it can be replaced while being transferred
+    uint8_t* buffer = Buffer(count);
+    memcpy(buffer, Buffer(next - slots), next->length);
+    next->pending = false;
+    next->sent = now;
+    txTransfer.Setup(buffer, next->length, false);
+    txSubmitted = true;
+    in->Submit(txTransfer);
+}
+
+}
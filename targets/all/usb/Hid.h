@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Hid.h
+ *
+ * Human Interface Device function with a compile-time report descriptor builder
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Endpoint.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! HID usage pages
+enum struct HidPage : uint16_t
+{
+    GenericDesktop = 0x01,  //!< Generic desktop controls
+    Simulation = 0x02,      //!< Simulation controls
+    Vr = 0x03,              //!< VR controls
+    Sport = 0x04,           //!< Sport controls
+    Game = 0x05,            //!< Game controls
+    GenericDevice = 0x06,   //!< Generic device controls
+    Keyboard = 0x07,        //!< Keyboard/keypad
+    Led = 0x08,             //!< LEDs
+    Button = 0x09,          //!< Buttons
+    Ordinal = 0x0A,         //!< Ordinal
+    Telephony = 0x0B,       //!< Telephony devices
+    Consumer = 0x0C,        //!< Consumer devices
+    Digitizer = 0x0D,       //!< Digitizers
+    Sensor = 0x20,          //!< Sensors
+    Vendor = 0xFF00,        //!< First vendor-defined page
+};
+
+//! Types of HID collections
+enum struct HidCollectionType : uint8_t
+{
+    Physical = 0,       //!< Group of axes
+    Application = 1,    //!< Mouse, keyboard, etc.
+    Logical = 2,        //!< Interrelated data
+    Report = 3,         //!< Report
+    NamedArray = 4,     //!< Named array
+    UsageSwitch = 5,    //!< Usage switch
+    UsageModifier = 6,  //!< Usage modifier
+};
+
+//! Flags of HID Input, Output and Feature items
+enum struct HidFlags : uint16_t
+{
+    Data = 0,               //!< Data (default)
+    Constant = BIT(0),      //!< Constant, e.g. padding
+    Array = 0,              //!< Array (default)
+    Variable = BIT(1),      //!< Variable
+    Absolute = 0,           //!< Absolute (default)
+    Relative = BIT(2),      //!< Relative
+    Wrap = BIT(3),          //!< Value wraps around
+    NonLinear = BIT(4),     //!< Non-linear
+    NoPreferred = BIT(5),   //!< No preferred state
+    NullState = BIT(6),     //!< Has a null state
+    Volatile = BIT(7),      //!< Volatile (Output and Feature only)
+    BufferedBytes = BIT(8), //!< Buffered bytes
+};
+
+DEFINE_FLAG_ENUM(HidFlags);
+
+//! Single item of a HID report descriptor, see USB_HID_REPORT
+struct HidItem
+{
+    enum Type : uint8_t
+    {
+        Main = 0,
+        Global = 1,
+        Local = 2,
+    };
+
+    uint8_t bytes[5];   //!< Encoded item
+    uint8_t length;     //!< Length of the encoded item
+
+    //! Creates a short item with the specified data size (0, 1, 2 or 4 bytes)
+    static constexpr HidItem Short(Type type, uint8_t tag, uint32_t data, unsigned size)
+    {
+        HidItem res = {};
+        res.bytes[0] = tag << 4 | type << 2 | (size == 4 ? 3 : size);
+        for (unsigned i = 0; i < size; i++)
+            res.bytes[1 + i] = uint8_t(data >> (8 * i));
+        res.length = 1 + size;
+        return res;
+    }
+
+    //! Creates a short item with the smallest data size able to hold the unsigned value
+    static constexpr HidItem Unsigned(Type type, uint8_t tag, uint32_t value)
+    {
+        return Short(type, tag, value, value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : 4);
+    }
+
+    //! Creates a short item with the smallest data size able to hold the signed value
+    static constexpr HidItem Signed(Type type, uint8_t tag, int32_t value)
+    {
+        return Short(type, tag, uint32_t(value), value >= -0x80 && value <= 0x7F ? 1 : value >= -0x8000 && value <= 0x7FFF ? 2 : 4);
+    }
+};
+
+constexpr HidItem HidInput(HidFlags flags) { return HidItem::Unsigned(HidItem::Main, 0x8, uint16_t(flags)); }
+constexpr HidItem HidOutput(HidFlags flags) { return HidItem::Unsigned(HidItem::Main, 0x9, uint16_t(flags)); }
+constexpr HidItem HidFeature(HidFlags flags) { return HidItem::Unsigned(HidItem::Main, 0xB, uint16_t(flags)); }
+constexpr HidItem HidCollection(HidCollectionType type) { return HidItem::Unsigned(HidItem::Main, 0xA, uint8_t(type)); }
+constexpr HidItem HidEndCollection() { return HidItem::Short(HidItem::Main, 0xC, 0, 0); }
+
+constexpr HidItem HidUsagePage(HidPage page) { return HidItem::Unsigned(HidItem::Global, 0x0, uint16_t(page)); }
+constexpr HidItem HidLogicalMinimum(int32_t value) { return HidItem::Signed(HidItem::Global, 0x1, value); }
+constexpr HidItem HidLogicalMaximum(int32_t value) { return HidItem::Signed(HidItem::Global, 0x2, value); }
+constexpr HidItem HidPhysicalMinimum(int32_t value) { return HidItem::Signed(HidItem::Global, 0x3, value); }
+constexpr HidItem HidPhysicalMaximum(int32_t value) { return HidItem::Signed(HidItem::Global, 0x4, value); }
+constexpr HidItem HidUnitExponent(int8_t exponent) { return HidItem::Short(HidItem::Global, 0x5, uint8_t(exponent) & 0xF, 1); }
+constexpr HidItem HidUnit(uint32_t unit) { return HidItem::Unsigned(HidItem::Global, 0x6, unit); }
+constexpr HidItem HidReportSize(uint8_t bits) { return HidItem::Unsigned(HidItem::Global, 0x7, bits); }
+constexpr HidItem HidReportId(uint8_t id) { return HidItem::Unsigned(HidItem::Global, 0x8, id); }
+constexpr HidItem HidReportCount(uint16_t count) { return HidItem::Unsigned(HidItem::Global, 0x9, count); }
+constexpr HidItem HidPush() { return HidItem::Short(HidItem::Global, 0xA, 0, 0); }
+constexpr HidItem HidPop() { return HidItem::Short(HidItem::Global, 0xB, 0, 0); }
+
+constexpr HidItem HidUsage(uint16_t usage) { return HidItem::Unsigned(HidItem::Local, 0x0, usage); }
+constexpr HidItem HidUsageMinimum(uint16_t usage) { return HidItem::Unsigned(HidItem::Local, 0x1, usage); }
+constexpr HidItem HidUsageMaximum(uint16_t usage) { return HidItem::Unsigned(HidItem::Local, 0x2, usage); }
+
+//! Encoded HID report descriptor of @p n bytes, created using USB_HID_REPORT
+template<size_t n> struct HidReportDescriptor
+{
+    uint8_t data[n];    //!< Encoded items
+};
+
+template<typename... T> constexpr size_t _HidReportLength(const T&... items)
+{
+    return (items.length + ...);
+}
+
+template<size_t n, typename... T> constexpr HidReportDescriptor<n> _HidReport(const T&... items)
+{
+    HidReportDescriptor<n> res = {};
+    const HidItem list[] = { items... };
+    size_t offset = 0;
+    for (auto& item: list)
+    {
+        for (unsigned i = 0; i < item.length; i++)
+            res.data[offset++] = item.bytes[i];
+    }
+    return res;
+}
+
+//! HID class descriptor, follows the interface descriptor and describes the report descriptor
+PACKED_UNALIGNED_STRUCT HidDescriptor : DescriptorHeader
+{
+    constexpr HidDescriptor(uint16_t reportLength, uint8_t countryCode = 0, uint16_t bcdHid = 0x0111)
+        : DescriptorHeader(sizeof(HidDescriptor), DescriptorType::Hid),
+        bcdHID(bcdHid),
+        bCountryCode(countryCode),
+        wReportDescriptorLength(reportLength) {}
+
+    uint16_t bcdHID;                //!< HID specification version (BCD)
+    uint8_t bCountryCode;           //!< Country code of localized hardware, zero if not localized
+    uint8_t bNumDescriptors = 1;    //!< Number of class descriptors
+    DescriptorType bReportDescriptorType = DescriptorType::HidReport;   //!< Type of the class descriptor
+    uint16_t wReportDescriptorLength;   //!< Length of the report descriptor
+};
+
+//! Creates the interface of a HID function with an interrupt IN endpoint
+/*!
+ * @p interval is specified for high speed (see EndpointForSpeed), @p boot selects the boot
+ * protocol (Protocol::HidKeyboard or Protocol::HidMouse) supported by the interface
+ */
+template<size_t n> constexpr auto HidDescriptors(uint8_t interface, const HidReportDescriptor<n>& report, uint8_t endpoint, uint16_t maxPacketSize, uint8_t interval,
+    uint8_t strName = 0, Protocol boot = Protocol::None)
+{
+    return InterfaceDescriptor(interface, 0, InterfaceClass::Hid, boot == Protocol::None ? SubClass::None : SubClass::HidBoot, boot, strName,
+        HidDescriptor(n),
+        EndpointDescriptor::InterruptIn(endpoint, maxPacketSize, interval));
+}
+
+//! Creates the interface of a HID function with interrupt IN and OUT endpoints, see HidDescriptors
+template<size_t n> constexpr auto HidDescriptorsInOut(uint8_t interface, const HidReportDescriptor<n>& report, uint8_t endpoint, uint16_t maxPacketSize, uint8_t interval,
+    uint8_t strName = 0, Protocol boot = Protocol::None)
+{
+    return InterfaceDescriptor(interface, 0, InterfaceClass::Hid, boot == Protocol::None ? SubClass::None : SubClass::HidBoot, boot, strName,
+        HidDescriptor(n),
+        EndpointDescriptor::InterruptIn(endpoint, maxPacketSize, interval),
+        EndpointDescriptor::InterruptOut(endpoint, maxPacketSize, interval));
+}
+
+//! HID report types
+enum struct HidReportType : uint8_t
+{
+    Input = 1,      //!< Input report (device to host)
+    Output = 2,     //!< Output report (host to device)
+    Feature = 3,    //!< Feature report (both directions)
+};
+
+//! Application side of a Hid function
+class HidReports
+{
+public:
+    //! Gets the current report requested by GET_REPORT, returns its length (without the report ID) or -1 if the report does not exist
+    virtual int GetReport(HidReportType type, uint8_t id, void* buffer, size_t length) = 0;
+    //! Processes a report sent by SET_REPORT or received on the interrupt OUT endpoint, returns false if the report is not accepted
+    virtual bool SetReport(HidReportType type, uint8_t id, const void* data, size_t length) { return false; }
+    //! Called when the host selects the boot protocol (false) or the report protocol (true)
+    virtual void SetProtocol(bool report) {}
+};
+
+//! State of a HID function, handles the class-specific requests and sends the input reports
+/*!
+ * Input reports are queued using Send(), which keeps just the latest report for each report ID.
+ * A report that has not been sent yet is replaced by a newer one with the same ID, so the host
+ * receives the current state with the next poll instead of a backlog of stale reports. Reports
+ * with different IDs are sent in the order in which they were first queued.
+ *
+ * When an idle rate is set by the host, the last report of each ID is repeated whenever
+ * no new report was sent for the idle period. Setting the rate of a report ID that has not
+ * been sent yet assigns a slot to it, the request is stalled if all the slots are in use.
+ *
+ * Send(), Poll() and HandleRequest() must follow the rules of Endpoint, i.e. run on the same
+ * scheduler as the controller driver.
+ */
+class Hid
+{
+public:
+    //! Queue entry holding the latest report of a single report ID
+    struct Slot
+    {
+        uint8_t id;         //!< Report ID
+        uint8_t length;     //!< Length of the report including the report ID byte, zero if no report was queued yet
+        uint8_t idle;       //!< Idle rate in 4 ms units, zero for no repeats
+        bool assigned;      //!< Slot is assigned to the report ID, by a queued report or by SET_IDLE
+        bool pending;       //!< Report is waiting to be sent
+        uint32_t order;     //!< Order in which the pending reports are sent
+        uint32_t sent;      //!< Time of the last transmission
+    };
+
+    //! Creates the function with the specified report descriptor
+    /*!
+     * @p slots holds @p count entries and @p buffers holds @p count + 3 buffers of @p maxReportSize + 1 bytes,
+     * use HidStorage to allocate them
+     */
+    Hid(HidReports& reports, const void* reportDescriptor, size_t reportLength, Slot* slots, size_t count, uint8_t* buffers, size_t maxReportSize)
+        : reports(reports), reportDescriptor(reportDescriptor), hidDescriptor(reportLength), slots(slots), buffers(buffers),
+        count(count), slotSize(maxReportSize + 1), reportIds(UsesReportIds(reportDescriptor, reportLength))
+    {
+        memset(slots, 0, count * sizeof(Slot));
+    }
+
+    //! Handles the class-specific requests and the GET_DESCRIPTOR requests directed at the interface
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+
+    //! Starts using the endpoints, to be called when the configuration is selected
+    /*!
+     * @p out is not used if its max packet size exceeds the buffer size (the maximum report size + 1), as a full packet would overrun the buffer
+     */
+    void Open(Endpoint& in, Endpoint* out = NULL);
+    //! Cancels all transfers and discards queued reports, to be called when the configuration is deselected
+    void Close();
+
+    //! Queues an input report, replacing a report with the same ID that has not been sent yet
+    /*!
+     * @p id is zero if the report descriptor does not contain any HidReportId items, otherwise
+     * it is sent as the first byte of the report
+     * @returns false if the report is too long or there is no free slot for a new report ID
+     */
+    bool Send(uint8_t id, const void* data, size_t length);
+    //! Sends the next pending report if the endpoint is idle, repeats reports according to the idle rate
+    /*!
+     * @p now is a free-running time in milliseconds
+     */
+    void Poll(uint32_t now);
+
+    //! Checks if the host selected the report protocol (the default) rather than the boot protocol
+    bool ReportProtocol() const { return reportProtocol; }
+    //! Gets the idle rate of the specified report ID in 4 ms units
+    uint8_t Idle(uint8_t id) const { auto s = Find(id); return s ? s->idle : defaultIdle; }
+
+private:
+    HidReports& reports;
+    const void* reportDescriptor;
+    HidDescriptor hidDescriptor;
+    Slot* slots;
+    uint8_t* buffers;   // slot data, then the IN transfer, OUT transfer and control buffers
+    uint8_t count;
+    uint8_t slotSize;
+    bool reportIds;
+    uint8_t defaultIdle = 0;
+    bool reportProtocol = true;
+    bool txSubmitted = false;
+    uint8_t response;
+    uint32_t order = 0;
+    Endpoint* in = NULL;
+    Endpoint* out = NULL;
+    EndpointTransfer txTransfer, rxTransfer;
+
+    static bool UsesReportIds(const void* reportDescriptor, size_t length);
+    const Slot* Find(uint8_t id) const;
+    Slot* Assign(uint8_t id);
+    uint8_t* Buffer(size_t index) const { return buffers + index * slotSize; }
+    void Queue(Slot& slot) { if (!slot.pending) { slot.pending = true; slot.order = order++; } }
+    void SubmitOut();
+};
+
+//! Hid with storage for @p n report IDs of up to @p maxReportSize bytes (excluding the report ID)
+template<size_t n, size_t maxReportSize> class HidStorage : public Hid
+{
+    static_assert(n > 0 && n < 256 && maxReportSize < 255, "Unsupported HID report queue size");
+
+public:
+    //! Creates the function with the specified report descriptor
+    template<size_t length> HidStorage(HidReports& reports, const HidReportDescriptor<length>& report)
+        : Hid(reports, report.data, length, slots, n, buffers, maxReportSize) {}
+
+private:
+    Slot slots[n];
+    uint8_t buffers[(n + 3) * (maxReportSize + 1)];
+};
+
+//! Class-specific request handlers for a Hid function, for use with a SetupDispatcher
+/*!
+ * @p hid is the member of @p TContext holding the function state, @p interface is the number of its interface
+ */
+template<typename TContext, typename THid, THid TContext::*hid, uint8_t interface> struct HidRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*hid).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> Out(SetupPacket::Request request)
+    {
+        return OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface);
+    }
+
+    static constexpr SetupHandler<TContext> In(SetupPacket::Request request)
+    {
+        return OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, Handle, interface);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdGetDescriptor, Handle, interface),
+        In(SetupPacket::ClassHidGetReport),
+        In(SetupPacket::ClassHidGetIdle),
+        In(SetupPacket::ClassHidGetProtocol),
+        Out(SetupPacket::ClassHidSetReport),
+        Out(SetupPacket::ClassHidSetIdle),
+        Out(SetupPacket::ClassHidSetProtocol),
+    };
+};
+
+}
+
+//! Creates a HidReportDescriptor from a list of HidItems, e.g. USB_HID_REPORT(HidUsagePage(HidPage::GenericDesktop), HidUsage(0x02), ...)
+#define USB_HID_REPORT(...) ::usb::_HidReport<::usb::_HidReportLength(__VA_ARGS__)>(__VA_ARGS__)
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/HostParser.cpp
+ */
+
+#include <usb/HostParser.h>
+
+namespace usb
+{
+
+/****** HostConfig ******/
+
+HostParseError HostConfig::Parse(const void* data, size_t length)
+{
+    this->data = NULL;
+    this->length = 0;
+    interfaceCount = endpointCount = 0;
+
+    auto base = (const uint8_t*)data;
+    auto config = (const ConfigDescriptorHeader*)data;
+    if (length < sizeof(ConfigDescriptorHeader))
+        return HostParseError::Truncated;
+    if (config->bDescriptorType != DescriptorType::Config || config->bLength < sizeof(ConfigDescriptorHeader))
+        return HostParseError::InvalidHeader;
+    if (config->wTotalLength < config->bLength)
+        return HostParseError::InvalidLength;
+    if (config->wTotalLength > length)
+        return HostParseError::Truncated;
+
+    size_t total = config->wTotalLength;
+    HostInterfaceEntry* current = NULL;
+
+    for (size_t offset = config->bLength; offset < total;)
+    {
+        if (total - offset < sizeof(DescriptorHeader))
+            return HostParseError::Truncated;
+
+        auto hdr = (const DescriptorHeader*)(base + offset);
+        size_t len = hdr->bLength;
+        if (len < sizeof(DescriptorHeader))
+            return HostParseError::InvalidLength;
+        if (len > total - offset)
+            return HostParseError::Truncated;
+
+        switch (hdr->bDescriptorType)
+        {
+            case DescriptorType::Interface:
+            {
+                if (len < sizeof(InterfaceDescriptorHeader))
+                    return HostParseError::InvalidLength;
+                if (interfaceCount == maxInterfaces)
+                    return HostParseError::TooManyInterfaces;
+
+                auto ifd = (const InterfaceDescriptorHeader*)hdr;
+                current = &interfaces[interfaceCount++];
+                *current = { uint16_t(offset), uint16_t(offset), ifd->bInterfaceNumber, ifd->bAlternateSetting, endpointCount, 0 };
+                break;
+            }
+
+            case DescriptorType::Endpoint:
+                if (len < sizeof(EndpointDescriptor))
+                    return HostParseError::InvalidLength;
+                if (!current)
+                    return HostParseError::EndpointOutsideInterface;
+                if (endpointCount == maxEndpoints)
+                    return HostParseError::TooManyEndpoints;
+
+                endpoints[endpointCount++] = { uint16_t(offset), ((const EndpointDescriptor*)hdr)->bEndpointAddress, uint8_t(current - interfaces) };
+                current->endpoints++;
+                break;
+
+            case DescriptorType::InterfaceAssociation:
+                // an association starts a new function, the following descriptors do not belong to the previous interface
+                current = NULL;
+                break;
+
+            default:
+                break;
+        }
+
+        offset += len;
+        if (current)
+            current->end = offset;
+    }
+
+    this->data = base;
+    this->length = total;
+    return HostParseError::None;
+}
+
+int HostConfig::FindInterface(uint8_t number, uint8_t alternate) const
+{
+    for (size_t i = 0; i < interfaceCount; i++)
+    {
+        if (interfaces[i].number == number && interfaces[i].alternate == alternate)
+            return i;
+    }
+    return -1;
+}
+
+const EndpointDescriptor* HostConfig::FindEndpoint(uint8_t address, int interface, int alternate) const
+{
+    for (size_t i = 0; i < endpointCount; i++)
+    {
+        auto& e = endpoints[i];
+        if (e.address != address)
+            continue;
+
+        auto& ifd = interfaces[e.interface];
+        if ((interface < 0 || interface == ifd.number) && (alternate < 0 || alternate == ifd.alternate))
+            return At<EndpointDescriptor>(e.offset);
+    }
+    return NULL;
+}
+
+const DescriptorHeader* HostConfig::FindDescriptor(size_t interface, DescriptorType type, const DescriptorHeader* after) const
+{
+    auto& e = interfaces[interface];
+    // the interface descriptor itself is skipped, the bounds of all descriptors were checked by Parse()
+    auto hdr = after ? after->Next() : At<InterfaceDescriptorHeader>(e.offset)->Next();
+    auto end = At<DescriptorHeader>(e.end);
+
+    for (; hdr < end; hdr = hdr->Next())
+    {
+        if (hdr->bDescriptorType == type)
+            return hdr;
+    }
+    return NULL;
+}
+
+const DescriptorHeader* HostConfig::FindClassSpecific(size_t interface, DescriptorType type, DescriptorSubType subType, const DescriptorHeader* after) const
+{
+    for (auto hdr = FindDescriptor(interface, type, after); hdr; hdr = FindDescriptor(interface, type, hdr))
+    {
+        // the subtype immediately follows the header
+        if (hdr->bLength > sizeof(DescriptorHeader) && DescriptorSubType(((const uint8_t*)hdr)[2]) == subType)
+            return hdr;
+    }
+    return NULL;
+}
+
+/****** HostConfigCache ******/
+
+const HostConfig* HostConfigCache::Find(const DeviceDescriptor& device, uint8_t index)
+{
+    auto key = HostDeviceKey::From(device, index);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& e = entries[i];
+        if (e.valid && e.key == key)
+        {
+            e.used = ++time;
+            return &e.config;
+        }
+    }
+    return NULL;
+}
+
+const HostConfig* HostConfigCache::Store(const DeviceDescriptor& device, uint8_t index, const void* config, size_t length, HostParseError* error)
+{
+    auto key = HostDeviceKey::From(device, index);
+    Entry* entry = NULL;
+
+    // an existing entry of the same configuration is reused, then a free one, then the least recently used
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& e = entries[i];
+        if (e.valid && e.key == key)
+        {
+            entry = &e;
+            break;
+        }
+        if (!entry || (entry->valid && (!e.valid || int32_t(e.used - entry->used) < 0)))
+            entry = &e;
+    }
+
+    HostParseError res = HostParseError::TooLong;
+    auto& spare = entries[count];
+    if (entry)
+    {
+        // data beyond wTotalLength is not needed, so longer buffers are accepted as long as the configuration fits
+        bool clipped = length > maxLength;
+        if (clipped)
+            length = maxLength;
+        memcpy(spare.data, config, length);
+        res = spare.config.Parse(spare.data, length);
+        if (res == HostParseError::Truncated && clipped)
+            res = HostParseError::TooLong;
+    }
+
+    if (error)
+        *error = res;
+    if (res != HostParseError::None)
+        return NULL;
+
+    // the selected entry takes over the buffers of the spare, its own become the new spare
+    Entry replaced = *entry;
+    *entry = spare;
+    spare = replaced;
+    spare.valid = false;
+    entry->key = key;
+    entry->used = ++time;
+    entry->valid = true;
+    return &entry->config;
+}
+
+void HostConfigCache::Remove(const DeviceDescriptor& device)
+{
+    auto key = HostDeviceKey::From(device);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& e = entries[i];
+        key.index = e.key.index;
+        if (e.key == key)
+            e.valid = false;
+    }
+}
+
+void HostConfigCache::Clear()
+{
+    for (size_t i = 0; i < count; i++)
+        entries[i].valid = false;
+}
+
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/HostParser.h
+ *
+ * Host-side parser of configuration descriptors received from attached devices
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+
+namespace usb
+{
+
+//! Problems detected when parsing a configuration descriptor
+enum struct HostParseError : uint8_t
+{
+    None,                       //!< Configuration is valid
+    Truncated,                  //!< Data shorter than the configuration header, wTotalLength or a nested descriptor
+    InvalidHeader,              //!< Data does not start with a configuration descriptor
+    InvalidLength,              //!< Descriptor shorter than its header or its standard layout, or wTotalLength shorter than the configuration descriptor
+    EndpointOutsideInterface,   //!< Endpoint descriptor not preceded by an interface descriptor
+    TooManyInterfaces,          //!< More interface descriptors (alternate settings included) than entries in the index
+    TooManyEndpoints,           //!< More endpoint descriptors than entries in the index
+    TooLong,                    //!< Configuration does not fit into the cache entry
+};
+
+//! Index entry of a single interface alternate setting
+struct HostInterfaceEntry
+{
+    uint16_t offset;        //!< Offset of the InterfaceDescriptorHeader in the configuration
+    uint16_t end;           //!< Offset of the first descriptor not belonging to the alternate setting
+    uint8_t number;         //!< Interface number
+    uint8_t alternate;      //!< Alternate setting
+    uint8_t firstEndpoint;  //!< Index of the first HostEndpointEntry of the alternate setting
+    uint8_t endpoints;      //!< Number of endpoint descriptors found (bNumEndpoints is not trusted)
+};
+
+//! Index entry of a single endpoint
+struct HostEndpointEntry
+{
+    uint16_t offset;        //!< Offset of the EndpointDescriptor in the configuration
+    uint8_t address;        //!< Endpoint address
+    uint8_t interface;      //!< Index of the HostInterfaceEntry containing the endpoint
+};
+
+//! Parsed configuration descriptor of an attached device
+/*!
+ * Parse() validates the bounds of every descriptor and builds an index of all interface
+ * alternate settings and endpoints in a single pass, using the entries provided by the caller.
+ * All lookups afterwards use the index, the descriptors are returned as pointers into the
+ * original data, which must stay valid while the HostConfig is used.
+ *
+ * Interfaces are identified by their index in the order of appearance (alternate settings
+ * included), see FindInterface.
+ */
+class HostConfig
+{
+public:
+    HostConfig(HostInterfaceEntry* interfaces = NULL, size_t maxInterfaces = 0, HostEndpointEntry* endpoints = NULL, size_t maxEndpoints = 0)
+        : interfaces(interfaces), endpoints(endpoints), maxInterfaces(maxInterfaces), maxEndpoints(maxEndpoints) {}
+
+    //! Parses the configuration descriptor, including all nested descriptors up to wTotalLength
+    HostParseError Parse(const void* data, size_t length);
+
+    //! Checks if a configuration was parsed successfully
+    operator bool() const { return data; }
+    //! Gets the configuration descriptor header
+    const ConfigDescriptorHeader* Header() const { return (const ConfigDescriptorHeader*)data; }
+    //! Gets the total length of the configuration
+    size_t Length() const { return length; }
+
+    //! Gets the number of interface descriptors, alternate settings included
+    size_t InterfaceCount() const { return interfaceCount; }
+    //! Gets the index entry of the specified interface
+    const HostInterfaceEntry& InterfaceEntry(size_t interface) const { return interfaces[interface]; }
+    //! Gets the descriptor of the specified interface
+    const InterfaceDescriptorHeader* Interface(size_t interface) const { return At<InterfaceDescriptorHeader>(interfaces[interface].offset); }
+    //! Finds the index of the interface with the specified number and alternate setting, returns -1 if not found
+    int FindInterface(uint8_t number, uint8_t alternate = 0) const;
+
+    //! Gets the total number of endpoint descriptors
+    size_t EndpointCount() const { return endpointCount; }
+    //! Gets the index entry of the specified endpoint
+    const HostEndpointEntry& EndpointEntry(size_t endpoint) const { return endpoints[endpoint]; }
+    //! Gets the endpoint descriptor with the specified index within the interface
+    const EndpointDescriptor* Endpoint(size_t interface, size_t n) const
+    {
+        auto& e = interfaces[interface];
+        return n < e.endpoints ? At<EndpointDescriptor>(endpoints[e.firstEndpoint + n].offset) : NULL;
+    }
+    //! Finds the endpoint descriptor with the specified address, optionally restricted to an interface number and alternate setting (-1 matches any)
+    const EndpointDescriptor* FindEndpoint(uint8_t address, int interface = -1, int alternate = 0) const;
+
+    //! Finds the next descriptor of the specified type belonging to the interface, following @p after if specified
+    const DescriptorHeader* FindDescriptor(size_t interface, DescriptorType type, const DescriptorHeader* after = NULL) const;
+    //! Finds the next class-specific descriptor with the specified type and subtype belonging to the interface
+    const DescriptorHeader* FindClassSpecific(size_t interface, DescriptorType type, DescriptorSubType subType, const DescriptorHeader* after = NULL) const;
+
+    //! Finds the next descriptor of the specified type, returns NULL if it is shorter than @p T
+    template<typename T> const T* Find(size_t interface, DescriptorType type, const DescriptorHeader* after = NULL) const
+    {
+        auto hdr = FindDescriptor(interface, type, after);
+        while (hdr && hdr->bLength < sizeof(T))
+            hdr = FindDescriptor(interface, type, hdr);
+        return (const T*)hdr;
+    }
+
+    //! Finds the next class-specific descriptor with the specified subtype, skipping descriptors shorter than @p T
+    template<typename T> const T* Find(size_t interface, DescriptorType type, DescriptorSubType subType, const DescriptorHeader* after = NULL) const
+    {
+        auto hdr = FindClassSpecific(interface, type, subType, after);
+        while (hdr && hdr->bLength < sizeof(T))
+            hdr = FindClassSpecific(interface, type, subType, hdr);
+        return (const T*)hdr;
+    }
+
+private:
+    const uint8_t* data = NULL;
+    HostInterfaceEntry* interfaces;
+    HostEndpointEntry* endpoints;
+    uint16_t length = 0;
+    uint8_t maxInterfaces, maxEndpoints;
+    uint8_t interfaceCount = 0, endpointCount = 0;
+
+    template<typename T> const T* At(size_t offset) const { return (const T*)(data + offset); }
+};
+
+//! HostConfig with an index of @p interfaceSlots interface alternate settings and @p endpointSlots endpoints
+template<size_t interfaceSlots, size_t endpointSlots> class HostConfigStorage : public HostConfig
+{
+    static_assert(interfaceSlots < 256 && endpointSlots < 256, "Index is limited to 255 entries");
+
+public:
+    HostConfigStorage()
+        : HostConfig(interfaceEntries, interfaceSlots, endpointEntries, endpointSlots) {}
+
+private:
+    HostInterfaceEntry interfaceEntries[interfaceSlots];
+    HostEndpointEntry endpointEntries[endpointSlots];
+};
+
+//! Identification of a cached configuration
+struct HostDeviceKey
+{
+    uint16_t idVendor;      //!< Vendor ID
+    uint16_t idProduct;     //!< Product ID
+    uint16_t bcdDevice;     //!< Device version
+    uint8_t index;          //!< Configuration index
+
+    //! Creates the key of a configuration of the specified device
+    static HostDeviceKey From(const DeviceDescriptor& device, uint8_t index = 0)
+    {
+        return { device.idVendor, device.idProduct, device.bcdDevice, index };
+    }
+
+    bool operator ==(const HostDeviceKey& other) const
+    {
+        return idVendor == other.idVendor && idProduct == other.idProduct && bcdDevice == other.bcdDevice && index == other.index;
+    }
+};
+
+//! Cache of parsed configurations of known devices
+/*!
+ * When a device is attached again, its DeviceDescriptor (which is always read) is enough
+ * to find the configuration parsed during a previous enumeration, so the host can skip
+ * both GET_DESCRIPTOR(Config) requests and the parsing. The configuration is copied into
+ * the cache, so the original buffer can be reused. When the cache is full, the least
+ * recently used entry is replaced.
+ *
+ * A new configuration is parsed into a spare entry, which replaces the selected one only
+ * if the parsing succeeds, so storing an invalid configuration never evicts a valid one.
+ *
+ * Devices reporting the same VID, PID and bcdDevice are assumed to have the same descriptors,
+ * a device known to violate that should be removed using Remove() before it is enumerated.
+ */
+class HostConfigCache
+{
+public:
+    //! Single cached configuration
+    struct Entry
+    {
+        HostDeviceKey key;  //!< Identification of the configuration
+        uint32_t used;      //!< Time of the last use, for replacement
+        bool valid;         //!< Entry holds a parsed configuration
+        uint8_t* data;      //!< Copy of the configuration
+        HostConfig config;  //!< Configuration parsed from the copy
+    };
+
+    //! Creates the cache with @p count entries and a spare one following them, holding configurations up to @p maxLength bytes, use HostConfigCacheStorage to allocate them
+    HostConfigCache(Entry* entries, size_t count, size_t maxLength)
+        : entries(entries), count(count), maxLength(maxLength) {}
+
+    //! Finds the cached configuration of the specified device, returns NULL if the configuration is not known
+    const HostConfig* Find(const DeviceDescriptor& device, uint8_t index = 0);
+    //! Copies and parses the configuration of the specified device, returns NULL if it could not be parsed
+    const HostConfig* Store(const DeviceDescriptor& device, uint8_t index, const void* config, size_t length, HostParseError* error = NULL);
+    //! Removes all cached configurations of the specified device
+    void Remove(const DeviceDescriptor& device);
+    //! Removes all cached configurations
+    void Clear();
+
+private:
+    Entry* entries;
+    size_t count;
+    size_t maxLength;
+    uint32_t time = 0;
+};
+
+//! HostConfigCache with @p n entries, each holding a configuration of up to @p configBytes bytes
+//! with up to @p interfaceSlots interface alternate settings and @p endpointSlots endpoints
+template<size_t n, size_t configBytes = 512, size_t interfaceSlots = 16, size_t endpointSlots = 32> class HostConfigCacheStorage : public HostConfigCache
+{
+    static_assert(configBytes <= 0xFFFF && interfaceSlots < 256 && endpointSlots < 256, "Unsupported cache entry size");
+
+public:
+    HostConfigCacheStorage()
+        : HostConfigCache(cacheEntries, n, configBytes)
+    {
+        for (size_t i = 0; i <= n; i++)
+        {
+            cacheEntries[i].valid = false;
+            cacheEntries[i].data = configData[i];
+            cacheEntries[i].config = HostConfig(interfaceEntries[i], interfaceSlots, endpointEntries[i], endpointSlots);
+        }
+    }
+
+private:
+    // the last entry is the spare used for parsing
+    Entry cacheEntries[n + 1];
+    uint8_t configData[n + 1][configBytes];
+    HostInterfaceEntry interfaceEntries[n + 1][interfaceSlots];
+    HostEndpointEntry endpointEntries[n + 1][endpointSlots];
+};
+
+}
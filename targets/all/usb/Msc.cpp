@@ -0,0 +1,599 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Msc.cpp
+ */
+
+#include <usb/Msc.h>
+
+namespace usb
+{
+
+namespace
+{
+
+enum : uint32_t
+{
+    CbwSignature = 0x43425355,  // "USBC"
+    CswSignature = 0x53425355,  // "USBS"
+};
+
+enum
+{
+    CswPassed = 0,
+    CswFailed = 1,
+    CswPhaseError = 2,
+};
+
+enum
+{
+    ScsiTestUnitReady = 0x00,
+    ScsiRequestSense = 0x03,
+    ScsiInquiry = 0x12,
+    ScsiModeSense6 = 0x1A,
+    ScsiStartStopUnit = 0x1B,
+    ScsiPreventAllowMediumRemoval = 0x1E,
+    ScsiReadFormatCapacities = 0x23,
+    ScsiReadCapacity10 = 0x25,
+    ScsiRead10 = 0x28,
+    ScsiWrite10 = 0x2A,
+    ScsiVerify10 = 0x2F,
+    ScsiSynchronizeCache10 = 0x35,
+    ScsiModeSense10 = 0x5A,
+};
+
+enum
+{
+    SenseNotReady = 0x02,
+    SenseMediumError = 0x03,
+    SenseIllegalRequest = 0x05,
+    SenseDataProtect = 0x07,
+};
+
+enum
+{
+    AscWriteError = 0x0C,
+    AscUnrecoveredReadError = 0x11,
+    AscInvalidCommand = 0x20,
+    AscLbaOutOfRange = 0x21,
+    AscInvalidFieldInCdb = 0x24,
+    AscWriteProtected = 0x27,
+    AscMediumNotPresent = 0x3A,
+};
+
+// CBW field offsets
+enum
+{
+    CbwSignatureOffset = 0,
+    CbwTagOffset = 4,
+    CbwDataLengthOffset = 8,
+    CbwFlagsOffset = 12,
+    CbwLunOffset = 13,
+    CbwCbLengthOffset = 14,
+    CbwCbOffset = 15,
+};
+
+uint32_t GetLe32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24; }
+void PutLe32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+uint32_t GetBe32(const uint8_t* p) { return uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+uint16_t GetBe16(const uint8_t* p) { return p[0] << 8 | p[1]; }
+void PutBe32(uint8_t* p, uint32_t v) { p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v; }
+
+void PutPadded(uint8_t* p, const char* s, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+        p[i] = *s ? *s++ : ' ';
+}
+
+}
+
+MscBot::MscBot(BlockDevice* const* luns, uint8_t lunCount, void* buffer, size_t bufferSize, const char* vendor, const char* product, const char* revision)
+    : luns(luns), vendor(vendor), product(product), revision(revision), halfSize(bufferSize / 2), lunCount(lunCount), maxLun(lunCount - 1),
+    stage(Stage::Command), xfer(0)
+{
+    halves[0].data = (uint8_t*)buffer;
+    halves[1].data = (uint8_t*)buffer + halfSize;
+    halves[0].state = halves[1].state = Buffer::Free;
+    halves[0].deferred = halves[1].deferred = false;
+    deferredError = false;
+    sense[0] = sense[1] = sense[2] = 0;
+    Reset();
+}
+
+ControlResult MscBot::HandleRequest(const SetupPacket& setup, ControlStage)
+{
+    switch (setup.bRequest)
+    {
+        case SetupPacket::ClassMscBOMReset:
+            if (setup.direction != SetupPacket::DirOut || setup.wValue || setup.wLength)
+                break;
+            Reset();
+            return ControlResult::Ack();
+
+        case SetupPacket::ClassMscGetMaxLun:
+            if (setup.direction != SetupPacket::DirIn || setup.wValue || setup.wLength != 1)
+                break;
+            return ControlResult::In(&maxLun, 1);
+
+        default:
+            return ControlResult::Unhandled();
+    }
+
+    return ControlResult::Stall();
+}
+
+void MscBot::Reset()
+{
+    Flush();
+    halves[0].state = halves[1].state = Buffer::Free;
+    stage = Stage::Command;
+    haltIn = haltOut = false;
+    xfer = 0;
+    remaining = mediaRemaining = 0;
+    response = NULL;
+}
+
+void MscBot::ClearHalt(bool in)
+{
+    if (stage == Stage::Error)
+        return;
+
+    if (in)
+        haltIn = false;
+    else
+        haltOut = false;
+}
+
+MscTransfer MscBot::NextOut()
+{
+    if (stage == Stage::Command)
+        return { cbw, sizeof(cbw) };
+
+    if (stage != Stage::DataOut)
+        return { NULL, 0 };
+
+    Half& h = halves[xfer];
+    if (h.state == Buffer::Dirty)
+        WriteBehind(h);     // no overlap possible, the other half is still being written
+
+    uint32_t bs = luns[lun]->BlockSize();
+    uint32_t chunk = halfSize / bs * bs;
+    h.lun = lun;
+    h.block = mediaBlock;
+    h.length = remaining < chunk ? remaining : chunk;
+    h.deferred = false;
+    h.state = Buffer::Busy;
+    return { h.data, h.length };
+}
+
+void MscBot::OutReceived(size_t length)
+{
+    if (stage == Stage::Command)
+    {
+        ProcessCommand(length);
+        return;
+    }
+
+    if (stage != Stage::DataOut)
+        return;
+
+    Half& h = halves[xfer];
+    if (h.state != Buffer::Busy)
+        return;
+
+    bool shortPacket = length < h.length;
+    if (length > h.length)
+        length = h.length;
+
+    uint32_t bs = luns[lun]->BlockSize();
+    uint32_t blocks = length / bs;
+    h.length = blocks * bs;
+    h.state = blocks ? Buffer::Dirty : Buffer::Free;
+    xfer ^= 1;
+
+    mediaBlock += blocks;
+    remaining -= length;
+    residue -= length;
+
+    if (shortPacket || length % bs)
+    {
+        // the host sent less data than announced in the CBW
+        status = CswPhaseError;
+        Complete();
+    }
+    else if (!remaining)
+    {
+        Complete();
+    }
+}
+
+MscTransfer MscBot::NextIn()
+{
+    if (stage == Stage::DataIn)
+    {
+        if (response)
+            return { (void*)response, remaining };
+
+        Half& h = halves[xfer];
+        if (h.state != Buffer::Filled && !(mediaRemaining && ReadAhead(h)))
+        {
+            // read error, terminate the data phase
+            Complete();
+            return { NULL, 0 };
+        }
+
+        h.state = Buffer::Busy;
+        return { h.data, h.length };
+    }
+
+    if (stage == Stage::Status && !haltIn)
+    {
+        PutLe32(csw, CswSignature);
+        PutLe32(csw + 4, tag);
+        PutLe32(csw + 8, residue);
+        csw[12] = status;
+        // failures of the remaining writes can now be reported only with the next command
+        for (auto& h: halves)
+            h.deferred = true;
+        return { csw, sizeof(csw) };
+    }
+
+    return { NULL, 0 };
+}
+
+void MscBot::InSent()
+{
+    if (stage == Stage::Status)
+    {
+        stage = Stage::Command;
+        return;
+    }
+
+    if (stage != Stage::DataIn)
+        return;
+
+    if (response)
+    {
+        residue -= remaining;
+        remaining = 0;
+        response = NULL;
+        Complete();
+        return;
+    }
+
+    Half& h = halves[xfer];
+    if (h.state != Buffer::Busy)
+        return;
+
+    h.state = Buffer::Free;
+    xfer ^= 1;
+    remaining -= h.length;
+    residue -= h.length;
+    if (!remaining)
+        Complete();
+}
+
+bool MscBot::Poll()
+{
+    // older data is always in the half to be transferred next
+    for (unsigned i = 0; i < 2; i++)
+    {
+        Half& h = halves[xfer ^ i];
+        if (h.state == Buffer::Dirty)
+        {
+            WriteBehind(h);
+            return true;
+        }
+    }
+
+    if (stage == Stage::DataIn && !response && mediaRemaining)
+    {
+        for (unsigned i = 0; i < 2; i++)
+        {
+            Half& h = halves[xfer ^ i];
+            if (h.state == Buffer::Free)
+            {
+                ReadAhead(h);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool MscBot::Flush()
+{
+    bool res = true;
+    for (unsigned i = 0; i < 2; i++)
+    {
+        Half& h = halves[xfer ^ i];
+        if (h.state == Buffer::Dirty && !WriteBehind(h))
+            res = false;
+    }
+    return res;
+}
+
+bool MscBot::ReadAhead(Half& h)
+{
+    uint32_t bs = luns[lun]->BlockSize();
+    uint32_t chunk = halfSize / bs * bs;
+    uint32_t len = mediaRemaining < chunk ? mediaRemaining : chunk;
+
+    if (!len || !luns[lun]->Read(mediaBlock, h.data, len / bs))
+    {
+        // the data phase is terminated when the failed half is about to be sent
+        mediaRemaining = 0;
+        Fail(SenseMediumError, AscUnrecoveredReadError);
+        return false;
+    }
+
+    h.lun = lun;
+    h.block = mediaBlock;
+    h.length = len;
+    h.state = Buffer::Filled;
+    mediaBlock += len / bs;
+    mediaRemaining -= len;
+    return true;
+}
+
+bool MscBot::WriteBehind(Half& h)
+{
+    auto dev = luns[h.lun];
+    h.state = Buffer::Free;
+    if (dev->Write(h.block, h.data, h.length / dev->BlockSize()))
+        return true;
+
+    if (h.deferred)
+    {
+        deferredError = true;
+        sense[0] = SenseMediumError;
+        sense[1] = AscWriteError;
+        sense[2] = 0;
+    }
+    else
+    {
+        Fail(SenseMediumError, AscWriteError);
+    }
+    return false;
+}
+
+void MscBot::Fail(uint8_t key, uint8_t asc, uint8_t ascq)
+{
+    status = CswFailed;
+    sense[0] = key;
+    sense[1] = asc;
+    sense[2] = ascq;
+}
+
+void MscBot::Complete()
+{
+    // the host expects more data, the endpoint must be halted to terminate the data phase
+    if (residue)
+    {
+        if (cbw[CbwFlagsOffset] & 0x80)
+            haltIn = true;
+        else
+            haltOut = true;
+    }
+
+    remaining = 0;
+    response = NULL;
+    stage = Stage::Status;
+}
+
+void MscBot::ProcessCommand(size_t length)
+{
+    if (length != sizeof(cbw) || GetLe32(cbw + CbwSignatureOffset) != CbwSignature ||
+        cbw[CbwLunOffset] >= lunCount || !cbw[CbwCbLengthOffset] || cbw[CbwCbLengthOffset] > 16)
+    {
+        stage = Stage::Error;
+        haltIn = haltOut = true;
+        return;
+    }
+
+    tag = GetLe32(cbw + CbwTagOffset);
+    residue = GetLe32(cbw + CbwDataLengthOffset);
+    lun = cbw[CbwLunOffset];
+    status = CswPassed;
+    remaining = mediaRemaining = 0;
+    response = NULL;
+
+    const uint8_t* cdb = cbw + CbwCbOffset;
+
+    // blocks written behind must reach the medium before they can be read back,
+    // only consecutive writes keep the pipeline going
+    if (cdb[0] != ScsiWrite10)
+        Flush();
+
+    if (deferredError && cdb[0] != ScsiRequestSense && cdb[0] != ScsiInquiry)
+    {
+        deferredError = false;
+        status = CswFailed;
+        Complete();
+        return;
+    }
+
+    Execute(cdb);
+}
+
+void MscBot::Execute(const uint8_t* cdb)
+{
+    auto dev = luns[lun];
+    uint8_t* buf = responseBuffer;
+
+    switch (cdb[0])
+    {
+        case ScsiTestUnitReady:
+            if (!dev->Ready())
+                Fail(SenseNotReady, AscMediumNotPresent);
+            break;
+
+        case ScsiRequestSense:
+            memset(buf, 0, 18);
+            buf[0] = 0x70;
+            buf[2] = sense[0];
+            buf[7] = 10;
+            buf[12] = sense[1];
+            buf[13] = sense[2];
+            sense[0] = sense[1] = sense[2] = 0;
+            deferredError = false;
+            return Respond(buf, 18, cdb[4]);
+
+        case ScsiInquiry:
+            if (cdb[1] & 1)
+            {
+                // vital product data pages are not supported
+                Fail(SenseIllegalRequest, AscInvalidFieldInCdb);
+                break;
+            }
+            buf[0] = 0x00;      // direct access block device
+            buf[1] = 0x80;      // removable medium
+            buf[2] = 0x04;      // SPC-2
+            buf[3] = 0x02;      // response data format
+            buf[4] = 36 - 5;    // additional length
+            buf[5] = buf[6] = buf[7] = 0;
+            PutPadded(buf + 8, vendor, 8);
+            PutPadded(buf + 16, product, 16);
+            PutPadded(buf + 32, revision, 4);
+            return Respond(buf, 36, GetBe16(cdb + 3));
+
+        case ScsiModeSense6:
+            buf[0] = 3;
+            buf[1] = 0;
+            buf[2] = dev->ReadOnly() ? 0x80 : 0;
+            buf[3] = 0;
+            return Respond(buf, 4, cdb[4]);
+
+        case ScsiModeSense10:
+            memset(buf, 0, 8);
+            buf[1] = 6;
+            buf[3] = dev->ReadOnly() ? 0x80 : 0;
+            return Respond(buf, 8, GetBe16(cdb + 7));
+
+        case ScsiStartStopUnit:
+        case ScsiPreventAllowMediumRemoval:
+            break;
+
+        case ScsiReadFormatCapacities:
+            if (!dev->Ready())
+            {
+                Fail(SenseNotReady, AscMediumNotPresent);
+                break;
+            }
+            memset(buf, 0, 12);
+            buf[3] = 8;
+            PutBe32(buf + 4, dev->BlockCount());
+            PutBe32(buf + 8, dev->BlockSize());
+            buf[8] = 0x02;      // formatted media
+            return Respond(buf, 12, GetBe16(cdb + 7));
+
+        case ScsiReadCapacity10:
+            // the last LBA of an empty medium cannot be reported
+            if (!dev->Ready() || !dev->BlockCount())
+            {
+                Fail(SenseNotReady, AscMediumNotPresent);
+                break;
+            }
+            PutBe32(buf, dev->BlockCount() - 1);
+            PutBe32(buf + 4, dev->BlockSize());
+            return Respond(buf, 8, 8);
+
+        case ScsiRead10:
+        case ScsiWrite10:
+        case ScsiVerify10:
+        {
+            uint32_t block = GetBe32(cdb + 2);
+            uint32_t count = GetBe16(cdb + 7);
+            if (!dev->Ready())
+            {
+                Fail(SenseNotReady, AscMediumNotPresent);
+                break;
+            }
+            if (block > dev->BlockCount() || count > dev->BlockCount() - block)
+            {
+                Fail(SenseIllegalRequest, AscLbaOutOfRange);
+                break;
+            }
+            if (cdb[0] == ScsiVerify10)
+                break;      // without BYTCHK, verification of readable blocks always succeeds
+            if (cdb[0] == ScsiWrite10 && dev->ReadOnly())
+            {
+                Fail(SenseDataProtect, AscWriteProtected);
+                break;
+            }
+
+            mediaBlock = block;
+            if (cdb[0] == ScsiRead10)
+                BeginIn(count * dev->BlockSize(), true);
+            else
+                BeginOut(count * dev->BlockSize());
+            return;
+        }
+
+        case ScsiSynchronizeCache10:
+            // blocks written behind have already been flushed before executing the command
+            if (!dev->Flush())
+                Fail(SenseMediumError, AscWriteError);
+            break;
+
+        default:
+            Fail(SenseIllegalRequest, AscInvalidCommand);
+            break;
+    }
+
+    Complete();
+}
+
+void MscBot::Respond(const void* data, size_t length, size_t allocation)
+{
+    if (length > allocation)
+        length = allocation;
+    response = (const uint8_t*)data;
+    BeginIn(length, false);
+}
+
+void MscBot::BeginIn(uint32_t length, bool medium)
+{
+    bool hostIn = cbw[CbwFlagsOffset] & 0x80;
+
+    if (length && (!hostIn || residue < (medium ? length : 1)))
+    {
+        // the host does not expect the data, or cannot accept all of it
+        status = CswPhaseError;
+        Complete();
+        return;
+    }
+
+    // non-medium responses are simply truncated to the length expected by the host
+    remaining = length < residue ? length : residue;
+    if (medium)
+        mediaRemaining = remaining;
+
+    if (remaining)
+        stage = Stage::DataIn;
+    else
+        Complete();
+}
+
+void MscBot::BeginOut(uint32_t length)
+{
+    bool hostIn = cbw[CbwFlagsOffset] & 0x80;
+
+    if (length && (hostIn || residue < length))
+    {
+        status = CswPhaseError;
+        Complete();
+        return;
+    }
+
+    remaining = length;
+    if (remaining)
+        stage = Stage::DataOut;
+    else
+        Complete();
+}
+
+}
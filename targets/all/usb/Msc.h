@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Msc.h
+ *
+ * Mass Storage Bulk-Only Transport with a SCSI transparent command set subset
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Creates the interface of a Mass Storage Bulk-Only Transport function
+constexpr auto MscDescriptors(uint8_t interface, uint8_t endpoint, uint16_t maxPacketSize, uint8_t strName = 0)
+{
+    return InterfaceDescriptor(interface, 0, InterfaceClass::MassStorage, SubClass::MscScsi, Protocol::MscBulkOnly, strName,
+        EndpointDescriptor::BulkIn(endpoint, maxPacketSize),
+        EndpointDescriptor::BulkOut(endpoint, maxPacketSize));
+}
+
+//! Block device backing a logical unit of a MscBot
+class BlockDevice
+{
+public:
+    //! Gets the size of a block in bytes
+    virtual uint32_t BlockSize() = 0;
+    //! Gets the number of blocks of the medium
+    virtual uint32_t BlockCount() = 0;
+    //! Checks if a medium is present and ready
+    virtual bool Ready() { return true; }
+    //! Checks if the medium is write-protected
+    virtual bool ReadOnly() { return false; }
+
+    //! Reads @p count consecutive blocks starting at @p block
+    virtual bool Read(uint32_t block, void* buffer, uint32_t count) = 0;
+    //! Writes @p count consecutive blocks starting at @p block
+    virtual bool Write(uint32_t block, const void* buffer, uint32_t count) = 0;
+    //! Commits any data cached by the device to the medium
+    virtual bool Flush() { return true; }
+};
+
+//! Single bulk transfer requested by a MscBot
+struct MscTransfer
+{
+    void* data;         //!< Data to be sent, or the destination of received data, NULL if there is no transfer to perform
+    uint32_t length;    //!< Length of the transfer
+};
+
+//! Mass Storage Bulk-Only Transport engine
+/*!
+ * The engine is driven by the bulk endpoint events and requests transfers directly
+ * to and from a data buffer split into two halves. While one half is being transferred
+ * over USB, Poll() accesses the medium using the other one - blocks following the current
+ * transfer are read ahead, and received blocks are written behind, possibly even after the CSW
+ * has been sent. Blocks written behind are always committed before any other command than WRITE(10)
+ * is processed, and SYNCHRONIZE CACHE(10) additionally flushes the BlockDevice. A failure
+ * of a write-behind is reported as a deferred error in response to the next command.
+ *
+ * The expected use is:
+ *   - start the transfer returned by NextOut() or NextIn() (depending on the CurrentStage)
+ *   - call Poll() while it is in progress
+ *   - call OutReceived() or InSent() when it completes
+ *   - stall the endpoints indicated by InHalted() and OutHalted()
+ */
+class MscBot
+{
+public:
+    enum struct Stage : uint8_t
+    {
+        Command,    //!< Waiting for a CBW, received using NextOut()
+        DataIn,     //!< IN data phase in progress, transfers are obtained using NextIn()
+        DataOut,    //!< OUT data phase in progress, transfers are obtained using NextOut()
+        Status,     //!< CSW is to be sent using NextIn(), once the IN endpoint is no longer halted
+        Error,      //!< Invalid CBW received, both endpoints remain halted until Reset()
+    };
+
+    //! Creates the engine for the specified logical units
+    /*!
+     * @p buffer is split into two halves, each of which must be a multiple of the block size
+     * of all the devices and of the bulk endpoint max packet size. @p vendor, @p product
+     * and @p revision are reported in the INQUIRY response.
+     */
+    MscBot(BlockDevice* const* luns, uint8_t lunCount, void* buffer, size_t bufferSize,
+        const char* vendor = "MinuteOS", const char* product = "Mass Storage", const char* revision = "1.0");
+
+    //! Handles the Mass Storage class-specific requests
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+    //! Performs the Bulk-Only Mass Storage Reset, blocks written behind are committed first
+    void Reset();
+
+    //! Gets the current stage of the engine
+    Stage CurrentStage() const { return stage; }
+    //! Checks if the bulk IN endpoint must be halted
+    bool InHalted() const { return haltIn; }
+    //! Checks if the bulk OUT endpoint must be halted
+    bool OutHalted() const { return haltOut; }
+    //! Notifies the engine that the host cleared the halt feature of an endpoint
+    /*!
+     * The halts requested after an invalid CBW persist until Reset(), as required by the specification
+     */
+    void ClearHalt(bool in);
+
+    //! Gets the next OUT transfer (a CBW or write data)
+    MscTransfer NextOut();
+    //! Completes the OUT transfer returned by NextOut()
+    void OutReceived(size_t length);
+    //! Gets the next IN transfer (read data, a command response or a CSW)
+    /*!
+     * No transfer is returned when the data phase has been terminated early (e.g. by a read error)
+     * or the CSW is blocked by the IN endpoint being halted
+     */
+    MscTransfer NextIn();
+    //! Completes the IN transfer returned by NextIn()
+    void InSent();
+
+    //! Performs pending medium access - read-ahead or write-behind - using the buffer not currently being transferred
+    /*!
+     * @returns true if any work was done
+     */
+    bool Poll();
+    //! Commits all blocks written behind, returns false if any of them failed
+    bool Flush();
+
+private:
+    enum struct Buffer : uint8_t
+    {
+        Free,       //!< Buffer contains no useful data
+        Filled,     //!< Buffer contains blocks read ahead, not yet sent
+        Busy,       //!< Buffer is being transferred over USB
+        Dirty,      //!< Buffer contains received blocks, not yet written
+    };
+
+    struct Half
+    {
+        uint8_t* data;
+        uint32_t block;
+        uint32_t length;
+        uint8_t lun;
+        Buffer state;
+        bool deferred;          // CSW of the command that received the data has been sent
+    };
+
+    BlockDevice* const* luns;
+    const char* vendor;
+    const char* product;
+    const char* revision;
+    Half halves[2];
+    uint32_t halfSize;
+    uint8_t lunCount;
+    uint8_t maxLun;
+
+    Stage stage;
+    bool haltIn, haltOut;
+    bool deferredError;
+    uint8_t xfer;               // half to be transferred next
+    uint8_t lun;                // LUN of the current command
+    uint8_t status;             // status to be reported in the CSW
+    uint8_t sense[3];           // sense key, ASC, ASCQ
+
+    uint32_t tag;               // tag of the current command
+    uint32_t residue;           // data expected by the host and not yet transferred
+    uint32_t remaining;         // data to be transferred by the device
+    uint32_t mediaBlock;        // next block to be read or written
+    uint32_t mediaRemaining;    // bytes of the medium not yet read
+    const uint8_t* response;    // response of a non-medium command
+
+    uint8_t cbw[31];
+    uint8_t csw[13];
+    uint8_t responseBuffer[36];
+
+    void ProcessCommand(size_t length);
+    void Execute(const uint8_t* cdb);
+    void Respond(const void* data, size_t length, size_t allocation);
+    void BeginIn(uint32_t length, bool medium);
+    void BeginOut(uint32_t length);
+    void Fail(uint8_t key, uint8_t asc, uint8_t ascq = 0);
+    void Complete();
+    bool ReadAhead(Half& h);
+    bool WriteBehind(Half& h);
+};
+
+//! Class-specific request handlers for a MscBot function, for use with a SetupDispatcher
+/*!
+ * @p msc is the member of @p TContext holding the function state, @p interface is the number of its interface
+ */
+template<typename TContext, MscBot TContext::*msc, uint8_t interface> struct MscRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*msc).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassMscBOMReset, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassMscGetMaxLun, Handle, interface),
+    };
+};
+
+}
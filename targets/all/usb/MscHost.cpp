@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/MscHost.cpp
+ */
+
+#include <usb/MscHost.h>
+#include <usb/Benchmark.h>
+
+namespace usb
+{
+
+namespace
+{
+
+enum : uint32_t
+{
+    CbwSignature = 0x43425355,  // "USBC"
+    CswSignature = 0x53425355,  // "USBS"
+};
+
+enum
+{
+    ScsiReadCapacity10 = 0x25,
+    ScsiRead10 = 0x28,
+    ScsiWrite10 = 0x2A,
+};
+
+uint32_t GetLe32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24; }
+void PutLe32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+uint32_t GetBe32(const uint8_t* p) { return uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+void PutBe32(uint8_t* p, uint32_t v) { p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v; }
+
+// every block gets a different pattern, so blocks written to or read from a wrong address are detected as well
+uint8_t Pattern(uint32_t block, uint32_t offset) { return uint8_t(block * 7 + offset + (offset >> 8)); }
+
+}
+
+bool MscRunner::Attach(const HostConfig& config, uint8_t interface)
+{
+    in = out = 0;
+
+    int index = config.FindInterface(interface, 0);
+    if (index < 0)
+        return false;
+
+    auto ifd = config.Interface(index);
+    if (ifd->bInterfaceClass != InterfaceClass::MassStorage || ifd->bInterfaceProtocol != Protocol::MscBulkOnly)
+        return false;
+
+    for (size_t n = 0; auto epd = config.Endpoint(index, n); n++)
+    {
+        if (epd->Type() == EndpointType::Bulk)
+            (epd->bEndpointAddress & 0x80 ? in : out) = epd->bEndpointAddress;
+    }
+
+    return in && out;
+}
+
+bool MscRunner::Command(const uint8_t (&cdb)[10], bool dataIn, void* data, uint32_t length)
+{
+    uint8_t cbw[31] = {}, csw[13];
+    PutLe32(cbw, CbwSignature);
+    PutLe32(cbw + 4, ++tag);
+    PutLe32(cbw + 8, length);
+    cbw[12] = dataIn ? 0x80 : 0;
+    cbw[14] = sizeof(cdb);
+    memcpy(cbw + 15, cdb, sizeof(cdb));
+
+    return Transfer(out, cbw, sizeof(cbw)) == sizeof(cbw) &&
+        (!length || Transfer(dataIn ? in : out, data, length) == int(length)) &&
+        Transfer(in, csw, sizeof(csw)) == sizeof(csw) &&
+        GetLe32(csw) == CswSignature && GetLe32(csw + 4) == tag && !GetLe32(csw + 8) && !csw[12];
+}
+
+MscRunResult MscRunner::Run(bool write, uint32_t block, uint16_t blocks, uint32_t count)
+{
+    MscRunResult res = {};
+
+    uint8_t capacity[8] = {};
+    const uint8_t readCapacity[10] = { ScsiReadCapacity10 };
+    if (in && out && Command(readCapacity, true, capacity, sizeof(capacity)))
+        res.blockSize = GetBe32(capacity + 4);
+
+    // the last LBA is reported, the commands must fit within the medium
+    uint32_t lastBlock = GetBe32(capacity);
+    res.length = blocks * res.blockSize;
+    if (!res.blockSize || !blocks || res.length > bufferSize || block > lastBlock || uint64_t(blocks) * count > lastBlock - block + 1ull)
+    {
+        res.failures = count;
+        return res;
+    }
+
+    uint64_t start = Nanoseconds();
+    for (uint32_t i = 0; i < count; i++, block += blocks)
+    {
+        uint8_t cdb[10] = { uint8_t(write ? ScsiWrite10 : ScsiRead10) };
+        PutBe32(cdb + 2, block);
+        cdb[7] = blocks >> 8;
+        cdb[8] = blocks;
+
+        if (write)
+        {
+            for (uint32_t b = 0; b < blocks; b++)
+                for (uint32_t j = 0; j < res.blockSize; j++)
+                    buffer[b * res.blockSize + j] = Pattern(block + b, j);
+        }
+
+        if (!Command(cdb, !write, buffer, res.length))
+        {
+            // the state of the transport is unknown without a reset recovery, the remaining commands are not issued
+            res.failures = count - i;
+            break;
+        }
+
+        res.commands++;
+        res.bytes += res.length;
+
+        if (!write)
+        {
+            for (uint32_t b = 0; b < blocks; b++)
+            {
+                for (uint32_t j = 0; j < res.blockSize; j++)
+                {
+                    if (buffer[b * res.blockSize + j] != Pattern(block + b, j))
+                    {
+                        res.errors++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    res.time = Nanoseconds() - start;
+    return res;
+}
+
+size_t MscRunner::Format(char* buffer, size_t size, const char* name, const MscRunResult& result)
+{
+    return JsonWriter(buffer, size)
+        .String("name", name)
+        .Number("bytes", result.bytes)
+        .Fixed("mb_per_s", result.BytesPerSecond() / 1000)
+        .Number("commands", result.commands)
+        .Number("failures", result.failures)
+        .Number("errors", result.errors)
+        .Number("command_bytes", result.length)
+        .Number("block_size", result.blockSize)
+        .Finish();
+}
+
+}
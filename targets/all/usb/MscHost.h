@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/MscHost.h
+ *
+ * Host-side runner of the Mass Storage Bulk-Only Transport throughput tests
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/HostParser.h>
+#include <usb/VirtualHost.h>
+
+namespace usb
+{
+
+//! Results of a single test run performed by MscRunner
+struct MscRunResult
+{
+    uint64_t time;          //!< Host-side duration of the run in nanoseconds, including the CBW and CSW of every command
+    uint64_t bytes;         //!< Data bytes transferred in the data phases
+    uint32_t commands;      //!< Commands completed with a passed CSW and no residue
+    uint32_t failures;      //!< Commands that failed in any phase, or were not issued because the run stopped at an earlier failure
+    uint32_t errors;        //!< Blocks read that did not match the pattern written by MscRunner::Write
+    uint32_t length;        //!< Data length of every command
+    uint32_t blockSize;     //!< Block size reported by READ CAPACITY(10), zero if the command failed
+
+    //! Gets the throughput of the run
+    uint64_t BytesPerSecond() const { return time ? bytes * 1000000000ull / time : 0; }
+};
+
+//! Measures the sequential READ(10) and WRITE(10) throughput of a Bulk-Only Transport device from the host
+/*!
+ * Each run reads the capacity of LUN 0 using READ CAPACITY(10), then issues the requested number
+ * of commands, each consisting of the CBW, the data phase and the CSW, on consecutive ranges
+ * of blocks. Write fills every block with a pattern derived from its address, so a following
+ * Read of the same blocks verifies the data.
+ *
+ * The bus access is provided by a derived class, VirtualMscRunner drives an in-process
+ * VirtualHost, so the tests can run without hardware.
+ */
+class MscRunner
+{
+public:
+    //! Creates the runner using @p buffer of @p bufferSize bytes for the data of a single command
+    MscRunner(uint8_t* buffer, size_t bufferSize)
+        : buffer(buffer), bufferSize(bufferSize) {}
+
+    //! Locates the bulk endpoints of the Bulk-Only Transport interface with the specified number in a parsed configuration
+    bool Attach(const HostConfig& config, uint8_t interface);
+
+    //! Measures @p count READ(10) commands of @p blocks blocks each, starting at @p block
+    MscRunResult Read(uint32_t block, uint16_t blocks, uint32_t count) { return Run(false, block, blocks, count); }
+    //! Measures @p count WRITE(10) commands of @p blocks blocks each, starting at @p block
+    MscRunResult Write(uint32_t block, uint16_t blocks, uint32_t count) { return Run(true, block, blocks, count); }
+
+    //! Formats the result as a single line of JSON, returns the length of the output (excluding the null terminator)
+    /*!
+     * Throughput is reported as mb_per_s in MB/s (10^6 bytes per second) with three decimals
+     */
+    static size_t Format(char* buffer, size_t size, const char* name, const MscRunResult& result);
+
+protected:
+    //! Performs a transfer on a non-control endpoint, returns the number of bytes transferred or -1 on failure
+    virtual int Transfer(uint8_t address, void* data, size_t length) = 0;
+    //! Gets the current time in nanoseconds from a monotonic clock
+    virtual uint64_t Nanoseconds() = 0;
+
+private:
+    uint8_t* buffer;
+    size_t bufferSize;
+    uint8_t in = 0, out = 0;
+    uint32_t tag = 0;
+
+    MscRunResult Run(bool write, uint32_t block, uint16_t blocks, uint32_t count);
+    bool Command(const uint8_t (&cdb)[10], bool dataIn, void* data, uint32_t length);
+};
+
+//! MscRunner performing the tests on a VirtualHost, timed by the simulated bus time
+class VirtualMscRunner : public MscRunner
+{
+public:
+    //! Creates the runner, @p timeout limits every transfer to the specified number of (micro)frames
+    VirtualMscRunner(VirtualHost& host, uint8_t* buffer, size_t bufferSize, uint32_t timeout = 1000)
+        : MscRunner(buffer, bufferSize), host(host), timeout(timeout) {}
+
+protected:
+    int Transfer(uint8_t address, void* data, size_t length) override { return host.Transfer(address, data, length, false, timeout); }
+    uint64_t Nanoseconds() override { return host.Now(); }
+
+private:
+    VirtualHost& host;
+    uint32_t timeout;
+};
+
+}
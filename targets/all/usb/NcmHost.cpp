@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/NcmHost.cpp
+ */
+
+#include <usb/NcmHost.h>
+#include <usb/Benchmark.h>
+
+namespace usb
+{
+
+namespace
+{
+
+// every datagram gets a different pattern, so reordered or duplicated datagrams are detected as well
+uint8_t Pattern(uint32_t datagram, size_t offset) { return uint8_t(datagram * 13 + offset); }
+
+}
+
+bool NcmRunner::Attach(const HostConfig& config, uint8_t interface)
+{
+    this->interface = interface;
+    in = out = 0;
+
+    int index = config.FindInterface(interface, 0);
+    if (index < 0 || config.Interface(index)->bInterfaceClass != InterfaceClass::Cdc || config.Interface(index)->bInterfaceSubClass != SubClass::CdcNcm)
+        return false;
+
+    // the data endpoints are only present in alternate setting 1 of the data interface
+    index = config.FindInterface(interface + 1, 1);
+    if (index < 0)
+        return false;
+
+    for (size_t n = 0; auto epd = config.Endpoint(index, n); n++)
+    {
+        if (epd->Type() == EndpointType::Bulk)
+            (epd->bEndpointAddress & 0x80 ? in : out) = epd->bEndpointAddress;
+    }
+
+    return in && out;
+}
+
+bool NcmRunner::SetInterface(uint8_t alternate)
+{
+    return Control(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdSetInterface,
+        alternate, interface + 1, NULL, 0) >= 0;
+}
+
+NcmRunResult NcmRunner::Loopback(uint16_t length, uint32_t count)
+{
+    NcmRunResult res = {};
+    NtbParameters params;
+    if (!in || !out || Control(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassNcmGetNtbParameters,
+        0, interface, &params, sizeof(params)) != sizeof(params))
+    {
+        res.failures = 1;
+        return res;
+    }
+
+    // both NTBs have the same size, so every datagram sent fits into the NTB looping it back
+    uint32_t size = bufferSize / 2;
+    if (params.dwNtbOutMaxSize < size)
+        size = params.dwNtbOutMaxSize;
+    if (params.dwNtbInMaxSize < size)
+        size = params.dwNtbInMaxSize;
+    res.ntbSize = size;
+
+    if (Control(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassNcmSetNtbInputSize,
+        0, interface, &size, 4) < 0 || !SetInterface(1))
+    {
+        res.failures = 1;
+        return res;
+    }
+
+    uint8_t* tx = buffer;
+    uint8_t* rx = buffer + bufferSize / 2;
+    NtbWriter writer;
+    NtbReader reader;
+
+    uint64_t start = Nanoseconds();
+    for (uint32_t sent = 0; sent < count; )
+    {
+        uint32_t first = sent;
+        writer.Begin(tx, size, false, sequence++, 32, params.wNdpOutDivisor, params.wNdpOutPayloadRemainder, params.wNdpOutAlignment);
+        while (sent < count && writer.Fits(length))
+        {
+            auto d = (uint8_t*)writer.Reserve(length);
+            for (size_t i = 0; i < length; i++)
+                d[i] = Pattern(sent, i);
+            sent++;
+        }
+
+        // the device receives up to the maximum size, a shorter NTB of whole packets needs a ZLP
+        size_t ntb = writer.Finish();
+        int n = writer.Empty() ? -1 : Transfer(out, tx, ntb, ntb < size);
+        if (n == int(ntb))
+            n = Transfer(in, rx, size, false);
+        if (n <= 0 || !reader.Begin(rx, n))
+        {
+            res.failures++;
+            break;
+        }
+
+        res.ntbs++;
+        const void* datagram;
+        size_t received;
+        uint32_t next = first;
+        while (reader.Next(datagram, received))
+        {
+            bool ok = next < sent && received == length;
+            for (size_t i = 0; ok && i < length; i++)
+                ok = ((const uint8_t*)datagram)[i] == Pattern(next, i);
+            if (ok)
+            {
+                res.datagrams++;
+                res.bytes += 2 * length;
+            }
+            else
+            {
+                res.errors++;
+            }
+            next++;
+        }
+        if (next < sent)
+            res.errors += sent - next;
+    }
+    res.time = Nanoseconds() - start;
+
+    SetInterface(0);
+    return res;
+}
+
+size_t NcmRunner::Format(char* buffer, size_t size, const char* name, const NcmRunResult& result)
+{
+    return JsonWriter(buffer, size)
+        .String("name", name)
+        .Number("datagrams", result.datagrams)
+        .Fixed("frames_per_s", result.MilliDatagramsPerSecond())
+        .Fixed("mb_per_s", result.BytesPerSecond() / 1000)
+        .Number("ntbs", result.ntbs)
+        .Number("failures", result.failures)
+        .Number("errors", result.errors)
+        .Number("ntb_size", result.ntbSize)
+        .Finish();
+}
+
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/NcmHost.h
+ *
+ * Host-side runner of the CDC-NCM datagram throughput tests
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/CdcNcm.h>
+#include <usb/HostParser.h>
+#include <usb/VirtualHost.h>
+
+namespace usb
+{
+
+//! Results of a single test run performed by NcmRunner
+struct NcmRunResult
+{
+    uint64_t time;          //!< Host-side duration of the run in nanoseconds
+    uint64_t bytes;         //!< Datagram bytes transferred, in both directions
+    uint32_t datagrams;     //!< Datagrams looped back and verified
+    uint32_t ntbs;          //!< NTBs sent by the host, each answered by a single NTB from the device
+    uint32_t failures;      //!< Failed setup of the run or NTB exchanges that failed, timed out or returned an invalid NTB, the run stops at the first one
+    uint32_t errors;        //!< Datagrams missing from the returned NTBs or not matching the ones sent
+    uint32_t ntbSize;       //!< Maximum size of the NTBs in both directions
+
+    //! Gets the datagram rate in thousandths of datagrams per second
+    uint64_t MilliDatagramsPerSecond() const { return time ? uint64_t(datagrams) * 1000000000000ull / time : 0; }
+    //! Gets the throughput of the run
+    uint64_t BytesPerSecond() const { return time ? bytes * 1000000000ull / time : 0; }
+};
+
+//! Measures the datagram throughput of a CDC-NCM function from the host
+/*!
+ * Each run reads the NTB parameters of the function, limits the IN NTB size to the buffer
+ * using SET_NTB_INPUT_SIZE and selects alternate setting 1 of the data interface. Synthetic
+ * datagrams are then aggregated by NtbWriter into NTB-16 blocks of the maximum OUT size,
+ * and every NTB sent is expected to be answered by an IN NTB looping back the same datagrams,
+ * which are verified using NtbReader. The data interface is returned to alternate setting 0
+ * at the end of the run.
+ *
+ * The bus access is provided by a derived class, VirtualNcmRunner drives an in-process
+ * VirtualHost, so the tests can run without hardware.
+ */
+class NcmRunner
+{
+public:
+    //! Creates the runner using @p buffer of @p bufferSize bytes, split between an OUT and an IN NTB
+    NcmRunner(uint8_t* buffer, size_t bufferSize)
+        : buffer(buffer), bufferSize(bufferSize) {}
+
+    //! Locates the data endpoints of the CDC-NCM function with the specified communication interface number in a parsed configuration
+    bool Attach(const HostConfig& config, uint8_t interface);
+
+    //! Measures @p count datagrams of @p length bytes looped back by the device
+    NcmRunResult Loopback(uint16_t length, uint32_t count);
+
+    //! Formats the result as a single line of JSON, returns the length of the output (excluding the null terminator)
+    /*!
+     * The datagram rate is reported as frames_per_s and the throughput as mb_per_s in MB/s (10^6 bytes per second), with three decimals
+     */
+    static size_t Format(char* buffer, size_t size, const char* name, const NcmRunResult& result);
+
+protected:
+    //! Performs a control transfer, returns the length of the data stage or -1 if the request failed
+    virtual int Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+        uint16_t value, uint16_t index, void* data, uint16_t length) = 0;
+    //! Performs a transfer on a non-control endpoint, terminating an OUT transfer of whole packets with a ZLP if @p zlp is set
+    /*!
+     * @returns the number of bytes transferred or -1 on failure
+     */
+    virtual int Transfer(uint8_t address, void* data, size_t length, bool zlp) = 0;
+    //! Gets the current time in nanoseconds from a monotonic clock
+    virtual uint64_t Nanoseconds() = 0;
+
+private:
+    uint8_t* buffer;
+    size_t bufferSize;
+    uint8_t interface = 0;
+    uint8_t in = 0, out = 0;
+    uint16_t sequence = 0;
+
+    bool SetInterface(uint8_t alternate);
+};
+
+//! NcmRunner performing the tests on a VirtualHost, timed by the simulated bus time
+class VirtualNcmRunner : public NcmRunner
+{
+public:
+    //! Creates the runner, @p timeout limits every transfer to the specified number of (micro)frames
+    VirtualNcmRunner(VirtualHost& host, uint8_t* buffer, size_t bufferSize, uint32_t timeout = 1000)
+        : NcmRunner(buffer, bufferSize), host(host), timeout(timeout) {}
+
+protected:
+    int Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+        uint16_t value, uint16_t index, void* data, uint16_t length) override
+    {
+        return host.Control(direction, type, recipient, request, value, index, data, length);
+    }
+
+    int Transfer(uint8_t address, void* data, size_t length, bool zlp) override { return host.Transfer(address, data, length, zlp, timeout); }
+    uint64_t Nanoseconds() override { return host.Now(); }
+
+private:
+    VirtualHost& host;
+    uint32_t timeout;
+};
+
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/PacketRamPlan.h
+ *
+ * Compile-time allocation of controller packet memory
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+
+namespace usb
+{
+
+//! Packet memory allocated to a single endpoint
+struct EndpointBuffer
+{
+    uint8_t bEndpointAddress;   //!< Address of the endpoint
+    EndpointType type;          //!< Type of the endpoint
+    uint8_t buffers;            //!< Number of buffers, 2 for double-buffered (ping-pong) endpoints
+    uint16_t offset;            //!< Offset of the first buffer in packet memory
+    uint16_t size;              //!< Size of a single buffer
+
+    //! Gets the offset of the specified buffer
+    constexpr uint16_t Offset(unsigned buffer = 0) const { return offset + buffer * size; }
+    //! Checks if the endpoint is double-buffered
+    constexpr bool DoubleBuffered() const { return buffers > 1; }
+};
+
+//! Layout of endpoint buffers in controller packet memory
+/*!
+ * Every endpoint address gets a buffer large enough for the largest wMaxPacketSize it has
+ * in any interface alternate setting (including high-bandwidth transactions). The space
+ * remaining after that is used to double-buffer isochronous and then bulk endpoints, smallest
+ * first, so that as many of them as possible can be double-buffered.
+ */
+template<size_t n> struct PacketRamPlan
+{
+    EndpointBuffer endpoints[n ? n : 1] = {};   //!< Endpoint buffers, in order of allocation
+    uint8_t count = 0;                          //!< Number of endpoint buffers
+    uint8_t slots[32] = {};                     //!< Index of the buffer for each endpoint slot (see EndpointIndex::Slot) + 1
+    uint16_t used = 0;                          //!< Total amount of packet memory used, including the reserved area
+    bool fits = false;                          //!< All endpoint buffers fit in the available packet memory
+
+    //! Finds the buffer allocated to the endpoint with the specified address
+    constexpr const EndpointBuffer* Find(uint8_t address) const
+    {
+        unsigned i = slots[EndpointIndex<0>::Slot(address)];
+        return i ? &endpoints[i - 1] : NULL;
+    }
+};
+
+//! Gets the number of bytes an endpoint transfers per (micro)frame, including additional high-bandwidth transactions
+constexpr unsigned EndpointBufferSize(const EndpointDescriptor& epd)
+{
+    return epd.MaxPacketSize() * epd.Transactions();
+}
+
+//! Plans the allocation of packet memory of @p ramSize bytes for all endpoints of a configuration
+/*!
+ * @param reserved bytes at the start of packet memory not available for allocation (e.g. used for EP0 or descriptor tables)
+ * @param alignment required alignment of each buffer
+ */
+template<typename... TInterfaces> constexpr auto PlanPacketRam(const ConfigDescriptorBlock<TInterfaces...>& config, unsigned ramSize, unsigned reserved = 0, unsigned alignment = 4)
+{
+    using Plan = PacketRamPlan<_NestedCount<EndpointDescriptor, ConfigDescriptorBlock<TInterfaces...>>::value>;
+    Plan plan;
+
+    struct Visitor
+    {
+        Plan& plan;
+        unsigned alignment;
+
+        constexpr void operator()(const InterfaceDescriptorHeader&, size_t) {}
+        constexpr void operator()(const EndpointDescriptor& epd, size_t)
+        {
+            unsigned size = (EndpointBufferSize(epd) + alignment - 1) / alignment * alignment;
+            unsigned slot = EndpointIndex<0>::Slot(epd.bEndpointAddress);
+            if (unsigned i = plan.slots[slot])
+            {
+                // the same endpoint in another alternate setting
+                if (plan.endpoints[i - 1].size < size)
+                    plan.endpoints[i - 1].size = size;
+            }
+            else
+            {
+                plan.endpoints[plan.count] = { epd.bEndpointAddress, EndpointType(epd.bmAttributes & 3), 1, 0, uint16_t(size) };
+                plan.slots[slot] = ++plan.count;
+            }
+        }
+    };
+
+    VisitDescriptors(config, Visitor { plan, alignment });
+
+    unsigned used = (reserved + alignment - 1) / alignment * alignment;
+    for (unsigned i = 0; i < plan.count; i++)
+        used += plan.endpoints[i].size;
+
+    plan.fits = used <= ramSize;
+    if (plan.fits)
+    {
+        // double-buffer isochronous endpoints first, then bulk, smallest first to maximize their count
+        for (auto type: { EndpointType::Isochronous, EndpointType::Bulk })
+        {
+            for (;;)
+            {
+                EndpointBuffer* best = NULL;
+                for (unsigned i = 0; i < plan.count; i++)
+                {
+                    auto& e = plan.endpoints[i];
+                    if (e.type == type && e.buffers == 1 && used + e.size <= ramSize && (!best || e.size < best->size))
+                        best = &e;
+                }
+                if (!best)
+                    break;
+                best->buffers = 2;
+                used += best->size;
+            }
+        }
+    }
+
+    unsigned offset = (reserved + alignment - 1) / alignment * alignment;
+    for (unsigned i = 0; i < plan.count; i++)
+    {
+        auto& e = plan.endpoints[i];
+        e.offset = offset;
+        offset += e.size * e.buffers;
+    }
+
+    plan.used = used;
+    return plan;
+}
+
+}
+
+//! Declares a constexpr PacketRamPlan @p name for a configuration, failing compilation if the buffers do not fit
+#define USB_PACKET_RAM_PLAN(name, config, ...) \
+    static constexpr auto name = ::usb::PlanPacketRam(config, __VA_ARGS__); \
+    static_assert(name.fits, "Endpoint buffers of " #config " do not fit in packet memory")
@@ -8,6 +8,8 @@
  * Standard USB packets
  */
 
+#pragma once
+
 #include <base/base.h>
 
 #include <usb/Descriptors.h>
@@ -17,13 +19,13 @@ namespace usb
 
 struct SetupPacket
 {
-    enum Direction
+    enum Direction : uint8_t
     {
         DirOut,
         DirIn,
     };
 
-    enum Type
+    enum Type : uint8_t
     {
         TypeStandard,
         TypeClass,
@@ -31,7 +33,7 @@ struct SetupPacket
         TypeInvalid,
     };
 
-    enum Recipient
+    enum Recipient : uint8_t
     {
         RecipientDevice,
         RecipientInterface,
@@ -49,21 +51,73 @@ struct SetupPacket
         StdSetDescriptor = 7,
         StdGetConfiguration = 8,
         StdSetConfiguration = 9,
+        StdGetInterface = 10,
+        StdSetInterface = 11,
 
         ClassDfuDetach = 0,
+        ClassDfuDnload = 1,
+        ClassDfuUpload = 2,
         ClassDfuGetStatus = 3,
+        ClassDfuClrStatus = 4,
         ClassDfuGetState = 5,
+        ClassDfuAbort = 6,
+
+        ClassAudioCur = 1,
+        ClassAudioRange = 2,
+
+        ClassVideoSetCur = 0x01,
+        ClassVideoGetCur = 0x81,
+        ClassVideoGetMin = 0x82,
+        ClassVideoGetMax = 0x83,
+        ClassVideoGetRes = 0x84,
+        ClassVideoGetLen = 0x85,
+        ClassVideoGetInfo = 0x86,
+        ClassVideoGetDef = 0x87,
+
+        ClassHidGetReport = 1,
+        ClassHidGetIdle = 2,
+        ClassHidGetProtocol = 3,
+        ClassHidSetReport = 9,
+        ClassHidSetIdle = 10,
+        ClassHidSetProtocol = 11,
 
         ClassMscBOMReset = 0xFF,
         ClassMscGetMaxLun = 0xFE,
+
+        ClassCdcSetLineCoding = 0x20,
+        ClassCdcGetLineCoding = 0x21,
+        ClassCdcSetControlLineState = 0x22,
+        ClassCdcSendBreak = 0x23,
+        ClassCdcSetEthernetPacketFilter = 0x43,
+
+        ClassNcmGetNtbParameters = 0x80,
+        ClassNcmGetNetAddress = 0x81,
+        ClassNcmSetNetAddress = 0x82,
+        ClassNcmGetNtbFormat = 0x83,
+        ClassNcmSetNtbFormat = 0x84,
+        ClassNcmGetNtbInputSize = 0x85,
+        ClassNcmSetNtbInputSize = 0x86,
+        ClassNcmGetMaxDatagramSize = 0x87,
+        ClassNcmSetMaxDatagramSize = 0x88,
+        ClassNcmGetCrcMode = 0x89,
+        ClassNcmSetCrcMode = 0x8A,
     };
 
-    enum Feature
+    enum Feature : uint8_t
     {
         FeatureEndpointHalt = 0,
         FeatureDeviceRemoteWakeup = 1,
     };
 
+    //! Builds a request key, as found in the lower half of w[0] (bmRequestType in the low byte, bRequest in the high byte)
+    static constexpr uint16_t Key(Direction direction, Type type, Recipient recipient, uint8_t request)
+    {
+        return recipient | type << 5 | direction << 7 | request << 8;
+    }
+
+    //! Gets the request key of the packet, see Key(Direction, Type, Recipient, uint8_t)
+    uint16_t Key() const { return (uint16_t)w[0]; }
+
     union
     {
         uint64_t dw;
@@ -96,4 +150,6 @@ struct SetupPacket
     };
 };
 
+static_assert(sizeof(SetupPacket) == 8, "SetupPacket must match the on-wire layout");
+
 }
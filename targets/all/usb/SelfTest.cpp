@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/SelfTest.cpp
+ */
+
+#include <usb/SelfTest.h>
+#include <usb/Audio.h>
+#include <usb/Dfu.h>
+#include <usb/VirtualHost.h>
+
+namespace usb
+{
+
+namespace
+{
+
+// a pair of bulk endpoints with the transfers queued directly by the checks
+struct QueueBus : VirtualDevice
+{
+    Endpoint in { EndpointDescriptor::BulkIn(1, 64) }, out { EndpointDescriptor::BulkOut(1, 64) };
+
+    ControlResult Setup(const SetupPacket& setup, ControlStage stage) override { return ControlResult::Stall(); }
+
+    Endpoint* FindEndpoint(uint8_t address) override
+    {
+        if (address == in.Address())
+            return &in;
+        if (address == out.Address())
+            return &out;
+        return NULL;
+    }
+};
+
+void Fill(uint8_t* buffer, size_t length, uint8_t seed)
+{
+    for (size_t i = 0; i < length; i++)
+        buffer[i] = uint8_t(seed + i);
+}
+
+bool Completed(const EndpointTransfer& t, size_t length)
+{
+    return t.done && t.status == TransferStatus::Complete && t.transferred == length;
+}
+
+// flash erased by DfuTarget::Begin, programming only clears bits and takes 2 ms per block
+struct SimulatedFlash : DfuTarget
+{
+    uint8_t memory[2048];
+    const VirtualHost* host = NULL;
+    uint32_t busy = 0;          // programming time added to the bus time
+    unsigned begins = 0, manifests = 0;
+
+    DfuStatus Begin() override
+    {
+        memset(memory, 0xFF, sizeof(memory));
+        begins++;
+        return DfuStatus::Ok;
+    }
+
+    DfuStatus Write(uint32_t offset, const void* data, size_t length) override
+    {
+        if (offset > sizeof(memory) || length > sizeof(memory) - offset)
+            return DfuStatus::ErrAddress;
+        for (size_t i = 0; i < length; i++)
+            memory[offset + i] &= ((const uint8_t*)data)[i];
+        busy += 2;
+        return memcmp(memory + offset, data, length) ? DfuStatus::ErrVerify : DfuStatus::Ok;
+    }
+
+    DfuStatus Manifest() override
+    {
+        manifests++;
+        return DfuStatus::Ok;
+    }
+
+    uint32_t Milliseconds() override { return host->Now() / 1000000 + busy; }
+};
+
+struct DfuFunction
+{
+    SimulatedFlash flash;
+    uint8_t buffer[512];
+    Dfu dfu;
+
+    DfuFunction(DfuAttributes attributes, bool runtime)
+        : dfu(flash, buffer, sizeof(buffer), attributes, runtime) {}
+};
+
+constexpr auto dfuDispatcher = MakeSetupDispatcher<DfuFunction>(DfuRequests<DfuFunction, &DfuFunction::dfu, 0>::handlers);
+
+// blocks are programmed between frames unless programming is suspended by the check
+struct DfuBus : VirtualDevice
+{
+    DfuFunction function;
+    bool programming = true;
+    bool started = false;       // the firmware was started by a bus reset
+
+    DfuBus(DfuAttributes attributes, bool runtime = false)
+        : function(attributes, runtime) {}
+
+    ControlResult Setup(const SetupPacket& setup, ControlStage stage) override { return dfuDispatcher.Dispatch(function, setup, stage); }
+    void Run() override { if (programming) function.dfu.Poll(); }
+    void Reset() override { started = function.dfu.Reset() || started; }
+};
+
+int DfuRequest(VirtualHost& host, SetupPacket::Request request, uint16_t value, void* data, uint16_t length)
+{
+    auto dir = request == SetupPacket::ClassDfuUpload || request == SetupPacket::ClassDfuGetStatus || request == SetupPacket::ClassDfuGetState ?
+        SetupPacket::DirIn : SetupPacket::DirOut;
+    return host.Control(dir, SetupPacket::TypeClass, SetupPacket::RecipientInterface, request, value, 0, data, length);
+}
+
+DfuState DfuGetState(VirtualHost& host)
+{
+    uint8_t state;
+    return DfuRequest(host, SetupPacket::ClassDfuGetState, 0, &state, 1) == 1 ? DfuState(state) : DfuState::Error;
+}
+
+// polls DFU_GETSTATUS, waiting for bwPollTimeout as the host does, until the device leaves the busy states
+DfuState DfuSettle(VirtualHost& host, DfuStatus& status)
+{
+    uint8_t response[6];
+    for (unsigned i = 0; i < 100; i++)
+    {
+        if (DfuRequest(host, SetupPacket::ClassDfuGetStatus, 0, response, 6) != 6)
+            break;
+        status = DfuStatus(response[0]);
+        auto state = DfuState(response[4]);
+        if (state != DfuState::DownloadBusy && state != DfuState::Manifest)
+            return state;
+        host.Wait((response[1] | response[2] << 8 | response[3] << 16) * 1000);
+    }
+    status = DfuStatus::ErrUnknown;
+    return DfuState::Error;
+}
+
+// a 48 kHz stereo function with an asynchronous playback stream using explicit feedback and a capture stream,
+// whose codec is clocked from a 12.288 MHz (256 fs) master clock while the bus frames follow a host clock off by drift ppm
+struct AudioBus : VirtualDevice
+{
+    static constexpr uint32_t rate = 48000;
+    static constexpr uint32_t capacity = 480;
+
+    const VirtualHost* host = NULL;
+    int32_t drift;
+    uint32_t playbackBuffer[capacity], captureBuffer[capacity];
+    AudioRing playbackRing { playbackBuffer, capacity, 4 }, captureRing { captureBuffer, capacity, 4 };
+    AudioStream playback { playbackRing, rate, Speed::Full }, capture { captureRing, rate, Speed::Full };
+    AudioFeedback feedback { rate, Speed::Full, 8 };
+    bool running = false;       // the codec starts once the playback ring is filled to the target
+    uint64_t codecFrames = 0;
+    uint32_t played = 0, recorded = 0;
+    uint32_t starved = 0, full = 0, corrupted = 0;
+
+    AudioBus(int32_t drift) : drift(drift) {}
+
+    ControlResult Setup(const SetupPacket& setup, ControlStage stage) override { return ControlResult::Stall(); }
+
+    // rate of the codec in frames per bus frame, 16.16 fixed point
+    uint32_t Exact() const { return uint32_t((uint64_t(rate) << 16) * 1000 / (1000000 + drift)); }
+
+    void Frame(uint16_t frame) override
+    {
+        uint64_t clock = host->Now() * 12288 / (1000000 + drift);
+        feedback.Sof(frame, uint32_t(clock));
+
+        uint32_t frames = uint32_t((clock >> 8) - codecFrames);
+        codecFrames = clock >> 8;
+        if (!running && !(running = playbackRing.Level() >= playback.Target()))
+            return;
+
+        // the codec plays the sequence numbers sent by the host and records its own
+        uint32_t data[64];
+        while (frames)
+        {
+            uint32_t n = frames < 64 ? frames : 64;
+            uint32_t read = playbackRing.Read(data, n);
+            for (uint32_t i = 0; i < read; i++)
+                corrupted += data[i] != played++;
+            starved += read < n;
+            for (uint32_t i = 0; i < n; i++)
+                data[i] = recorded++;
+            full += captureRing.Write(data, n) < n;
+            frames -= n;
+        }
+    }
+};
+
+// downloads the image in blocks of the transfer size, returns false if any block is not accepted
+bool DfuDownload(VirtualHost& host, const uint8_t* image, size_t length, uint16_t blockSize)
+{
+    DfuStatus status;
+    for (uint16_t block = 0; length; block++)
+    {
+        uint16_t n = length < blockSize ? length : blockSize;
+        if (DfuRequest(host, SetupPacket::ClassDfuDnload, block, (void*)image, n) != n ||
+            DfuSettle(host, status) != DfuState::DownloadIdle || status != DfuStatus::Ok)
+            return false;
+        image += n;
+        length -= n;
+    }
+    return true;
+}
+
+}
+
+unsigned SelfTest::Run()
+{
+    failures = 0;
+    RunEndpointQueue();
+    RunDfu();
+    RunAudioClock();
+    return failures;
+}
+
+/****** Endpoint queue ******/
+
+void SelfTest::RunEndpointQueue()
+{
+    QueueBus bus;
+    VirtualHost host(bus);
+    uint8_t data[3][128], rx[256];
+    EndpointTransfer t[3];
+    EndpointPacket packet;
+    bool ok = true;
+
+    // transfers are sent in the order they were queued, each ending with its own short packet
+    static const uint16_t lengths[] = { 100, 64, 10 };
+    for (unsigned i = 0; i < 3; i++)
+    {
+        Fill(data[i], lengths[i], i * 50);
+        t[i].Setup(data[i], lengths[i], false);
+        bus.in.Submit(t[i]);
+    }
+    for (unsigned i = 0; i < 3; i++)
+        ok = ok && host.Transfer(0x81, rx, lengths[i]) == lengths[i] && !memcmp(rx, data[i], lengths[i]) && Completed(t[i], lengths[i]);
+    Check("endpoint_order", ok && !bus.in.Busy());
+
+    // a transfer of whole packets is terminated by a ZLP
+    t[0].Setup(data[0], 128);
+    bus.in.Submit(t[0]);
+    Check("endpoint_zlp", host.Transfer(0x81, rx, sizeof(rx)) == 128 && host.Stats().transactions == 3 && Completed(t[0], 128));
+
+    // the header counts when deciding about the ZLP, but it is not part of the transferred data
+    static const uint8_t header[4] = { 0xAA, 0xBB, 0xCC, 0xDD };
+    t[0].Setup(data[0], 60);
+    t[0].SetHeader(header, sizeof(header));
+    bus.in.Submit(t[0]);
+    Check("endpoint_header_zlp", host.Transfer(0x81, rx, sizeof(rx)) == 64 && host.Stats().transactions == 2 &&
+        !memcmp(rx, header, sizeof(header)) && !memcmp(rx + sizeof(header), data[0], 60) && Completed(t[0], 60) && !t[0].header);
+
+    // a short packet ends an OUT transfer before its buffer is full
+    Fill(rx, 100, 7);
+    t[0].Setup(data[0], 128, false);
+    bus.out.Submit(t[0]);
+    Check("endpoint_short_out", host.Transfer(0x01, rx, 100) == 100 && Completed(t[0], 100) && !memcmp(data[0], rx, 100));
+
+    // cancelling completes the armed transfer and the queued ones, new transfers are armed again
+    t[0].Setup(data[0], 64);
+    t[1].Setup(data[1], 64);
+    bus.in.Submit(t[0]);
+    bus.in.Submit(t[1]);
+    ok = bus.in.Next(packet);
+    bus.in.Cancel();
+    ok = ok && t[0].done && t[0].status == TransferStatus::Cancelled && t[1].done && t[1].status == TransferStatus::Cancelled && !bus.in.Busy();
+    Fill(data[2], 10, 99);
+    t[2].Setup(data[2], 10);
+    bus.in.Submit(t[2]);
+    Check("endpoint_cancel_armed", ok && host.Transfer(0x81, rx, sizeof(rx)) == 10 && !memcmp(rx, data[2], 10) && Completed(t[2], 10));
+
+    // a buffer shorter than a packet is rejected, the full packet sent by the host is NAKed instead of overrunning it
+    uint8_t guard[64];
+    memset(guard, 0x5A, sizeof(guard));
+    t[0].Setup(guard, 10, false);
+    bus.out.Submit(t[0]);
+    Fill(rx, 64, 1);
+    ok = t[0].done && t[0].status == TransferStatus::Invalid && !bus.out.Busy();
+    ok = ok && host.Transfer(0x01, rx, 64, false, 4) == 0 && host.Stats().naks && !host.Stats().overruns;
+    for (auto b: guard)
+        ok = ok && b == 0x5A;
+    Check("endpoint_out_overrun", ok);
+}
+
+/****** DFU ******/
+
+void SelfTest::RunDfu()
+{
+    // the image ends with a short block
+    uint8_t image[1000];
+    Fill(image, sizeof(image), 3);
+    DfuStatus status;
+    bool ok;
+
+    {
+        // blocks are programmed while the next ones are received, manifestation is followed by dfuIDLE
+        DfuBus bus(DfuAttributes::CanDownload | DfuAttributes::ManifestationTolerant);
+        VirtualHost host(bus);
+        bus.function.flash.host = &host;
+        auto& flash = bus.function.flash;
+
+        ok = DfuDownload(host, image, sizeof(image), bus.function.dfu.TransferSize());
+        ok = ok && DfuRequest(host, SetupPacket::ClassDfuDnload, 4, NULL, 0) == 0 && DfuSettle(host, status) == DfuState::Idle && status == DfuStatus::Ok;
+        ok = ok && !memcmp(flash.memory, image, sizeof(image)) && flash.begins == 1 && flash.manifests == 1;
+        for (size_t i = sizeof(image); i < sizeof(flash.memory); i++)
+            ok = ok && flash.memory[i] == 0xFF;
+        Check("dfu_download", ok);
+    }
+
+    {
+        // dfuDNBUSY is reported only when both halves are occupied, for as long as programming them takes
+        DfuBus bus(DfuAttributes::CanDownload | DfuAttributes::ManifestationTolerant);
+        VirtualHost host(bus);
+        bus.function.flash.host = &host;
+        auto& dfu = bus.function.dfu;
+        uint8_t response[6];
+
+        bus.programming = false;
+        ok = DfuRequest(host, SetupPacket::ClassDfuDnload, 0, image, 256) == 256 && DfuSettle(host, status) == DfuState::DownloadIdle;
+        ok = ok && DfuRequest(host, SetupPacket::ClassDfuDnload, 1, image + 256, 256) == 256 &&
+            DfuRequest(host, SetupPacket::ClassDfuGetStatus, 0, response, 6) == 6 && DfuState(response[4]) == DfuState::DownloadBusy;
+        uint32_t timeout = response[1] | response[2] << 8 | response[3] << 16;
+        ok = ok && timeout && timeout == 2 * dfu.ProgramTime();
+        bus.programming = true;
+        host.Wait(timeout * 1000);
+        ok = ok && DfuRequest(host, SetupPacket::ClassDfuGetStatus, 0, response, 6) == 6 && DfuState(response[4]) == DfuState::DownloadIdle;
+        ok = ok && !memcmp(bus.function.flash.memory, image, 512);
+        Check("dfu_poll_timeout", ok);
+    }
+
+    {
+        // a device that is not manifestation tolerant waits for a reset, which starts the new firmware
+        DfuBus bus(DfuAttributes::CanDownload);
+        VirtualHost host(bus);
+        bus.function.flash.host = &host;
+
+        ok = DfuDownload(host, image, sizeof(image), bus.function.dfu.TransferSize());
+        ok = ok && DfuRequest(host, SetupPacket::ClassDfuDnload, 4, NULL, 0) == 0 && DfuSettle(host, status) == DfuState::ManifestWaitReset;
+        ok = ok && bus.function.flash.manifests == 1 && !bus.started;
+        host.Reset();
+        Check("dfu_manifest_wait_reset", ok && bus.started);
+    }
+
+    {
+        // DFU_DETACH in run-time mode enters DFU mode on the following reset
+        DfuBus bus(DfuAttributes::CanDownload, true);
+        VirtualHost host(bus);
+        bus.function.flash.host = &host;
+
+        ok = DfuGetState(host) == DfuState::AppIdle && DfuRequest(host, SetupPacket::ClassDfuDetach, 1000, NULL, 0) == 0 &&
+            DfuGetState(host) == DfuState::AppDetach;
+        host.Reset();
+        Check("dfu_detach_reset", ok && DfuGetState(host) == DfuState::Idle && !bus.started);
+    }
+
+    {
+        // a reset interrupting the download leaves the device in dfuERROR until DFU_CLRSTATUS
+        DfuBus bus(DfuAttributes::CanDownload | DfuAttributes::ManifestationTolerant);
+        VirtualHost host(bus);
+        bus.function.flash.host = &host;
+
+        ok = DfuDownload(host, image, 512, bus.function.dfu.TransferSize());
+        host.Reset();
+        ok = ok && DfuSettle(host, status) == DfuState::Error && status == DfuStatus::ErrUsbReset && !bus.started;
+        ok = ok && DfuRequest(host, SetupPacket::ClassDfuClrStatus, 0, NULL, 0) == 0 && DfuGetState(host) == DfuState::Idle;
+        Check("dfu_reset_during_download", ok);
+    }
+}
+
+/****** Audio clock ******/
+
+void SelfTest::RunAudioClock()
+{
+    // the host clock runs fast, then slow against the codec
+    static const int32_t drifts[] = { 500, -500 };
+    static const char* names[] = { "audio_fast_host_clock", "audio_slow_host_clock" };
+
+    for (unsigned d = 0; d < 2; d++)
+    {
+        AudioBus bus(drifts[d]);
+        VirtualHost host(bus);
+        bus.host = &host;
+
+        uint32_t packet[64];
+        uint32_t phase = 0, sent = 0, received = 0, errors = 0, rateError = 0, levelError = 0;
+        uint64_t settled = 0;
+        bool capturing = false;
+
+        // 4 seconds, the last one checks the settled state
+        for (unsigned i = 0; i < 4000; i++)
+        {
+            host.Wait(1000);
+
+            // the host paces the playback packets by the feedback in 10.14 format
+            uint8_t fb[3];
+            bus.feedback.Encode(fb, bus.playbackRing.Level(), bus.playback.Target());
+            uint32_t value = (fb[0] | fb[1] << 8 | fb[2] << 16) << 2;
+            phase += value;
+            uint32_t frames = phase >> 16;
+            phase &= 0xFFFF;
+            if (frames > bus.playback.MaxPacketFrames())
+                frames = bus.playback.MaxPacketFrames();
+            for (uint32_t f = 0; f < frames; f++)
+                packet[f] = sent++;
+            bus.playback.Received(packet, frames * 4);
+
+            // capture packets follow the measured rate once the device has buffered half of the ring
+            if (!capturing && !(capturing = bus.captureRing.Level() >= bus.capture.Target()))
+                continue;
+            size_t length = bus.capture.NextIn(packet, bus.feedback.Rate());
+            for (size_t f = 0; f < length / 4; f++)
+                errors += packet[f] != received++;
+
+            if (i >= 3000)
+            {
+                uint32_t exact = bus.Exact(), measured = bus.feedback.Rate();
+                uint32_t error = measured > exact ? measured - exact : exact - measured;
+                uint32_t level = bus.playbackRing.Level(), target = bus.playback.Target();
+                uint32_t offset = level > target ? level - target : target - level;
+                rateError = error > rateError ? error : rateError;
+                levelError = offset > levelError ? offset : levelError;
+                settled += value;
+            }
+        }
+
+        // the measured rate settles within 20 ppm, the feedback within 20 ppm on average and the ring within a packet of the target
+        uint64_t exact = uint64_t(bus.Exact()) * 1000;
+        uint64_t average = settled > exact ? settled - exact : exact - settled;
+        bool converged = rateError <= 64 && average <= 64 * 1000 && levelError <= bus.playback.MaxPacketFrames();
+        Check(names[d], converged && !bus.starved && !bus.full && !bus.playback.Overruns() && !bus.capture.Underruns() &&
+            !bus.corrupted && !errors && sent && received);
+    }
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/SelfTest.h
+ *
+ * Functional checks of the device stack on a VirtualHost
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+namespace usb
+{
+
+//! Runner of the functional checks of the device stack
+/*!
+ * Like the Benchmark, the suite is intended to be built for the host. Every check drives
+ * a part of the device stack through a VirtualHost and verifies its behavior:
+ *
+ * - the Endpoint transfer queue - ordering of queued transfers, ZLP termination with and
+ *   without a header, short OUT transfers, cancellation of an armed packet and rejection
+ *   of OUT buffers that a full packet would overrun
+ * - the Dfu download pipeline on a simulated flash - a download ending with a short block,
+ *   GETSTATUS polling honoring bwPollTimeout, manifestation with and without manifestation
+ *   tolerance, and the states left by a bus reset
+ * - the Audio streams against a codec clock drifting from the host clock, in both directions -
+ *   the explicit feedback converging to the codec rate, and the rings of the playback and capture
+ *   streams running without under-runs, over-runs or lost frames
+ *
+ * The platform receives the outcome of every check.
+ */
+class SelfTest
+{
+public:
+    //! Runs all checks, returns the number of failed ones
+    unsigned Run();
+
+protected:
+    //! Called with the outcome of every check
+    virtual void Report(const char* name, bool passed) = 0;
+
+private:
+    unsigned failures;
+
+    //! Reports the outcome of a check, returns @p passed
+    bool Check(const char* name, bool passed)
+    {
+        Report(name, passed);
+        failures += !passed;
+        return passed;
+    }
+
+    void RunEndpointQueue();
+    void RunDfu();
+    void RunAudioClock();
+};
+
+}
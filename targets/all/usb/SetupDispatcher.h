@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/SetupDispatcher.h
+ *
+ * Table-driven dispatch of control requests
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Packets.h>
+
+namespace usb
+{
+
+//! Stage of a control transfer in which a request handler is invoked
+enum struct ControlStage : uint8_t
+{
+    Setup,      //!< Setup packet has been received
+    DataOut,    //!< OUT data stage requested using ControlResult::Out has been received
+};
+
+//! Produces IN data stage content as each packet is sent, instead of sending it from memory
+/*!
+ * Writes @p length bytes of the data starting at @p offset into @p buffer, @p source is the pointer
+ * passed to ControlResult::In
+ */
+typedef void (*ControlGenerator)(const void* source, size_t offset, void* buffer, size_t length);
+
+//! Result of handling a control request
+struct ControlResult
+{
+    enum struct Status : uint8_t
+    {
+        Unhandled,  //!< Request was not handled, dispatching continues with the next matching handler
+        Stall,      //!< Request is invalid and the control endpoint should be stalled
+        Ack,        //!< Request has been processed, status stage follows
+        In,         //!< IN data stage follows, sending the specified data
+        Out,        //!< OUT data stage follows, receiving into the specified buffer
+    };
+
+    Status status;      //!< Outcome of the request
+    uint16_t length;    //!< Length of the data stage
+    union
+    {
+        const void* in; //!< Source of the IN data stage
+        void* out;      //!< Destination of the OUT data stage
+    };
+    ControlGenerator generate;  //!< Generator of the IN data stage from the source, NULL if the source is sent as it is
+
+    static constexpr ControlResult Unhandled() { return { Status::Unhandled, 0, { NULL }, NULL }; }
+    static constexpr ControlResult Stall() { return { Status::Stall, 0, { NULL }, NULL }; }
+    static constexpr ControlResult Ack() { return { Status::Ack, 0, { NULL }, NULL }; }
+    static constexpr ControlResult In(const void* data, size_t length) { return { Status::In, uint16_t(length), { data }, NULL }; }
+    //! Creates a result with an IN data stage produced by @p generate from @p source as each packet is sent
+    static constexpr ControlResult In(const void* source, size_t length, ControlGenerator generate) { return { Status::In, uint16_t(length), { source }, generate }; }
+    static constexpr ControlResult Out(void* buffer, size_t length) { return { Status::Out, uint16_t(length), { buffer }, NULL }; }
+
+#if USB_COMPACT_STRINGS
+    //! Creates a result sending the specified string, expanded from UTF-8 as it is sent
+    static constexpr ControlResult In(const StringEntry* str) { return In(str, str->len, ExpandCompactString); }
+#else
+    //! Creates a result sending the specified string
+    static constexpr ControlResult In(const StringEntry* str) { return In(str, str->len); }
+#endif
+
+    //! Checks if the request was handled
+    constexpr operator bool() const { return status != Status::Unhandled; }
+    //! Checks if the IN data stage must be terminated by a zero-length packet
+    constexpr bool NeedsZlp(const SetupPacket& setup, unsigned maxPacketSize) const
+    {
+        return status == Status::In && length < setup.wLength && !(length % maxPacketSize);
+    }
+};
+
+//! Control request handler registration
+template<typename TContext> struct SetupHandler
+{
+    typedef ControlResult (*Handler)(TContext& context, const SetupPacket& setup, ControlStage stage);
+
+    uint16_t key;       //!< Request key, see SetupPacket::Key
+    int16_t filter;     //!< Interface number or endpoint address to match against the low byte of wIndex, negative to match any
+    Handler handler;    //!< Handler function
+};
+
+//! Creates a SetupHandler for the specified request
+template<typename TContext> constexpr SetupHandler<TContext> OnSetup(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+    typename SetupHandler<TContext>::Handler handler, int filter = -1)
+{
+    return { SetupPacket::Key(direction, type, recipient, request), int16_t(filter), handler };
+}
+
+//! Routes setup packets to handlers registered at compile time
+/*!
+ * Handlers are sorted by request key, with filtered handlers preceding wildcard ones.
+ * Keys are located using a multiplicative hash with a multiplier selected at compile time
+ * to minimize collisions (usually to none), so the number of probes per request is bounded
+ * by MaxProbes() regardless of the number of registered handlers.
+ */
+template<typename TContext, size_t n> class SetupDispatcher
+{
+    static_assert(n > 0 && n < 255, "Unsupported number of setup handlers");
+
+    static constexpr unsigned BucketBits()
+    {
+        unsigned bits = 2;
+        while ((1u << bits) < n * 4)
+            bits++;
+        return bits;
+    }
+
+    static constexpr unsigned Buckets = 1u << BucketBits();
+    static constexpr unsigned Mask = Buckets - 1;
+
+    SetupHandler<TContext> handlers[n] = {};
+    uint8_t buckets[Buckets] = {};  // index of the first handler with the key + 1, zero for empty bucket
+    uint32_t multiplier = 0;
+    uint8_t maxProbes = 0;
+
+    constexpr unsigned Hash(uint16_t key) const { return (key * multiplier) >> (32 - BucketBits()); }
+
+    constexpr unsigned Fill(uint32_t mul)
+    {
+        multiplier = mul;
+        unsigned probes = 0;
+        for (auto& b: buckets)
+            b = 0;
+        for (unsigned i = 0; i < n; i++)
+        {
+            if (i && handlers[i].key == handlers[i - 1].key)
+                continue;
+            unsigned h = Hash(handlers[i].key), p = 1;
+            for (; buckets[h]; h = (h + 1) & Mask)
+                p++;
+            buckets[h] = i + 1;
+            if (p > probes)
+                probes = p;
+        }
+        return probes;
+    }
+
+public:
+    constexpr SetupDispatcher(const SetupHandler<TContext>* const* lists, const size_t* counts, size_t numLists)
+    {
+        // merge and sort by key, filtered handlers first
+        size_t count = 0;
+        for (size_t l = 0; l < numLists; l++)
+        {
+            for (size_t i = 0; i < counts[l]; i++)
+            {
+                auto h = lists[l][i];
+                size_t j = count++;
+                for (; j > 0 && (handlers[j - 1].key > h.key || (handlers[j - 1].key == h.key && handlers[j - 1].filter < 0 && h.filter >= 0)); j--)
+                    handlers[j] = handlers[j - 1];
+                handlers[j] = h;
+            }
+        }
+
+        // select the multiplier resulting in the fewest collisions
+        uint32_t best = 0;
+        unsigned bestProbes = ~0u;
+        for (uint32_t mul = 0x9E3779B1u, attempt = 0; attempt < 256 && bestProbes > 1; attempt++, mul += 0x3C6EF372u)
+        {
+            unsigned probes = Fill(mul | 1);
+            if (probes < bestProbes)
+            {
+                best = mul | 1;
+                bestProbes = probes;
+            }
+        }
+
+        maxProbes = Fill(best);
+    }
+
+    //! Gets the maximum number of buckets examined when locating a request
+    constexpr unsigned MaxProbes() const { return maxProbes; }
+
+    //! Dispatches a control request to the registered handlers
+    ControlResult Dispatch(TContext& context, const SetupPacket& setup, ControlStage stage = ControlStage::Setup) const
+    {
+        uint16_t key = setup.Key();
+        for (unsigned h = Hash(key), p = 0; p < maxProbes; h = (h + 1) & Mask, p++)
+        {
+            unsigned i = buckets[h];
+            if (!i--)
+                break;
+            if (handlers[i].key != key)
+                continue;
+
+            for (; i < n && handlers[i].key == key; i++)
+            {
+                auto& reg = handlers[i];
+                if (reg.filter >= 0 && reg.filter != (setup.wIndex & 0xFF))
+                    continue;
+                if (auto res = reg.handler(context, setup, stage))
+                {
+                    if (res.status == ControlResult::Status::In && res.length > setup.wLength)
+                        res.length = setup.wLength;
+                    return res;
+                }
+            }
+            break;
+        }
+
+        return ControlResult::Unhandled();
+    }
+};
+
+//! Creates a SetupDispatcher from one or more arrays of SetupHandler registrations
+template<typename TContext, size_t... n> constexpr SetupDispatcher<TContext, (n + ...)> MakeSetupDispatcher(const SetupHandler<TContext> (&... lists)[n])
+{
+    const SetupHandler<TContext>* ptrs[] = { lists... };
+    size_t counts[] = { n... };
+    return SetupDispatcher<TContext, (n + ...)>(ptrs, counts, sizeof...(n));
+}
+
+}
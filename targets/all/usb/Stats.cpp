@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Stats.cpp
+ */
+
+#include <usb/Stats.h>
+
+#if USB_STATS
+
+namespace usb
+{
+
+void UsbStats::Register(uint8_t address)
+{
+    // endpoints in alternate settings usually share addresses, they are tracked together
+    unsigned slot = Slot(address);
+    if (slots[slot] || count >= capacity)
+        return;
+
+    endpoints[count].address = address;
+    slots[slot] = ++count;
+}
+
+void UsbStats::SetupCompleted(uint32_t time, bool stalled)
+{
+    if (stalled)
+        control.stalls++;
+    control.latency.Add(time - setupTime);
+}
+
+void UsbStats::Packet(uint8_t address, size_t length, size_t maxPacketSize)
+{
+    if (auto s = Lookup(address))
+    {
+        s->packets++;
+        s->bytes += length;
+        if (length < maxPacketSize)
+            s->shortPackets++;
+    }
+}
+
+void UsbStats::TransferStarted(uint8_t address, uint32_t time)
+{
+    if (unsigned i = slots[Slot(address)])
+        started[i - 1] = time;
+}
+
+void UsbStats::TransferCompleted(uint8_t address, uint32_t time)
+{
+    if (unsigned i = slots[Slot(address)])
+        endpoints[i - 1].latency.Add(time - started[i - 1]);
+}
+
+void UsbStats::Clear()
+{
+    control = {};
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint8_t address = endpoints[i].address;
+        endpoints[i] = {};
+        endpoints[i].address = address;
+    }
+}
+
+size_t UsbStats::Snapshot()
+{
+    StatsSnapshotHeader header;
+    header.endpoints = count;
+
+    uint8_t* p = snapshot;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, &control, sizeof(control));
+    p += sizeof(control);
+    memcpy(p, endpoints, count * sizeof(EndpointStats));
+    p += count * sizeof(EndpointStats);
+    return p - snapshot;
+}
+
+ControlResult UsbStats::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    // the snapshot is taken in the setup stage, so the data stage returns consistent values
+    size_t length = Snapshot();
+    if (setup.wValue & 1)
+        Clear();
+    return ControlResult::In(snapshot, length);
+}
+
+}
+
+#endif
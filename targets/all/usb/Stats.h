@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Stats.h
+ *
+ * Per-endpoint performance counters and latency histograms
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/SetupDispatcher.h>
+
+//! Enables the collection of UsbStats, when zero all the instrumentation compiles to nothing
+#ifndef USB_STATS
+#define USB_STATS 0
+#endif
+
+namespace usb
+{
+
+//! Histogram of latencies in microseconds with fixed logarithmic buckets
+/*!
+ * Bucket 0 counts latencies below 16 us, each following bucket covers four times the range
+ * of the previous one (16-63 us, 64-255 us, ... 16-64 ms), the last bucket counts everything above 64 ms
+ */
+struct LatencyHistogram
+{
+    static constexpr unsigned Buckets = 8;
+
+    uint32_t buckets[Buckets];  //!< Number of samples in each bucket
+
+    //! Gets the bucket for the specified latency
+    static constexpr unsigned Bucket(uint32_t us)
+    {
+        if (us < 16)
+            return 0;
+        unsigned log2 = 31 - __builtin_clz(us);
+        unsigned b = (log2 - 2) / 2;
+        return b < Buckets ? b : Buckets - 1;
+    }
+
+    //! Adds a sample to the histogram
+    void Add(uint32_t us) { buckets[Bucket(us)]++; }
+};
+
+//! Counters of the control endpoint
+struct ControlStats
+{
+    uint32_t busResets;         //!< Number of bus resets
+    uint32_t requests;          //!< Number of setup packets received
+    uint32_t stalls;            //!< Number of requests rejected with a stall
+    LatencyHistogram latency;   //!< Time from the reception of the setup packet to the completion of the request
+};
+
+//! Counters of a single non-control endpoint
+struct EndpointStats
+{
+    uint8_t address;            //!< Address of the endpoint
+    uint8_t _reserved[3];
+    uint32_t packets;           //!< Number of data packets transferred (including ZLPs)
+    uint32_t bytes;             //!< Number of payload bytes transferred
+    uint32_t naks;              //!< Number of transactions NAKed by the device (IN) or the host (OUT)
+    uint32_t shortPackets;      //!< Number of packets shorter than the max packet size
+    uint32_t stalls;            //!< Number of transactions stalled because of a halt
+    uint32_t resets;            //!< Number of data toggle resets (clear halt, configuration change)
+    LatencyHistogram latency;   //!< Time from the start to the completion of transfers
+};
+
+//! Header of the snapshot returned by the statistics vendor request
+/*!
+ * The header is followed by ControlStats and @ref endpoints EndpointStats structures,
+ * all fields are little-endian 32-bit values except where noted otherwise
+ */
+struct StatsSnapshotHeader
+{
+    uint8_t version = 1;                            //!< Version of the format
+    uint8_t endpoints;                              //!< Number of EndpointStats structures following the ControlStats
+    uint8_t buckets = LatencyHistogram::Buckets;    //!< Number of buckets in each LatencyHistogram
+    uint8_t _reserved = 0;
+};
+
+static_assert(sizeof(StatsSnapshotHeader) == 4 && sizeof(ControlStats) == 44 && sizeof(EndpointStats) == 60,
+    "Statistics structures must match the snapshot format");
+
+#if USB_STATS
+
+//! Instrumentation layer collecting the performance counters
+/*!
+ * The controller driver reports the events using the methods below, the timestamps are in
+ * microseconds from any free-running clock. Use UsbStatsFor to create an instance sized for
+ * a specific configuration, no memory is allocated at runtime.
+ *
+ * When USB_STATS is zero, all the methods are empty inline functions, so the instrumentation
+ * calls may be left in the driver. Handler registrations (StatsRequests) should be guarded
+ * by #if USB_STATS to remove the vendor request as well.
+ */
+class UsbStats
+{
+public:
+    UsbStats(EndpointStats* endpoints, uint32_t* started, size_t capacity, void* snapshot)
+        : endpoints(endpoints), started(started), snapshot((uint8_t*)snapshot), capacity(capacity)
+    {
+        memset(endpoints, 0, capacity * sizeof(EndpointStats));
+    }
+
+    //! Records a bus reset
+    void BusReset() { control.busResets++; }
+    //! Records the reception of a setup packet
+    void SetupReceived(uint32_t time) { control.requests++; setupTime = time; }
+    //! Records the completion (status stage) or stall of a control request
+    void SetupCompleted(uint32_t time, bool stalled);
+
+    //! Records a data packet transferred on an endpoint
+    void Packet(uint8_t address, size_t length, size_t maxPacketSize);
+    //! Records a NAK on an endpoint
+    void Nak(uint8_t address) { if (auto s = Lookup(address)) s->naks++; }
+    //! Records a stall of a halted endpoint
+    void Stall(uint8_t address) { if (auto s = Lookup(address)) s->stalls++; }
+    //! Records a data toggle reset of an endpoint
+    void Reset(uint8_t address) { if (auto s = Lookup(address)) s->resets++; }
+    //! Records the start of a transfer on an endpoint (e.g. the first packet armed)
+    void TransferStarted(uint8_t address, uint32_t time);
+    //! Records the completion of a transfer on an endpoint
+    void TransferCompleted(uint8_t address, uint32_t time);
+
+    //! Gets the counters of the control endpoint
+    const ControlStats& Control() const { return control; }
+    //! Gets the counters of the specified endpoint, NULL if the endpoint is not tracked
+    const EndpointStats* Find(uint8_t address) const { return ((UsbStats*)this)->Lookup(address); }
+
+    //! Resets all counters
+    void Clear();
+    //! Copies the counters to the snapshot buffer, returns its length
+    size_t Snapshot();
+    //! Gets the data of the last snapshot
+    const void* SnapshotData() const { return snapshot; }
+
+    //! Handles the vendor request returning the snapshot, bit 0 of wValue requests clearing the counters afterwards
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+
+protected:
+    //! Starts tracking an endpoint
+    void Register(uint8_t address);
+
+private:
+    EndpointStats* endpoints;
+    uint32_t* started;
+    uint8_t* snapshot;
+    uint8_t capacity;
+    uint8_t count = 0;
+    uint8_t slots[32] = {};     // index of the EndpointStats + 1 for each endpoint slot, zero if not tracked
+    uint32_t setupTime = 0;
+    ControlStats control = {};
+
+    static unsigned Slot(uint8_t address) { return (address & 0xF) | ((address >> 3) & 0x10); }
+    EndpointStats* Lookup(uint8_t address) { unsigned i = slots[Slot(address)]; return i ? &endpoints[i - 1] : NULL; }
+};
+
+//! UsbStats with storage for @p n endpoints
+template<size_t n> class UsbStatsStorage : public UsbStats
+{
+public:
+    //! Creates the statistics tracking all the endpoints in the specified configuration
+    template<typename TConfig> UsbStatsStorage(const TConfig& config)
+        : UsbStats(endpoints, started, n, snapshot)
+    {
+        VisitDescriptors(config, [this](const auto& d, size_t)
+        {
+            if constexpr (std::is_same<std::decay_t<decltype(d)>, EndpointDescriptor>::value)
+                Register(d.bEndpointAddress);
+        });
+    }
+
+private:
+    EndpointStats endpoints[n ? n : 1] = {};
+    uint32_t started[n ? n : 1] = {};
+    uint32_t snapshot[(sizeof(StatsSnapshotHeader) + sizeof(ControlStats) + n * sizeof(EndpointStats)) / 4];
+};
+
+#else
+
+class UsbStats
+{
+public:
+    UsbStats() = default;
+    UsbStats(EndpointStats* endpoints, uint32_t* started, size_t capacity, void* snapshot) {}
+
+    void BusReset() {}
+    void SetupReceived(uint32_t time) {}
+    void SetupCompleted(uint32_t time, bool stalled) {}
+    void Packet(uint8_t address, size_t length, size_t maxPacketSize) {}
+    void Nak(uint8_t address) {}
+    void Stall(uint8_t address) {}
+    void Reset(uint8_t address) {}
+    void TransferStarted(uint8_t address, uint32_t time) {}
+    void TransferCompleted(uint8_t address, uint32_t time) {}
+    const ControlStats& Control() const { return control; }
+    const EndpointStats* Find(uint8_t address) const { return NULL; }
+    void Clear() {}
+    size_t Snapshot() { return 0; }
+    const void* SnapshotData() const { return NULL; }
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage) { return ControlResult::Unhandled(); }
+
+protected:
+    void Register(uint8_t address) {}
+
+private:
+    static constexpr ControlStats control = {};
+};
+
+template<size_t n> class UsbStatsStorage : public UsbStats
+{
+public:
+    template<typename TConfig> constexpr UsbStatsStorage(const TConfig& config) {}
+};
+
+#endif
+
+//! UsbStats sized for the distinct endpoint addresses of @p config (a constexpr ConfigDescriptorBlock)
+/*!
+ * Endpoints repeated in several alternate settings share a single entry, e.g. <tt>UsbStatsFor<config> stats { config };</tt>
+ */
+template<const auto& config> using UsbStatsFor = UsbStatsStorage<config.BuildEndpointIndex().Addresses()>;
+
+//! Registers the statistics vendor request
+template<typename TContext, typename TStats, TStats TContext::*stats, uint8_t request> struct StatsRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*stats).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeVendor, SetupPacket::RecipientDevice, request, Handle),
+    };
+};
+
+}
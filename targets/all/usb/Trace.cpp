@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Trace.cpp
+ */
+
+#include <usb/Trace.h>
+
+namespace usb
+{
+
+namespace
+{
+
+enum
+{
+    LinkTypeUsbLinuxMmapped = 220,
+    ErrorPipe = -32,        // -EPIPE, stalled
+    ErrorConnReset = -104,  // -ECONNRESET, unlinked
+    ErrorInProgress = -115, // -EINPROGRESS, reported for submissions
+};
+
+struct PcapHeader
+{
+    uint32_t magic = 0xA1B2C3D4;
+    uint16_t versionMajor = 2;
+    uint16_t versionMinor = 4;
+    int32_t thiszone = 0;
+    uint32_t sigfigs = 0;
+    uint32_t snaplen = 65535;
+    uint32_t network = LinkTypeUsbLinuxMmapped;
+};
+
+struct PcapRecord
+{
+    uint32_t tsSec;
+    uint32_t tsUsec;
+    uint32_t inclLen;
+    uint32_t origLen;
+};
+
+// struct usbmon_packet from Documentation/usb/usbmon.rst
+struct UsbmonPacket
+{
+    uint64_t id;
+    uint8_t eventType;
+    uint8_t transferType;
+    uint8_t endpoint;
+    uint8_t device;
+    uint16_t bus;
+    uint8_t setupFlag;
+    uint8_t dataFlag;
+    int64_t tsSec;
+    int32_t tsUsec;
+    int32_t status;
+    uint32_t urbLength;
+    uint32_t dataLength;
+    uint64_t setup;
+    int32_t interval;
+    int32_t startFrame;
+    uint32_t transferFlags;
+    uint32_t descriptors;
+};
+
+static_assert(sizeof(PcapHeader) == 24 && sizeof(PcapRecord) == 16 && sizeof(UsbmonPacket) == 64, "Invalid pcap structure layout");
+
+// usbmon transfer types indexed by EndpointType
+const uint8_t transferTypes[] = { 2, 0, 3, 1 };
+
+}
+
+int TracePcapWriter::Convert(const void* dump, size_t length)
+{
+    auto header = (const TraceHeader*)dump;
+    if (length < sizeof(TraceHeader) || header->magic != TraceHeader::Magic || header->version != 1 ||
+        header->entrySize != sizeof(TraceEvent) || !header->capacity ||
+        length < sizeof(TraceHeader) + header->capacity * sizeof(TraceEvent))
+        return -1;
+
+    auto entries = (const TraceEvent*)(header + 1);
+    uint32_t capacity = header->capacity, head = header->head;
+    // the oldest slot might have been in the middle of being overwritten when the dump was taken
+    uint32_t tail = head >= capacity ? head - (capacity - 1) : 0;
+
+    PcapHeader ph;
+    Write(&ph, sizeof(ph));
+
+    uint64_t time = 0, ids[32] = {}, id = 0;
+    uint32_t lastTime = entries[tail % capacity].time;
+    uint8_t address = 0, pendingAddress = 0;
+    uint8_t controlEndpoint = 0;
+    int packets = 0;
+
+    for (; tail != head; tail++)
+    {
+        const TraceEvent& e = entries[tail % capacity];
+        // timestamps are 32-bit microseconds, extended assuming the gaps between events are shorter than the wraparound
+        time += e.time - lastTime;
+        lastTime = e.time;
+
+        unsigned slot = (e.address & 0xF) | ((e.address >> 3) & 0x10);
+
+        switch (e.type)
+        {
+            case TraceEventType::Setup:
+            {
+                SetupPacket setup;
+                setup.dw = e.setup;
+                controlEndpoint = setup.direction == SetupPacket::DirIn ? 0x80 : 0;
+                pendingAddress = setup.bmRequestType == 0 && setup.bRequest == SetupPacket::StdSetAddress ? setup.wValue : address;
+                ids[0] = ++id;
+                Packet(e, time, ids[0], 'S', controlEndpoint, address, setup.wLength);
+                packets++;
+                break;
+            }
+
+            case TraceEventType::ControlComplete:
+                Packet(e, time, ids[0], 'C', controlEndpoint, address, e.length);
+                // the new address is applied after the status stage
+                if (e.status == TraceStatus::Ok)
+                    address = pendingAddress;
+                packets++;
+                break;
+
+            case TraceEventType::TransferStart:
+                ids[slot] = ++id;
+                Packet(e, time, ids[slot], 'S', e.address, address, e.length);
+                packets++;
+                break;
+
+            case TraceEventType::TransferComplete:
+                if (!ids[slot])
+                    ids[slot] = ++id;
+                Packet(e, time, ids[slot], 'C', e.address, address, e.length);
+                ids[slot] = 0;
+                packets++;
+                break;
+
+            case TraceEventType::BusReset:
+                address = pendingAddress = 0;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return packets;
+}
+
+void TracePcapWriter::Packet(const TraceEvent& event, uint64_t time, uint64_t id, char eventType, uint8_t endpoint, uint8_t address, uint32_t urbLength)
+{
+    struct
+    {
+        PcapRecord record;
+        UsbmonPacket packet;
+    } p = {};
+
+    p.record.tsSec = time / 1000000;
+    p.record.tsUsec = time % 1000000;
+    p.record.inclLen = p.record.origLen = sizeof(UsbmonPacket);
+
+    auto& u = p.packet;
+    u.id = id;
+    u.eventType = eventType;
+    u.transferType = transferTypes[event.endpointType & 3];
+    u.endpoint = endpoint;
+    u.device = address;
+    u.bus = 1;
+    u.tsSec = p.record.tsSec;
+    u.tsUsec = p.record.tsUsec;
+    u.urbLength = urbLength;
+    // payload is never captured, the flag tells the dissector why
+    u.dataFlag = endpoint & 0x80 ? '<' : '>';
+
+    if (event.type == TraceEventType::Setup)
+    {
+        u.setup = event.setup;
+        u.setupFlag = 0;
+    }
+    else
+    {
+        u.setupFlag = '-';
+    }
+
+    if (eventType == 'C')
+        u.status = event.status == TraceStatus::Stall ? ErrorPipe : event.status == TraceStatus::Cancelled ? ErrorConnReset : 0;
+    else
+        u.status = ErrorInProgress;
+
+    if (event.endpointType == uint8_t(EndpointType::Interrupt) || event.endpointType == uint8_t(EndpointType::Isochronous))
+        u.interval = 1;
+
+    Write(&p, sizeof(p));
+}
+
+}
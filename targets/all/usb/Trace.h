@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Trace.h
+ *
+ * Binary trace of USB events with pcap export
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Packets.h>
+
+namespace usb
+{
+
+//! Types of traced events
+enum struct TraceEventType : uint8_t
+{
+    Setup,              //!< Setup packet received, TraceEvent::setup contains the packet
+    ControlComplete,    //!< Status stage of a control transfer completed or the request was stalled
+    TransferStart,      //!< Transfer started on a non-control endpoint
+    TransferComplete,   //!< Transfer completed on a non-control endpoint
+    BusReset,           //!< Bus reset detected
+    Suspend,            //!< Bus suspended
+    Resume,             //!< Bus resumed
+};
+
+//! Bit masks of TraceEventType values, used to select the recorded events at compile time
+enum : uint32_t
+{
+    TraceSetup = BIT(unsigned(TraceEventType::Setup)) | BIT(unsigned(TraceEventType::ControlComplete)),
+    TraceTransfers = BIT(unsigned(TraceEventType::TransferStart)) | BIT(unsigned(TraceEventType::TransferComplete)),
+    TraceBus = BIT(unsigned(TraceEventType::BusReset)) | BIT(unsigned(TraceEventType::Suspend)) | BIT(unsigned(TraceEventType::Resume)),
+    TraceAll = TraceSetup | TraceTransfers | TraceBus,
+};
+
+//! Completion status of a traced transfer
+enum struct TraceStatus : uint8_t
+{
+    Ok,         //!< Transfer completed successfully
+    Stall,      //!< Request or transfer was stalled
+    Cancelled,  //!< Transfer was cancelled
+};
+
+//! Single event in a TraceRing
+struct TraceEvent
+{
+    uint32_t time;          //!< Timestamp in microseconds
+    TraceEventType type;    //!< Type of the event
+    uint8_t address;        //!< Endpoint address (zero for bus events)
+    uint8_t endpointType;   //!< EndpointType of the endpoint
+    TraceStatus status;     //!< Completion status
+    union
+    {
+        uint64_t setup;     //!< Setup packet (SetupPacket::dw) for TraceEventType::Setup
+        struct
+        {
+            uint32_t length;    //!< Requested (start) or actual (complete) length of the transfer
+            uint32_t _reserved2;
+        };
+    };
+};
+
+static_assert(sizeof(TraceEvent) == 16, "TraceEvent must match the dump format");
+
+//! Header of a TraceRing, immediately followed by the event entries
+/*!
+ * The complete TraceRing object (header and entries) is the dump format read by TracePcapWriter
+ */
+struct TraceHeader
+{
+    static constexpr uint32_t Magic = 0x54425355;   // "USBT"
+
+    uint32_t magic = Magic;             //!< Identifies the dump
+    uint16_t version = 1;               //!< Version of the dump format
+    uint16_t entrySize = sizeof(TraceEvent);    //!< Size of a single entry
+    uint32_t capacity;                  //!< Number of entries in the ring
+    volatile uint32_t head = 0;         //!< Total number of events written, the latest event is at (head - 1) % capacity
+};
+
+//! Single-producer lock-free ring of USB events
+/*!
+ * Events are recorded by the USB interrupt (the only producer), when the ring is full the oldest
+ * events are overwritten, so the ring always contains the latest history. Recording is a handful
+ * of stores, the entry is written before the head is published with release semantics.
+ *
+ * Events of types not present in @p types and on endpoints not present in @p endpoints
+ * (bit 0-15 for OUT endpoints, 16-31 for IN endpoints, same as EndpointIndex::Slot) are filtered
+ * at compile time, the calls recording them compile to nothing.
+ */
+template<size_t n, uint32_t types = TraceAll, uint32_t endpoints = ~0u> class TraceRing
+{
+    static_assert(n && !(n & (n - 1)), "Trace ring capacity must be a power of two");
+
+public:
+    constexpr TraceRing() { header.capacity = n; }
+
+    //! Records a setup packet
+    ALWAYS_INLINE void Setup(uint32_t time, const SetupPacket& setup)
+    {
+        if (Enabled(TraceEventType::Setup, 0))
+            Record(time, TraceEventType::Setup, 0, EndpointType::Control, TraceStatus::Ok, setup.dw);
+    }
+
+    //! Records the completion of a control transfer
+    ALWAYS_INLINE void ControlComplete(uint32_t time, uint32_t length, bool stalled)
+    {
+        if (Enabled(TraceEventType::ControlComplete, 0))
+            Record(time, TraceEventType::ControlComplete, 0, EndpointType::Control, stalled ? TraceStatus::Stall : TraceStatus::Ok, length);
+    }
+
+    //! Records the start of a transfer on a non-control endpoint
+    ALWAYS_INLINE void TransferStart(uint32_t time, uint8_t address, EndpointType type, uint32_t length)
+    {
+        if (Enabled(TraceEventType::TransferStart, address))
+            Record(time, TraceEventType::TransferStart, address, type, TraceStatus::Ok, length);
+    }
+
+    //! Records the completion of a transfer on a non-control endpoint
+    ALWAYS_INLINE void TransferComplete(uint32_t time, uint8_t address, EndpointType type, uint32_t length, TraceStatus status = TraceStatus::Ok)
+    {
+        if (Enabled(TraceEventType::TransferComplete, address))
+            Record(time, TraceEventType::TransferComplete, address, type, status, length);
+    }
+
+    //! Records a bus event (reset, suspend or resume)
+    ALWAYS_INLINE void Bus(uint32_t time, TraceEventType type)
+    {
+        if (types & BIT(unsigned(type)))
+            Record(time, type, 0, EndpointType::Control, TraceStatus::Ok, 0);
+    }
+
+    //! Gets the total number of events recorded
+    uint32_t Count() const { return __atomic_load_n(&header.head, __ATOMIC_ACQUIRE); }
+
+    //! Reads the event at position @p tail, to be used by a consumer running concurrently with the producer
+    /*!
+     * @p tail is advanced past the event read, when the producer has already overwritten the event,
+     * @p tail skips to the oldest event still available
+     * @returns false if there are no more events
+     */
+    bool Read(uint32_t& tail, TraceEvent& event) const
+    {
+        for (;;)
+        {
+            // the slot of the oldest event is the one the producer writes next, it is not readable
+            uint32_t head = Count();
+            if (head - tail > n - 1)
+                tail = head - (n - 1);
+            if (tail == head)
+                return false;
+            event = entries[tail % n];
+            // the copy must complete before the head is checked again
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            // the producer starts overwriting the entry only after publishing event tail + n - 1
+            if (Count() - tail < n)
+                break;
+        }
+        tail++;
+        return true;
+    }
+
+    //! Gets the dump of the ring, to be converted using TracePcapWriter
+    const void* Dump() const { return &header; }
+    //! Gets the size of the dump
+    static constexpr size_t DumpSize() { return sizeof(TraceHeader) + n * sizeof(TraceEvent); }
+
+private:
+    TraceHeader header;
+    TraceEvent entries[n] = {};
+
+    static constexpr bool Enabled(TraceEventType type, uint8_t address)
+    {
+        return (types & BIT(unsigned(type))) && (endpoints & BIT((address & 0xF) | ((address >> 3) & 0x10)));
+    }
+
+    ALWAYS_INLINE void Record(uint32_t time, TraceEventType type, uint8_t address, EndpointType epType, TraceStatus status, uint64_t data)
+    {
+        uint32_t head = header.head;
+        TraceEvent* e = &entries[head % n];
+        e->time = time;
+        e->type = type;
+        e->address = address;
+        e->endpointType = uint8_t(epType);
+        e->status = status;
+        e->setup = data;    // also covers the length, the targets are little-endian
+        // the entry must be complete before it is published to the consumer
+        __atomic_store_n(&header.head, head + 1, __ATOMIC_RELEASE);
+    }
+};
+
+//! Converts a TraceRing dump to a pcap file with the Linux usbmon link type (LINKTYPE_USB_LINUX_MMAPPED)
+/*!
+ * Setup packets and transfer starts become URB submissions, control and transfer completions
+ * become URB completions, as seen by the host. Payload data is not traced, so the URBs carry
+ * no data. The device address is tracked from SET_ADDRESS requests. Bus events have no
+ * usbmon representation and are skipped.
+ */
+class TracePcapWriter
+{
+public:
+    //! Converts the dump, returns the number of packets written or -1 if the dump is not valid
+    int Convert(const void* dump, size_t length);
+
+protected:
+    //! Called with consecutive chunks of the pcap file
+    virtual void Write(const void* data, size_t length) = 0;
+
+private:
+    void Packet(const TraceEvent& event, uint64_t time, uint64_t id, char eventType, uint8_t endpoint, uint8_t address, uint32_t urbLength);
+};
+
+}
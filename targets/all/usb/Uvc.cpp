@@ -0,0 +1,523 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Uvc.cpp
+ */
+
+#include <usb/Uvc.h>
+
+namespace usb
+{
+
+namespace
+{
+
+// finds the descriptors of an alternate setting, returns NULL if not found
+const InterfaceDescriptorHeader* FindAlternate(const ConfigDescriptorHeader* config, uint8_t interface, uint8_t alternate, const DescriptorHeader*& end)
+{
+    const InterfaceDescriptorHeader* found = NULL;
+    end = config->End();
+    for (auto d = config->Next(); d < config->End() && d->bLength; d = d->Next())
+    {
+        if (d->bDescriptorType != DescriptorType::Interface && d->bDescriptorType != DescriptorType::InterfaceAssociation)
+            continue;
+
+        if (found)
+        {
+            end = d;
+            break;
+        }
+
+        auto ifd = (const InterfaceDescriptorHeader*)d;
+        if (d->bDescriptorType == DescriptorType::Interface && ifd->bInterfaceNumber == interface && ifd->bAlternateSetting == alternate)
+            found = ifd;
+    }
+    return found;
+}
+
+const EndpointDescriptor* FindEndpoint(const InterfaceDescriptorHeader* ifd, const DescriptorHeader* end)
+{
+    for (auto d = ifd->Next(); d < end && d->bLength; d = d->Next())
+    {
+        if (d->bDescriptorType == DescriptorType::Endpoint)
+            return (const EndpointDescriptor*)d;
+    }
+    return NULL;
+}
+
+bool IsFormat(DescriptorSubType subType)
+{
+    return subType == DescriptorSubType::VideoFormatUncompressed || subType == DescriptorSubType::VideoFormatMjpeg;
+}
+
+bool IsFrame(DescriptorSubType subType)
+{
+    return subType == DescriptorSubType::VideoFrameUncompressed || subType == DescriptorSubType::VideoFrameMjpeg;
+}
+
+}
+
+/****** Uvc ******/
+
+bool Uvc::Open(const ConfigDescriptorHeader* config, uint8_t interface, Endpoint& data, Speed speed)
+{
+    Close();
+
+    const DescriptorHeader* end;
+    auto ifd = FindAlternate(config, interface, 0, end);
+    if (!ifd)
+        return false;
+
+    this->config = config;
+    this->interface = interface;
+    this->data = &data;
+    highSpeed = speed == Speed::High;
+    // bulk streaming uses the endpoint in alternate setting 0
+    bulk = FindEndpoint(ifd, end);
+
+    probe = {};
+    Negotiate(probe);
+    committed = probe;
+    return true;
+}
+
+void Uvc::Close()
+{
+    Stop();
+    config = NULL;
+    data = NULL;
+    alternate = 0;
+}
+
+bool Uvc::Negotiate(VideoProbeCommit& p) const
+{
+    const DescriptorHeader* end;
+    auto ifd = config ? FindAlternate(config, interface, 0, end) : NULL;
+    if (!ifd)
+        return false;
+
+    const VideoFrameDescriptor* frame = NULL;
+    uint8_t format = 0;
+    for (auto d = ifd->Next(); d < end && d->bLength && !frame; d = d->Next())
+    {
+        if (d->bDescriptorType != DescriptorType::ClassSpecificInterface || d->bLength < sizeof(VideoFormatDescriptor))
+            continue;
+
+        auto fmt = (const VideoFormatDescriptor*)d;
+        if (IsFormat(fmt->bDescriptorSubtype))
+        {
+            // zero indexes select the first format and its default frame
+            format = fmt->bFormatIndex;
+            if (!p.bFormatIndex)
+                p.bFormatIndex = format;
+            if (format == p.bFormatIndex && !p.bFrameIndex)
+                p.bFrameIndex = fmt->DefaultFrame();
+        }
+        else if (IsFrame(fmt->bDescriptorSubtype) && d->bLength >= sizeof(VideoFrameDescriptor) && format == p.bFormatIndex &&
+            ((const VideoFrameDescriptor*)d)->bFrameIndex == p.bFrameIndex)
+        {
+            frame = (const VideoFrameDescriptor*)d;
+        }
+    }
+
+    if (!frame)
+        return false;
+
+    // snap to the nearest supported interval
+    uint32_t interval = p.dwFrameInterval ? p.dwFrameInterval : frame->dwDefaultFrameInterval;
+    unsigned n = frame->Intervals();
+    if (frame->bFrameIntervalType)
+    {
+        uint32_t best = frame->dwDefaultFrameInterval, distance = ~0u;
+        for (unsigned i = 0; i < n; i++)
+        {
+            uint32_t value = frame->Interval(i);
+            uint32_t d = value > interval ? value - interval : interval - value;
+            if (d < distance)
+            {
+                best = value;
+                distance = d;
+            }
+        }
+        interval = best;
+    }
+    else if (n == 3)
+    {
+        uint32_t min = frame->Interval(0), max = frame->Interval(1), step = frame->Interval(2);
+        interval = interval < min ? min : interval > max ? max : interval;
+        if (step)
+            interval = min + (interval - min + step / 2) / step * step;
+        if (interval > max)
+            interval = max;
+    }
+
+    p.dwFrameInterval = interval;
+    p.wKeyFrameRate = p.wPFrameRate = p.wCompQuality = p.wCompWindowSize = 0;
+    p.wDelay = 0;
+    p.dwMaxVideoFrameSize = frame->dwMaxVideoFrameBufferSize;
+    p.dwClockFrequency = clockFrequency;
+    p.bmFramingInfo = 3;
+    p.bPreferedVersion = p.bMinVersion = p.bMaxVersion = 0;
+
+    if (bulk)
+    {
+        // the whole frame is a single payload
+        p.dwMaxPayloadTransferSize = p.dwMaxVideoFrameSize + HeaderLength();
+        return true;
+    }
+
+    // the smallest alternate setting carrying the frame within the frame interval, or the largest one
+    uint32_t best = 0, largest = 0;
+    uint8_t exponent;
+    for (unsigned alt = 1; alt < 256; alt++)
+    {
+        uint32_t capacity = Capacity(alt, &exponent);
+        if (!capacity)
+            break;
+
+        uint32_t packets = uint64_t(interval) * (highSpeed ? 8000 : 1000) / (10000000ull << (exponent - 1));
+        uint32_t needed = (p.dwMaxVideoFrameSize + (packets ? packets : 1) - 1) / (packets ? packets : 1) + HeaderLength();
+        if (capacity >= needed && (!best || capacity < best))
+            best = capacity;
+        if (capacity > largest)
+            largest = capacity;
+    }
+
+    p.dwMaxPayloadTransferSize = best ? best : largest;
+    return true;
+}
+
+uint32_t Uvc::Capacity(uint8_t alternate, uint8_t* exponent) const
+{
+    const DescriptorHeader* end;
+    auto ifd = config && alternate ? FindAlternate(config, interface, alternate, end) : NULL;
+    auto epd = ifd ? FindEndpoint(ifd, end) : NULL;
+    if (!epd || epd->Type() != EndpointType::Isochronous)
+        return 0;
+
+    // packets are sent every 2^(bInterval-1) (micro)frames
+    if (exponent)
+        *exponent = epd->bInterval ? epd->bInterval : 1;
+    return epd->MaxPacketSize() * epd->Transactions();
+}
+
+bool Uvc::SetAlternate(uint8_t alternate)
+{
+    if (alternate && (bulk || !Capacity(alternate)))
+        return false;
+    Stop();
+    this->alternate = alternate;
+    if (alternate)
+        Start();
+    return true;
+}
+
+ControlResult Uvc::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    auto control = VideoStreamingControl(setup.wValue >> 8);
+    if (control != VideoStreamingControl::Probe && control != VideoStreamingControl::Commit)
+        return ControlResult::Stall();
+
+    switch (setup.bRequest)
+    {
+        case SetupPacket::ClassVideoSetCur:
+            if (stage == ControlStage::Setup)
+            {
+                // UVC 1.0 hosts send only the first 26 bytes
+                if (setup.wLength < offsetof(VideoProbeCommit, dwClockFrequency) || setup.wLength > sizeof(VideoProbeCommit))
+                    break;
+                request = {};
+                return ControlResult::Out(&request, setup.wLength);
+            }
+
+            if (!Negotiate(request))
+                break;
+            if (control == VideoStreamingControl::Probe)
+            {
+                probe = request;
+            }
+            else
+            {
+                committed = request;
+                // the isochronous stream starts when the host selects the alternate setting
+                if (bulk)
+                    Start();
+            }
+            return ControlResult::Ack();
+
+        case SetupPacket::ClassVideoGetCur:
+            return ControlResult::In(control == VideoStreamingControl::Probe ? &probe : &committed, sizeof(VideoProbeCommit));
+
+        case SetupPacket::ClassVideoGetMin:
+        case SetupPacket::ClassVideoGetMax:
+        case SetupPacket::ClassVideoGetDef:
+            // any supported combination can be selected, report the default one
+            if (control != VideoStreamingControl::Probe)
+                break;
+            response = {};
+            Negotiate(response);
+            return ControlResult::In(&response, sizeof(VideoProbeCommit));
+
+        case SetupPacket::ClassVideoGetLen:
+            return ControlResult::In(&length, 2);
+
+        case SetupPacket::ClassVideoGetInfo:
+            return ControlResult::In(&info, 1);
+
+        default:
+            return ControlResult::Unhandled();
+    }
+
+    return ControlResult::Stall();
+}
+
+bool Uvc::Start()
+{
+    Stop();
+    if (!data)
+        return false;
+
+    payloadSize = committed.dwMaxPayloadTransferSize;
+    if (!bulk)
+    {
+        uint32_t capacity = Capacity(alternate);
+        if (capacity < payloadSize)
+            payloadSize = capacity;
+    }
+
+    if (payloadSize <= HeaderLength())
+        return false;
+
+    streaming = true;
+    return true;
+}
+
+void Uvc::Stop()
+{
+    streaming = false;
+    if (data)
+        data->Cancel();
+
+    // all queued payloads are cancelled now
+    Reclaim();
+
+    // the partially queued frame and the frames not started yet are dropped
+    if (current)
+    {
+        Finish(*current, TransferStatus::Cancelled);
+        current = NULL;
+    }
+
+    while (pending)
+    {
+        auto frame = pending;
+        pending = frame->next;
+        Finish(*frame, TransferStatus::Cancelled);
+    }
+    pendingTail = NULL;
+}
+
+void Uvc::Submit(VideoFrame& frame)
+{
+    frame.next = NULL;
+    frame.status = TransferStatus::Pending;
+    frame.done = false;
+
+    if (!streaming)
+    {
+        Finish(frame, TransferStatus::Cancelled);
+        return;
+    }
+
+    if (pendingTail)
+        pendingTail->next = &frame;
+    else
+        pending = &frame;
+    pendingTail = &frame;
+
+    Fill();
+}
+
+void Uvc::Poll(uint32_t clock, uint16_t sof)
+{
+    this->clock = clock;
+    this->sof = sof;
+    Reclaim();
+    Fill();
+}
+
+void Uvc::Finish(VideoFrame& frame, TransferStatus status)
+{
+    if (status == TransferStatus::Complete)
+        stats.frames++;
+    else
+        stats.dropped++;
+
+    frame.status = status;
+    frame.done = true;
+}
+
+void Uvc::Reclaim()
+{
+    // payloads of a single endpoint complete in order
+    while (slots[tail].frame && slots[tail].transfer.done)
+    {
+        auto& s = slots[tail];
+        if (s.last)
+            Finish(*s.frame, s.transfer.status);
+        s.frame = NULL;
+        if (++tail == count)
+            tail = 0;
+    }
+}
+
+void Uvc::Skip()
+{
+    while (segment < current->count && offset == current->segments[segment].length)
+    {
+        segment++;
+        offset = 0;
+    }
+}
+
+void Uvc::Fill()
+{
+    uint8_t headerLength = HeaderLength();
+
+    while (streaming && !slots[head].frame)
+    {
+        if (!current)
+        {
+            if (!pending)
+                break;
+
+            current = pending;
+            pending = current->next;
+            if (!pending)
+                pendingTail = NULL;
+            segment = offset = 0;
+            fid ^= 1;
+            Skip();
+        }
+
+        // payloads do not cross segment boundaries, so the data is sent directly from the frame
+        const uint8_t* p = NULL;
+        size_t n = 0;
+        if (segment < current->count)
+        {
+            auto& seg = current->segments[segment];
+            size_t space = payloadSize - headerLength;
+            p = seg.data + offset;
+            n = seg.length - offset < space ? seg.length - offset : space;
+            offset += n;
+            Skip();
+        }
+        bool last = segment == current->count;
+
+        auto& s = slots[head];
+        auto info = VideoPayloadInfo(fid) | VideoPayloadInfo::EndOfHeader;
+        if (last)
+            info = info | VideoPayloadInfo::EndOfFrame;
+        s.header[0] = headerLength;
+        if (clockFrequency)
+        {
+            info = info | VideoPayloadInfo::Pts | VideoPayloadInfo::Scr;
+            uint16_t frameNumber = sof & 0x7FF;
+            memcpy(s.header + 2, &current->pts, 4);
+            memcpy(s.header + 6, &clock, 4);
+            memcpy(s.header + 10, &frameNumber, 2);
+        }
+        s.header[1] = uint8_t(info);
+
+        // a short bulk payload must be terminated, so the host does not wait for the rest of it
+        s.transfer.Setup(p, n, bulk && n + headerLength < payloadSize);
+        s.transfer.SetHeader(s.header, headerLength);
+        s.frame = current;
+        s.last = last;
+        if (++head == count)
+            head = 0;
+
+        stats.payloads++;
+        stats.bytes += n;
+        if (last)
+            current = NULL;
+        data->Submit(s.transfer);
+    }
+}
+
+/****** VideoTestPattern ******/
+
+void VideoTestPattern::Yuy2(uint8_t* buffer, uint16_t width, uint16_t height)
+{
+    // 75% color bars in BT.601 Y, U, V
+    static const uint8_t bars[8][3] = {
+        { 180, 128, 128 }, { 162, 44, 142 }, { 131, 156, 44 }, { 112, 72, 58 },
+        { 84, 184, 198 }, { 65, 100, 212 }, { 35, 212, 114 }, { 16, 128, 128 },
+    };
+
+    uint32_t line = uint32_t(width) * 2;
+    for (unsigned y = 0; y < 2u * height; y++)
+    {
+        auto& bar = bars[(y % height) * 8 / height];
+        uint8_t* p = buffer + y * line;
+        for (unsigned x = 0; x < width / 2u; x++, p += 4)
+        {
+            p[0] = bar[0];
+            p[1] = bar[1];
+            p[2] = bar[0];
+            p[3] = bar[2];
+        }
+    }
+
+    this->buffer = buffer;
+    frameSize = line * height;
+    stride = line;
+    steps = height;
+    n = 0;
+}
+
+void VideoTestPattern::Mjpeg(uint8_t* buffer, uint32_t size)
+{
+    // SOI, comment segments filling the frame, EOI
+    uint8_t* p = buffer;
+    uint8_t* end = buffer + size - 2;
+    *p++ = 0xFF;
+    *p++ = 0xD8;
+    while (p < end)
+    {
+        size_t n = end - p;
+        if (n < 4)
+        {
+            // too short for a segment, pad with fill bytes allowed before a marker
+            memset(p, 0xFF, n);
+            break;
+        }
+
+        size_t segment = n - 2 < 0xFFFF ? n - 2 : 0xFFFF;
+        p[0] = 0xFF;
+        p[1] = 0xFE;
+        p[2] = segment >> 8;
+        p[3] = segment;
+        memset(p + 4, 0, segment - 2);
+        p += segment + 2;
+    }
+    end[0] = 0xFF;
+    end[1] = 0xD9;
+
+    this->buffer = buffer;
+    frameSize = size;
+    stride = 0;
+    steps = 1;
+    n = 0;
+}
+
+void VideoTestPattern::Next(VideoFrame& frame, uint32_t pts)
+{
+    frame.Setup(buffer + (n % steps) * stride, frameSize);
+    frame.pts = pts;
+    n++;
+}
+
+}
@@ -0,0 +1,564 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Uvc.h
+ *
+ * USB Video Class 1.1 streaming function
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Endpoint.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Video terminal types
+enum struct VideoTerminal : uint16_t
+{
+    UsbStreaming = 0x0101,      //!< USB streaming terminal
+    VendorInput = 0x0200,       //!< Vendor-specific input terminal
+    Camera = 0x0201,            //!< Camera sensor, see VideoCameraTerminal
+    MediaTransport = 0x0202,    //!< Sequential media input
+    VendorOutput = 0x0300,      //!< Vendor-specific output terminal
+    Display = 0x0301,           //!< Generic display
+};
+
+//! Controls of the VideoStreaming interface, in the high byte of wValue
+enum struct VideoStreamingControl : uint8_t
+{
+    Probe = 1,      //!< Negotiation of the streaming parameters, VideoProbeCommit
+    Commit = 2,     //!< Selection of the negotiated parameters, VideoProbeCommit
+};
+
+//! GUID identifying an uncompressed video format
+struct VideoGuid
+{
+    uint8_t data[16];
+};
+
+//! Creates the GUID of an uncompressed format identified by a FourCC code, e.g. VideoFourcc('Y', 'U', 'Y', '2') or VideoFourcc('N', 'V', '1', '2')
+constexpr VideoGuid VideoFourcc(char a, char b, char c, char d)
+{
+    return { { uint8_t(a), uint8_t(b), uint8_t(c), uint8_t(d), 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+}
+
+//! Gets the frame interval in 100 ns units for the specified frame rate
+constexpr uint32_t VideoInterval(uint32_t fps) { return 10000000 / fps; }
+
+//! Creates a generic Input Terminal descriptor
+constexpr auto VideoInputTerminal(uint8_t id, VideoTerminal type, uint8_t assocTerminal = 0, uint8_t strName = 0)
+{
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoInputTerminal, id, type, assocTerminal, strName);
+}
+
+//! Creates a Camera Terminal descriptor, by default without any controls
+constexpr auto VideoCameraTerminal(uint8_t id, uint16_t controls = 0, uint8_t strName = 0)
+{
+    // no optical zoom, two bytes of controls
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoInputTerminal, id, VideoTerminal::Camera, uint8_t(0), strName,
+        uint16_t(0), uint16_t(0), uint16_t(0), uint8_t(2), controls);
+}
+
+//! Creates a Processing Unit descriptor, by default without any controls
+constexpr auto VideoProcessingUnit(uint8_t id, uint8_t sourceId, uint16_t controls = 0, uint8_t strName = 0)
+{
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoProcessingUnit, id, sourceId, uint16_t(0), uint8_t(2), controls, strName, uint8_t(0));
+}
+
+//! Creates an Output Terminal descriptor
+constexpr auto VideoOutputTerminal(uint8_t id, VideoTerminal type, uint8_t sourceId, uint8_t assocTerminal = 0, uint8_t strName = 0)
+{
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoOutputTerminal, id, type, assocTerminal, sourceId, strName);
+}
+
+//! Creates a VideoControl interface with the specified terminal and unit descriptors
+/*!
+ * The class-specific header, including the total length of the @p entities, is generated automatically.
+ * @p clockFrequency is the frequency of the device clock used for the timestamps in the payload headers.
+ * The optional status interrupt endpoint is not used.
+ */
+template<typename... TEntities> constexpr auto VideoControlInterface(uint8_t interface, uint8_t streamingInterface, uint32_t clockFrequency, uint8_t strName, const TEntities&... entities)
+{
+    uint16_t total = sizeof(CustomDescriptor<DescriptorSubType, uint16_t, uint16_t, uint32_t, uint8_t, uint8_t>) + (sizeof(TEntities) + ... + 0);
+    return InterfaceDescriptor(interface, 0, InterfaceClass::Video, SubClass::VideoControl, Protocol::None, strName,
+        ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoHeader, uint16_t(0x0110), total, clockFrequency, uint8_t(1), streamingInterface),
+        entities...);
+}
+
+// uncompressed and MJPEG frame descriptors share the same layout
+template<typename... TIntervals> constexpr auto _VideoFrame(DescriptorSubType subType, uint8_t index, uint16_t width, uint16_t height, uint32_t frameSize,
+    uint32_t interval, const TIntervals&... more)
+{
+    uint32_t shortest = interval, longest = interval;
+    ((shortest = uint32_t(more) < shortest ? uint32_t(more) : shortest, longest = uint32_t(more) > longest ? uint32_t(more) : longest), ...);
+    // bit rates at the lowest and highest frame rate, the first interval is the default
+    return ClassSpecificInterfaceDescriptor(subType, index, uint8_t(0), width, height,
+        uint32_t(uint64_t(frameSize) * 80000000 / longest), uint32_t(uint64_t(frameSize) * 80000000 / shortest),
+        frameSize, interval, uint8_t(1 + sizeof...(more)), interval, uint32_t(more)...);
+}
+
+//! Creates an Uncompressed Frame descriptor with the specified discrete frame intervals (see VideoInterval), the first one is the default
+template<typename... TIntervals> constexpr auto VideoFrameUncompressed(uint8_t index, uint16_t width, uint16_t height, uint8_t bitsPerPixel,
+    uint32_t interval, const TIntervals&... more)
+{
+    return _VideoFrame(DescriptorSubType::VideoFrameUncompressed, index, width, height, uint32_t(width) * height * bitsPerPixel / 8, interval, more...);
+}
+
+//! Creates an MJPEG Frame descriptor with the specified discrete frame intervals (see VideoInterval), the first one is the default
+template<typename... TIntervals> constexpr auto VideoFrameMjpeg(uint8_t index, uint16_t width, uint16_t height, uint32_t maxFrameSize,
+    uint32_t interval, const TIntervals&... more)
+{
+    return _VideoFrame(DescriptorSubType::VideoFrameMjpeg, index, width, height, maxFrameSize, interval, more...);
+}
+
+//! Creates an Uncompressed Format descriptor followed by its frame descriptors, the first frame is the default
+template<typename... TFrames> constexpr auto VideoFormatUncompressed(uint8_t index, const VideoGuid& guid, uint8_t bitsPerPixel, const TFrames&... frames)
+{
+    return DescriptorGroup(
+        // default frame, no aspect ratio, progressive, no copy protection
+        ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoFormatUncompressed, index, uint8_t(sizeof...(frames)), guid, bitsPerPixel,
+            uint8_t(1), uint8_t(0), uint8_t(0), uint8_t(0), uint8_t(0)),
+        frames...);
+}
+
+//! Creates an MJPEG Format descriptor followed by its frame descriptors, the first frame is the default
+template<typename... TFrames> constexpr auto VideoFormatMjpeg(uint8_t index, const TFrames&... frames)
+{
+    return DescriptorGroup(
+        // variable size samples, default frame, no aspect ratio, progressive, no copy protection
+        ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoFormatMjpeg, index, uint8_t(sizeof...(frames)), uint8_t(0),
+            uint8_t(1), uint8_t(0), uint8_t(0), uint8_t(0), uint8_t(0)),
+        frames...);
+}
+
+//! Creates a Color Matching descriptor, by default BT.709 primaries and transfer characteristics with SMPTE 170M (BT.601) matrix coefficients
+/*!
+ * Should be grouped with the format it applies to, e.g. DescriptorGroup(VideoFormatUncompressed(...), VideoColorMatching())
+ */
+constexpr auto VideoColorMatching(uint8_t primaries = 1, uint8_t transfer = 1, uint8_t matrix = 4)
+{
+    return ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoColorFormat, primaries, transfer, matrix);
+}
+
+template<typename T> constexpr uint8_t _Zero(const T&) { return 0; }
+
+// distinct type of the input header, so Composite can renumber the endpoint address it contains
+template<typename... TContent> PACKED_UNALIGNED_STRUCT _VideoInputHeaderBlock : CustomDescriptor<DescriptorSubType, TContent...>
+{
+    constexpr _VideoInputHeaderBlock(const CustomDescriptor<DescriptorSubType, TContent...>& header)
+        : CustomDescriptor<DescriptorSubType, TContent...>(header) {}
+
+    // bNumFormats and wTotalLength precede the endpoint address
+    constexpr uint8_t EndpointAddress() const { return this->content.rest.rest.rest.first; }
+};
+
+template<typename... TContent, typename TFn> constexpr void _RenumberEndpointReferences(const _VideoInputHeaderBlock<TContent...>& header, TFn& renumber)
+{
+    const_cast<_VideoInputHeaderBlock<TContent...>&>(header).content.rest.rest.rest.first = renumber(header.EndpointAddress());
+}
+
+// the input header lists the formats, with no controls for any of them
+template<typename... TFormats> constexpr auto _VideoInputHeader(uint8_t endpointAddress, uint8_t terminalLink, const TFormats&... formats)
+{
+    auto header = ClassSpecificInterfaceDescriptor(DescriptorSubType::VideoInputHeader, uint8_t(sizeof...(TFormats)), uint16_t(0), endpointAddress,
+        uint8_t(0), terminalLink, uint8_t(0), uint8_t(0), uint8_t(0), uint8_t(1), _Zero(formats)...);
+    header.content.rest.rest.first = sizeof(header) + (sizeof(TFormats) + ... + 0);
+    return _VideoInputHeaderBlock(header);
+}
+
+//! Creates a VideoStreaming interface sending the @p formats over the bulk endpoint @p data
+template<typename... TFormats> constexpr auto VideoStreamingBulk(uint8_t interface, uint8_t terminalLink, const EndpointDescriptor& data, uint8_t strName,
+    const TFormats&... formats)
+{
+    return InterfaceDescriptor(interface, 0, InterfaceClass::Video, SubClass::VideoStreaming, Protocol::None, strName,
+        _VideoInputHeader(data.bEndpointAddress, terminalLink, formats...),
+        formats...,
+        data);
+}
+
+//! Creates alternate setting 0 of a VideoStreaming interface sending the @p formats over isochronous IN endpoint @p endpoint
+/*!
+ * The endpoint itself is only present in the alternate settings created using VideoIsoAlternate, which
+ * have to follow in increasing order of bandwidth, e.g.:
+ *
+ *     DescriptorGroup(
+ *         VideoStreamingIso(1, 2, 1, 0, VideoFormatUncompressed(1, VideoFourcc('Y', 'U', 'Y', '2'), 16, ...)),
+ *         VideoIsoAlternate(1, 1, VideoIsoEndpoint(1, 1024)),
+ *         VideoIsoAlternate(1, 2, VideoIsoEndpoint(1, 3072)))
+ */
+template<typename... TFormats> constexpr auto VideoStreamingIso(uint8_t interface, uint8_t terminalLink, uint8_t endpoint, uint8_t strName,
+    const TFormats&... formats)
+{
+    return InterfaceDescriptor(interface, 0, InterfaceClass::Video, SubClass::VideoStreaming, Protocol::None, strName,
+        _VideoInputHeader(0x80 | endpoint, terminalLink, formats...),
+        formats...);
+}
+
+//! Creates an alternate setting of a VideoStreaming interface containing the isochronous endpoint @p data
+constexpr auto VideoIsoAlternate(uint8_t interface, uint8_t alternate, const EndpointDescriptor& data, uint8_t strName = 0)
+{
+    return InterfaceDescriptor(interface, alternate, InterfaceClass::Video, SubClass::VideoStreaming, Protocol::None, strName, data);
+}
+
+//! Creates an asynchronous isochronous IN endpoint transferring @p payloadSize bytes per (micro)frame
+/*!
+ * Payloads over 1024 bytes use high-bandwidth transactions, so up to 3072 bytes fit in a microframe.
+ * The endpoint is specified for high speed (see EndpointForSpeed).
+ */
+constexpr EndpointDescriptor VideoIsoEndpoint(uint8_t number, unsigned payloadSize, uint8_t interval = 1)
+{
+    unsigned transactions = payloadSize > 2048 ? 3 : payloadSize > 1024 ? 2 : 1;
+    return EndpointDescriptor::IsochronousIn(number, (payloadSize + transactions - 1) / transactions, interval).HighBandwidth(transactions);
+}
+
+//! Combines the VideoControl and VideoStreaming interfaces into a single function using an InterfaceAssociationDescriptor
+/*!
+ * When used in a Composite, the endpoint address in the VideoStreaming input header is renumbered along with the endpoint itself
+ */
+template<typename TControl, typename TStreaming> constexpr auto VideoFunction(uint8_t interface, uint8_t strName, const TControl& control, const TStreaming& streaming)
+{
+    return DescriptorGroup(
+        InterfaceAssociationDescriptor(interface, 2, InterfaceClass::Video, SubClass::VideoInterfaceCollection, Protocol::None, strName),
+        control,
+        streaming);
+}
+
+//! Common header of the Uncompressed and MJPEG Format descriptors
+PACKED_UNALIGNED_STRUCT VideoFormatDescriptor : DescriptorHeader
+{
+    DescriptorSubType bDescriptorSubtype;   //!< Format descriptor subtype
+    uint8_t bFormatIndex;                   //!< Index of the format
+    uint8_t bNumFrameDescriptors;           //!< Number of the frame descriptors following the format
+
+    //! Gets the index of the default frame
+    uint8_t DefaultFrame() const
+    {
+        size_t offset = bDescriptorSubtype == DescriptorSubType::VideoFormatUncompressed ? 22 : 6;
+        return bLength > offset ? ((const uint8_t*)this)[offset] : 1;
+    }
+};
+
+//! Layout shared by the Uncompressed and MJPEG Frame descriptors
+PACKED_UNALIGNED_STRUCT VideoFrameDescriptor : DescriptorHeader
+{
+    DescriptorSubType bDescriptorSubtype;   //!< Frame descriptor subtype
+    uint8_t bFrameIndex;                    //!< Index of the frame within its format
+    uint8_t bmCapabilities;                 //!< Still image and fixed frame rate capabilities
+    uint16_t wWidth;                        //!< Width in pixels
+    uint16_t wHeight;                       //!< Height in pixels
+    uint32_t dwMinBitRate;                  //!< Bit rate at the longest frame interval
+    uint32_t dwMaxBitRate;                  //!< Bit rate at the shortest frame interval
+    uint32_t dwMaxVideoFrameBufferSize;     //!< Maximum size of a frame in bytes
+    uint32_t dwDefaultFrameInterval;        //!< Default frame interval in 100 ns units
+    uint8_t bFrameIntervalType;             //!< Number of discrete intervals, zero for a continuous range
+
+    //! Gets the number of intervals present in the descriptor (three for a continuous range)
+    unsigned Intervals() const
+    {
+        unsigned n = bFrameIntervalType ? bFrameIntervalType : 3;
+        unsigned fit = bLength > sizeof(VideoFrameDescriptor) ? (bLength - sizeof(VideoFrameDescriptor)) / 4 : 0;
+        return n < fit ? n : fit;
+    }
+
+    //! Gets the discrete interval, or the minimum, maximum and step of a continuous range, with the specified index
+    uint32_t Interval(unsigned i) const
+    {
+        uint32_t res;
+        memcpy(&res, (const uint8_t*)(this + 1) + i * 4, 4);
+        return res;
+    }
+};
+
+//! Class-specific VideoStreaming input header
+PACKED_UNALIGNED_STRUCT VideoInputHeaderDescriptor : DescriptorHeader
+{
+    DescriptorSubType bDescriptorSubtype;   //!< DescriptorSubType::VideoInputHeader
+    uint8_t bNumFormats;                    //!< Number of formats
+    uint16_t wTotalLength;                  //!< Length of the header and all format and frame descriptors
+    uint8_t bEndpointAddress;               //!< Address of the bulk or isochronous endpoint carrying the video data
+    uint8_t bmInfo;                         //!< Capabilities
+    uint8_t bTerminalLink;                  //!< Output terminal the endpoint is connected to
+};
+
+//! Video probe and commit control, in the UVC 1.1 layout
+/*!
+ * UVC 1.0 hosts only transfer the fields up to and including dwMaxPayloadTransferSize (26 bytes)
+ */
+PACKED_UNALIGNED_STRUCT VideoProbeCommit
+{
+    uint16_t bmHint;                    //!< Fields the host wants kept fixed during negotiation
+    uint8_t bFormatIndex;               //!< Index of the format, zero to select the first one
+    uint8_t bFrameIndex;                //!< Index of the frame, zero to select the default one of the format
+    uint32_t dwFrameInterval;           //!< Frame interval in 100 ns units, zero to select the default one
+    uint16_t wKeyFrameRate;             //!< Key frame rate (unused)
+    uint16_t wPFrameRate;               //!< P-frame rate (unused)
+    uint16_t wCompQuality;              //!< Compression quality (unused)
+    uint16_t wCompWindowSize;           //!< Compression window size (unused)
+    uint16_t wDelay;                    //!< Internal latency of the device in milliseconds
+    uint32_t dwMaxVideoFrameSize;       //!< Maximum size of a frame in bytes
+    uint32_t dwMaxPayloadTransferSize;  //!< Maximum size of a payload, including its header
+    uint32_t dwClockFrequency;          //!< Frequency of the clock used for the timestamps in the payload headers
+    uint8_t bmFramingInfo;              //!< FID and EOF bits are used in the payload headers
+    uint8_t bPreferedVersion;           //!< Preferred payload format version (unused)
+    uint8_t bMinVersion;                //!< Minimum payload format version (unused)
+    uint8_t bMaxVersion;                //!< Maximum payload format version (unused)
+};
+
+//! Bits of the second byte of the payload header
+enum struct VideoPayloadInfo : uint8_t
+{
+    FrameId = BIT(0),       //!< Toggled at the start of every frame
+    EndOfFrame = BIT(1),    //!< Last payload of the frame
+    Pts = BIT(2),           //!< Presentation time stamp present
+    Scr = BIT(3),           //!< Source clock reference present
+    Still = BIT(5),         //!< Still image
+    Error = BIT(6),         //!< Error in the payload
+    EndOfHeader = BIT(7),   //!< Last header of the payload
+};
+
+DEFINE_FLAG_ENUM(VideoPayloadInfo);
+
+//! Contiguous part of a VideoFrame
+struct VideoSegment
+{
+    const uint8_t* data;    //!< Data of the segment
+    size_t length;          //!< Length of the segment
+};
+
+//! Frame sent by Uvc, owned by the caller
+/*!
+ * The frame may consist of any number of segments (e.g. lines written by separate DMA transfers),
+ * which are sent directly from their buffers. The structure and the data must remain valid until
+ * the frame is completed or dropped, which is signalled by the @ref done flag.
+ */
+struct VideoFrame
+{
+    const VideoSegment* segments;       //!< Segments of the frame
+    size_t count;                       //!< Number of segments
+    VideoSegment single;                //!< Segment used by Setup(const void*, size_t)
+    uint32_t pts;                       //!< Presentation time stamp, in units of the clock passed to Uvc::Poll
+    volatile bool done;                 //!< Set when the frame is no longer pending, can be used with await_signal
+    volatile TransferStatus status;     //!< Complete if the frame was sent, Cancelled if it was dropped
+    VideoFrame* next;                   //!< Next frame in the queue
+
+    //! Prepares a frame stored in a single contiguous buffer
+    void Setup(const void* data, size_t length)
+    {
+        single = { (const uint8_t*)data, length };
+        segments = &single;
+        count = 1;
+    }
+
+    //! Prepares a frame consisting of multiple segments
+    void Setup(const VideoSegment* segments, size_t count)
+    {
+        this->segments = segments;
+        this->count = count;
+    }
+};
+
+//! Statistics of a video stream
+struct VideoStreamStats
+{
+    uint32_t frames;    //!< Frames sent
+    uint32_t dropped;   //!< Frames dropped because the stream was not running or was stopped
+    uint32_t payloads;  //!< Payloads sent, including the headers
+    uint64_t bytes;     //!< Bytes of frame data sent, excluding the headers
+};
+
+//! State of a UVC function, negotiates the stream parameters and sends the frames
+/*!
+ * The formats, frames and isochronous alternate settings are read from the configuration passed
+ * to Open(). PROBE requests are negotiated to the nearest supported values: the frame interval is
+ * snapped to the nearest discrete interval of the frame, and dwMaxPayloadTransferSize is the whole
+ * frame for bulk streaming, or the capacity of the smallest isochronous alternate setting able to
+ * carry the frame within the frame interval (or the largest one if none can). The bulk stream starts
+ * when the host sends COMMIT, the isochronous stream when the host selects a non-zero alternate setting.
+ *
+ * Frames are sent without copying: each payload is a transfer of a @ref Slot, carrying the payload
+ * header from the slot (see EndpointTransfer::SetHeader) and the data directly from a segment of
+ * the frame. Payloads end at segment boundaries, so segments should not be much shorter than
+ * the payload size. All slots can be in flight at once, which keeps the bus busy while completed
+ * payloads are reclaimed by Poll().
+ *
+ * For isochronous streaming, the Endpoint must be created from the largest alternate setting,
+ * payloads are limited to the capacity of the alternate setting selected by the host. A bulk stream
+ * has to be stopped using Stop() when the host clears the halt of the endpoint.
+ *
+ * Submit(), Stop(), Poll() and HandleRequest() must follow the rules of Endpoint, i.e. run on
+ * the same scheduler as the controller driver.
+ */
+class Uvc
+{
+public:
+    //! Transfer slot of a single payload
+    struct Slot
+    {
+        EndpointTransfer transfer;  //!< Transfer of the payload data, pointing into the frame
+        VideoFrame* frame;          //!< Frame the payload belongs to, NULL if the slot is unused
+        bool last;                  //!< Last payload of the frame
+        uint8_t header[12];         //!< Payload header, sent in front of the data
+    };
+
+    //! Creates the function with @p count transfer slots, use UvcStorage to allocate them
+    /*!
+     * @p clockFrequency is the frequency of the clock passed to Poll(), the payload headers include
+     * the PTS and SCR timestamps if it is non-zero
+     */
+    Uvc(Slot* slots, size_t count, uint32_t clockFrequency = 0)
+        : slots(slots), count(count), clockFrequency(clockFrequency)
+    {
+        memset(slots, 0, count * sizeof(Slot));
+    }
+
+    //! Handles the PROBE and COMMIT requests of the VideoStreaming interface
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+    //! Selects an alternate setting of the VideoStreaming interface, to be called from DeviceState::OnSetInterface
+    /*!
+     * A non-zero alternate setting starts the isochronous stream, zero stops it
+     */
+    bool SetAlternate(uint8_t alternate);
+
+    //! Starts using the VideoStreaming interface @p interface of the selected configuration, to be called when the configuration is selected
+    /*!
+     * @p data is the bulk or isochronous IN endpoint of the interface, @p speed is the current bus speed
+     * @returns false if the configuration does not contain the interface
+     */
+    bool Open(const ConfigDescriptorHeader* config, uint8_t interface, Endpoint& data, Speed speed);
+    //! Stops the stream and returns to alternate setting 0, to be called when the configuration is deselected
+    void Close();
+    //! Stops the stream, dropping all frames
+    void Stop();
+
+    //! Queues a frame for sending, the frame is dropped immediately if the stream is not running
+    void Submit(VideoFrame& frame);
+    //! Reclaims the completed payloads and queues new ones
+    /*!
+     * @p clock is the current value of the device clock (see Uvc()), @p sof the current (micro)frame number,
+     * both are used for the SCR timestamp of the queued payloads. Frames are marked as done here.
+     */
+    void Poll(uint32_t clock = 0, uint16_t sof = 0);
+
+    //! Checks if the stream is running
+    bool Streaming() const { return streaming; }
+    //! Gets the committed stream parameters
+    const VideoProbeCommit& Committed() const { return committed; }
+    //! Gets the selected alternate setting
+    uint8_t Alternate() const { return alternate; }
+    //! Gets the size of the payloads sent, including the header
+    uint32_t PayloadSize() const { return payloadSize; }
+    //! Gets the statistics of the stream
+    const VideoStreamStats& Stats() const { return stats; }
+
+private:
+    Slot* slots;
+    uint8_t count;
+    uint8_t head = 0, tail = 0;     // next slot to be queued, next slot to be reclaimed
+    uint8_t interface = 0;
+    uint8_t alternate = 0;
+    uint8_t fid = 0;
+    bool bulk = false;
+    bool highSpeed = false;
+    bool streaming = false;
+    uint32_t clockFrequency;
+    uint32_t payloadSize = 0;
+    uint32_t clock = 0;
+    uint16_t sof = 0;
+    const ConfigDescriptorHeader* config = NULL;
+    Endpoint* data = NULL;
+    VideoFrame* pending = NULL;
+    VideoFrame* pendingTail = NULL;
+    VideoFrame* current = NULL;
+    size_t segment, offset;         // position in the current frame
+    VideoStreamStats stats = {};
+    VideoProbeCommit probe = {}, committed = {}, request, response;
+    uint16_t length = sizeof(VideoProbeCommit);
+    uint8_t info = 3;               // GET and SET supported
+
+    uint8_t HeaderLength() const { return clockFrequency ? 12 : 2; }
+    bool Negotiate(VideoProbeCommit& p) const;
+    uint32_t Capacity(uint8_t alternate, uint8_t* exponent = NULL) const;
+    bool Start();
+    void Skip();
+    void Fill();
+    void Reclaim();
+    void Finish(VideoFrame& frame, TransferStatus status);
+};
+
+//! Uvc with @p n payload transfer slots
+template<size_t n> class UvcStorage : public Uvc
+{
+    static_assert(n >= 2 && n < 256, "Unsupported number of transfer slots");
+
+public:
+    UvcStorage(uint32_t clockFrequency = 0)
+        : Uvc(slots, n, clockFrequency) {}
+
+private:
+    Slot slots[n];
+};
+
+//! Class-specific request handlers for a Uvc function, for use with a SetupDispatcher
+/*!
+ * @p uvc is the member of @p TContext holding the function state, @p interface is the number of the VideoStreaming interface.
+ * The alternate settings are selected by StandardRequests, @p TContext must forward DeviceState::OnSetInterface
+ * and DeviceState::OnGetInterface of the interface to Uvc::SetAlternate and Uvc::Alternate.
+ */
+template<typename TContext, typename TUvc, TUvc TContext::*uvc, uint8_t interface> struct UvcRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*uvc).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassVideoSetCur, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassVideoGetCur, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassVideoGetMin, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassVideoGetMax, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassVideoGetLen, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassVideoGetInfo, Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeClass, SetupPacket::RecipientInterface, SetupPacket::ClassVideoGetDef, Handle, interface),
+    };
+};
+
+//! Synthetic test pattern producing frames without copying or rendering, for benchmarking
+/*!
+ * The pattern is rendered once into a buffer holding two copies of the frame. Every frame is a window
+ * into the buffer, scrolled by one more line than the previous one, so successive frames differ
+ * but cost nothing to produce. The MJPEG pattern is a placeholder of fixed size consisting only
+ * of JPEG markers, which is enough to measure the frame rate but cannot be decoded.
+ */
+class VideoTestPattern
+{
+public:
+    //! Gets the size of the buffer needed for a YUY2 pattern
+    static constexpr size_t Yuy2BufferSize(uint16_t width, uint16_t height) { return size_t(width) * height * 4; }
+
+    //! Renders horizontal color bars of @p width x @p height pixels in YUY2, @p buffer must hold Yuy2BufferSize bytes
+    void Yuy2(uint8_t* buffer, uint16_t width, uint16_t height);
+    //! Renders a placeholder MJPEG frame of @p size bytes, @p buffer must hold @p size bytes
+    void Mjpeg(uint8_t* buffer, uint32_t size);
+
+    //! Sets up @p frame as the next frame of the pattern, with the specified presentation time stamp
+    void Next(VideoFrame& frame, uint32_t pts = 0);
+
+    //! Gets the size of a single frame
+    uint32_t FrameSize() const { return frameSize; }
+
+private:
+    const uint8_t* buffer = NULL;
+    uint32_t frameSize = 0;
+    uint32_t stride = 0;    // bytes the window moves by every frame
+    uint32_t steps = 1;     // frames before the window returns to the start
+    uint32_t n = 0;
+};
+
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/UvcHost.cpp
+ */
+
+#include <usb/UvcHost.h>
+#include <usb/Benchmark.h>
+
+namespace usb
+{
+
+/****** VideoReceiver ******/
+
+void VideoReceiver::Reset(uint32_t frameSize)
+{
+    *this = VideoReceiver();
+    expected = frameSize;
+}
+
+bool VideoReceiver::Complete()
+{
+    frames++;
+    if (failed || (expected && size != expected))
+        errors++;
+    lastSize = size;
+    lastPts = pts;
+    lastHasPts = hasPts;
+    size = 0;
+    hasPts = false;
+    active = failed = false;
+    finished = true;
+    return true;
+}
+
+bool VideoReceiver::Payload(const uint8_t* data, size_t length)
+{
+    if (length < 2 || data[0] < 2 || data[0] > length)
+    {
+        errors++;
+        return false;
+    }
+
+    auto info = VideoPayloadInfo(data[1]);
+    uint8_t id = !!(info & VideoPayloadInfo::FrameId);
+    bool completed = false;
+
+    if (id != fid)
+    {
+        // a toggled FrameId ends the previous frame, even without EndOfFrame
+        if (active)
+            completed = Complete();
+        fid = id;
+        finished = false;
+    }
+    else if (finished)
+    {
+        // repeated header of the finished frame
+        return false;
+    }
+
+    active = true;
+    payloads++;
+    size += length - data[0];
+    bytes += length - data[0];
+    if (!!(info & VideoPayloadInfo::Error))
+        failed = true;
+    if (!!(info & VideoPayloadInfo::Pts) && data[0] >= 6)
+    {
+        memcpy(&pts, data + 2, 4);
+        hasPts = true;
+    }
+
+    if (!!(info & VideoPayloadInfo::EndOfFrame))
+        completed = Complete();
+
+    return completed;
+}
+
+/****** UvcRunner ******/
+
+bool UvcRunner::Attach(const HostConfig& config, uint8_t interface)
+{
+    this->config = &config;
+    this->interface = interface;
+    address = 0;
+
+    index = config.FindInterface(interface, 0);
+    if (index < 0 || config.Interface(index)->bInterfaceClass != InterfaceClass::Video)
+        return false;
+
+    auto header = config.Find<VideoInputHeaderDescriptor>(index, DescriptorType::ClassSpecificInterface, DescriptorSubType::VideoInputHeader);
+    if (!header)
+        return false;
+
+    address = header->bEndpointAddress;
+    // bulk streaming uses the endpoint in alternate setting 0
+    bulk = config.Endpoint(index, 0);
+    return true;
+}
+
+uint8_t UvcRunner::SelectAlternate(uint32_t payloadSize, uint32_t& capacity) const
+{
+    uint8_t best = 0;
+    capacity = 0;
+    for (unsigned alt = 1; alt < 256; alt++)
+    {
+        int i = config->FindInterface(interface, alt);
+        if (i < 0)
+            break;
+
+        auto epd = config->Endpoint(i, 0);
+        if (!epd || epd->bEndpointAddress != address)
+            continue;
+
+        uint32_t size = epd->MaxPacketSize() * epd->Transactions();
+        if (size >= payloadSize && (!best || size < capacity))
+        {
+            best = alt;
+            capacity = size;
+        }
+    }
+    return best;
+}
+
+uint32_t UvcRunner::ExpectedFrameSize(const VideoProbeCommit& p) const
+{
+    // only uncompressed frames have a fixed size
+    for (auto fmt = config->Find<VideoFormatDescriptor>(index, DescriptorType::ClassSpecificInterface, DescriptorSubType::VideoFormatUncompressed);
+        fmt; fmt = config->Find<VideoFormatDescriptor>(index, DescriptorType::ClassSpecificInterface, DescriptorSubType::VideoFormatUncompressed, fmt))
+    {
+        if (fmt->bFormatIndex == p.bFormatIndex)
+            return p.dwMaxVideoFrameSize;
+    }
+    return 0;
+}
+
+bool UvcRunner::Commit(VideoProbeCommit& p)
+{
+    auto request = [&](uint8_t req, VideoStreamingControl control)
+    {
+        return Control(req & 0x80 ? SetupPacket::DirIn : SetupPacket::DirOut, SetupPacket::TypeClass, SetupPacket::RecipientInterface, req,
+            uint16_t(control) << 8, interface, &p, sizeof(VideoProbeCommit)) == sizeof(VideoProbeCommit);
+    };
+
+    // the device adjusts the probed values, the result is committed as it is
+    return request(SetupPacket::ClassVideoSetCur, VideoStreamingControl::Probe) &&
+        request(SetupPacket::ClassVideoGetCur, VideoStreamingControl::Probe) &&
+        request(SetupPacket::ClassVideoSetCur, VideoStreamingControl::Commit);
+}
+
+VideoRunResult UvcRunner::Run(uint8_t format, uint8_t frame, uint32_t interval, uint32_t count)
+{
+    VideoRunResult res = {};
+    if (!address)
+        return res;
+
+    VideoProbeCommit p = {};
+    p.bmHint = 1;   // keep the frame interval
+    p.bFormatIndex = format;
+    p.bFrameIndex = frame;
+    p.dwFrameInterval = interval;
+
+    // commit starts a bulk stream
+    receiver.Reset();
+    if (!Commit(p))
+        return res;
+    res.committed = p;
+
+    uint32_t length = p.dwMaxPayloadTransferSize;
+    if (!bulk)
+    {
+        res.alternate = SelectAlternate(p.dwMaxPayloadTransferSize, length);
+        if (!res.alternate || Control(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdSetInterface,
+            res.alternate, interface, NULL, 0) < 0)
+            return res;
+    }
+
+    receiver.Reset(ExpectedFrameSize(p));
+    uint64_t start = 0;
+    if (length <= bufferSize)
+    {
+        // PTS ticks per frame interval (given in 100 ns units), zero if the frames cannot be timed
+        uint32_t ticks = uint32_t(uint64_t(p.dwFrameInterval) * p.dwClockFrequency / 10000000);
+        uint32_t firstPts = 0, prevPts = 0;
+        uint64_t firstTime = 0;
+
+        // every transfer returns a single payload, which ends with a short packet or fills the transfer
+        while (receiver.Frames() < count)
+        {
+            int n = Transfer(address, buffer, length);
+            if (n <= 0)
+                break;
+            if (!receiver.Payloads())
+                start = Nanoseconds();
+
+            uint32_t pts;
+            if (!receiver.Payload(buffer, n) || !ticks || !receiver.LastFramePts(pts))
+                continue;
+
+            uint64_t now = Nanoseconds();
+            if (receiver.Frames() == 1)
+            {
+                firstPts = pts;
+                firstTime = now;
+            }
+            else
+            {
+                uint32_t intervals = (pts - prevPts + ticks / 2) / ticks;
+                if (intervals > 1)
+                    res.dropped += intervals - 1;
+                uint64_t scheduled = firstTime + uint64_t(pts - firstPts) * 1000000000ull / p.dwClockFrequency;
+                if (now > scheduled + uint64_t(p.dwFrameInterval) * 100)
+                    res.late++;
+            }
+            prevPts = pts;
+        }
+    }
+    res.time = receiver.Payloads() ? Nanoseconds() - start : 0;
+
+    if (bulk)
+        Control(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientEndpoint, SetupPacket::StdClearFeature,
+            SetupPacket::FeatureEndpointHalt, address, NULL, 0);
+    else
+        Control(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdSetInterface,
+            0, interface, NULL, 0);
+
+    res.frames = receiver.Frames();
+    res.payloads = receiver.Payloads();
+    res.bytes = receiver.Bytes();
+    res.errors = receiver.Errors();
+    return res;
+}
+
+size_t UvcRunner::Format(char* buffer, size_t size, const char* name, const VideoRunResult& result)
+{
+    return JsonWriter(buffer, size)
+        .String("name", name)
+        .Number("frames", result.frames)
+        .Fixed("fps", result.MilliFramesPerSecond())
+        .Fixed("mb_per_s", result.BytesPerSecond() / 1000)
+        .Number("payloads", result.payloads)
+        .Number("errors", result.errors)
+        .Number("dropped", result.dropped)
+        .Number("late", result.late)
+        .Number("frame_size", result.committed.dwMaxVideoFrameSize)
+        .Number("payload_size", result.committed.dwMaxPayloadTransferSize)
+        .Number("alternate", result.alternate)
+        .Finish();
+}
+
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/UvcHost.h
+ *
+ * Host-side receiver and frame rate benchmark of UVC video streams
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/HostParser.h>
+#include <usb/VirtualHost.h>
+#include <usb/Uvc.h>
+
+namespace usb
+{
+
+//! Reassembles frames from the payloads of a UVC stream, without storing the data
+/*!
+ * A frame ends with a payload with the EndOfFrame bit, or when the FrameId bit toggles. Payloads
+ * repeating the FrameId of a finished frame (e.g. header-only isochronous payloads) are ignored.
+ */
+class VideoReceiver
+{
+public:
+    //! Starts receiving a new stream, frames of other size than @p frameSize are counted as errors unless it is zero
+    void Reset(uint32_t frameSize = 0);
+    //! Processes a single payload, returns true if it completed a frame
+    bool Payload(const uint8_t* data, size_t length);
+
+    //! Gets the number of completed frames
+    uint32_t Frames() const { return frames; }
+    //! Gets the number of payloads received
+    uint32_t Payloads() const { return payloads; }
+    //! Gets the number of frame data bytes received, excluding the headers
+    uint64_t Bytes() const { return bytes; }
+    //! Gets the number of invalid payloads and frames that were flagged, or had an unexpected size
+    uint32_t Errors() const { return errors; }
+    //! Gets the size of the last completed frame
+    uint32_t LastFrameSize() const { return lastSize; }
+    //! Gets the presentation time stamp of the last completed frame, returns false if its payloads carried none
+    bool LastFramePts(uint32_t& pts) const { pts = lastPts; return lastHasPts; }
+
+private:
+    uint32_t expected = 0;
+    uint32_t frames = 0, payloads = 0, errors = 0;
+    uint64_t bytes = 0;
+    uint32_t size = 0, lastSize = 0;
+    uint32_t pts = 0, lastPts = 0;
+    uint8_t fid = 0;
+    bool hasPts = false, lastHasPts = false;
+    bool active = false;        // frame in progress
+    bool finished = false;      // fid belongs to a finished frame
+    bool failed = false;        // frame in progress contains a payload flagged with an error
+
+    bool Complete();
+};
+
+//! Results of a single stream run performed by UvcRunner
+struct VideoRunResult
+{
+    uint64_t time;              //!< Host-side duration of the run in nanoseconds, from the first payload
+    uint64_t bytes;             //!< Frame data bytes received, excluding the headers
+    uint32_t frames;            //!< Frames received
+    uint32_t payloads;          //!< Payloads received
+    uint32_t errors;            //!< Invalid payloads and frames, see VideoReceiver::Errors
+    uint32_t dropped;           //!< Frames missing from the stream, detected from the gaps between presentation time stamps
+    uint32_t late;              //!< Frames received more than a frame interval behind the schedule set by the first frame
+    uint8_t alternate;          //!< Alternate setting selected for an isochronous stream, zero for bulk
+    VideoProbeCommit committed; //!< Parameters committed to the device, all zero if the negotiation failed
+
+    //! Gets the frame rate in thousandths of frames per second
+    uint64_t MilliFramesPerSecond() const { return time ? uint64_t(frames) * 1000000000000ull / time : 0; }
+    //! Gets the throughput of the run
+    uint64_t BytesPerSecond() const { return time ? bytes * 1000000000ull / time : 0; }
+};
+
+//! Negotiates a UVC stream and measures its frame rate from the host
+/*!
+ * Each run probes and commits the requested format, frame and interval, selects the smallest
+ * isochronous alternate setting with a capacity of at least the negotiated dwMaxPayloadTransferSize
+ * (the same way as the Linux uvcvideo driver), reads payloads until the requested number of frames
+ * is received, and stops the stream by selecting alternate setting 0 (isochronous) or clearing
+ * the halt of the endpoint (bulk).
+ *
+ * When the device reports dwClockFrequency and stamps the frames with a PTS, the frames are checked
+ * against the committed frame interval: a PTS gap longer than an interval counts the missing frames
+ * as dropped, and a frame received more than an interval later than its PTS predicts (relative
+ * to the first frame) counts as late.
+ *
+ * The bus access is provided by a derived class, VirtualUvcRunner drives an in-process
+ * VirtualHost, so the stream can be measured without hardware.
+ */
+class UvcRunner
+{
+public:
+    //! Creates the runner using @p buffer of @p bufferSize bytes for a single payload
+    UvcRunner(uint8_t* buffer, size_t bufferSize)
+        : buffer(buffer), bufferSize(bufferSize) {}
+
+    //! Locates the endpoint of the VideoStreaming interface with the specified number in a parsed configuration
+    /*!
+     * The configuration must remain valid while the runner is used
+     */
+    bool Attach(const HostConfig& config, uint8_t interface);
+
+    //! Receives @p count frames of the specified format and frame at the frame interval closest to @p interval (zero for the default)
+    VideoRunResult Run(uint8_t format, uint8_t frame, uint32_t interval, uint32_t count);
+
+    //! Formats the result as a single line of JSON, returns the length of the output (excluding the null terminator)
+    /*!
+     * The frame rate is reported in frames per second and the throughput as mb_per_s in MB/s (10^6 bytes per second), with three decimals
+     */
+    static size_t Format(char* buffer, size_t size, const char* name, const VideoRunResult& result);
+
+protected:
+    //! Performs a control transfer, returns the length of the data stage or -1 if the request failed
+    virtual int Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+        uint16_t value, uint16_t index, void* data, uint16_t length) = 0;
+    //! Performs a transfer on a non-control endpoint, returns the number of bytes transferred or -1 on failure
+    virtual int Transfer(uint8_t address, void* data, size_t length) = 0;
+    //! Gets the current time in nanoseconds from a monotonic clock
+    virtual uint64_t Nanoseconds() = 0;
+
+private:
+    uint8_t* buffer;
+    size_t bufferSize;
+    const HostConfig* config = NULL;
+    int index = -1;             // index of alternate setting 0 in the configuration
+    uint8_t interface = 0;
+    uint8_t address = 0;
+    bool bulk = false;
+    VideoReceiver receiver;
+
+    bool Commit(VideoProbeCommit& p);
+    uint8_t SelectAlternate(uint32_t payloadSize, uint32_t& capacity) const;
+    uint32_t ExpectedFrameSize(const VideoProbeCommit& p) const;
+};
+
+//! UvcRunner receiving the stream from a VirtualHost, timed by the simulated bus time
+class VirtualUvcRunner : public UvcRunner
+{
+public:
+    //! Creates the runner, @p timeout limits every payload to the specified number of (micro)frames
+    VirtualUvcRunner(VirtualHost& host, uint8_t* buffer, size_t bufferSize, uint32_t timeout = 1000)
+        : UvcRunner(buffer, bufferSize), host(host), timeout(timeout) {}
+
+protected:
+    int Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+        uint16_t value, uint16_t index, void* data, uint16_t length) override
+    {
+        return host.Control(direction, type, recipient, request, value, index, data, length);
+    }
+
+    int Transfer(uint8_t address, void* data, size_t length) override { return host.Transfer(address, data, length, false, timeout); }
+    uint64_t Nanoseconds() override { return host.Now(); }
+
+private:
+    VirtualHost& host;
+    uint32_t timeout;
+};
+
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/VirtualHost.cpp
+ */
+
+#include <usb/VirtualHost.h>
+#include <usb/ControlTransfer.h>
+
+namespace usb
+{
+
+VirtualHost::VirtualHost(VirtualDevice& device, const VirtualBusConfig& config)
+    : device(device), frameNs(config.speed == Speed::High ? 125000 : 1000000), rawBytes(config.speed == Speed::High ? 7500 : 1500),
+    nakRetries(config.nakRetries), resetTime(config.resetTime), addressRecovery(config.addressRecovery)
+{
+    budget = config.frameBudget ? config.frameBudget : rawBytes * 9 / 10;
+    // bulk transaction overhead according to USB 2.0 section 5.8.4
+    overhead = config.overhead ? config.overhead : config.speed == Speed::High ? 55 : 13;
+    stats = {};
+}
+
+void VirtualHost::NextFrame()
+{
+    frameStart += frameNs;
+    now = frameStart;
+    used = 0;
+    frame = (frame + 1) & (frameNs == 125000 ? 0x3FFF : 0x7FF);
+    stats.frames++;
+    device.Frame(frame);
+    device.Run();
+}
+
+void VirtualHost::Consume(size_t bytes)
+{
+    size_t cost = bytes + overhead;
+    // a transaction that does not fit in the rest of the frame is postponed to the next one
+    if (used && used + cost > budget)
+        NextFrame();
+    used += cost;
+    now = frameStart + uint64_t(used) * frameNs / rawBytes;
+}
+
+void VirtualHost::Wait(uint32_t us)
+{
+    uint64_t target = now + uint64_t(us) * 1000;
+    while (frameStart + frameNs <= target)
+        NextFrame();
+    now = target;
+    used = (now - frameStart) * rawBytes / frameNs;
+}
+
+void VirtualHost::Reset()
+{
+    Wait(resetTime);
+    device.Reset();
+    maxPacketSize0 = 8;
+}
+
+int VirtualHost::Control(const SetupPacket& setup, void* data)
+{
+    uint64_t start = now;
+    stats = {};
+
+    Consume(sizeof(SetupPacket));
+    stats.transactions++;
+
+    ControlTransfer ct;
+    uint8_t packet[64];
+    ct.Begin(setup, device.Setup(setup, ControlStage::Setup), maxPacketSize0, packet);
+
+    size_t len = 0;
+    while (ct.CurrentStage() == ControlTransfer::Stage::DataIn)
+    {
+        auto pkt = ct.NextIn();
+        memcpy((uint8_t*)data + len, pkt.data, pkt.length);
+        len += pkt.length;
+        Consume(pkt.length);
+        stats.transactions++;
+    }
+
+    while (ct.CurrentStage() == ControlTransfer::Stage::DataOut)
+    {
+        auto buf = ct.NextOut();
+        size_t n = setup.wLength - len < buf.length ? setup.wLength - len : buf.length;
+        memcpy(buf.data, (const uint8_t*)data + len, n);
+        len += n;
+        Consume(n);
+        stats.transactions++;
+        if (ct.OutReceived(n) && device.Setup(setup, ControlStage::DataOut).status != ControlResult::Status::Ack)
+        {
+            ct.End();
+            return -1;
+        }
+    }
+
+    if (ct.CurrentStage() == ControlTransfer::Stage::Stall)
+    {
+        ct.End();
+        return -1;
+    }
+
+    // status stage
+    Consume(0);
+    stats.transactions++;
+    ct.End();
+
+    stats.time = now - start;
+    stats.bytes = len;
+    return len;
+}
+
+int VirtualHost::Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+    uint16_t value, uint16_t index, void* data, uint16_t length)
+{
+    SetupPacket setup;
+    setup.dw = 0;
+    setup.recipient = recipient;
+    setup.type = type;
+    setup.direction = direction;
+    setup.bRequest = SetupPacket::Request(request);
+    setup.wValue = value;
+    setup.wIndex = index;
+    setup.wLength = length;
+    return Control(setup, data);
+}
+
+bool VirtualHost::Enumerate(uint8_t configuration)
+{
+    auto in = [this](uint8_t request, uint16_t value, uint16_t index, void* data, uint16_t length)
+    {
+        return Control(SetupPacket::DirIn, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, request, value, index, data, length);
+    };
+    auto out = [this](uint8_t request, uint16_t value)
+    {
+        return Control(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientDevice, request, value, 0, NULL, 0);
+    };
+
+    uint64_t t = now;
+    Reset();
+    phases[unsigned(EnumerationPhase::Reset)] = now - t;
+
+    // the first request reads only the part of the device descriptor containing bMaxPacketSize0
+    t = now;
+    if (in(SetupPacket::StdGetDescriptor, unsigned(DescriptorType::Device) << 8, 0, deviceBuffer, 8) < 8)
+        return false;
+    maxPacketSize0 = Device().bMaxPacketSize0;
+    if (out(SetupPacket::StdSetAddress, 1) < 0)
+        return false;
+    Wait(addressRecovery);
+    if (in(SetupPacket::StdGetDescriptor, unsigned(DescriptorType::Device) << 8, 0, deviceBuffer, sizeof(deviceBuffer)) < int(sizeof(DeviceDescriptor)))
+        return false;
+    phases[unsigned(EnumerationPhase::DeviceDescriptor)] = now - t;
+
+    t = now;
+    bool found = false;
+    for (unsigned i = 0; i < Device().bNumConfigurations && !found; i++)
+    {
+        uint16_t value = unsigned(DescriptorType::Config) << 8 | i;
+        if (in(SetupPacket::StdGetDescriptor, value, 0, configBuffer, sizeof(ConfigDescriptorHeader)) < int(sizeof(ConfigDescriptorHeader)))
+            return false;
+        if (Config().bConfigurationValue != configuration)
+            continue;
+        uint16_t total = Config().wTotalLength < sizeof(configBuffer) ? Config().wTotalLength : sizeof(configBuffer);
+        if (in(SetupPacket::StdGetDescriptor, value, 0, configBuffer, total) < total)
+            return false;
+        found = true;
+    }
+    phases[unsigned(EnumerationPhase::ConfigDescriptor)] = now - t;
+    if (!found)
+        return false;
+
+    // strings are optional, failures are ignored like a real host would
+    t = now;
+    if (in(SetupPacket::StdGetDescriptor, unsigned(DescriptorType::String) << 8, 0, stringBuffer, 255) >= 4)
+    {
+        uint16_t language = stringBuffer[2] | stringBuffer[3] << 8;
+        for (uint8_t index: { Device().iManufacturer, Device().iProduct, Device().iSerialNumber, Config().iConfiguration })
+        {
+            if (index)
+                in(SetupPacket::StdGetDescriptor, unsigned(DescriptorType::String) << 8 | index, language, stringBuffer, 255);
+        }
+    }
+    phases[unsigned(EnumerationPhase::Strings)] = now - t;
+
+    t = now;
+    if (out(SetupPacket::StdSetConfiguration, configuration) < 0)
+        return false;
+    phases[unsigned(EnumerationPhase::SetConfiguration)] = now - t;
+    return true;
+}
+
+int VirtualHost::Transfer(uint8_t address, void* data, size_t length, bool zlp, uint32_t timeout)
+{
+    Endpoint* ep = device.FindEndpoint(address);
+    if (!ep)
+        return -1;
+
+    ep->Attach(this);
+
+    uint64_t start = now;
+    stats = {};
+
+    bool in = address & 0x80;
+    size_t mps = ep->MaxPacketSize();
+    bool periodic = ep->Type() == EndpointType::Isochronous || ep->Type() == EndpointType::Interrupt;
+    bool sendZlp = !in && zlp && !(length % mps);
+    size_t done = 0;
+    unsigned naks = 0;
+
+    while ((done < length || sendZlp) && stats.frames < timeout)
+    {
+        EndpointPacket pkt;
+        if (!ep->Next(pkt))
+        {
+            stats.naks++;
+            if (ep->Type() == EndpointType::Isochronous)
+            {
+                NextFrame();
+                continue;
+            }
+
+            // NAK handshake, the host retries a limited number of times in each frame
+            Consume(0);
+            device.Run();
+            if (++naks > nakRetries)
+            {
+                naks = 0;
+                NextFrame();
+            }
+            continue;
+        }
+
+        size_t n, packet = pkt.length;
+        if (in)
+        {
+            // the packet is gathered from the header and the data
+            packet += pkt.headerLength;
+            n = packet < length - done ? packet : length - done;
+            size_t header = pkt.headerLength < n ? pkt.headerLength : n;
+            if (header)
+                memcpy((uint8_t*)data + done, pkt.header, header);
+            memcpy((uint8_t*)data + done + header, pkt.data, n - header);
+            ep->Done(packet);
+        }
+        else
+        {
+            n = mps < length - done ? mps : length - done;
+            if (n > pkt.length)
+            {
+                // the buffer of the device would be overrun, the transfers are cancelled as after a controller error
+                ep->Cancel();
+                stats.overruns++;
+                break;
+            }
+            memcpy(pkt.data, (const uint8_t*)data + done, n);
+            ep->Done(n);
+            if (!n)
+                sendZlp = false;
+        }
+
+        done += n;
+        stats.transactions++;
+        Consume(n);
+
+        // periodic endpoints are serviced once per (micro)frame, even if the packet was short
+        if (periodic)
+            NextFrame();
+        if (in && packet < mps)
+            break;  // short packet
+    }
+
+    stats.time = now - start;
+    stats.bytes = done;
+    return stats.overruns ? -1 : int(done);
+}
+
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/VirtualHost.h
+ *
+ * Simulated host controller driving the device stack without hardware
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Packets.h>
+#include <usb/SetupDispatcher.h>
+#include <usb/Endpoint.h>
+
+namespace usb
+{
+
+//! Device side of a VirtualHost bus
+class VirtualDevice
+{
+public:
+    //! Handles a control request, typically forwarded to SetupDispatcher::Dispatch
+    virtual ControlResult Setup(const SetupPacket& setup, ControlStage stage) = 0;
+    //! Finds the transfer queue of a non-control endpoint
+    virtual Endpoint* FindEndpoint(uint8_t address) { return NULL; }
+    //! Called when the bus is reset
+    virtual void Reset() {}
+    //! Called on every start of (micro)frame with the (micro)frame number
+    virtual void Frame(uint16_t frame) {}
+    //! Called whenever the host is waiting for the device (e.g. after a NAK), the device performs its processing here
+    virtual void Run() {}
+};
+
+//! Timing parameters of a VirtualHost bus
+struct VirtualBusConfig
+{
+    Speed speed = Speed::Full;          //!< Bus speed, determines the (micro)frame length and raw bandwidth
+    uint16_t frameBudget = 0;           //!< Bytes per (micro)frame available for transactions, zero for 90% of the raw bandwidth
+    uint16_t overhead = 0;              //!< Protocol overhead of a single transaction in bytes, zero for the specification value
+    uint8_t nakRetries = 1;             //!< Number of retries of a NAKed transaction within the same (micro)frame
+    uint32_t resetTime = 10000;         //!< Duration of the bus reset, including recovery, in microseconds
+    uint32_t addressRecovery = 2000;    //!< Recovery interval after SET_ADDRESS in microseconds
+};
+
+//! Statistics of a sequence of transactions
+struct VirtualTransferStats
+{
+    uint64_t time;          //!< Elapsed bus time in nanoseconds
+    uint64_t bytes;         //!< Payload bytes transferred
+    uint32_t transactions;  //!< Transactions carrying data (including ZLPs)
+    uint32_t naks;          //!< Transactions NAKed by the device (or isochronous packets missed)
+    uint32_t frames;        //!< (Micro)frames started
+    uint32_t overruns;      //!< OUT packets that did not fit into the packet armed by the device
+
+    //! Gets the achieved throughput
+    uint64_t BytesPerSecond() const { return time ? bytes * 1000000000ull / time : 0; }
+};
+
+//! Phases of enumeration timed by VirtualHost::Enumerate
+enum struct EnumerationPhase : uint8_t
+{
+    Reset,              //!< Bus reset
+    DeviceDescriptor,   //!< Initial GET_DESCRIPTOR(Device) and SET_ADDRESS
+    ConfigDescriptor,   //!< GET_DESCRIPTOR(Config), header and full length
+    Strings,            //!< GET_DESCRIPTOR(String) for the language table and all device strings
+    SetConfiguration,   //!< SET_CONFIGURATION
+    _Count,
+};
+
+//! Simulated host controller and bus
+/*!
+ * Issues real SetupPacket sequences against a VirtualDevice and moves data through its Endpoint
+ * queues, acting as their EndpointController. Time is simulated: every transaction consumes its
+ * payload plus protocol overhead from the bandwidth of the current (micro)frame, so the reported
+ * latencies and throughput depend only on the behavior of the device stack, not on the host machine.
+ */
+class VirtualHost : public EndpointController
+{
+public:
+    VirtualHost(VirtualDevice& device, const VirtualBusConfig& config = VirtualBusConfig());
+
+    //! Gets the current bus time in nanoseconds
+    uint64_t Now() const { return now; }
+    //! Gets the current (micro)frame number
+    uint16_t FrameNumber() const { return frame; }
+    //! Advances the bus time by the specified number of microseconds
+    void Wait(uint32_t us);
+
+    //! Resets the bus
+    void Reset();
+    //! Performs a control transfer, returns the length of the data stage or -1 if the device stalled the request
+    int Control(const SetupPacket& setup, void* data);
+    //! Performs a control transfer with the specified parameters
+    int Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+        uint16_t value, uint16_t index, void* data, uint16_t length);
+
+    //! Performs the complete enumeration sequence and selects the configuration with the specified value
+    bool Enumerate(uint8_t configuration = 1);
+    //! Gets the duration of an enumeration phase in nanoseconds
+    uint64_t PhaseTime(EnumerationPhase phase) const { return phases[unsigned(phase)]; }
+    //! Gets the device descriptor read during enumeration
+    const DeviceDescriptor& Device() const { return *(const DeviceDescriptor*)deviceBuffer; }
+    //! Gets the configuration descriptor read during enumeration
+    const ConfigDescriptorHeader& Config() const { return *(const ConfigDescriptorHeader*)configBuffer; }
+
+    //! Performs a bulk, interrupt or isochronous transfer on the specified endpoint
+    /*!
+     * The transfer ends when @p length bytes are transferred, a short packet is received (IN),
+     * or @p timeout (micro)frames elapse. OUT transfers of a multiple of the max packet size are
+     * terminated by a ZLP when @p zlp is set. Interrupt and isochronous endpoints perform
+     * at most one transaction per (micro)frame, a missed isochronous transaction is counted as a NAK.
+     * An OUT packet longer than the packet armed by the device is a data overrun, which cancels the transfers of the endpoint.
+     * @returns the number of bytes transferred, or -1 if the endpoint does not exist or an overrun occurred
+     */
+    int Transfer(uint8_t address, void* data, size_t length, bool zlp = false, uint32_t timeout = 1000);
+
+    //! Gets the statistics of the last Transfer or Control operation
+    const VirtualTransferStats& Stats() const { return stats; }
+
+    void Arm(Endpoint& endpoint) override {}
+
+private:
+    VirtualDevice& device;
+    uint64_t now = 0;
+    uint64_t frameStart = 0;
+    uint32_t frameNs;
+    uint16_t rawBytes;
+    uint16_t budget;
+    uint16_t used = 0;
+    uint16_t overhead;
+    uint16_t frame = 0;
+    uint8_t nakRetries;
+    uint8_t maxPacketSize0 = 8;
+    uint32_t resetTime, addressRecovery;
+    VirtualTransferStats stats;
+    uint64_t phases[unsigned(EnumerationPhase::_Count)] = {};
+    uint8_t deviceBuffer[sizeof(DeviceDescriptor)] = {};
+    uint8_t configBuffer[1024] = {};
+    uint8_t stringBuffer[256];
+
+    void Consume(size_t bytes);
+    void NextFrame();
+};
+
+}
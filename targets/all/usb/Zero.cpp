@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Zero.cpp
+ */
+
+#include <usb/Zero.h>
+
+namespace usb
+{
+
+/****** Patterns ******/
+
+void ZeroFill(ZeroPattern pattern, void* buffer, size_t length, size_t maxPacketSize)
+{
+    auto p = (uint8_t*)buffer;
+    switch (pattern)
+    {
+        case ZeroPattern::Zeros:
+            memset(p, 0, length);
+            break;
+
+        case ZeroPattern::Mod63:
+            for (size_t offset = 0; offset < length; offset += maxPacketSize)
+            {
+                size_t end = length - offset < maxPacketSize ? length : offset + maxPacketSize;
+                uint8_t value = 0;
+                for (size_t i = offset; i < end; i++)
+                {
+                    p[i] = value;
+                    if (++value == 63)
+                        value = 0;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool ZeroCheck(ZeroPattern pattern, const void* data, size_t length, size_t maxPacketSize)
+{
+    auto p = (const uint8_t*)data;
+    switch (pattern)
+    {
+        case ZeroPattern::Zeros:
+            for (size_t i = 0; i < length; i++)
+            {
+                if (p[i])
+                    return false;
+            }
+            return true;
+
+        case ZeroPattern::Mod63:
+            for (size_t offset = 0; offset < length; offset += maxPacketSize)
+            {
+                size_t end = length - offset < maxPacketSize ? length : offset + maxPacketSize;
+                uint8_t value = 0;
+                for (size_t i = offset; i < end; i++)
+                {
+                    if (p[i] != value)
+                        return false;
+                    if (++value == 63)
+                        value = 0;
+                }
+            }
+            return true;
+
+        default:
+            return true;
+    }
+}
+
+/****** Zero ******/
+
+ControlResult Zero::HandleRequest(const SetupPacket& setup, ControlStage stage)
+{
+    switch (ZeroRequest(setup.bRequest))
+    {
+        case ZeroRequest::Start:
+            if (stage == ControlStage::Setup)
+            {
+                if (setup.wLength != sizeof(ZeroRunParameters))
+                    break;
+                return ControlResult::Out(&request, sizeof(ZeroRunParameters));
+            }
+            if (!Start(request))
+                break;
+            return ControlResult::Ack();
+
+        case ZeroRequest::Stop:
+            Stop();
+            return ControlResult::Ack();
+
+        case ZeroRequest::GetStats:
+            // the counters are copied in the setup stage, so the data stage returns consistent values
+            Flush();
+            snapshot = stats;
+            return ControlResult::In(&snapshot, sizeof(ZeroStats));
+
+        default:
+            return ControlResult::Unhandled();
+    }
+
+    return ControlResult::Stall();
+}
+
+bool Zero::SetAlternate(uint8_t alternate)
+{
+    if (alternate > 1)
+        return false;
+    Stop();
+    this->alternate = alternate;
+    return true;
+}
+
+void Zero::Open(Endpoint& bulkIn, Endpoint& bulkOut, Endpoint* interruptIn, Endpoint* interruptOut, Endpoint* isoIn, Endpoint* isoOut)
+{
+    Close();
+    pipes[unsigned(ZeroPipe::Bulk)] = { &bulkIn, &bulkOut };
+    pipes[unsigned(ZeroPipe::Interrupt)] = { interruptIn, interruptOut };
+    pipes[unsigned(ZeroPipe::Isochronous)] = { isoIn, isoOut };
+}
+
+void Zero::Close()
+{
+    Stop();
+    for (auto& pipe: pipes)
+        pipe = {};
+    alternate = 0;
+}
+
+bool Zero::Start(const ZeroRunParameters& params)
+{
+    Stop();
+
+    unsigned active = 0;
+    for (unsigned p = 0; p < unsigned(ZeroPipe::_Count); p++)
+    {
+        if (params.pipes & BIT(p))
+        {
+            if (!Available(p))
+                return false;
+            active++;
+        }
+    }
+
+    if (!active || params.mode == ZeroMode::Idle || params.mode > ZeroMode::Loopback || params.pattern > ZeroPattern::None ||
+        params.length > bufferSize)
+        return false;
+
+    // every pipe needs two slots, in each direction for SourceSink
+    if (count / active < (params.mode == ZeroMode::SourceSink ? 4u : 2u))
+        return false;
+
+    // OUT transfers are rounded up to whole packets, which must fit into the buffers as well
+    uint32_t n = params.length ? params.length : bufferSize;
+    if (params.mode != ZeroMode::Source)
+    {
+        for (unsigned p = 0; p < unsigned(ZeroPipe::_Count); p++)
+        {
+            if ((params.pipes & BIT(p)) && PacketLength(*pipes[p].out, n) > bufferSize)
+                return false;
+        }
+    }
+
+    this->params = params;
+    length = n;
+    starting = true;
+    return true;
+}
+
+void Zero::Stop()
+{
+    Flush();
+    starting = false;
+    params.mode = ZeroMode::Idle;
+
+    for (auto& pipe: pipes)
+    {
+        if (pipe.in)
+            pipe.in->Cancel();
+        if (pipe.out)
+            pipe.out->Cancel();
+    }
+
+    for (size_t i = 0; i < count; i++)
+        slots[i].endpoint = NULL;
+}
+
+void Zero::Queue(Slot& slot, Endpoint& endpoint, size_t length)
+{
+    slot.endpoint = &endpoint;
+    slot.order = order++;
+    // IN transfers are not terminated by a ZLP, the host always reads the length it expects,
+    // OUT transfers are armed as whole packets (see Endpoint::Submit) and end with the short packet of the host
+    slot.transfer.Setup(Buffer(slot), endpoint.IsIn() ? length : PacketLength(endpoint, length), false);
+    endpoint.Submit(slot.transfer);
+}
+
+void Zero::Begin(uint32_t now)
+{
+    starting = false;
+    start = now;
+    stats = {};
+
+    unsigned active = 0;
+    for (unsigned p = 0; p < unsigned(ZeroPipe::_Count); p++)
+        active += !!(params.pipes & BIT(p));
+
+    unsigned perPipe = count / active;
+    Slot* slot = slots;
+    for (unsigned p = 0; p < unsigned(ZeroPipe::_Count); p++)
+    {
+        if (!(params.pipes & BIT(p)))
+            continue;
+
+        auto& pipe = pipes[p];
+        for (unsigned i = 0; i < perPipe; i++, slot++)
+        {
+            slot->pipe = p;
+            bool in = params.mode == ZeroMode::Source || (params.mode == ZeroMode::SourceSink && i < perPipe / 2);
+            if (in)
+            {
+                ZeroFill(params.pattern, Buffer(*slot), length, pipe.in->MaxPacketSize());
+                Queue(*slot, *pipe.in, length);
+            }
+            else
+            {
+                Queue(*slot, *pipe.out, length);
+            }
+        }
+    }
+}
+
+void Zero::Complete(Slot& slot, uint32_t now)
+{
+    auto& t = slot.transfer;
+    auto& pipe = pipes[slot.pipe];
+    bool in = slot.endpoint->IsIn();
+
+    if (t.status != TransferStatus::Complete)
+    {
+        // cancelled during the run (e.g. when the host clears a halt), loopback data is lost
+        Queue(slot, in && params.mode != ZeroMode::Loopback ? *pipe.in : *pipe.out, length);
+        return;
+    }
+
+    uint32_t time = now - start;
+    if (!stats.transfersIn && !stats.transfersOut)
+        stats.firstTransfer = time;
+    stats.elapsed = time;
+
+    if (in)
+    {
+        stats.transfersIn++;
+        stats.bytesIn += t.transferred;
+        // source buffers still hold the pattern, loopback buffers return to the OUT endpoint
+        Queue(slot, params.mode == ZeroMode::Loopback ? *pipe.out : *pipe.in, length);
+        return;
+    }
+
+    stats.transfersOut++;
+    stats.bytesOut += t.transferred;
+    if (t.transferred < length)
+        stats.shortTransfers++;
+
+    if (params.mode == ZeroMode::Loopback)
+    {
+        // a ZLP is not looped back, the buffer is reused for the next OUT transfer right away
+        if (t.transferred)
+        {
+            Queue(slot, *pipe.in, t.transferred);
+            return;
+        }
+    }
+    else if (!ZeroCheck(params.pattern, t.buffer, t.transferred, slot.endpoint->MaxPacketSize()))
+    {
+        stats.errors++;
+    }
+
+    Queue(slot, *pipe.out, length);
+}
+
+void Zero::Poll(uint32_t now)
+{
+    polled = now;
+    if (starting)
+        Begin(now);
+    if (!Running())
+        return;
+
+    // completions are processed in the order the transfers were queued, so loopback data is echoed in order
+    for (;;)
+    {
+        Slot* next = NULL;
+        for (size_t i = 0; i < count; i++)
+        {
+            auto& s = slots[i];
+            if (s.endpoint && s.transfer.done && (!next || int32_t(s.order - next->order) < 0))
+                next = &s;
+        }
+
+        if (!next)
+            break;
+        Complete(*next, now);
+    }
+}
+
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/Zero.h
+ *
+ * Vendor-class source/sink/loopback test function, modelled after the Linux g_zero gadget
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/Descriptors.h>
+#include <usb/Endpoint.h>
+#include <usb/SetupDispatcher.h>
+
+namespace usb
+{
+
+//! Endpoint pairs of a Zero function
+enum struct ZeroPipe : uint8_t
+{
+    Bulk,           //!< Bulk IN and OUT endpoints, present in both alternate settings
+    Interrupt,      //!< Interrupt IN and OUT endpoints, present in both alternate settings
+    Isochronous,    //!< Isochronous IN and OUT endpoints, present in alternate setting 1 only
+    _Count,
+};
+
+//! Operating modes of a Zero test run
+enum struct ZeroMode : uint8_t
+{
+    Idle = 0,           //!< No transfers are queued
+    Source = 1,         //!< The device sends pattern data on the IN endpoints
+    Sink = 2,           //!< The device receives and verifies pattern data on the OUT endpoints
+    SourceSink = 3,     //!< Source and Sink simultaneously
+    Loopback = 4,       //!< Data received on an OUT endpoint is sent back on the IN endpoint of the same pipe
+};
+
+//! Data patterns of a Zero test run, same as the pattern parameter of g_zero
+enum struct ZeroPattern : uint8_t
+{
+    Zeros,      //!< All bytes are zero
+    Mod63,      //!< Byte at offset i of each packet is (i % 63), so shifted or lost data does not match
+    None,       //!< Data is neither generated nor verified
+};
+
+//! Vendor requests of a Zero function, directed at its interface
+enum struct ZeroRequest : uint8_t
+{
+    Start = 1,      //!< Starts a run, ZeroRunParameters in the data stage
+    Stop = 2,       //!< Stops the run, cancelling all transfers
+    GetStats = 3,   //!< Returns the ZeroStats of the current or last run
+};
+
+//! Parameters of a test run, sent in the data stage of ZeroRequest::Start
+struct ZeroRunParameters
+{
+    ZeroMode mode;          //!< Operating mode
+    ZeroPattern pattern;    //!< Pattern sent by the source and verified by the sink
+    uint8_t pipes;          //!< Bit mask of the pipes used by the run, BIT(ZeroPipe)
+    uint8_t _reserved;
+    uint32_t length;        //!< Length of every transfer, zero for the buffer size
+};
+
+//! Device-side counters of a test run, returned by ZeroRequest::GetStats
+/*!
+ * All fields are little-endian, times are in microseconds of the clock passed to Zero::Poll
+ * and are measured from the first Poll following the start of the run
+ */
+struct ZeroStats
+{
+    uint32_t firstTransfer;     //!< Time to the completion of the first transfer
+    uint32_t elapsed;           //!< Time to the completion of the last transfer
+    uint32_t transfersIn;       //!< Completed IN transfers
+    uint32_t transfersOut;      //!< Completed OUT transfers
+    uint64_t bytesIn;           //!< Bytes sent by the device
+    uint64_t bytesOut;          //!< Bytes received by the device
+    uint32_t errors;            //!< OUT transfers not matching the pattern
+    uint32_t shortTransfers;    //!< OUT transfers shorter than the run length
+};
+
+//! Fills the buffer with the pattern, restarting at every packet of @p maxPacketSize bytes
+void ZeroFill(ZeroPattern pattern, void* buffer, size_t length, size_t maxPacketSize);
+//! Checks if the data matches the pattern, restarting at every packet of @p maxPacketSize bytes
+bool ZeroCheck(ZeroPattern pattern, const void* data, size_t length, size_t maxPacketSize);
+
+//! Creates the alternate settings of the vendor interface of a Zero function
+/*!
+ * The bulk pipe uses endpoint @p endpoint, the interrupt pipe @p endpoint + 1 and the isochronous
+ * pipe @p endpoint + 2. Alternate setting 0 contains the bulk and interrupt endpoints, alternate
+ * setting 1 adds the isochronous ones, so their bandwidth is only reserved when the host selects it.
+ * The intervals are specified for high speed (see EndpointForSpeed).
+ */
+constexpr auto ZeroDescriptors(uint8_t interface, uint8_t endpoint, uint16_t maxPacketSize, uint16_t interruptPacketSize, uint8_t interruptInterval,
+    uint16_t isoPacketSize, uint8_t isoInterval = 1, uint8_t strName = 0)
+{
+    return DescriptorGroup(
+        InterfaceDescriptor(interface, 0, InterfaceClass::Vendor, SubClass::Vendor, Protocol::Vendor, strName,
+            EndpointDescriptor::BulkIn(endpoint, maxPacketSize),
+            EndpointDescriptor::BulkOut(endpoint, maxPacketSize),
+            EndpointDescriptor::InterruptIn(endpoint + 1, interruptPacketSize, interruptInterval),
+            EndpointDescriptor::InterruptOut(endpoint + 1, interruptPacketSize, interruptInterval)),
+        InterfaceDescriptor(interface, 1, InterfaceClass::Vendor, SubClass::Vendor, Protocol::Vendor, strName,
+            EndpointDescriptor::BulkIn(endpoint, maxPacketSize),
+            EndpointDescriptor::BulkOut(endpoint, maxPacketSize),
+            EndpointDescriptor::InterruptIn(endpoint + 1, interruptPacketSize, interruptInterval),
+            EndpointDescriptor::InterruptOut(endpoint + 1, interruptPacketSize, interruptInterval),
+            EndpointDescriptor::IsochronousIn(endpoint + 2, isoPacketSize, isoInterval),
+            EndpointDescriptor::IsochronousOut(endpoint + 2, isoPacketSize, isoInterval)));
+}
+
+//! State of a Zero function, runs the source, sink and loopback tests requested by the host
+/*!
+ * A run is started by ZeroRequest::Start (or locally using Start()) and queues transfers on the
+ * selected pipes until it is stopped. The transfer slots are divided evenly between the pipes,
+ * with SourceSink using half of the slots of each pipe for either direction. Every pipe needs
+ * at least two slots so the next transfer is queued while the previous one completes, and the
+ * transfers are requeued without copying - the source buffers are filled just once when the run
+ * starts, loopback buffers alternate between the OUT and IN endpoints.
+ *
+ * The isochronous pipe is only used in alternate setting 1, selecting an alternate setting
+ * stops the current run.
+ *
+ * Start(), Stop(), Poll() and HandleRequest() must follow the rules of Endpoint, i.e. run on
+ * the same scheduler as the controller driver.
+ */
+class Zero
+{
+public:
+    //! Transfer slot of a run
+    struct Slot
+    {
+        EndpointTransfer transfer;  //!< Transfer using the buffer of the slot
+        Endpoint* endpoint;         //!< Endpoint the transfer is queued on, NULL if the slot is unused
+        uint32_t order;             //!< Order in which the transfers were queued
+        uint8_t pipe;               //!< Pipe the slot is assigned to
+    };
+
+    //! Creates the function with @p count slots and as many buffers of @p bufferSize bytes, use ZeroStorage to allocate them
+    Zero(Slot* slots, size_t count, uint8_t* buffers, size_t bufferSize)
+        : slots(slots), buffers(buffers), bufferSize(bufferSize), count(count)
+    {
+        memset(slots, 0, count * sizeof(Slot));
+    }
+
+    //! Handles the vendor requests of the interface
+    ControlResult HandleRequest(const SetupPacket& setup, ControlStage stage);
+    //! Selects an alternate setting of the interface, stopping the run, to be called from DeviceState::OnSetInterface
+    bool SetAlternate(uint8_t alternate);
+
+    //! Starts using the endpoints, to be called when the configuration is selected
+    void Open(Endpoint& bulkIn, Endpoint& bulkOut, Endpoint* interruptIn = NULL, Endpoint* interruptOut = NULL,
+        Endpoint* isoIn = NULL, Endpoint* isoOut = NULL);
+    //! Stops the run and returns to alternate setting 0, to be called when the configuration is deselected
+    void Close();
+
+    //! Starts a run, the transfers are queued by the next Poll(), returns false if the parameters are not supported
+    bool Start(const ZeroRunParameters& params);
+    //! Stops the run, cancelling all its transfers, the counters are kept until the next run
+    /*!
+     * Transfers completed since the last Poll() are counted as if they completed at the time of that Poll(),
+     * the same applies to ZeroRequest::GetStats
+     */
+    void Stop();
+
+    //! Queues the transfers of a starting run and requeues completed ones
+    /*!
+     * @p now is a free-running time in microseconds, used for the device-side timing
+     */
+    void Poll(uint32_t now);
+
+    //! Checks if a run is in progress
+    bool Running() const { return params.mode != ZeroMode::Idle; }
+    //! Gets the counters of the current or last run
+    const ZeroStats& Stats() const { return stats; }
+    //! Gets the selected alternate setting
+    uint8_t Alternate() const { return alternate; }
+
+private:
+    struct Pipe
+    {
+        Endpoint* in;
+        Endpoint* out;
+    };
+
+    Slot* slots;
+    uint8_t* buffers;
+    size_t bufferSize;
+    uint8_t count;
+    uint8_t alternate = 0;
+    bool starting = false;
+    uint32_t length;
+    uint32_t start;
+    uint32_t polled;
+    uint32_t order = 0;
+    Pipe pipes[unsigned(ZeroPipe::_Count)] = {};
+    ZeroRunParameters params = {};
+    ZeroRunParameters request;
+    ZeroStats stats = {};
+    ZeroStats snapshot;
+
+    uint8_t* Buffer(const Slot& slot) const { return buffers + (&slot - slots) * bufferSize; }
+    static size_t PacketLength(const Endpoint& endpoint, size_t length) { return (length + endpoint.MaxPacketSize() - 1) / endpoint.MaxPacketSize() * endpoint.MaxPacketSize(); }
+    bool Available(unsigned pipe) const { return pipes[pipe].in && pipes[pipe].out && (pipe != unsigned(ZeroPipe::Isochronous) || alternate == 1); }
+    // transfers completed since the last Poll are counted at the time of that Poll
+    void Flush() { if (Running() && !starting) Poll(polled); }
+    void Queue(Slot& slot, Endpoint& endpoint, size_t length);
+    void Begin(uint32_t now);
+    void Complete(Slot& slot, uint32_t now);
+};
+
+//! Zero with @p n transfer slots of @p slotSize bytes
+template<size_t n, size_t slotSize> class ZeroStorage : public Zero
+{
+    static_assert(n >= 2 && n < 256, "Unsupported number of transfer slots");
+
+public:
+    ZeroStorage()
+        : Zero(slots, n, buffers, slotSize) {}
+
+private:
+    Slot slots[n];
+    uint8_t buffers[n * slotSize];
+};
+
+//! Vendor request handlers for a Zero function, for use with a SetupDispatcher
+/*!
+ * @p zero is the member of @p TContext holding the function state, @p interface is the number of its interface.
+ * The alternate settings are selected by StandardRequests, @p TContext must forward DeviceState::OnSetInterface
+ * and DeviceState::OnGetInterface of the interface to Zero::SetAlternate and Zero::Alternate.
+ */
+template<typename TContext, typename TZero, TZero TContext::*zero, uint8_t interface> struct ZeroRequests
+{
+    static ControlResult Handle(TContext& ctx, const SetupPacket& setup, ControlStage stage)
+    {
+        return (ctx.*zero).HandleRequest(setup, stage);
+    }
+
+    static constexpr SetupHandler<TContext> handlers[] = {
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeVendor, SetupPacket::RecipientInterface, uint8_t(ZeroRequest::Start), Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirOut, SetupPacket::TypeVendor, SetupPacket::RecipientInterface, uint8_t(ZeroRequest::Stop), Handle, interface),
+        OnSetup<TContext>(SetupPacket::DirIn, SetupPacket::TypeVendor, SetupPacket::RecipientInterface, uint8_t(ZeroRequest::GetStats), Handle, interface),
+    };
+};
+
+}
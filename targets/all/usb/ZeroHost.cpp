@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/ZeroHost.cpp
+ */
+
+#include <usb/ZeroHost.h>
+#include <usb/Benchmark.h>
+
+namespace usb
+{
+
+bool ZeroRunner::Attach(const HostConfig& config, uint8_t interface)
+{
+    this->interface = interface;
+    for (auto& pipe: pipes)
+        pipe = {};
+
+    for (uint8_t alternate = 0; alternate < 2; alternate++)
+    {
+        int index = config.FindInterface(interface, alternate);
+        if (index < 0 || config.Interface(index)->bInterfaceClass != InterfaceClass::Vendor)
+            continue;
+
+        for (size_t n = 0; auto epd = config.Endpoint(index, n); n++)
+        {
+            unsigned p;
+            switch (epd->Type())
+            {
+                case EndpointType::Bulk: p = unsigned(ZeroPipe::Bulk); break;
+                case EndpointType::Interrupt: p = unsigned(ZeroPipe::Interrupt); break;
+                case EndpointType::Isochronous: p = unsigned(ZeroPipe::Isochronous); break;
+                default: continue;
+            }
+
+            // endpoints repeated in alternate setting 1 are used in alternate setting 0
+            auto& pipe = pipes[p];
+            if (pipe.alternate != alternate && (pipe.in || pipe.out))
+                continue;
+
+            (epd->bEndpointAddress & 0x80 ? pipe.in : pipe.out) = epd->bEndpointAddress;
+            pipe.alternate = alternate;
+            pipe.maxPacketSize = epd->MaxPacketSize() * epd->Transactions();
+        }
+    }
+
+    return Has(ZeroPipe::Bulk);
+}
+
+bool ZeroRunner::SetInterface(uint8_t alternate)
+{
+    return Control(SetupPacket::DirOut, SetupPacket::TypeStandard, SetupPacket::RecipientInterface, SetupPacket::StdSetInterface,
+        alternate, interface, NULL, 0) >= 0;
+}
+
+ZeroRunResult ZeroRunner::Run(ZeroMode mode, ZeroPipe pipe, ZeroPattern pattern, uint32_t length, uint32_t count)
+{
+    ZeroRunResult res = {};
+    auto& p = pipes[unsigned(pipe)];
+    bool loopback = mode == ZeroMode::Loopback;
+
+    if (!Has(pipe) || !length || (loopback ? 2 * length : length) > bufferSize || !SetInterface(p.alternate))
+    {
+        res.failures = count;
+        return res;
+    }
+
+    ZeroRunParameters params = { mode, pattern, uint8_t(BIT(unsigned(pipe))), 0, length };
+    if (Control(SetupPacket::DirOut, SetupPacket::TypeVendor, SetupPacket::RecipientInterface, uint8_t(ZeroRequest::Start),
+        0, interface, &params, sizeof(params)) < 0)
+    {
+        res.failures = count;
+        count = 0;
+    }
+
+    uint8_t* tx = buffer;
+    uint8_t* rx = loopback ? buffer + length : buffer;
+    if (mode != ZeroMode::Source)
+        ZeroFill(pattern, tx, length, p.maxPacketSize);
+
+    uint64_t start = Nanoseconds();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t t0 = Nanoseconds();
+        bool ok;
+
+        if (mode == ZeroMode::Source)
+        {
+            int n = Transfer(p.in, rx, length);
+            res.bytes += n > 0 ? n : 0;
+            ok = n == int(length);
+            if (ok && !ZeroCheck(pattern, rx, length, p.maxPacketSize))
+                res.errors++;
+        }
+        else
+        {
+            int n = Transfer(p.out, tx, length);
+            res.bytes += n > 0 ? n : 0;
+            ok = n == int(length);
+            if (ok && loopback)
+            {
+                n = Transfer(p.in, rx, length);
+                res.bytes += n > 0 ? n : 0;
+                ok = n == int(length);
+                if (ok && memcmp(tx, rx, length))
+                    res.errors++;
+            }
+        }
+
+        if (!ok)
+        {
+            res.failures++;
+            continue;
+        }
+
+        uint64_t latency = Nanoseconds() - t0;
+        res.transfers++;
+        if (res.samples < maxSamples)
+            samples[res.samples++] = latency < 0xFFFFFFFF ? latency : 0xFFFFFFFF;
+    }
+    res.time = Nanoseconds() - start;
+
+    Control(SetupPacket::DirOut, SetupPacket::TypeVendor, SetupPacket::RecipientInterface, uint8_t(ZeroRequest::Stop), 0, interface, NULL, 0);
+    if (Control(SetupPacket::DirIn, SetupPacket::TypeVendor, SetupPacket::RecipientInterface, uint8_t(ZeroRequest::GetStats),
+        0, interface, &res.device, sizeof(ZeroStats)) != sizeof(ZeroStats))
+        res.device = {};
+    if (p.alternate)
+        SetInterface(0);
+
+    // insertion sort, the number of samples is limited by the caller
+    for (size_t i = 1; i < res.samples; i++)
+    {
+        uint32_t s = samples[i];
+        size_t j = i;
+        for (; j > 0 && samples[j - 1] > s; j--)
+            samples[j] = samples[j - 1];
+        samples[j] = s;
+    }
+
+    if (res.samples)
+    {
+        // nearest-rank percentiles
+        for (size_t i = 0; i < countof(Percentiles); i++)
+        {
+            size_t rank = (res.samples * Percentiles[i] + 99) / 100;
+            res.latency[i] = samples[rank ? rank - 1 : 0];
+        }
+    }
+
+    return res;
+}
+
+size_t ZeroRunner::Format(char* buffer, size_t size, const char* name, const ZeroRunResult& result)
+{
+    return JsonWriter(buffer, size)
+        .String("name", name)
+        .Number("bytes", result.bytes)
+        .Fixed("mb_per_s", result.BytesPerSecond() / 1000)
+        .Number("transfers", result.transfers)
+        .Number("failures", result.failures)
+        .Number("errors", result.errors)
+        .Fixed("p50_us", result.latency[0])
+        .Fixed("p90_us", result.latency[1])
+        .Fixed("p99_us", result.latency[2])
+        .Fixed("max_us", result.latency[3])
+        .Number("device_elapsed_us", result.device.elapsed)
+        .Number("device_errors", result.device.errors)
+        .Finish();
+}
+
+}
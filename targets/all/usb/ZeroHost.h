@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2026 triaxis s.r.o.
+ * Licensed under the MIT license. See LICENSE.txt file in the repository root
+ * for full license information.
+ *
+ * efm32-usb/usb/ZeroHost.h
+ *
+ * Host-side runner of the Zero function throughput and latency tests
+ */
+
+#pragma once
+
+#include <base/base.h>
+
+#include <usb/HostParser.h>
+#include <usb/VirtualHost.h>
+#include <usb/Zero.h>
+
+namespace usb
+{
+
+//! Results of a single test run performed by ZeroRunner
+struct ZeroRunResult
+{
+    uint64_t time;          //!< Host-side duration of the run in nanoseconds
+    uint64_t bytes;         //!< Payload bytes transferred, in both directions for Loopback
+    uint32_t transfers;     //!< Transfers (round trips for Loopback) completed in full
+    uint32_t failures;      //!< Transfers that failed, timed out or were short
+    uint32_t errors;        //!< Transfers received by the host not matching the pattern or the looped back data
+    uint32_t samples;       //!< Number of latency samples
+    uint32_t latency[4];    //!< Transfer (Loopback round trip) latency percentiles in nanoseconds, see ZeroRunner::Percentiles
+    ZeroStats device;       //!< Counters reported by the device after the run, all zero if they could not be read
+
+    //! Gets the throughput of the run
+    uint64_t BytesPerSecond() const { return time ? bytes * 1000000000ull / time : 0; }
+};
+
+//! Runs the source, sink and loopback tests of a Zero function from the host
+/*!
+ * Each run selects the alternate setting containing the pipe, starts the device side using
+ * ZeroRequest::Start, performs the requested number of transfers of equal length while timing
+ * each of them (including both directions of a Loopback round trip), stops the device
+ * and reads back its counters. The data received by the host is verified against the pattern
+ * (or against the data sent in Loopback mode).
+ *
+ * The bus access is provided by a derived class, VirtualZeroRunner drives an in-process
+ * VirtualHost, so the tests can run without hardware.
+ */
+class ZeroRunner
+{
+public:
+    //! Percentiles reported in ZeroRunResult::latency (the last one is the maximum)
+    static constexpr uint8_t Percentiles[] = { 50, 90, 99, 100 };
+
+    //! Creates the runner using @p buffer of @p bufferSize bytes for the data and up to @p maxSamples latency samples
+    /*!
+     * Loopback runs need twice the transfer length in the buffer, samples beyond @p maxSamples are not included in the percentiles
+     */
+    ZeroRunner(uint8_t* buffer, size_t bufferSize, uint32_t* samples, size_t maxSamples)
+        : buffer(buffer), samples(samples), bufferSize(bufferSize), maxSamples(maxSamples) {}
+
+    //! Locates the endpoints of the Zero function with the specified interface number in a parsed configuration
+    bool Attach(const HostConfig& config, uint8_t interface);
+    //! Checks if the pipe was found by Attach
+    bool Has(ZeroPipe pipe) const { return pipes[unsigned(pipe)].in && pipes[unsigned(pipe)].out; }
+
+    //! Measures the device sending @p count transfers of @p length bytes on the pipe
+    ZeroRunResult Source(ZeroPipe pipe, ZeroPattern pattern, uint32_t length, uint32_t count) { return Run(ZeroMode::Source, pipe, pattern, length, count); }
+    //! Measures the device receiving @p count transfers of @p length bytes on the pipe
+    ZeroRunResult Sink(ZeroPipe pipe, ZeroPattern pattern, uint32_t length, uint32_t count) { return Run(ZeroMode::Sink, pipe, pattern, length, count); }
+    //! Measures @p count round trips of @p length bytes looped back by the device on the pipe
+    ZeroRunResult Loopback(ZeroPipe pipe, ZeroPattern pattern, uint32_t length, uint32_t count) { return Run(ZeroMode::Loopback, pipe, pattern, length, count); }
+
+    //! Formats the result as a single line of JSON, returns the length of the output (excluding the null terminator)
+    /*!
+     * Throughput is reported as mb_per_s in MB/s (10^6 bytes per second) with three decimals, latencies in microseconds
+     */
+    static size_t Format(char* buffer, size_t size, const char* name, const ZeroRunResult& result);
+
+protected:
+    //! Performs a control transfer, returns the length of the data stage or -1 if the request failed
+    virtual int Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+        uint16_t value, uint16_t index, void* data, uint16_t length) = 0;
+    //! Performs a transfer on a non-control endpoint, returns the number of bytes transferred or -1 on failure
+    virtual int Transfer(uint8_t address, void* data, size_t length) = 0;
+    //! Gets the current time in nanoseconds from a monotonic clock
+    virtual uint64_t Nanoseconds() = 0;
+
+private:
+    struct Pipe
+    {
+        uint8_t in, out;        // endpoint addresses, zero if not found
+        uint8_t alternate;      // alternate setting containing the endpoints
+        uint16_t maxPacketSize; // packet size the pattern restarts at
+    };
+
+    uint8_t* buffer;
+    uint32_t* samples;
+    size_t bufferSize;
+    size_t maxSamples;
+    uint8_t interface = 0;
+    Pipe pipes[unsigned(ZeroPipe::_Count)] = {};
+
+    ZeroRunResult Run(ZeroMode mode, ZeroPipe pipe, ZeroPattern pattern, uint32_t length, uint32_t count);
+    bool SetInterface(uint8_t alternate);
+};
+
+//! ZeroRunner performing the tests on a VirtualHost, timed by the simulated bus time
+class VirtualZeroRunner : public ZeroRunner
+{
+public:
+    //! Creates the runner, @p timeout limits every transfer to the specified number of (micro)frames
+    VirtualZeroRunner(VirtualHost& host, uint8_t* buffer, size_t bufferSize, uint32_t* samples, size_t maxSamples, uint32_t timeout = 1000)
+        : ZeroRunner(buffer, bufferSize, samples, maxSamples), host(host), timeout(timeout) {}
+
+protected:
+    int Control(SetupPacket::Direction direction, SetupPacket::Type type, SetupPacket::Recipient recipient, uint8_t request,
+        uint16_t value, uint16_t index, void* data, uint16_t length) override
+    {
+        return host.Control(direction, type, recipient, request, value, index, data, length);
+    }
+
+    int Transfer(uint8_t address, void* data, size_t length) override { return host.Transfer(address, data, length, false, timeout); }
+    uint64_t Nanoseconds() override { return host.Now(); }
+
+private:
+    VirtualHost& host;
+    uint32_t timeout;
+};
+
+}